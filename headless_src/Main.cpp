@@ -0,0 +1,83 @@
+#include <OSP.h>
+#include <game/HeadlessRunner.h>
+#include <stdexcept>
+
+// ospgl_headless: runs a replay without renderer, see HeadlessRunner.h
+// Takes the same arguments as ospgl, plus (as setting overrides, so they may also go in settings.toml):
+//  -headless.replay=replays/debug_launch.toml	Replay to run, relative to udata
+//  -headless.ticks=N							Overrides the ticks of the replay
+//  -headless.checksum_every=N					Also logs the checksum every N ticks
+//  -headless.expect=0x...						Exits with 1 if the final checksum is different, 2 if it's not
+//												a hexadecimal number
+// It also exits with 1 if any check of the replay's [expect] table fails, and with 2 if the replay
+// has invalid fields
+//  -headless.trace=trace.json					Writes a Chrome trace of the run, relative to udata
+int main(int argc, char** argv)
+{
+	osp = new OSP();
+	osp->init(argc, argv, true);
+	// The help menu was shown
+	if(osp->assets == nullptr)
+	{
+		return 0;
+	}
+
+	auto config = osp->config;
+	std::string replay = config->get_qualified_as<std::string>("headless.replay")
+			.value_or("replays/debug_launch.toml");
+
+	// Parsed before running, so a typo doesn't waste a whole run
+	auto expect = config->get_qualified_as<std::string>("headless.expect");
+	uint64_t expected = 0;
+	if(expect)
+	{
+		size_t end = 0;
+		try
+		{
+			expected = std::stoull(*expect, &end, 16);
+		}
+		catch(const std::logic_error&)
+		{
+			// invalid_argument or out_of_range
+			end = 0;
+		}
+
+		// stoull also takes negative numbers
+		if(end == 0 || end != expect->size() || expect->find('-') != std::string::npos)
+		{
+			logger->error("Invalid headless.expect '{}', it must be a 64 bit hexadecimal checksum", *expect);
+			osp->finish();
+			return 2;
+		}
+	}
+
+	HeadlessRunner runner(replay);
+	if(!runner.valid)
+	{
+		osp->finish();
+		return 2;
+	}
+	runner.ticks = config->get_qualified_as<int64_t>("headless.ticks").value_or(runner.ticks);
+	runner.checksum_every = config->get_qualified_as<int64_t>("headless.checksum_every").value_or(0);
+	runner.trace_path = config->get_qualified_as<std::string>("headless.trace").value_or("");
+	logger->check(runner.trace_path.empty() || osp->assets->is_path_safe(runner.trace_path), "Unsafe trace path");
+
+	uint64_t sum = runner.run();
+
+	int ret = runner.failed_expectations > 0 ? 1 : 0;
+	if(expect)
+	{
+		if(expected != sum)
+		{
+			logger->error("Checksum mismatch, expected 0x{:016x}, the simulation is not deterministic", expected);
+			ret = 1;
+		}
+		else
+		{
+			logger->info("Checksum matches");
+		}
+	}
+
+	osp->finish();
+	return ret;
+}
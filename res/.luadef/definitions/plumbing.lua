@@ -15,8 +15,8 @@ function plumbing_machine:create_port(id, marker, ui_name, is_flow_port, x, y) e
 --
 ---@class plumbing.fluid_map
 plumbing.fluid_map = {}
----@return assets.physical_material mat
----@return plumbing.stored_fluid
+--- Stored fluids may be modified while iterating, but don't add new materials to the container!
+---@return fun():assets.physical_material, plumbing.stored_fluid
 function plumbing.fluid_map:pairs() end
 
 ---@class plumbing.stored_fluid
@@ -99,4 +99,8 @@ function plumbing.stored_fluids:react(T, react_V, liquid_react_factor, dt) end
 ---@return plumbing.stored_fluids
 function plumbing.stored_fluids.new() end
 
+---@param iterations integer
+--- Logs the time taken by react and by moving fluids around on a few typical tank mixtures
+function plumbing.stored_fluids.benchmark(iterations) end
+
 return plumbing
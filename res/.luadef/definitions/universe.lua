@@ -7,6 +7,7 @@
 ---@field system universe.planetary_system
 ---@field entities universe.entity[] Read only
 ---@field save_db universe.save_database
+---@field timewarp universe.timewarp
 local universe = {}
 
 ---@param event_id string
@@ -33,6 +34,33 @@ function universe:get_entity(id) end
 ---@param dt number
 function universe:update(dt) end
 
+---@class universe.timewarp
+--- Puts vehicles on rails and advances the system without bullet
+local timewarp = {}
+
+---@param rate number Rates of 1 or lower end warp
+---@return boolean false if warp can't start because an entity is not timewarp safe
+function timewarp:set_rate(rate) end
+
+---@return number
+---@nodiscard
+function timewarp:get_rate() end
+
+---@return boolean
+---@nodiscard
+function timewarp:is_warping() end
+
+---@return integer
+---@nodiscard
+function timewarp:get_vehicles_on_rails() end
+
+---@param count integer Light states to put on rails, a quarter of them landed
+---@param rate number
+---@param frames integer Frames of 1/60s to simulate
+---@return number simulated seconds per wall second, also logged
+--- The system is restored afterwards, can't be used while warping
+function timewarp:benchmark(count, rate, frames) end
+
 ---@class universe.planetary_system
 ---@field elements universe.element[]
 local planetary_system = {}
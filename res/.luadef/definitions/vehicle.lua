@@ -18,6 +18,7 @@ local container = {}
 ---@field parts vehicle.part[]
 ---@field root vehicle.piece
 ---@field meta vehicle_meta
+---@field plumbing vehicle.plumbing
 container.vehicle = {}
 
 ---@param event_id string
@@ -74,6 +75,16 @@ function container.vehicle:get_piece_by_id(id) end
 ---@return vehicle.part|nil
 function container.vehicle:get_part_by_id(id) end
 
+---@return boolean
+---@nodiscard
+--- Vehicles can go on rails if they are landed, or away from surfaces and atmospheres
+function container.vehicle:is_timewarp_safe() end
+
+---@return integer
+---@nodiscard
+--- Index of the element the vehicle is resting on, or -1 if it's not landed
+function container.vehicle:get_landed_element() end
+
 ---@return glm.vec3 minimum bound (z is lower, floor of the vehicle)
 ---@return glm.vec3 maximum bound (z is higher, ceiling of the vehicle)
 function container.vehicle:get_bounds() end
@@ -95,6 +106,85 @@ function container.vehicle:move_piece(piece, pos, rot, marker) end
 ---  -> angular velocity (optional glm.vec3)
 function packed_vehicle:set_world_state(state) end
 
+---@return universe.world_state
+---@nodiscard
+--- State of the root piece, but velocity is that of the center of mass
+function packed_vehicle:get_world_state() end
+
+---@return glm.vec3
+---@nodiscard
+function packed_vehicle:get_com_position() end
+
+
+---@enum vehicle.plumbing_solver
+container.plumbing_solver = {
+	--- Finds every path between two true ports and flows over the forced ones
+	paths = 0,
+	--- Solves the pressure of every port and junction
+	nodal = 1
+}
+
+---@class vehicle.plumbing
+local vehicle_plumbing = {}
+
+---@return vehicle.plumbing_solver
+---@nodiscard
+function vehicle_plumbing:get_solver() end
+
+---@param solver vehicle.plumbing_solver
+function vehicle_plumbing:set_solver(solver) end
+
+---@return integer
+---@nodiscard
+function vehicle_plumbing:get_path_count() end
+
+---@return integer
+---@nodiscard
+function vehicle_plumbing:get_flowing_path_count() end
+
+---@return integer
+---@nodiscard
+function vehicle_plumbing:get_graph_rebuilds() end
+
+---@return integer
+---@nodiscard
+function vehicle_plumbing:get_reductions() end
+
+---@return integer
+---@nodiscard
+--- Iterations of the last solve of the nodal solver
+function vehicle_plumbing:get_network_iterations() end
+
+---@return number
+---@nodiscard
+--- Biggest flow imbalance in a junction after the last solve of the nodal solver, relative to the biggest flow
+function vehicle_plumbing:get_network_residual() end
+
+---@return number
+---@nodiscard
+--- In seconds
+function vehicle_plumbing:get_last_update_time() end
+
+--- Forces the plumbing graph to be rebuilt on the next update
+function vehicle_plumbing:invalidate_graph() end
+
+---@return boolean
+--- Rebuilds the plumbing graph and checks it's the same as the cached one, logs an error if not
+function vehicle_plumbing:check_graph_cache() end
+
+---@param value boolean
+--- If true, the cached plumbing graph is checked every update (slow)
+function vehicle_plumbing:set_check_cache(value) end
+
+---@return boolean
+function vehicle_plumbing:get_check_cache() end
+
+---@param ticks integer
+--- Logs the time per tick of finding the flows with the selected solver, with and without the cached graph
+function vehicle_plumbing:benchmark(ticks) end
+
+--- Logs the flows found by both solvers on every true port and how much they differ
+function vehicle_plumbing:compare_solvers() end
 
 ---@class vehicle.unpacked
 local unpacked_vehicle = {}
@@ -113,6 +203,32 @@ function unpacked_vehicle:get_velocity() end
 ---@nodiscard
 function unpacked_vehicle:get_orientation(renderer) end
 
+--- Time spent checking for broken links in the last update
+---@return number seconds
+---@nodiscard
+function unpacked_vehicle:get_last_link_check_time() end
+
+---@param native boolean Count native links if true, lua links otherwise
+---@return integer
+---@nodiscard
+function unpacked_vehicle:get_link_count(native) end
+
+--- Lua links only count their wrapper, their environments live in the shared lua state
+---@return integer bytes
+---@nodiscard
+function unpacked_vehicle:get_link_memory_usage() end
+
+--- Time spent rebuilding physics (welded groups and links) the last time the vehicle changed
+---@return number seconds
+---@nodiscard
+function unpacked_vehicle:get_last_build_time() end
+
+--- Separates stages (evenly spread welded pieces) one by one and logs the rebuild times,
+--- the vehicle is welded back afterwards
+---@param stages integer
+---@param iterations integer
+function unpacked_vehicle:benchmark(stages, iterations) end
+
 
 ---@class vehicle.welded_group
 local welded_group = {}
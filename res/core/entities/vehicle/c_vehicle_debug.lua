@@ -1,10 +1,15 @@
 local imgui = require("imgui")
+local vehicle = require("vehicle")
+local plumbing_lib = require("plumbing")
 
 local vehicle_debug = {}
 
 vehicle_debug.shown_machines = {}
 
 function vehicle_debug:draw_main()
+	self:plumbing_tab()
+	self:links_tab()
+	self:timewarp_tab()
 	self:parts_tab()
 end
 
@@ -22,6 +27,66 @@ function vehicle_debug:draw_machines()
 	end
 end
 
+function vehicle_debug:plumbing_tab()
+	local plumbing = self.vehicle.plumbing
+	if imgui.collapsing_header("Plumbing") then
+		local nodal = plumbing:get_solver() == vehicle.plumbing_solver.nodal
+		if imgui.checkbox("Nodal solver", nodal) ~= nodal then
+			plumbing:set_solver(nodal and vehicle.plumbing_solver.paths or vehicle.plumbing_solver.nodal)
+		end
+		if nodal then
+			imgui.text(string.format("Iterations: %i, residual: %.2e", plumbing:get_network_iterations(),
+				plumbing:get_network_residual()))
+		else
+			imgui.text("Paths: " .. plumbing:get_path_count() .. " (" .. plumbing:get_flowing_path_count() .. " flowing)")
+		end
+		imgui.text("Graph rebuilds: " .. plumbing:get_graph_rebuilds() .. ", reductions: " .. plumbing:get_reductions())
+		local check = plumbing:get_check_cache()
+		if imgui.checkbox("Check graph cache", check) ~= check then
+			plumbing:set_check_cache(not check)
+		end
+		imgui.text(string.format("Last update: %.4fms", plumbing:get_last_update_time() * 1000.0))
+		if imgui.button("Benchmark plumbing") then
+			plumbing:benchmark(1000)
+		end
+		imgui.same_line()
+		if imgui.button("Compare solvers") then
+			plumbing:compare_solvers()
+		end
+		imgui.same_line()
+		if imgui.button("Benchmark fluids") then
+			plumbing_lib.stored_fluids.benchmark(10000)
+		end
+	end
+end
+
+function vehicle_debug:links_tab()
+	if self.vehicle:is_packed() then return end
+	local unpacked = self.vehicle.unpacked
+	if imgui.collapsing_header("Links") then
+		imgui.text("Native: " .. unpacked:get_link_count(true) .. ", lua: " .. unpacked:get_link_count(false))
+		imgui.text(string.format("Link memory: %.2fKB (shared lua state: %.2fKB)",
+			unpacked:get_link_memory_usage() / 1024.0, collectgarbage("count")))
+		imgui.text(string.format("Link check: %.4fms", unpacked:get_last_link_check_time() * 1000.0))
+		imgui.text(string.format("Last physics rebuild: %.4fms", unpacked:get_last_build_time() * 1000.0))
+		if imgui.button("Benchmark separation") then
+			unpacked:benchmark(8, 10)
+		end
+	end
+end
+
+function vehicle_debug:timewarp_tab()
+	local timewarp = osp.universe.timewarp
+	if imgui.collapsing_header("Timewarp") then
+		imgui.text("Safe: " .. tostring(self.vehicle:is_timewarp_safe()) ..
+			", landed on: " .. self.vehicle:get_landed_element())
+		imgui.text("Rate: " .. timewarp:get_rate() .. "x, vehicles on rails: " .. timewarp:get_vehicles_on_rails())
+		if not timewarp:is_warping() and imgui.button("Benchmark timewarp") then
+			timewarp:benchmark(500, 10000, 60)
+		end
+	end
+end
+
 function vehicle_debug:parts_tab()
 	for _, part in ipairs(self.vehicle.parts) do
 		imgui.push_id(part.id)
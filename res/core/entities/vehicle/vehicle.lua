@@ -56,7 +56,7 @@ end
 
 function get_position(physics)
     if vehicle:is_packed() then
-        return glm.vec3.new(0, 0, 0)
+        return vehicle.packed:get_com_position()
     else
         return vehicle.unpacked:get_center_of_mass(not physics)
     end
@@ -64,7 +64,7 @@ end
 
 function get_velocity(physics)
 	if vehicle:is_packed() then 
-		return glm.vec3.new(0, 0, 0)
+		return vehicle.packed:get_world_state().vel
 	else 
 		return vehicle.unpacked:get_velocity()
 	end
@@ -72,12 +72,20 @@ end
 
 function get_orientation(physics)
 	if vehicle:is_packed() then
-		return glm.quat.new(1, 0, 0, 0)
+		return vehicle.packed:get_world_state().rot
 	else
 		return vehicle.unpacked:get_orientation(true)
 	end
 end
 
+function get_vehicle()
+	return vehicle
+end
+
+function timewarp_safe()
+	return vehicle:is_timewarp_safe()
+end
+
 function separate_vehicle(veh)
     osp.universe:create_entity("core:entities/vehicle/vehicle.lua", veh)
 end
@@ -6,6 +6,7 @@ require("universe")
 local assets = require("assets")
 local debug_drawer = require("debug_drawer")
 local glm = require("glm")
+local input = require("input")
 local veh_spawner = require("core:scenes/vehicle_spawner.lua")
 
 local renderer = osp.renderer
@@ -65,6 +66,23 @@ local function late_init()
 	interactable_veh:init(veh)
 end
 
+-- Changed with the period and comma keys
+local warp_rates = {1, 5, 10, 50, 100, 1000, 10000, 100000}
+local warp_index = 1
+
+local function update_timewarp()
+	if gui_input.keyboard_blocked or gui_input.ext_keyboard_blocked then return end
+	local n_index = warp_index
+	if input.key_down(input.key.period) then
+		n_index = math.min(warp_index + 1, #warp_rates)
+	elseif input.key_down(input.key.comma) then
+		n_index = math.max(warp_index - 1, 1)
+	end
+	if n_index ~= warp_index and universe.timewarp:set_rate(warp_rates[n_index]) then
+		warp_index = n_index
+	end
+end
+
 function pre_update(dt)
 	osp.universe:update(dt)
 end
@@ -95,6 +113,7 @@ function update(dt)
 		end
 	end
 	gui_input.ext_keyboard_blocked = gui_input.ext_keyboard_blocked or ent_blocked_kb
+	update_timewarp()
 	
 	gui_screen:input_pass()
 	local cu = camera:get_camera_uniforms(lwidth, lheight)
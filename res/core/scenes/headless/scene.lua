@@ -0,0 +1,69 @@
+-- The scene used by the headless runner (ospgl_headless), like the flight scene
+-- but without renderer, gui or camera. The runner feeds it the replayed inputs
+local logger = require("logger")
+require("universe")
+local assets = require("assets")
+local input = require("input")
+local veh_spawner = require("core:scenes/vehicle_spawner.lua")
+
+local universe = osp.universe
+
+---@type universe.entity
+local controlled_ent = nil
+local vehicle_file = nil
+local launchpad_name = nil
+
+-- We get passed the udata vehicle to spawn and the launchpad (of the first entity) to spawn it at
+function load(vehicle, launchpad)
+	vehicle_file = vehicle
+	launchpad_name = launchpad
+end
+
+-- Same as in the flight scene, the launchpad is ready after the first update
+local function late_init()
+	local pad = universe.entities[1]
+	local lpad = pad.lua.get_launchpads()[launchpad_name]
+	assert(lpad, "Launchpad " .. launchpad_name .. " not found")
+	local veh = veh_spawner.spawn_vehicle_at_launchpad(universe, assets.get_udata_vehicle(vehicle_file), lpad, true)
+	assert(veh, "Could not spawn " .. vehicle_file)
+	logger.info("Spawned " .. vehicle_file .. " at launchpad " .. launchpad_name)
+
+	controlled_ent = veh
+end
+
+-- Changed with the period and comma keys, as in the flight scene
+local warp_rates = {1, 5, 10, 50, 100, 1000, 10000, 100000}
+local warp_index = 1
+
+local function update_timewarp()
+	local n_index = warp_index
+	if input.key_down(input.key.period) then
+		n_index = math.min(warp_index + 1, #warp_rates)
+	elseif input.key_down(input.key.comma) then
+		n_index = math.max(warp_index - 1, 1)
+	end
+	if n_index ~= warp_index and universe.timewarp:set_rate(warp_rates[n_index]) then
+		warp_index = n_index
+	end
+end
+
+function pre_update(dt)
+	osp.universe:update(dt)
+end
+
+local first_frame = true
+
+function update(dt)
+	if first_frame then
+		if vehicle_file then late_init() end
+		first_frame = false
+	end
+
+	if controlled_ent then
+		local input_ctx = controlled_ent:get_input_ctx()
+		if input_ctx then
+			input_ctx:update(false, dt)
+		end
+	end
+	update_timewarp()
+end
@@ -21,6 +21,8 @@ local renderer = osp.renderer
 local anim = nil
 
 local predictor = orbit.quick_predictor.new(universe.system)
+predictor:set_priority(orbit.prediction_priority.focused)
+predictor:set_use_ephemeris(true)
 predictor:launch()
 
 
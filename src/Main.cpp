@@ -21,17 +21,19 @@ int main(int argc, char** argv)
 	double fps_t = 0.0;
 	double dt_avg = 0.0;
 
-	PROFILE_FUNC();
-
 	while (osp->should_loop())
 	{
-		PROFILE_BLOCK("frame");
+		{
+			PROFILE_BLOCK("frame");
 
-		osp->start_frame();
-		osp->update();
-		osp->render();
-		osp->finish_frame();
+			osp->start_frame();
+			osp->update();
+			osp->render();
+			osp->finish_frame();
+		}
 
+		// After the frame block closes, so it's included in this frame
+		PROFILE_FRAME();
 	}
 
 	osp->finish();
@@ -9,6 +9,7 @@
 #include <game/GameState.h>
 #include <game/database/GameDatabase.h>
 #include <util/ThreadUtil.h>
+#include <universe/SimulationThread.h>
 
 InputUtil* input;
 
@@ -69,7 +70,7 @@ bool is_number(const std::string& s)
 	return !s.empty() && it == s.end();
 }
 
-void OSP::init(int argc, char** argv)
+void OSP::init(int argc, char** argv, bool headless)
 {
 	set_this_thread_name("main");
 	argh::parser args(argc, argv);
@@ -127,7 +128,7 @@ void OSP::init(int argc, char** argv)
 		
 		// Load settings
 		std::string settings_file = AssetManager::load_string_raw(udata_path + settings_path);
-		std::shared_ptr<cpptoml::table> config = SerializeUtil::load_string(settings_file);
+		config = SerializeUtil::load_string(settings_file);
 		if(!config)
 		{
 			logger->fatal("Could not load settings file!");
@@ -175,22 +176,43 @@ void OSP::init(int argc, char** argv)
 		auto locale_toml = config->get_qualified_as<std::string>("locale.language");
 		current_locale = locale_toml ? *locale_toml : "en";
 
+		threaded_simulation = config->get_qualified_as<bool>("simulation.threaded").value_or(false);
+
 		assets = new AssetManager(res_path, udata_path);
-		renderer = new Renderer(*config);
-		audio_engine = new AudioEngine(*config);
+		if(headless)
+		{
+			// No window, GL context or audio device. The simulation thread
+			// needs a renderer to take turns with, so it's always disabled
+			threaded_simulation = false;
+		}
+		else
+		{
+			renderer = new Renderer(*config);
+			audio_engine = new AudioEngine(*config);
+		}
 		create_global_debug_drawer();
-		create_global_texture_drawer();
-		create_global_text_drawer();
+		if(!headless)
+		{
+			create_global_texture_drawer();
+			create_global_text_drawer();
+		}
 		create_global_lua_core();
 		create_global_profiler();
 
 
 		game_database = new GameDatabase();
 		input = new InputUtil();
-		input->setup(renderer->window);
+		if(!headless)
+		{
+			input->setup(renderer->window);
+		}
 
 		dt = 0.0;
-		launch_menu(to_load);
+		// Headless, whoever drives the simulation loads the game state
+		if(!headless)
+		{
+			launch_menu(to_load);
+		}
 	}
 }
 
@@ -200,6 +222,7 @@ void OSP::finish()
 	delete game_state;
 	delete input;
 	destroy_global_lua_core();
+	destroy_global_profiler();
 	destroy_global_text_drawer();
 	destroy_global_texture_drawer();
 	destroy_global_debug_drawer();
@@ -233,6 +256,11 @@ void OSP::start_frame()
 void OSP::update()
 {
 	PROFILE_FUNC();
+	// Wait for the simulation thread to finish its turn
+	if(game_state->universe.sim_thread)
+	{
+		game_state->universe.sim_thread->acquire();
+	}
 	game_state->update();
 }
 
@@ -242,8 +270,19 @@ void OSP::render()
 
 	if(renderer != nullptr)
 	{
-		game_state->render();
 		// It's the responsability of the Scene to call renderer render
+		game_state->render();
+	}
+
+	// Nothing touches the universe while presenting, so the simulation thread runs meanwhile,
+	// until acquire() at the start of the next update (see SimulationThread)
+	if(game_state->universe.sim_thread)
+	{
+		game_state->universe.sim_thread->release();
+	}
+
+	if(renderer != nullptr)
+	{
 		renderer->do_imgui();
 		renderer->finish();
 	}
@@ -252,6 +291,11 @@ void OSP::render()
 void OSP::finish_frame()
 {
 	double max_dt = game_state->universe.MAX_PHYSICS_STEPS * game_state->universe.PHYSICS_STEPSIZE;
+	if(threaded_simulation)
+	{
+		// The simulation thread catches up with long frames
+		max_dt = SimulationThread::MAX_FRAME_DT;
+	}
 	dt = dtt.restart();
 	game_dt = dt;
 
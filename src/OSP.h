@@ -35,6 +35,12 @@ public:
 	// For use with user input unrelated to simulation (cameras and similar)
 	double game_dt{};
 
+	// Run bullet on its own thread (simulation.threaded in settings), see SimulationThread
+	bool threaded_simulation{};
+
+	// The loaded settings, with the command line overrides applied
+	std::shared_ptr<cpptoml::table> config;
+
 	AssetManager* assets{};
 	Renderer* renderer{};
 	AudioEngine* audio_engine{};
@@ -43,7 +49,9 @@ public:
 	Universe* universe;
 
 	constexpr static const char* OSP_VERSION = "PRE-RELEASE";
-	void init(int argc, char** argv);
+	// Headless creates no renderer (and thus no window or GL context), audio engine
+	// or game state, see the headless runner (HeadlessRunner.h)
+	void init(int argc, char** argv, bool headless = false);
 	void finish();
 	
 	bool should_loop();
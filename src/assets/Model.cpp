@@ -458,7 +458,8 @@ void Model::get_gpu()
 {
 	gpu_users++;
 
-	if (!uploaded)
+	// Headless there's no GL context, models are only used for their data
+	if (!uploaded && osp->renderer != nullptr)
 	{
 		upload();
 	}
@@ -1,6 +1,8 @@
 #include "AudioEngine.h"
 #include <miniaudio/miniaudio.h>
 #include <util/Logger.h>
+#include <util/Profiler.h>
+#include <util/ThreadUtil.h>
 #include <GLFW/glfw3.h>
 #include <glm/gtc/constants.hpp>
 #include "AudioSource.h"
@@ -158,6 +160,14 @@ void AudioEngine::set_listener(glm::dvec3 pos, glm::dvec3 fwd, glm::dvec3 up, gl
 // TODO: We could use many optimizations, such as SIMD if possible
 void AudioEngine::data_callback(ma_device* device, void* output, const void* input, ma_uint32 frames)
 {
+	// The thread is created by miniaudio, we name it on the first callback (before profiling)
+	thread_local bool named = false;
+	if(!named)
+	{
+		set_this_thread_name("audio");
+		named = true;
+	}
+	PROFILE_BLOCK("audio_mix");
 
 	auto* engine = (AudioEngine*)device->pUserData;
 	float* foutput = (float*)output;
@@ -15,7 +15,10 @@ void GameState::write(cpptoml::table& target) const
 
 void GameState::physics_update(double bdt)
 {
-	scene->physics_update(bdt);
+	if(scene)
+	{
+		scene->physics_update(bdt);
+	}
 }
 
 void GameState::update()
@@ -92,7 +95,7 @@ GameState* GameState::create_empty(const std::string &planetary_system_package)
 	return out;
 }
 
-GameState *GameState::load(const std::string &path)
+GameState *GameState::load(const std::string &path, bool load_save_scene)
 {
 	GameState* out = new GameState();
 	// TODO: This could be moved somewhere else, but it's important
@@ -135,8 +138,11 @@ GameState *GameState::load(const std::string &path)
 	out->load_inner(*root);
 
 	// Finally, we may load the scene
-	auto scene_toml = root->get_table("scene");
-	out->load_scene_from_save(*scene_toml);
+	if(load_save_scene)
+	{
+		auto scene_toml = root->get_table("scene");
+		out->load_scene_from_save(*scene_toml);
+	}
 
 	return out;
 }
@@ -59,7 +59,9 @@ public:
 	void reload_system(bool buildings = true, bool elements = false);
 
 	static GameState* create_main_menu(const std::string& skip_to_save);
-	static GameState* load(const std::string& path);
+	// If load_save_scene is false no scene is loaded (use load_scene), the save's
+	// scene may need a renderer
+	static GameState* load(const std::string& path, bool load_save_scene = true);
 
 	void write();
 
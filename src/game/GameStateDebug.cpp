@@ -3,6 +3,8 @@
 #include "GameState.h"
 #include <algorithm>
 #include <util/InputUtil.h>
+#include <universe/SimulationThread.h>
+#include <util/Profiler.h>
 
 void GameStateDebug::update()
 {
@@ -39,6 +41,18 @@ void GameStateDebug::update()
 			do_scene();
 			ImGui::End();
 		}
+		if(planets_undocked)
+		{
+			ImGui::Begin("Planets");
+			do_planets();
+			ImGui::End();
+		}
+		if(profiler_undocked)
+		{
+			ImGui::Begin("Profiler");
+			do_profiler();
+			ImGui::End();
+		}
 
 		for(Entity* e : osp->universe->entities)
 		{
@@ -67,6 +81,8 @@ GameStateDebug::GameStateDebug(GameState* gamestate)
 	assets_undocked = false;
 	entities_undocked = false;
 	scene_undocked = false;
+	planets_undocked = false;
+	profiler_undocked = false;
 	override_camera = false;
 	centered_camera = nullptr;
 }
@@ -116,17 +132,66 @@ void GameStateDebug::do_scene()
 	g->scene->do_imgui_debug();
 }
 
+void GameStateDebug::do_planets()
+{
+	do_docking_button(&planets_undocked);
+
+	for(SystemElement* elem : osp->universe->system.elements)
+	{
+		RockyPlanetRenderer* rocky = elem->renderer.rocky;
+		if(rocky == nullptr || rocky->server == nullptr)
+		{
+			continue;
+		}
+
+		ImGui::PushID(elem);
+		if(ImGui::CollapsingHeader(elem->name.c_str()))
+		{
+			rocky->renderer.do_imgui();
+			rocky->server->do_imgui();
+		}
+		ImGui::PopID();
+	}
+}
+
 void GameStateDebug::do_assets()
 {
 	do_docking_button(&assets_undocked);
 }
 
+void GameStateDebug::do_profiler()
+{
+	do_docking_button(&profiler_undocked);
+	ImGui::SameLine();
+	if(profiler->is_capturing())
+	{
+		if(ImGui::Button("End capture"))
+		{
+			profiler->end_capture(osp->assets->udata_path + "profiler_trace.json");
+		}
+	}
+	else
+	{
+		if(ImGui::Button("Begin capture"))
+		{
+			profiler->begin_capture();
+		}
+	}
+	profiler->show_imgui();
+}
+
 void GameStateDebug::do_launcher()
 {
 	ImGui::Begin("Debug menu");
 	ImGui::Text("Toggle with Ctrl+Alt+F12 / º / `");
 	// Basic perfomance info
 	ImGui::Text("FPS: %i | Game FPS: %i", (int)(1.0 / osp->game_dt), (int)(1.0 / osp->dt));
+	SimulationThread* sim_thread = g->universe.sim_thread;
+	if(sim_thread)
+	{
+		ImGui::Text("Simulation thread: %i ticks in %.2fms last turn", (int)sim_thread->get_last_turn_ticks(),
+			  sim_thread->get_last_turn_time() * 1000.0);
+	}
 	if(override_camera)
 	{
 		if(ImGui::Button("Free camera"))
@@ -155,6 +220,16 @@ void GameStateDebug::do_launcher()
 		do_scene();
 		ImGui::EndTabItem();
 	}
+	if(!planets_undocked && ImGui::BeginTabItem("Planets"))
+	{
+		do_planets();
+		ImGui::EndTabItem();
+	}
+	if(!profiler_undocked && ImGui::BeginTabItem("Profiler"))
+	{
+		do_profiler();
+		ImGui::EndTabItem();
+	}
 	ImGui::EndTabBar();
 
 
@@ -23,11 +23,15 @@ private:
 	void do_launcher();
 	void do_assets();
 	void do_scene();
+	void do_planets();
+	void do_profiler();
 
 	bool terminal_undocked;
 	bool entities_undocked;
 	bool assets_undocked;
 	bool scene_undocked;
+	bool planets_undocked;
+	bool profiler_undocked;
 
 	static void do_docking_button(bool* val);
 
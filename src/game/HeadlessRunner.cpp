@@ -0,0 +1,334 @@
+#include "HeadlessRunner.h"
+#include "GameState.h"
+#include "scenes/LuaScene.h"
+#include <OSP.h>
+#include <util/Timer.h>
+#include <util/Profiler.h>
+#include <util/DebugDrawer.h>
+#include <universe/vehicle/Vehicle.h>
+#include <physics/ground/GroundShape.h>
+#include <algorithm>
+#include <cstring>
+
+static constexpr uint64_t FNV_OFFSET = 0xcbf29ce484222325ULL;
+static constexpr uint64_t FNV_PRIME = 0x100000001b3ULL;
+
+static void hash_bytes(uint64_t& h, const void* data, size_t size)
+{
+	const auto* bytes = (const uint8_t*)data;
+	for(size_t i = 0; i < size; i++)
+	{
+		h ^= bytes[i];
+		h *= FNV_PRIME;
+	}
+}
+
+static void hash_double(uint64_t& h, double v)
+{
+	hash_bytes(h, &v, sizeof(double));
+}
+
+static void hash_dvec3(uint64_t& h, const glm::dvec3& v)
+{
+	hash_double(h, v.x);
+	hash_double(h, v.y);
+	hash_double(h, v.z);
+}
+
+static void hash_dquat(uint64_t& h, const glm::dquat& q)
+{
+	hash_double(h, q.x);
+	hash_double(h, q.y);
+	hash_double(h, q.z);
+	hash_double(h, q.w);
+}
+
+// The padding component of btVector3 is not hashed, it may be anything
+static void hash_btvec3(uint64_t& h, const btVector3& v)
+{
+	hash_double(h, (double)v.x());
+	hash_double(h, (double)v.y());
+	hash_double(h, (double)v.z());
+}
+
+static void hash_bttform(uint64_t& h, const btTransform& tform)
+{
+	hash_btvec3(h, tform.getOrigin());
+	for(int i = 0; i < 3; i++)
+	{
+		hash_btvec3(h, tform.getBasis()[i]);
+	}
+}
+
+void HeadlessRunner::apply_inputs(int64_t tick)
+{
+	// Same as InputUtil::update, but keys come from the replay
+	std::memcpy(input->prev_key_status, input->current_key_status, InputUtil::KEY_LIST_SIZE * sizeof(bool));
+	std::fill(input->current_key_status, input->current_key_status + InputUtil::KEY_LIST_SIZE, false);
+	input->repeating_key = -1;
+
+	for(const KeyHold& hold : keys)
+	{
+		if(tick >= hold.from && tick < hold.to)
+		{
+			input->current_key_status[hold.key] = true;
+		}
+	}
+}
+
+uint64_t HeadlessRunner::checksum()
+{
+	Universe& universe = game_state->universe;
+	PlanetarySystem& sys = universe.system;
+	uint64_t h = FNV_OFFSET;
+
+	hash_double(h, sys.t);
+	hash_double(h, sys.bt);
+	for(const CartesianState& st : sys.states_now)
+	{
+		hash_dvec3(h, st.pos);
+		hash_dvec3(h, st.vel);
+	}
+
+	for(Entity* e : universe.entities)
+	{
+		int64_t uid = e->get_uid();
+		hash_bytes(h, &uid, sizeof(int64_t));
+		hash_dvec3(h, e->get_position(true));
+		hash_dvec3(h, e->get_velocity(true));
+		hash_dquat(h, e->get_orientation(true));
+
+		Vehicle* v = e->get_vehicle();
+		if(v == nullptr || v->is_packed())
+		{
+			continue;
+		}
+
+		for(Piece* p : v->all_pieces)
+		{
+			hash_bttform(h, p->get_global_transform());
+			hash_btvec3(h, p->get_linear_velocity());
+			hash_btvec3(h, p->get_angular_velocity());
+		}
+	}
+
+	return h;
+}
+
+void HeadlessRunner::log_timings(double wall)
+{
+	const UniverseTimings& tm = game_state->universe.timings;
+	double sim_time = (double)ticks * Universe::PHYSICS_STEPSIZE;
+
+	logger->info("Headless run of {}: {} ticks ({} bullet ticks, {:.1f}s simulated) in {:.3f}s, {:.1f}x real time",
+				 replay_path, ticks, tm.ticks, sim_time, wall, sim_time / std::max(wall, 1e-9));
+
+	// bullet includes physics_update which includes plumbing, each line is exclusive
+	double bullet = tm.bullet - tm.physics_update;
+	double physics_update = tm.physics_update - tm.plumbing;
+	double other = wall - tm.system - tm.entities - tm.bullet;
+
+	auto line = [this, wall](const char* name, double time)
+	{
+		logger->info("  {:<16} {:10.3f}ms total {:8.4f}ms per tick {:6.2f}%",
+					 name, time * 1000.0, time * 1000.0 / (double)std::max(ticks, (int64_t)1),
+					 time / std::max(wall, 1e-9) * 100.0);
+	};
+
+	line("system", tm.system);
+	line("entities", tm.entities);
+	line("bullet", bullet);
+	line("physics_update", physics_update);
+	line("plumbing", tm.plumbing);
+	line("other", other);
+}
+
+size_t HeadlessRunner::count_ground_tiles(size_t& memory)
+{
+	size_t tiles = 0;
+	memory = 0;
+	for(SystemElement* elem : game_state->universe.system.elements)
+	{
+		// ground_shape is not initialized on bodies without surface
+		if(elem->config.has_surface)
+		{
+			GroundShapeServer* server = elem->ground_shape->get_server();
+			tiles += server->cache.size();
+			memory += server->get_memory_usage();
+		}
+	}
+	return tiles;
+}
+
+void HeadlessRunner::check_expectations()
+{
+	failed_expectations = 0;
+	size_t end_memory;
+	size_t end_tiles = count_ground_tiles(end_memory);
+	// Same MB as surface.physics_cache_mb
+	double peak_mb = (double)peak_ground_memory / 1000000.0;
+	logger->info("Ground tiles: peak {} ({:.2f}MB), {} at the end", peak_ground_tiles, peak_mb, end_tiles);
+
+	if(expect.max_ground_memory_mb >= 0.0 && peak_mb > expect.max_ground_memory_mb)
+	{
+		logger->error("Expectation failed: ground tiles used {:.2f}MB, limit is {:.2f}MB",
+					  peak_mb, expect.max_ground_memory_mb);
+		failed_expectations++;
+	}
+
+	if(expect.max_ground_tiles >= 0 && peak_ground_tiles > (size_t)expect.max_ground_tiles)
+	{
+		logger->error("Expectation failed: {} ground tiles cached, limit is {}",
+					  peak_ground_tiles, expect.max_ground_tiles);
+		failed_expectations++;
+	}
+
+	if(expect.max_ground_tiles_at_end >= 0 && end_tiles > (size_t)expect.max_ground_tiles_at_end)
+	{
+		logger->error("Expectation failed: {} ground tiles cached at the end, limit is {}",
+					  end_tiles, expect.max_ground_tiles_at_end);
+		failed_expectations++;
+	}
+}
+
+uint64_t HeadlessRunner::run()
+{
+	game_state = GameState::load(save, false);
+	Universe& universe = game_state->universe;
+
+	std::vector<sol::object> args;
+	if(!vehicle.empty())
+	{
+		args.push_back(sol::make_object(universe.lua_state, vehicle));
+		args.push_back(sol::make_object(universe.lua_state, launchpad));
+	}
+	game_state->load_scene(new LuaScene(game_state, "core:scenes/headless/scene.lua", "", args));
+
+	osp->dt = Universe::PHYSICS_STEPSIZE;
+	osp->game_dt = Universe::PHYSICS_STEPSIZE;
+	universe.timings.reset();
+	if(!trace_path.empty())
+	{
+		profiler->begin_capture();
+	}
+
+	peak_ground_tiles = 0;
+	peak_ground_memory = 0;
+	// Checksums are not part of the run
+	double checksum_time = 0.0;
+	double start = Timer::now();
+	for(int64_t tick = 0; tick < ticks; tick++)
+	{
+		apply_inputs(tick);
+		game_state->scene->pre_update();
+		game_state->scene->update();
+		// Nothing renders, so nothing would clear it
+		debug_drawer->clear();
+		PROFILE_FRAME();
+
+		size_t memory;
+		peak_ground_tiles = std::max(peak_ground_tiles, count_ground_tiles(memory));
+		peak_ground_memory = std::max(peak_ground_memory, memory);
+
+		if(checksum_every > 0 && (tick + 1) % checksum_every == 0)
+		{
+			double cstart = Timer::now();
+			logger->info("Tick {}: checksum 0x{:016x}", tick + 1, checksum());
+			checksum_time += Timer::now() - cstart;
+		}
+	}
+	double wall = Timer::now() - start - checksum_time;
+
+	log_timings(wall);
+	if(!trace_path.empty())
+	{
+		profiler->end_capture(osp->assets->udata_path + trace_path);
+	}
+
+	check_expectations();
+	uint64_t sum = checksum();
+	logger->info("Final checksum: 0x{:016x}", sum);
+
+	// After the checksum, even if the benchmark restores the system
+	if(timewarp_bench.count > 0)
+	{
+		universe.timewarp.benchmark((size_t)timewarp_bench.count, timewarp_bench.rate,
+									(size_t)timewarp_bench.frames);
+	}
+	return sum;
+}
+
+HeadlessRunner::HeadlessRunner(const std::string& replay_path)
+{
+	this->replay_path = replay_path;
+	game_state = nullptr;
+	checksum_every = 0;
+	failed_expectations = 0;
+	peak_ground_tiles = 0;
+	peak_ground_memory = 0;
+	valid = true;
+
+	logger->check(osp->assets->is_path_safe(replay_path), "Unsafe replay path");
+	auto root = SerializeUtil::load_file(osp->assets->udata_path + replay_path);
+
+	save = root->get_as<std::string>("save").value_or("debug-save/");
+	ticks = root->get_as<int64_t>("ticks").value_or(900);
+	vehicle = root->get_as<std::string>("vehicle").value_or("");
+	launchpad = root->get_as<std::string>("launchpad").value_or("main");
+
+	auto expect_table = root->get_table("expect");
+	if(expect_table)
+	{
+		expect.max_ground_memory_mb = expect_table->get_as<double>("max_ground_memory_mb")
+				.value_or(expect.max_ground_memory_mb);
+		expect.max_ground_tiles = expect_table->get_as<int64_t>("max_ground_tiles")
+				.value_or(expect.max_ground_tiles);
+		expect.max_ground_tiles_at_end = expect_table->get_as<int64_t>("max_ground_tiles_at_end")
+				.value_or(expect.max_ground_tiles_at_end);
+	}
+
+	auto bench_table = root->get_table("timewarp_benchmark");
+	if(bench_table)
+	{
+		timewarp_bench.count = bench_table->get_as<int64_t>("count").value_or(500);
+		timewarp_bench.rate = bench_table->get_as<double>("rate").value_or(timewarp_bench.rate);
+		timewarp_bench.frames = bench_table->get_as<int64_t>("frames").value_or(timewarp_bench.frames);
+		if(timewarp_bench.count < 0 || timewarp_bench.rate <= 1.0 || timewarp_bench.frames <= 0)
+		{
+			logger->error("[timewarp_benchmark] of replay {} needs count >= 0, rate > 1 and frames > 0",
+						  replay_path);
+			valid = false;
+		}
+	}
+
+	auto key_tables = root->get_table_array("key");
+	if(key_tables)
+	{
+		for(size_t i = 0; i < key_tables->get().size(); i++)
+		{
+			const auto& key_table = key_tables->get()[i];
+			auto key = key_table->get_as<int64_t>("key");
+			auto from = key_table->get_as<int64_t>("from");
+			auto to = key_table->get_as<int64_t>("to");
+			if(!key || !from || (!to && key_table->contains("to")))
+			{
+				logger->error("[[key]] number {} of replay {} needs integer key and from (and to, if present)",
+							  i + 1, replay_path);
+				valid = false;
+				continue;
+			}
+
+			KeyHold hold;
+			hold.key = (int)*key;
+			hold.from = *from;
+			hold.to = to.value_or(hold.from + 1);
+			if(*key < 0 || *key >= (int64_t)InputUtil::KEY_LIST_SIZE)
+			{
+				logger->error("Invalid key {} in replay {}", *key, replay_path);
+				valid = false;
+				continue;
+			}
+			keys.push_back(hold);
+		}
+	}
+}
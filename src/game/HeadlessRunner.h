@@ -0,0 +1,95 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <cstdint>
+
+class GameState;
+
+// Runs a save without renderer (OSP::init with headless) for a fixed amount of ticks,
+// replaying recorded inputs, and logs the time spent on each subsystem (UniverseTimings)
+// and a checksum of the simulation state. The same replay on the same build must give
+// the same checksum, so it's both the determinism regression check and the benchmark
+// for performance changes. Entry point is headless_src/Main.cpp (ospgl_headless target)
+//
+// Replays are toml files in udata (for example udata/replays/debug_launch.toml) with the
+// save, the amount of ticks, the udata vehicle to spawn and its launchpad, and which keys
+// are held on each tick. Every tick is a frame of exactly Universe::PHYSICS_STEPSIZE,
+// so bullet steps once per frame (like the game running at 30fps).
+// The scene is core:scenes/headless/scene.lua, not the one in the save
+// Replays may also have an [expect] table with limits checked over the run, which
+// makes long replays soak tests (see udata/replays/ground_soak.toml), and a
+// [timewarp_benchmark] table to run TimeWarp::benchmark once the replay is done
+// (see udata/replays/timewarp_bench.toml)
+class HeadlessRunner
+{
+private:
+
+	struct KeyHold
+	{
+		// GLFW key code, as in the input configs
+		int key;
+		// Held during ticks [from, to)
+		int64_t from, to;
+	};
+
+	std::string replay_path;
+	std::string save;
+	// Empty if nothing is spawned
+	std::string vehicle;
+	std::string launchpad;
+	std::vector<KeyHold> keys;
+
+	// Negative means not checked. Ground tiles and memory are of every body together
+	struct Expectations
+	{
+		// Highest over every tick
+		double max_ground_memory_mb = -1.0;
+		int64_t max_ground_tiles = -1;
+		// After the last tick
+		int64_t max_ground_tiles_at_end = -1;
+	};
+	Expectations expect;
+
+	// Arguments of TimeWarp::benchmark, not run if count is 0
+	struct TimewarpBenchmark
+	{
+		int64_t count = 0;
+		double rate = 10000.0;
+		int64_t frames = 60;
+	};
+	TimewarpBenchmark timewarp_bench;
+
+	size_t peak_ground_tiles;
+	size_t peak_ground_memory;
+
+	GameState* game_state;
+
+	void apply_inputs(int64_t tick);
+	void log_timings(double wall);
+	// Returns the physics tiles cached by every body, and their memory in bytes
+	size_t count_ground_tiles(size_t& memory);
+	// Logs an error for every failed expectation
+	void check_expectations();
+
+public:
+
+	int64_t ticks;
+	// The checksum is also logged every this many ticks, to find where two runs diverge.
+	// 0 only logs it at the end
+	int64_t checksum_every;
+	// If not empty, a profiler trace of the run is written there (relative to udata)
+	std::string trace_path;
+	// Checks of the [expect] table that failed, set by run()
+	int failed_expectations;
+	// False if the replay has invalid fields (they are logged), then run() must not be called
+	bool valid;
+
+	// FNV-1a of the bits of the system time and states, and of the position, velocity and
+	// orientation of every entity (and every piece of unpacked vehicles)
+	uint64_t checksum();
+
+	// Loads the save and runs the replay, returns the final checksum
+	uint64_t run();
+
+	explicit HeadlessRunner(const std::string& replay_path);
+};
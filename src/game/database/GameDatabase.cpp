@@ -117,18 +117,19 @@ void GameDatabase::add_reaction(const std::string &path, const std::string &pkg)
 
 void GameDatabase::finish_loading()
 {
-	// Build the reaction map
+	// Known materials get the lowest ids, the rest are interned as they are used
+	for(const std::string& mat : materials)
+	{
+		material_registry.intern(AssetHandle<PhysicalMaterial>(mat));
+	}
+
+	// Compile the reactions (remember equilibria, they may go both ways!)
 	for(const std::string& react : reactions)
 	{
 		ChemicalReaction reaction;
 		std::string reaction_path = osp->assets->resolve_path(react);
 		SerializeUtil::read_file_to(reaction_path, reaction);
-
-		// Find the reactants / products (remember equilibria!)
-		for(StechiometricMaterial& mat : reaction.reactants)
-		{
-			material_to_reactions.insert({mat.reactant, reaction});
-		}
+		material_registry.add_reaction(reaction);
 	}
 
 }
@@ -3,7 +3,7 @@
 #include <string>
 #include <assets/AssetManager.h>
 #include <assets/PhysicalMaterial.h>
-#include <universe/vehicle/material/ChemicalReaction.h>
+#include <universe/vehicle/material/MaterialRegistry.h>
 
 // Stores different game assets, such as parts, planetary systems, toolbars...
 // that may be used by the user and not by code. This is different from assets
@@ -22,10 +22,9 @@ class GameDatabase
 public:
 
 
-	// We use this interesting data structure for reactions
-	// This way, to find all possible reactions for a combination of materials we need to check
-	// only one of them and we save the computation to load time
-	std::multimap<std::string, ChemicalReaction> material_to_reactions;
+	// Materials are interned here, and reactions compiled to use the interned ids, so finding
+	// the possible reactions for a combination of materials is just a few bit operations
+	MaterialRegistry material_registry;
 	std::vector<std::string> parts;
 	std::vector<std::string> plumbing_machines;
 	std::vector<std::string> systems;
@@ -3,6 +3,7 @@
 #include "../GameState.h"
 #include "renderer/Renderer.h"
 #include <gui/skins/SimpleSkin.h>
+#include <util/Profiler.h>
 
 LuaScene::LuaScene(GameState* in_state, const std::string& scene_script, const std::string& in_pkg,
 				   std::vector<sol::object> args) :
@@ -12,7 +13,11 @@ LuaScene::LuaScene(GameState* in_state, const std::string& scene_script, const s
 	this->to_pass_args = args;
 	this->in_pkg = in_pkg;
 	this->lua_state = &in_state->universe.lua_state;
-	osp->renderer->cam = &cam;
+	// Headless scenes have nothing to render
+	if(osp->renderer != nullptr)
+	{
+		osp->renderer->cam = &cam;
+	}
 
 	auto[pkg, name] = osp->assets->get_package_and_name(scene_script, in_pkg);
 	this->name = pkg + ":" + name;
@@ -44,23 +49,27 @@ void LuaScene::load()
 
 void LuaScene::pre_update()
 {
+	PROFILE_BLOCK("lua_scene_pre_update");
 	LuaUtil::call_function_if_present(env["pre_update"], osp->dt);
 }
 
 
 void LuaScene::update()
 {
+	PROFILE_BLOCK("lua_scene_update");
 	gui_input.update();
 	LuaUtil::call_function_if_present(env["update"], osp->dt);
 }
 
 void LuaScene::physics_update(double bdt)
 {
+	PROFILE_BLOCK("lua_scene_physics_update");
 	LuaUtil::call_function_if_present(env["physics_update"], bdt);
 }
 
 void LuaScene::render()
 {
+	PROFILE_BLOCK("lua_scene_render");
 	LuaUtil::call_function_if_present(env["render"]);
 }
 
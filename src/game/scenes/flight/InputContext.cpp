@@ -100,7 +100,8 @@ void InputContext::obtain_joystick_states()
 {
 	for(int jid = 0; jid < 16; jid++)
 	{
-		if(glfwJoystickPresent(jid))
+		// Headless GLFW is not initialized, there are no joysticks
+		if(osp->renderer != nullptr && glfwJoystickPresent(jid))
 		{
 			joystick_states[jid].is_present = true;
 			joystick_states[jid].axes = glfwGetJoystickAxes(jid, &joystick_states[jid].axes_count);
@@ -165,9 +166,19 @@ double InputContext::get_joystick_axis(int jid, int axis)
 }
 
 
+bool InputContext::is_key_pressed(int key)
+{
+	if(osp->renderer == nullptr)
+	{
+		// Headless there's no window, keys are set on the global input (by the replay)
+		return input->key_pressed(key);
+	}
+
+	return glfwGetKey(osp->renderer->window, key) == GLFW_PRESS;
+}
+
 bool InputContext::update(bool keyboard_blocked, double dt)
 {
-	GLFWwindow* window = osp->renderer->window;
 	obtain_joystick_states();
 
 	for(auto pair : actions)
@@ -181,7 +192,7 @@ bool InputContext::update(bool keyboard_blocked, double dt)
 	{	
 		for(auto& map : key_action_mappings)
 		{
-			if(glfwGetKey(window, map.key) == GLFW_PRESS)
+			if(is_key_pressed(map.key))
 			{
 				actions[map.to_action] = true;
 				kb_blocked = true;
@@ -217,13 +228,13 @@ bool InputContext::update(bool keyboard_blocked, double dt)
 
 		if(!keyboard_blocked)
 		{
-			if(glfwGetKey(window, map.plus_key) == GLFW_PRESS)
+			if(is_key_pressed(map.plus_key))
 			{
 				change += 1.0;
 				kb_blocked = true;
 			}
 
-			if(glfwGetKey(window, map.minus_key) == GLFW_PRESS)
+			if(is_key_pressed(map.minus_key))
 			{
 				change -= 1.0;
 				kb_blocked = true;
@@ -104,6 +104,7 @@ private:
 	std::array<JoystickState, 16> joystick_states;
 
 	void obtain_joystick_states();
+	bool is_key_pressed(int key);
 	
 	void init_config(cpptoml::table& base, cpptoml::table& target);
 
@@ -4,6 +4,11 @@
 
 void LuaOrbit::load_to(sol::table &table)
 {
+	table.new_enum("prediction_priority",
+		"focused", OrbitPredictionServer::Priority::FOCUSED,
+		"visible", OrbitPredictionServer::Priority::VISIBLE,
+		"background", OrbitPredictionServer::Priority::BACKGROUND);
+
 	table.new_usertype<QuickPredictor>("quick_predictor",
 	   "new", [](PlanetarySystem* sys)
 			{
@@ -11,6 +16,11 @@ void LuaOrbit::load_to(sol::table &table)
 			},
 			"get_drawer", &QuickPredictor::get_drawer,
 			"update", &QuickPredictor::update,
+			"set_integrator", &QuickPredictor::set_integrator,
+			"set_use_ephemeris", &QuickPredictor::set_use_ephemeris,
+			"set_priority", &QuickPredictor::set_priority,
+			"invalidate", &QuickPredictor::invalidate,
+			"stop", &QuickPredictor::stop,
 			"launch", &QuickPredictor::launch);
 
 	table.new_usertype<LandedTrajectory>("landed_trajectory", sol::no_constructor,
@@ -1,6 +1,7 @@
 #include "LuaPlumbing.h"
 #include <universe/vehicle/plumbing/PlumbingMachine.h>
 #include "LuaAssets.h"
+#include <game/database/GameDatabase.h>
 
 void LuaPlumbing::load_to(sol::table &table)
 {
@@ -11,6 +12,7 @@ void LuaPlumbing::load_to(sol::table &table)
 	table.new_usertype<StoredFluids>("stored_fluids",
 	 sol::constructors<StoredFluids()>(),
 		"get_contents", &StoredFluids::get_contents,
+		"benchmark", &StoredFluids::benchmark,
 		"add_fluid", [](StoredFluids& self, const LuaAssetHandle<PhysicalMaterial>& mat, float liquid, float gas)
 		{
 			self.add_fluid(mat.get_asset_handle(), liquid, gas);
@@ -38,17 +40,39 @@ void LuaPlumbing::load_to(sol::table &table)
 		 "react", &StoredFluids::react,
 		sol::meta_function::to_string, [](const StoredFluids& f)
 		{
+			const MaterialRegistry& registry = osp->game_database->material_registry;
 			std::string list = "Fluid contents: ";
-			for(const auto& pair : f.contents)
+			for(const StoredFluids::Entry& entry : f.get_fluids())
 			{
-				std::string substr = fmt::format("{}: {{{} kg liquid, {} kg gas}}; ", pair.first->name,
-												 pair.second.liquid_mass, pair.second.gas_mass);
+				std::string substr = fmt::format("{}: {{{} kg liquid, {} kg gas}}; ", registry.get(entry.id)->name,
+												 entry.fluid.liquid_mass, entry.fluid.gas_mass);
 				list += substr;
 			}
 			return list;
 		}
  	);
 
+	// Iterated with "for phys_mat, stored_fluid in contents:pairs() do", the stored fluids may be
+	// modified but don't add new materials to the container while iterating!
+	table.new_usertype<StoredFluids::Contents>("fluid_map", sol::no_constructor,
+		"pairs", [](const StoredFluids::Contents& self)
+		{
+			StoredFluids* fluids = self.fluids;
+			size_t i = 0;
+			return sol::as_function([fluids, i](sol::this_state st) mutable
+			{
+				sol::state_view lua(st);
+				if(i >= fluids->get_fluids().size())
+				{
+					return std::make_tuple(sol::make_object(lua, sol::lua_nil), sol::make_object(lua, sol::lua_nil));
+				}
+
+				StoredFluids::Entry& entry = fluids->get_fluids()[i++];
+				const PhysicalMaterial* mat = osp->game_database->material_registry.get(entry.id);
+				return std::make_tuple(sol::make_object(lua, mat), sol::make_object(lua, &entry.fluid));
+			});
+		});
+
 	table.new_usertype<StoredFluid>("stored_fluid",
 		"liquid_mass", &StoredFluid::liquid_mass,
 		"gas_mass", &StoredFluid::gas_mass,
@@ -2,6 +2,7 @@
 
 #include <utility>
 #include <universe/entity/Entity.h>
+#include <physics/ground/GroundShape.h>
 #include <game/scenes/flight/InputContext.h>
 #include "LuaEvents.h"
 
@@ -15,6 +16,7 @@ void LuaUniverse::load_to(sol::table& table)
 		"bt_world", &Universe::bt_world,
 		"save_db", &Universe::save_db,
 		"system", &Universe::system_ptr,
+		"timewarp", &Universe::timewarp,
 		"get_entity", &Universe::get_entity,
 		"entities", sol::property([](Universe* uv)
 		  {
@@ -36,11 +38,24 @@ void LuaUniverse::load_to(sol::table& table)
 		 }
 	);
 
+	table.new_usertype<TimeWarp>("timewarp", sol::no_constructor,
+		"set_rate", &TimeWarp::set_rate,
+		"get_rate", &TimeWarp::get_rate,
+		"is_warping", &TimeWarp::is_warping,
+		"get_vehicles_on_rails", &TimeWarp::get_vehicles_on_rails,
+		"benchmark", &TimeWarp::benchmark
+	);
+
 	table.new_usertype<PlanetarySystem>("planetary_system", sol::base_classes, sol::bases<Drawable>(),
 	        "get_element_position", &PlanetarySystem::get_element_position,
 			"get_element_velocity", &PlanetarySystem::get_element_velocity,
 			"get_element", &PlanetarySystem::get_element,
-			"elements", &PlanetarySystem::elements
+			"elements", &PlanetarySystem::elements,
+			"set_propagator", [](PlanetarySystem* self, const std::string& name)
+			{
+				return self->set_propagator(name);
+			},
+			"get_propagator_name", &PlanetarySystem::get_propagator_name
 	);
 
 	table.new_usertype<SystemElement>("system_element",
@@ -49,7 +64,12 @@ void LuaUniverse::load_to(sol::table& table)
 			  "nbody", sol::readonly(&SystemElement::nbody),
 			  "config", sol::readonly(&SystemElement::config),
 			  "dot_factor", sol::readonly(&SystemElement::dot_factor),
-			  "render_enabled", &SystemElement::render_enabled
+			  "render_enabled", &SystemElement::render_enabled,
+			  "benchmark_ground", [](SystemElement* self, size_t queries)
+			  {
+				  logger->check(self->config.has_surface, "{} has no surface to benchmark", self->name);
+				  self->ground_shape->benchmark(queries);
+			  }
 			  );
 
 	table.new_usertype<ElementConfig>("element_confg",
@@ -25,6 +25,7 @@ void LuaVehicle::load_to(sol::table& table)
 		 "new", [](){return std::make_shared<Vehicle>();},
 			EVENT_EMITTER_SIGN_UP(Vehicle),
 			"meta", &Vehicle::meta,
+			"plumbing", &Vehicle::plumbing,
 		 	"is_packed", &Vehicle::is_packed,
 			 "move_piece", &Vehicle::move_piece,
 		 	"packed", &Vehicle::packed_veh,
@@ -48,7 +49,9 @@ void LuaVehicle::load_to(sol::table& table)
 		 	"get_connected_to", &Vehicle::get_connected_to,
 		 	"get_connected_with", &Vehicle::get_connected_with,
 			 "get_part_by_id", &Vehicle::get_part_by_id,
-			 "get_piece_by_id", &Vehicle::get_piece_by_id);//,
+			 "get_piece_by_id", &Vehicle::get_piece_by_id,
+			 "is_timewarp_safe", &Vehicle::is_timewarp_safe,
+			 "get_landed_element", &Vehicle::get_landed_element);//,
 		//"get_attached_to", sol::overload(
 		//	sol::resolve<std::vector<Piece*>(Piece*)>(Vehicle::get_attached_to),
 		//	sol::resolve<Piece*(Piece*, const std::string&)>(Vehicle::get_attached_to)
@@ -59,12 +62,40 @@ void LuaVehicle::load_to(sol::table& table)
 	      "set_world_state", [](PackedVehicle* self, sol::table wstate)
 		  {
 				self->set_world_state(decode_worldstate_table(wstate));
-		  });
+		  },
+	      "get_world_state", &PackedVehicle::get_world_state,
+	      "get_com_position", &PackedVehicle::get_com_position);
+
+	table.new_enum("plumbing_solver",
+		"paths", VehiclePlumbing::Solver::PATHS,
+		"nodal", VehiclePlumbing::Solver::NODAL);
+
+	table.new_usertype<VehiclePlumbing>("vehicle_plumbing", sol::no_constructor,
+		 "get_solver", &VehiclePlumbing::get_solver,
+		 "set_solver", &VehiclePlumbing::set_solver,
+		 "get_path_count", &VehiclePlumbing::get_path_count,
+		 "get_flowing_path_count", &VehiclePlumbing::get_flowing_path_count,
+		 "get_graph_rebuilds", &VehiclePlumbing::get_graph_rebuilds,
+		 "get_reductions", &VehiclePlumbing::get_reductions,
+		 "get_network_iterations", &VehiclePlumbing::get_network_iterations,
+		 "get_network_residual", &VehiclePlumbing::get_network_residual,
+		 "get_last_update_time", &VehiclePlumbing::get_last_update_time,
+		 "invalidate_graph", &VehiclePlumbing::invalidate_graph,
+		 "check_graph_cache", &VehiclePlumbing::check_graph_cache,
+		 "set_check_cache", &VehiclePlumbing::set_check_cache,
+		 "get_check_cache", &VehiclePlumbing::get_check_cache,
+		 "benchmark", &VehiclePlumbing::benchmark,
+		 "compare_solvers", &VehiclePlumbing::compare_solvers);
 
 	table.new_usertype<UnpackedVehicle>("unpacked_vehicle", sol::no_constructor,
 		 "get_center_of_mass", &UnpackedVehicle::get_center_of_mass,
 		 "get_velocity", &UnpackedVehicle::get_velocity,
-		 "get_orientation", &UnpackedVehicle::get_orientation);
+		 "get_orientation", &UnpackedVehicle::get_orientation,
+		 "get_last_link_check_time", &UnpackedVehicle::get_last_link_check_time,
+		 "get_link_count", &UnpackedVehicle::get_link_count,
+		 "get_link_memory_usage", &UnpackedVehicle::get_link_memory_usage,
+		 "get_last_build_time", &UnpackedVehicle::get_last_build_time,
+		 "benchmark", &UnpackedVehicle::benchmark);
 
 	table.new_usertype<Piece>("piece",
 		"rigid_body", &Piece::rigid_body,
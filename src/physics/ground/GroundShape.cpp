@@ -1,4 +1,12 @@
 #include "GroundShape.h"
+#include <planet_mesher/quadtree/QuadTreePlanet.h>
+#include <algorithm>
+#include <random>
+#include <chrono>
+
+#pragma warning(push, 0)
+#include <BulletDynamics/Dynamics/btRigidBody.h>
+#pragma warning(pop)
 
 
 
@@ -43,67 +51,224 @@ void GroundShape::processAllTriangles(btTriangleCallback* callback, const btVect
 		glm::dvec3 aabb0 = to_dvec3(aabb_b0);
 		glm::dvec3 aabb1 = to_dvec3(aabb_b1);
 
-		glm::dvec3 daabb = aabb1 - aabb0;
+		std::vector<PlanetTileKey> keys;
+		get_tiles_in_aabb(aabb0, aabb1, keys);
 
-		// We need to "project" the aabb into the sphere, to do so we build the box
-		// with all its vertices
-		glm::dvec3 aabb_box[8];
-		aabb_box[0] = aabb0;
-		aabb_box[1] = aabb0 + glm::dvec3(daabb.x, 0.0, 0.0);
-		aabb_box[2] = aabb0 + glm::dvec3(daabb.x, 0.0, daabb.z);
-		aabb_box[3] = aabb0 + glm::dvec3(0.0, 0.0, daabb.z);
-		aabb_box[4] = aabb0 + glm::dvec3(0.0, daabb.y, 0.0);
-		aabb_box[5] = aabb0 + glm::dvec3(daabb.x, daabb.y, 0.0);
-		aabb_box[6] = aabb0 + glm::dvec3(0.0, daabb.y, daabb.z);
-		aabb_box[7] = aabb1;
+		server->queries++;
+		for (PlanetTileKey key : keys)
+		{
+			GroundShapeServer::TileAndTriangles* tile = server->query(key, 1.0);
+			server->process_aabb(tile, callback, aabb_b0, aabb_b1);
+		}
+	}
+}
 
-		// We create a new quad tree every time, perfomance is not that bad
-		QuadTreePlanet quad_tree = QuadTreePlanet();
+size_t GroundShape::get_physics_depth() const
+{
+	size_t depth = body->config.surface.max_depth + PlanetTile::PHYSICS_GRAPHICS_RELATION - 1;
+	return std::min(depth, PlanetTileKey::MAX_DEPTH);
+}
+
+void GroundShape::get_tiles_in_aabb(glm::dvec3 aabb0, glm::dvec3 aabb1, std::vector<PlanetTileKey>& out) const
+{
+	glm::dvec3 daabb = aabb1 - aabb0;
 
+	// We need to "project" the aabb into the sphere, to do so we build the box
+	// with all its vertices
+	glm::dvec3 aabb_box[8];
+	aabb_box[0] = aabb0;
+	aabb_box[1] = aabb0 + glm::dvec3(daabb.x, 0.0, 0.0);
+	aabb_box[2] = aabb0 + glm::dvec3(daabb.x, 0.0, daabb.z);
+	aabb_box[3] = aabb0 + glm::dvec3(0.0, 0.0, daabb.z);
+	aabb_box[4] = aabb0 + glm::dvec3(0.0, daabb.y, 0.0);
+	aabb_box[5] = aabb0 + glm::dvec3(daabb.x, daabb.y, 0.0);
+	aabb_box[6] = aabb0 + glm::dvec3(0.0, daabb.y, daabb.z);
+	aabb_box[7] = aabb1;
 
-		glm::dvec3 normalized[8];
+	size_t depth = get_physics_depth();
 
-		size_t wanted_depth = body->config.surface.max_depth + PlanetTile::PHYSICS_GRAPHICS_RELATION - 1;
+	// Tiles of the corners, and the range they span on each side they touch, so
+	// boxes bigger than a tile get all the tiles in between too
+	bool has_side[6] = { false, false, false, false, false, false };
+	uint32_t min_x[6], min_y[6], max_x[6], max_y[6];
+
+	for (size_t i = 0; i < 8; i++)
+	{
+		PlanetTileKey key = QuadTreePlanet::get_key_at(glm::normalize(aabb_box[i]), depth);
+		PlanetSide side = key.get_side();
+		uint32_t x, y;
+		key.get_xy(x, y);
 
-		glm::dvec3 rel = glm::normalize(aabb_box[0]);
+		if (!has_side[side])
+		{
+			has_side[side] = true;
+			min_x[side] = max_x[side] = x;
+			min_y[side] = max_y[side] = y;
+		}
+		else
+		{
+			min_x[side] = std::min(min_x[side], x);
+			min_y[side] = std::min(min_y[side], y);
+			max_x[side] = std::max(max_x[side], x);
+			max_y[side] = std::max(max_y[side], y);
+		}
 
-		// We now subdivide the quadtree down to a given depth using the
-		// 3D points, and generate the edge triangles of every leaf node
-		// of the wanted depth
-		// Maybe we should do a line check or something like that
-		// or a volume check to make sure the whole AABB gets high detail
-		// BUT unless vehicles are totally massive this should
-		// not really matter much
-		// TODO: If we implement massive vehicles, write that code :P
+		if (std::find(out.begin(), out.end(), key) == out.end())
+		{
+			out.push_back(key);
+		}
+	}
 
-		std::vector<QuadTreeNode*> leafs = std::vector<QuadTreeNode*>();
+	for (size_t side = 0; side < 6; side++)
+	{
+		// Huge boxes only get the corners, as before
+		if (!has_side[side] || max_x[side] - min_x[side] >= MAX_TILE_SPAN ||
+			max_y[side] - min_y[side] >= MAX_TILE_SPAN)
+		{
+			continue;
+		}
 
-		for (size_t i = 0; i < 8; i++)
+		for (uint32_t y = min_y[side]; y <= max_y[side]; y++)
 		{
-			normalized[i] = glm::normalize(aabb_box[i]);
-			
-			PlanetSide side = quad_tree.get_planet_side(normalized[i]);
-			glm::dvec2 off = quad_tree.get_planet_side_offset(normalized[i], side);
-
-			
-			QuadTreeNode* n_leaf = quad_tree.subdivide_to(off, side, wanted_depth);
-			if (std::find(leafs.begin(), leafs.end(), n_leaf) == leafs.end())
+			for (uint32_t x = min_x[side]; x <= max_x[side]; x++)
 			{
-				leafs.push_back(n_leaf);
+				PlanetTileKey key = PlanetTileKey::from_xy((PlanetSide)side, depth, x, y);
+				if (std::find(out.begin(), out.end(), key) == out.end())
+				{
+					out.push_back(key);
+				}
 			}
 		}
+	}
+}
+
+void GroundShape::prefetch(btCollisionWorld* world, glm::dvec3 planet_vel)
+{
+	if (body->renderer.rocky == nullptr || body->rigid_body == nullptr)
+	{
+		return;
+	}
+
+	btTransform inv = body->rigid_body->getWorldTransform().inverse();
+	double outer = body->config.radius + body->config.surface.max_height * 1.1;
+	size_t depth = get_physics_depth();
+	double tile_size = body->config.radius / (double)((uint64_t)1 << depth);
 
-		for (QuadTreeNode* leaf : leafs)
+	std::vector<PlanetTileKey> keys;
+
+	btCollisionObjectArray& objects = world->getCollisionObjectArray();
+	for (int i = 0; i < objects.size(); i++)
+	{
+		btRigidBody* rg = btRigidBody::upcast(objects[i]);
+		if (rg == nullptr || rg->isStaticOrKinematicObject())
 		{
-			btVector3* verts = server->query(leaf, 1.0);
-			// Return the triangles
-			for (size_t i = 0; i < PlanetTile::PHYSICS_INDEX_COUNT; i+=3)
+			continue;
+		}
+
+		btVector3 aabb_min, aabb_max;
+		rg->getAabb(aabb_min, aabb_max);
+		glm::dvec3 center = to_dvec3(inv * ((aabb_min + aabb_max) * 0.5));
+		glm::dvec3 half = to_dvec3((aabb_max - aabb_min) * 0.5);
+		double half_size = std::max(std::max(half.x, half.y), half.z);
+		// Velocity relative to the surface (rotation is slow enough to be ignored)
+		glm::dvec3 vel = to_dvec3(inv.getBasis() * (rg->getLinearVelocity() - to_btVector3(planet_vel)));
+		glm::dvec3 travel = vel * PREFETCH_TIME;
+
+		if (glm::length(center) - half_size - glm::length(travel) > outer)
+		{
+			continue;
+		}
+
+		// Steps of half a tile, so we don't skip any
+		size_t steps = (size_t)std::ceil(glm::length(travel) / (tile_size * 0.5));
+		steps = std::min(std::max(steps, (size_t)1), MAX_PREFETCH_STEPS);
+		for (size_t step = 0; step <= steps; step++)
+		{
+			glm::dvec3 p = center + travel * ((double)step / (double)steps);
+			get_tiles_in_aabb(p - glm::dvec3(half_size), p + glm::dvec3(half_size), keys);
+		}
+	}
+
+	server->prefetch(keys, PREFETCH_TIME);
+}
+
+void GroundShape::benchmark(size_t queries)
+{
+	logger->check(body->renderer.rocky != nullptr, "Ground benchmark needs a rocky body");
+
+	struct CountCallback : public btTriangleCallback
+	{
+		size_t count = 0;
+		void processTriangle(btVector3* triangle, int part, int index) override { count++; }
+	};
+
+	queries = std::max(queries, (size_t)1);
+	uint64_t old_queries = server->queries;
+	uint64_t old_touched = server->triangles_touched;
+	uint64_t old_reported = server->triangles_reported;
+
+	// Queries are spread over a few spots, so all their tiles fit in the cache
+	std::mt19937 rng(1234);
+	std::uniform_real_distribution<double> dist(-1.0, 1.0);
+	size_t depth = get_physics_depth();
+	std::vector<PlanetTileKey> spots;
+	for(size_t i = 0; i < std::min(queries, (size_t)16); i++)
+	{
+		glm::dvec3 dir = glm::normalize(glm::dvec3(dist(rng), dist(rng), dist(rng)));
+		spots.push_back(QuadTreePlanet::get_key_at(dir, depth));
+	}
+
+	// Any vertex of a tile is on the surface
+	std::vector<btVector3> centers;
+	for(size_t i = 0; i < queries; i++)
+	{
+		GroundShapeServer::TileAndTriangles* tile = server->query(spots[i % spots.size()], 60.0);
+		centers.push_back(tile->verts[rng() % PlanetTile::PHYSICS_INDEX_COUNT]);
+	}
+
+	auto run = [this, &centers](double size, bool ray, CountCallback& callback)
+	{
+		btVector3 half = btVector3(size, size, size) * 0.5;
+		for(const btVector3& center : centers)
+		{
+			if(ray)
 			{
-				callback->processTriangle(&verts[i], (int)0, (int)(i / 3));
+				btVector3 up = center.normalized() * 100.0;
+				processRaycast(&callback, center + up, center - up);
+			}
+			else
+			{
+				processAllTriangles(&callback, center - half, center + half);
 			}
 		}
-		
+	};
+
+	// Negative size means rays
+	for(double size : {2.0, 20.0, 200.0, -1.0})
+	{
+		bool ray = size < 0.0;
+		// Generates the tiles
+		CountCallback warm;
+		run(size, ray, warm);
+
+		uint64_t touched = server->triangles_touched;
+		CountCallback callback;
+		auto start = std::chrono::steady_clock::now();
+		run(size, ray, callback);
+		double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		touched = server->triangles_touched - touched;
+
+		double per_query = (double)callback.count / (double)queries;
+		double touched_per_query = (double)touched / (double)queries;
+		std::string name = ray ? "200m vertical rays" : fmt::format("{:.0f}m boxes", size);
+		logger->info("Ground benchmark ({}, {} queries): {:.1f} triangles per query, {:.1f} in the touched tiles "
+					 "({:.1f}x less), {:.4f}ms per query", name, queries, per_query, touched_per_query,
+					 touched_per_query / std::max(per_query, 1.0), wall / (double)queries * 1000.0);
 	}
+
+	server->queries = old_queries;
+	server->triangles_touched = old_touched;
+	server->triangles_reported = old_reported;
 }
 
 GroundShape::GroundShape(SystemElement* body)
@@ -126,5 +291,70 @@ GroundShape::~GroundShape()
 void
 GroundShape::processRaycast(btTriangleCallback* callback, const btVector3& raySource, const btVector3& rayTarget) const
 {
-	logger->info("Processing raycast");
+	if (body->renderer.rocky == nullptr)
+	{
+		return;
+	}
+
+	glm::dvec3 from = to_dvec3(raySource);
+	glm::dvec3 to = to_dvec3(rayTarget);
+	glm::dvec3 d = to - from;
+
+	// Clip the ray to the sphere containing all terrain
+	double outer = body->config.radius + body->config.surface.max_height * 1.1;
+	double a = glm::dot(d, d);
+	double b = 2.0 * glm::dot(from, d);
+	double c = glm::dot(from, from) - outer * outer;
+	double disc = b * b - 4.0 * a * c;
+	if (a < 1e-12 || disc < 0.0)
+	{
+		return;
+	}
+
+	double sq = glm::sqrt(disc);
+	double t0 = std::max((-b - sq) / (2.0 * a), 0.0);
+	double t1 = std::min((-b + sq) / (2.0 * a), 1.0);
+	if (t0 > t1)
+	{
+		return;
+	}
+
+	glm::dvec3 p0 = from + d * t0;
+	glm::dvec3 p1 = from + d * t1;
+
+	// We walk the ray finding the tiles under it, with steps small enough to not
+	// skip any tile: a tile is at most ~2 * radius / 2^depth wide, and the
+	// cube to sphere projection only makes them smaller
+	size_t depth = get_physics_depth();
+	double step = body->config.radius / (double)((uint64_t)1 << (depth + 1));
+	double length = glm::length(p1 - p0);
+	size_t steps = (size_t)std::ceil(length / step);
+	// (Very long rays at max depth could skip tiles, we accept that)
+	steps = std::min(std::max(steps, (size_t)1), MAX_RAY_STEPS);
+
+	std::vector<PlanetTileKey> keys;
+	for (size_t i = 0; i <= steps; i++)
+	{
+		glm::dvec3 p = p0 + (p1 - p0) * ((double)i / (double)steps);
+		PlanetTileKey key = QuadTreePlanet::get_key_at(glm::normalize(p), depth);
+		// Keys come in order, so most of the time we are in the same tile as before
+		if (!keys.empty() && keys.back() == key)
+		{
+			continue;
+		}
+
+		if (std::find(keys.begin(), keys.end(), key) == keys.end())
+		{
+			keys.push_back(key);
+		}
+	}
+
+	server->queries++;
+	btVector3 seg_from = to_btVector3(p0);
+	btVector3 seg_to = to_btVector3(p1);
+	for (PlanetTileKey key : keys)
+	{
+		GroundShapeServer::TileAndTriangles* tile = server->query(key, 1.0);
+		server->process_segment(tile, callback, seg_from, seg_to);
+	}
 }
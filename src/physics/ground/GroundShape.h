@@ -17,6 +17,17 @@ private:
 	SystemElement* body;
 	GroundShapeServer* server;
 
+	// Boxes spanning more tiles than this (per axis) only query the tiles of their corners
+	static constexpr uint32_t MAX_TILE_SPAN = 8;
+	static constexpr size_t MAX_RAY_STEPS = 16384;
+	// Seconds ahead we prefetch tiles for moving bodies
+	static constexpr double PREFETCH_TIME = 2.0;
+	static constexpr size_t MAX_PREFETCH_STEPS = 16;
+
+	size_t get_physics_depth() const;
+	// Appends the physics tiles (probably) touched by the box, in the planet frame
+	void get_tiles_in_aabb(glm::dvec3 aabb0, glm::dvec3 aabb1, std::vector<PlanetTileKey>& out) const;
+
 
 public:
 	
@@ -45,6 +56,22 @@ public:
 
 	virtual const char*	getName() const { return "PROCTERRAIN"; }
 
+	// Call every physics tick, unloads unused tiles
+	void update(double pdt) { server->update(pdt); }
+
+	GroundShapeServer* get_server() { return server; }
+
+	// Requests the tiles every dynamic rigid body near the surface will touch
+	// in the next PREFETCH_TIME seconds, assuming constant velocity.
+	// planet_vel is the velocity of the planet in the world
+	void prefetch(btCollisionWorld* world, glm::dvec3 planet_vel);
+
+	// Runs queries boxes of 2m, 20m and 200m, and as many vertical rays, at random spots of
+	// the surface and logs the triangles reported per query against all the triangles of
+	// the tiles they touch (what was reported before culling), and the time per query.
+	// Tiles are generated before timing. Server statistics are left as they were
+	void benchmark(size_t queries);
+
 	GroundShape(SystemElement* body);
 	~GroundShape();
 };
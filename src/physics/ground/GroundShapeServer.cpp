@@ -1,23 +1,349 @@
 #include "GroundShapeServer.h"
+#include <planet_mesher/generator/TerrainGenerator.h>
+#include <util/Logger.h>
+#include <util/ThreadUtil.h>
+#include <util/Profiler.h>
+#include <imgui/imgui.h>
+#include <algorithm>
+#include <chrono>
 
 
 
 
-btVector3* GroundShapeServer::query(QuadTreeNode* node, double time)
+void GroundShapeServer::update(double pdt)
 {
-	PlanetTilePath path = PlanetTilePath(node->get_path(), node->planetside);
+	PROFILE_BLOCK("ground_shape");
+	PROFILE_COUNTER("ground_tiles", cache.size());
+	last_stall = tick_stall;
+	max_stall = std::max(max_stall, tick_stall);
+	tick_stall = 0.0;
 
-	if (cache.find(path) != cache.end())
 	{
-		return &cache[path]->verts[0];
+		std::unique_lock<std::mutex> lock(prefetch_mtx);
+		for (auto& pair : prefetch_done)
+		{
+			if (cache.find(pair.first) == cache.end())
+			{
+				pair.second->prefetched = true;
+				lru.push_front(pair.first);
+				pair.second->lru_it = lru.begin();
+				cache[pair.first] = pair.second;
+			}
+			else
+			{
+				delete pair.second;
+			}
+		}
+		prefetch_done.clear();
 	}
-	else
+
+	for (auto it = cache.begin(); it != cache.end();)
+	{
+		TileAndTriangles* tile = it->second;
+		tile->time_remaining -= pdt;
+		if (tile->time_remaining <= 0.0)
+		{
+			evict(tile);
+			it = cache.erase(it);
+			expired++;
+		}
+		else
+		{
+			it++;
+		}
+	}
+
+	while (cache.size() > max_tiles)
+	{
+		auto it = cache.find(lru.back());
+		logger->check(it != cache.end(), "Ground shape LRU out of sync");
+		evict(it->second);
+		cache.erase(it);
+		evicted++;
+	}
+}
+
+void GroundShapeServer::evict(TileAndTriangles* tile)
+{
+	lru.erase(tile->lru_it);
+	delete tile;
+}
+
+GroundShapeServer::TileAndTriangles* GroundShapeServer::query(PlanetTileKey key, double time)
+{
+	auto it = cache.find(key);
+	if (it != cache.end())
+	{
+		hits++;
+		TileAndTriangles* tile = it->second;
+		if (tile->prefetched)
+		{
+			prefetch_hits++;
+			tile->prefetched = false;
+		}
+		tile->time_remaining = std::max(tile->time_remaining, time);
+		lru.splice(lru.begin(), lru, tile->lru_it);
+		return tile;
+	}
+
+	// Only misses, hits are too frequent to be worth it
+	PROFILE_BLOCK("ground_query_miss");
+	auto start = std::chrono::steady_clock::now();
+	TileAndTriangles* n_tile = nullptr;
+
+	{
+		std::unique_lock<std::mutex> lock(prefetch_mtx);
+
+		// If the prefetch thread is working on it, it will be done before we could
+		prefetch_cv.wait(lock, [this, key]()
+		{
+			return !prefetch_working || prefetch_current != key;
+		});
+
+		auto done = prefetch_done.find(key);
+		if (done != prefetch_done.end())
+		{
+			// Not generated here, so it's a hit, and the first use of the tile
+			n_tile = done->second;
+			n_tile->time_remaining = std::max(n_tile->time_remaining, time);
+			prefetch_done.erase(done);
+			hits++;
+			prefetch_hits++;
+		}
+		else
+		{
+			auto queued = std::find(prefetch_queue.begin(), prefetch_queue.end(), key);
+			if (queued != prefetch_queue.end())
+			{
+				prefetch_queue.erase(queued);
+			}
+		}
+	}
+
+	if (n_tile == nullptr)
 	{
+		misses++;
 		// We must generate a new cache entry
-		TileAndTriangles* n_tile = new TileAndTriangles(path, time, this);
-		cache[path] = n_tile;
+		n_tile = new TileAndTriangles(key, time, this, lua, generator, &work_array);
+	}
+
+	lru.push_front(key);
+	n_tile->lru_it = lru.begin();
+	cache[key] = n_tile;
+
+	tick_stall += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	return n_tile;
+}
+
+void GroundShapeServer::prefetch(const std::vector<PlanetTileKey>& keys, double time)
+{
+	std::unique_lock<std::mutex> lock(prefetch_mtx);
+
+	prefetch_queue.clear();
+	prefetch_time = time;
+	for (PlanetTileKey key : keys)
+	{
+		auto it = cache.find(key);
+		if (it != cache.end())
+		{
+			it->second->time_remaining = std::max(it->second->time_remaining, time);
+			continue;
+		}
+
+		if ((prefetch_working && prefetch_current == key) || prefetch_done.find(key) != prefetch_done.end())
+		{
+			continue;
+		}
+
+		if (std::find(prefetch_queue.begin(), prefetch_queue.end(), key) == prefetch_queue.end())
+		{
+			prefetch_queue.push_back(key);
+		}
+	}
+
+	if (!prefetch_queue.empty())
+	{
+		prefetch_cv.notify_all();
+	}
+}
+
+void GroundShapeServer::prefetch_func()
+{
+	set_this_thread_name("groundgen");
+
+	std::unique_lock<std::mutex> lock(prefetch_mtx);
+	while (true)
+	{
+		prefetch_cv.wait(lock, [this]()
+		{
+			return !prefetch_run || !prefetch_queue.empty();
+		});
+
+		if (!prefetch_run)
+		{
+			break;
+		}
+
+		PlanetTileKey key = prefetch_queue.front();
+		prefetch_queue.pop_front();
+		prefetch_current = key;
+		prefetch_working = true;
+		double time = prefetch_time;
+
+		lock.unlock();
+		TileAndTriangles* n_tile;
+		{
+			PROFILE_BLOCK("ground_prefetch");
+			n_tile = new TileAndTriangles(key, time, this, prefetch_lua, prefetch_generator,
+				&prefetch_array);
+		}
+		lock.lock();
+
+		prefetch_done[key] = n_tile;
+		prefetch_working = false;
+		// query() may be waiting for this tile
+		prefetch_cv.notify_all();
+	}
+}
+
+static bool aabb_overlap(const btVector3& a0, const btVector3& a1, const btVector3& b0, const btVector3& b1)
+{
+	return a0.x() <= b1.x() && a1.x() >= b0.x() &&
+		a0.y() <= b1.y() && a1.y() >= b0.y() &&
+		a0.z() <= b1.z() && a1.z() >= b0.z();
+}
+
+static void triangle_aabb(const btVector3* tri, btVector3& tmin, btVector3& tmax)
+{
+	tmin = tri[0];
+	tmax = tri[0];
+	tmin.setMin(tri[1]);
+	tmin.setMin(tri[2]);
+	tmax.setMax(tri[1]);
+	tmax.setMax(tri[2]);
+}
+
+// Slab test, dir = to - from, so the segment is t in [0, 1]
+static bool segment_overlap(const btVector3& from, const btVector3& dir, const btVector3& b0, const btVector3& b1)
+{
+	btScalar tmin = 0.0;
+	btScalar tmax = 1.0;
+	for (int axis = 0; axis < 3; axis++)
+	{
+		if (btFabs(dir[axis]) < SIMD_EPSILON)
+		{
+			if (from[axis] < b0[axis] || from[axis] > b1[axis])
+			{
+				return false;
+			}
+		}
+		else
+		{
+			btScalar inv = btScalar(1.0) / dir[axis];
+			btScalar t0 = (b0[axis] - from[axis]) * inv;
+			btScalar t1 = (b1[axis] - from[axis]) * inv;
+			if (t0 > t1)
+			{
+				std::swap(t0, t1);
+			}
+			tmin = std::max(tmin, t0);
+			tmax = std::min(tmax, t1);
+			if (tmin > tmax)
+			{
+				return false;
+			}
+		}
+	}
+
+	return true;
+}
+
+void GroundShapeServer::process_aabb(TileAndTriangles* tile, btTriangleCallback* callback,
+									 const btVector3& aabb_min, const btVector3& aabb_max)
+{
+	triangles_touched += PlanetTile::PHYSICS_INDEX_COUNT / 3;
+
+	if (!aabb_overlap(tile->aabb_min, tile->aabb_max, aabb_min, aabb_max))
+	{
+		return;
+	}
+
+	for (size_t row = 0; row < ROW_COUNT; row++)
+	{
+		if (!aabb_overlap(tile->row_min[row], tile->row_max[row], aabb_min, aabb_max))
+		{
+			continue;
+		}
+
+		for (size_t i = row * ROW_VERT_COUNT; i < (row + 1) * ROW_VERT_COUNT; i += 3)
+		{
+			btVector3* tri = &tile->verts[i];
+			btVector3 tmin, tmax;
+			triangle_aabb(tri, tmin, tmax);
+
+			if (aabb_overlap(tmin, tmax, aabb_min, aabb_max))
+			{
+				callback->processTriangle(tri, (int)0, (int)(i / 3));
+				triangles_reported++;
+			}
+		}
+	}
+}
+
+void GroundShapeServer::process_segment(TileAndTriangles* tile, btTriangleCallback* callback,
+										const btVector3& from, const btVector3& to)
+{
+	triangles_touched += PlanetTile::PHYSICS_INDEX_COUNT / 3;
+
+	btVector3 dir = to - from;
+	if (!segment_overlap(from, dir, tile->aabb_min, tile->aabb_max))
+	{
+		return;
+	}
 
-		return &n_tile->verts[0];
+	for (size_t row = 0; row < ROW_COUNT; row++)
+	{
+		if (!segment_overlap(from, dir, tile->row_min[row], tile->row_max[row]))
+		{
+			continue;
+		}
+
+		for (size_t i = row * ROW_VERT_COUNT; i < (row + 1) * ROW_VERT_COUNT; i += 3)
+		{
+			btVector3* tri = &tile->verts[i];
+			btVector3 tmin, tmax;
+			triangle_aabb(tri, tmin, tmax);
+
+			if (segment_overlap(from, dir, tmin, tmax))
+			{
+				callback->processTriangle(tri, (int)0, (int)(i / 3));
+				triangles_reported++;
+			}
+		}
+	}
+}
+
+size_t GroundShapeServer::get_memory_usage() const
+{
+	return cache.size() * sizeof(TileAndTriangles);
+}
+
+void GroundShapeServer::do_imgui()
+{
+	ImGui::Text("Physics tiles: %i / %i (%.2fMB)", (int)cache.size(), (int)max_tiles,
+		(float)get_memory_usage() / 1000000.0f);
+	uint64_t total = hits + misses;
+	ImGui::Text("Hits: %llu, misses: %llu (%.1f%% hit rate)", (unsigned long long)hits, (unsigned long long)misses,
+		total == 0 ? 0.0 : 100.0 * (double)hits / (double)total);
+	ImGui::Text("Expired: %llu, evicted: %llu", (unsigned long long)expired, (unsigned long long)evicted);
+	ImGui::Text("Prefetched hits: %llu, generated in tick: %llu", (unsigned long long)prefetch_hits,
+		(unsigned long long)misses);
+	ImGui::Text("Stall: %.2fms last tick, %.2fms worst", last_stall * 1000.0, max_stall * 1000.0);
+	if (queries != 0)
+	{
+		ImGui::Text("Triangles per query: %.1f (%.1f in touched tiles)",
+			(double)triangles_reported / (double)queries, (double)triangles_touched / (double)queries);
 	}
 }
 
@@ -25,29 +351,86 @@ GroundShapeServer::GroundShapeServer(SystemElement* body)
 {
 	this->body = body;
 
-	bool wrote_error = false;
+	hits = 0;
+	misses = 0;
+	expired = 0;
+	evicted = 0;
+	queries = 0;
+	triangles_touched = 0;
+	triangles_reported = 0;
+	prefetch_hits = 0;
+	last_stall = 0.0;
+	max_stall = 0.0;
+	tick_stall = 0.0;
+
+	double max_bytes = body->config.surface.physics_cache_mb * 1000000.0;
+	// Always allow a few tiles, a single query may need up to 8
+	max_tiles = std::max((size_t)(max_bytes / (double)sizeof(TileAndTriangles)), (size_t)8);
 
-	std::string script = AssetManager::load_string_raw(body->config.surface.script_path);
+	bool wrote_error = false;
 
 	PlanetTile::prepare_lua(lua);
-	LuaUtil::safe_lua(lua, script, wrote_error, body->config.surface.script_path);
+	PlanetTile::prepare_lua(prefetch_lua);
+	generator = nullptr;
+	prefetch_generator = nullptr;
+	if (body->config.surface.generator)
+	{
+		generator = new TerrainGenerator(*body->config.surface.generator);
+		prefetch_generator = new TerrainGenerator(*body->config.surface.generator);
+	}
+	else
+	{
+		std::string script = AssetManager::load_string_raw(body->config.surface.script_path);
+		LuaUtil::safe_lua(lua, script, wrote_error, body->config.surface.script_path);
+		LuaUtil::safe_lua(prefetch_lua, script, wrote_error, body->config.surface.script_path);
+	}
 
 	PlanetTile::generate_physics_index_array(indices);
+
+	prefetch_working = false;
+	prefetch_time = 1.0;
+	prefetch_run = true;
+	prefetch_thread = new std::thread(&GroundShapeServer::prefetch_func, this);
 }
 
 
 GroundShapeServer::~GroundShapeServer()
 {
+	{
+		std::unique_lock<std::mutex> lock(prefetch_mtx);
+		prefetch_run = false;
+		prefetch_cv.notify_all();
+	}
+	prefetch_thread->join();
+	delete prefetch_thread;
+
+	for (auto& pair : prefetch_done)
+	{
+		delete pair.second;
+	}
+
+	for (auto& pair : cache)
+	{
+		delete pair.second;
+	}
+
+	delete generator;
+	delete prefetch_generator;
 }
 
-GroundShapeServer::TileAndTriangles::TileAndTriangles(PlanetTilePath npath, double time, GroundShapeServer* server) 
-	: path(npath)
+GroundShapeServer::TileAndTriangles::TileAndTriangles(PlanetTileKey nkey, double time, GroundShapeServer* server,
+	sol::state& lua, TerrainGenerator* generator, PlanetTile::SimpleVertexArray<PlanetTile::PHYSICS_SIZE>* work_array)
+	: key(nkey)
 {
+	time_remaining = time;
+	prefetched = false;
+
 	//double growth = -2.1500;
 	double growth = -2.5; // A little excessive so vehicles "sink" a little and dont float
 	double planet_radius = server->body->config.radius + growth;
 
-	PlanetTile::generate_physics(npath, server->body->config.radius, server->lua, &server->work_array);
+	PlanetTilePath path = PlanetTilePath(key);
+	PlanetTile::generate_physics(path, server->body->config.radius, lua, generator, work_array);
 
 	glm::dmat4 model = glm::dmat4(1.0);
 	model = glm::scale(model, glm::dvec3(planet_radius));
@@ -55,10 +438,24 @@ GroundShapeServer::TileAndTriangles::TileAndTriangles(PlanetTilePath npath, doub
 
 	for (size_t i = 0; i < server->indices.size(); i++)
 	{
-		glm::dvec3 v = server->work_array[server->indices[i]].pos;
+		glm::dvec3 v = (*work_array)[server->indices[i]].pos;
 		// Transform to real position relative to planet
 		v = model * glm::dvec4(v, 1.0);
 
 		verts[i] = to_btVector3(v);
 	}
+
+	aabb_min = aabb_max = verts[0];
+	for (size_t row = 0; row < ROW_COUNT; row++)
+	{
+		row_min[row] = row_max[row] = verts[row * ROW_VERT_COUNT];
+		for (size_t i = row * ROW_VERT_COUNT; i < (row + 1) * ROW_VERT_COUNT; i++)
+		{
+			row_min[row].setMin(verts[i]);
+			row_max[row].setMax(verts[i]);
+		}
+
+		aabb_min.setMin(row_min[row]);
+		aabb_max.setMax(row_max[row]);
+	}
 }
@@ -6,6 +6,16 @@
 #include "../glm/BulletGlmCompat.h"
 #include <glm/glm.hpp>
 #include <unordered_map>
+#include <unordered_set>
+#include <list>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#pragma warning(push, 0)
+#include <BulletCollision/CollisionShapes/btTriangleCallback.h>
+#pragma warning(pop)
 
 // Handles generation of the ground shape triangles,
 // and, most importantly, caching of them using the
@@ -16,6 +26,17 @@
 // how much to wait before dumping the tile. 
 // We use physics dt, so lag should not make tiles instantly 
 // disappear
+// On top of that, memory is capped (surface.physics_cache_mb), once over the
+// cap the least recently used tiles are removed even if they have time remaining.
+// Eviction only happens in update(), so pointers returned by query() are
+// valid until the next update()
+// Triangles are stored in rows of cells (as generated by generate_physics_index_array),
+// with bounds for the tile and every row, so queries only walk the rows that
+// may contain the wanted triangles.
+// Tiles about to be needed can be requested with prefetch(), they are generated
+// in a background thread and moved to the cache on update(). query() only generates
+// (blocking the physics tick) if the tile was never requested, and waits if it's being
+// generated right now.
 
 
 
@@ -25,29 +46,90 @@ class GroundShapeServer
 public:
 	static constexpr size_t PHYSICS_VERT_COUNT = PlanetTile::PHYSICS_SIZE * PlanetTile::PHYSICS_SIZE;
 	static constexpr size_t PHYSICS_TRI_COUNT = PHYSICS_VERT_COUNT * 3;
-
-private:
-	
-	std::array<uint16_t, PlanetTile::PHYSICS_INDEX_COUNT> indices;
+	static constexpr size_t ROW_COUNT = PlanetTile::PHYSICS_SIZE - 1;
+	static constexpr size_t ROW_VERT_COUNT = PlanetTile::PHYSICS_INDEX_COUNT / ROW_COUNT;
 
 	struct TileAndTriangles
 	{
-		PlanetTilePath path;
+		PlanetTileKey key;
 		double time_remaining;
+		// Generated by the prefetch thread and not queried yet
+		bool prefetched;
+		// Position in lru
+		std::list<PlanetTileKey>::iterator lru_it;
 
 		btVector3 verts[PlanetTile::PHYSICS_INDEX_COUNT];
 
-		TileAndTriangles(PlanetTilePath npath, double time, GroundShapeServer* server);
+		btVector3 aabb_min, aabb_max;
+		btVector3 row_min[ROW_COUNT], row_max[ROW_COUNT];
+
+		TileAndTriangles(PlanetTileKey nkey, double time, GroundShapeServer* server, sol::state& lua,
+						 TerrainGenerator* generator, PlanetTile::SimpleVertexArray<PlanetTile::PHYSICS_SIZE>* work_array);
 	};
 
+private:
+	
+	std::array<uint16_t, PlanetTile::PHYSICS_INDEX_COUNT> indices;
+
+	// The prefetch thread has its own generation state, as query() may generate
+	// at the same time
+	sol::state prefetch_lua;
+	TerrainGenerator* prefetch_generator;
+	PlanetTile::SimpleVertexArray<PlanetTile::PHYSICS_SIZE> prefetch_array;
+
+	// Protects everything prefetch_ below
+	std::mutex prefetch_mtx;
+	std::condition_variable prefetch_cv;
+	std::deque<PlanetTileKey> prefetch_queue;
+	// Generated, waiting for update() to move them to the cache
+	std::unordered_map<PlanetTileKey, TileAndTriangles*, PlanetTileKeyHasher> prefetch_done;
+	// Being generated right now, not valid if prefetch_working = false
+	PlanetTileKey prefetch_current;
+	bool prefetch_working;
+	double prefetch_time;
+	bool prefetch_run;
+	std::thread* prefetch_thread;
+
+	void prefetch_func();
+
+	// Stall time (seconds) of query() on the current tick
+	double tick_stall;
+
+
+	// Most recently used first
+	std::list<PlanetTileKey> lru;
+	size_t max_tiles;
+
+	void evict(TileAndTriangles* tile);
 
 public:
 	
-	std::unordered_map<PlanetTilePath, TileAndTriangles*, PlanetTilePathHasher> cache;
+	std::unordered_map<PlanetTileKey, TileAndTriangles*, PlanetTileKeyHasher> cache;
+
+	uint64_t hits;
+	uint64_t misses;
+	// Tiles removed because their time ran out
+	uint64_t expired;
+	// Tiles removed because we were over the memory cap
+	uint64_t evicted;
+
+	// Hits on tiles generated by the prefetch thread, counted the first time
+	// each tile is queried (tiles prefetched but never used don't count)
+	uint64_t prefetch_hits;
+	// Seconds query() blocked the previous tick, and the worst tick
+	double last_stall;
+	double max_stall;
+
+	uint64_t queries;
+	// Triangles in the tiles touched by queries, what we would report without culling
+	uint64_t triangles_touched;
+	uint64_t triangles_reported;
 
 	PlanetTile::SimpleVertexArray<PlanetTile::PHYSICS_SIZE> work_array;
 
 	sol::state lua;
+	// If not nullptr, used instead of the lua script
+	TerrainGenerator* generator;
 
 	SystemElement* body;
 
@@ -55,8 +137,25 @@ public:
 	// proper unloading of unused tiles
 	void update(double pdt);
 
-	
-	btVector3* query(QuadTreeNode* node, double time = 1.0);
+	// time is how long (in physics seconds) the tile is kept since this query
+	TileAndTriangles* query(PlanetTileKey key, double time = 1.0);
+
+	// Replaces the previous prefetch requests, most urgent first.
+	// Tiles already in the cache are kept for at least time
+	void prefetch(const std::vector<PlanetTileKey>& keys, double time);
+
+	// Reports the triangles of the tile whose bounds overlap the given box
+	void process_aabb(TileAndTriangles* tile, btTriangleCallback* callback,
+					  const btVector3& aabb_min, const btVector3& aabb_max);
+
+	// Reports the triangles of the tile whose bounds the segment goes through
+	void process_segment(TileAndTriangles* tile, btTriangleCallback* callback,
+						 const btVector3& from, const btVector3& to);
+
+	size_t get_memory_usage() const;
+	size_t get_max_tiles() const { return max_tiles; }
+
+	void do_imgui();
 
 	GroundShapeServer(SystemElement* body);
 	~GroundShapeServer();
@@ -0,0 +1,330 @@
+#include "TerrainGenerator.h"
+#include <util/Logger.h>
+#include <util/SerializeUtil.h>
+#include <util/serializers/glm.h>
+#include <algorithm>
+
+size_t TerrainGenerator::find_node(const std::string& name, const std::string& user) const
+{
+	for(size_t i = 0; i < nodes.size(); i++)
+	{
+		if(nodes[i].name == name)
+		{
+			return i;
+		}
+	}
+
+	logger->fatal("Terrain generator node '{}' uses unknown node '{}' (nodes must be declared before use)",
+				  user, name);
+	return 0;
+}
+
+void TerrainGenerator::load_node(Node& node, const cpptoml::table& from)
+{
+	std::string type;
+	SAFE_TOML_GET(node.name, "name", std::string);
+	SAFE_TOML_GET(type, "type", std::string);
+	SAFE_TOML_GET_OR(node.scale, "scale", double, 1.0);
+	SAFE_TOML_GET_OR(node.offset, "offset", double, 0.0);
+
+	if(type == "constant")
+	{
+		node.type = NodeType::CONSTANT;
+		SAFE_TOML_GET(node.value, "value", double);
+	}
+	else if(type == "noise" || type == "crater")
+	{
+		node.type = type == "noise" ? NodeType::NOISE : NodeType::CRATER;
+
+		int seed;
+		double frequency;
+		SAFE_TOML_GET_OR(seed, "seed", int, 0);
+		SAFE_TOML_GET_OR(frequency, "frequency", double, 1.0);
+		node.noise = std::unique_ptr<FastNoise, FastNoiseDeleter>(fn_new(seed));
+		fn_set_frequency(node.noise.get(), frequency);
+
+		if(node.type == NodeType::NOISE)
+		{
+			std::string noise;
+			SAFE_TOML_GET_OR(noise, "noise", std::string, "simplex_fractal");
+			if(noise == "value") node.noise_type = NoiseType::VALUE;
+			else if(noise == "value_fractal") node.noise_type = NoiseType::VALUE_FRACTAL;
+			else if(noise == "perlin") node.noise_type = NoiseType::PERLIN;
+			else if(noise == "perlin_fractal") node.noise_type = NoiseType::PERLIN_FRACTAL;
+			else if(noise == "simplex") node.noise_type = NoiseType::SIMPLEX;
+			else if(noise == "simplex_fractal") node.noise_type = NoiseType::SIMPLEX_FRACTAL;
+			else logger->fatal("Unknown noise '{}' in terrain generator node '{}'", noise, node.name);
+
+			int octaves;
+			double gain, lacunarity;
+			std::string fractal_type;
+			SAFE_TOML_GET_OR(octaves, "octaves", int, 3);
+			SAFE_TOML_GET_OR(gain, "gain", double, 0.5);
+			SAFE_TOML_GET_OR(lacunarity, "lacunarity", double, 2.0);
+			SAFE_TOML_GET_OR(fractal_type, "fractal_type", std::string, "fbm");
+			fn_set_fractal_octaves(node.noise.get(), octaves);
+			fn_set_fractal_gain(node.noise.get(), gain);
+			fn_set_fractal_lacunarity(node.noise.get(), lacunarity);
+			if(fractal_type == "fbm") fn_set_fractal_type(node.noise.get(), FN_FBM);
+			else if(fractal_type == "billow") fn_set_fractal_type(node.noise.get(), FN_Billow);
+			else if(fractal_type == "rigid_multi") fn_set_fractal_type(node.noise.get(), FN_RigidMulti);
+			else logger->fatal("Unknown fractal type '{}' in terrain generator node '{}'", fractal_type, node.name);
+		}
+		else
+		{
+			double chance;
+			int layers;
+			SAFE_TOML_GET_OR(chance, "chance", double, 0.5);
+			SAFE_TOML_GET_OR(layers, "layers", int, 1);
+			fn_set_crater_chance(node.noise.get(), chance);
+			fn_set_crater_layers(node.noise.get(), layers);
+		}
+	}
+	else if(type == "image")
+	{
+		node.type = NodeType::IMAGE;
+		std::string image;
+		SAFE_TOML_GET(image, "image", std::string);
+		SAFE_TOML_GET_OR(node.channel, "channel", int, 0);
+		logger->check(node.channel >= 0 && node.channel < 4, "Image channel must be in [0, 3] (node '{}')", node.name);
+		node.image = AssetHandle<Image>(image);
+	}
+	else if(type == "blend" || type == "clamp")
+	{
+		std::vector<std::string> inputs;
+		auto input_array = from.get_array_of<std::string>("inputs");
+		logger->check(input_array.operator bool(), "Terrain generator node '{}' needs inputs", node.name);
+		for(const std::string& input : *input_array)
+		{
+			// The node is already in the list, and would read its own output as it's written
+			if(input == node.name)
+			{
+				logger->fatal("Terrain generator node '{}' uses itself as input", node.name);
+			}
+			node.inputs.push_back(find_node(input, node.name));
+		}
+
+		if(type == "blend")
+		{
+			node.type = NodeType::BLEND;
+			std::string op;
+			SAFE_TOML_GET_OR(op, "op", std::string, "add");
+			if(op == "add") node.op = BlendOp::ADD;
+			else if(op == "sub") node.op = BlendOp::SUB;
+			else if(op == "mul") node.op = BlendOp::MUL;
+			else if(op == "min") node.op = BlendOp::MIN;
+			else if(op == "max") node.op = BlendOp::MAX;
+			else if(op == "mix") node.op = BlendOp::MIX;
+			else logger->fatal("Unknown blend op '{}' in terrain generator node '{}'", op, node.name);
+
+			size_t needed = node.op == BlendOp::MIX ? 3 : 2;
+			logger->check(node.op == BlendOp::MIX ? node.inputs.size() == 3 : node.inputs.size() >= 2,
+						  "Terrain generator node '{}' needs {} inputs", node.name, needed);
+		}
+		else
+		{
+			node.type = NodeType::CLAMP;
+			logger->check(node.inputs.size() == 1, "Terrain generator node '{}' needs 1 input", node.name);
+			SAFE_TOML_GET(node.min, "min", double);
+			SAFE_TOML_GET(node.max, "max", double);
+		}
+	}
+	else
+	{
+		logger->fatal("Unknown terrain generator node type '{}' (node '{}')", type, node.name);
+	}
+}
+
+void TerrainGenerator::evaluate(Node& node, std::vector<double>& out, const glm::dvec3* coord_3d,
+								const glm::dvec2* coord_2d, size_t count)
+{
+	FastNoise* fn = node.noise.get();
+
+	switch(node.type)
+	{
+	case NodeType::CONSTANT:
+		std::fill(out.begin(), out.begin() + count, node.value);
+		break;
+	case NodeType::NOISE:
+		// The switch is kept out of the loop
+		switch(node.noise_type)
+		{
+#define NOISE_LOOP(func) \
+		for(size_t i = 0; i < count; i++) out[i] = func(fn, coord_3d[i].x, coord_3d[i].y, coord_3d[i].z); \
+		break;
+		case NoiseType::VALUE: NOISE_LOOP(fn_value3)
+		case NoiseType::VALUE_FRACTAL: NOISE_LOOP(fn_value_fractal3)
+		case NoiseType::PERLIN: NOISE_LOOP(fn_perlin3)
+		case NoiseType::PERLIN_FRACTAL: NOISE_LOOP(fn_perlin_fractal3)
+		case NoiseType::SIMPLEX: NOISE_LOOP(fn_simplex3)
+		case NoiseType::SIMPLEX_FRACTAL: NOISE_LOOP(fn_simplex_fractal3)
+#undef NOISE_LOOP
+		}
+		break;
+	case NodeType::CRATER:
+		for(size_t i = 0; i < count; i++)
+		{
+			out[i] = fn_crater3(fn, 0, coord_3d[i].x, coord_3d[i].y, coord_3d[i].z);
+		}
+		break;
+	case NodeType::IMAGE:
+	{
+		Image* img = node.image.get_noconst();
+		for(size_t i = 0; i < count; i++)
+		{
+			double u = (coord_2d[i].x + glm::pi<double>()) / glm::two_pi<double>();
+			double v = coord_2d[i].y / glm::pi<double>();
+			out[i] = img->sample_bilinear((float)u, (float)v)[node.channel];
+		}
+		break;
+	}
+	case NodeType::BLEND:
+	{
+		const std::vector<double>& a = values[node.inputs[0]];
+		const std::vector<double>& b = values[node.inputs[1]];
+		switch(node.op)
+		{
+		case BlendOp::ADD:
+			for(size_t i = 0; i < count; i++) out[i] = a[i] + b[i];
+			for(size_t j = 2; j < node.inputs.size(); j++)
+				for(size_t i = 0; i < count; i++) out[i] += values[node.inputs[j]][i];
+			break;
+		case BlendOp::SUB:
+			for(size_t i = 0; i < count; i++) out[i] = a[i] - b[i];
+			for(size_t j = 2; j < node.inputs.size(); j++)
+				for(size_t i = 0; i < count; i++) out[i] -= values[node.inputs[j]][i];
+			break;
+		case BlendOp::MUL:
+			for(size_t i = 0; i < count; i++) out[i] = a[i] * b[i];
+			for(size_t j = 2; j < node.inputs.size(); j++)
+				for(size_t i = 0; i < count; i++) out[i] *= values[node.inputs[j]][i];
+			break;
+		case BlendOp::MIN:
+			for(size_t i = 0; i < count; i++) out[i] = std::min(a[i], b[i]);
+			for(size_t j = 2; j < node.inputs.size(); j++)
+				for(size_t i = 0; i < count; i++) out[i] = std::min(out[i], values[node.inputs[j]][i]);
+			break;
+		case BlendOp::MAX:
+			for(size_t i = 0; i < count; i++) out[i] = std::max(a[i], b[i]);
+			for(size_t j = 2; j < node.inputs.size(); j++)
+				for(size_t i = 0; i < count; i++) out[i] = std::max(out[i], values[node.inputs[j]][i]);
+			break;
+		case BlendOp::MIX:
+		{
+			const std::vector<double>& w = values[node.inputs[2]];
+			for(size_t i = 0; i < count; i++) out[i] = a[i] * (1.0 - w[i]) + b[i] * w[i];
+			break;
+		}
+		}
+		break;
+	}
+	case NodeType::CLAMP:
+	{
+		const std::vector<double>& a = values[node.inputs[0]];
+		for(size_t i = 0; i < count; i++)
+		{
+			out[i] = glm::clamp(a[i], node.min, node.max);
+		}
+		break;
+	}
+	}
+
+	if(node.scale != 1.0 || node.offset != 0.0)
+	{
+		for(size_t i = 0; i < count; i++)
+		{
+			out[i] = out[i] * node.scale + node.offset;
+		}
+	}
+}
+
+glm::dvec3 TerrainGenerator::get_color(double v) const
+{
+	if(color_stops.empty())
+	{
+		return glm::dvec3(1.0);
+	}
+
+	if(v <= color_stops.front().at)
+	{
+		return color_stops.front().color;
+	}
+
+	for(size_t i = 1; i < color_stops.size(); i++)
+	{
+		if(v < color_stops[i].at)
+		{
+			const ColorStop& a = color_stops[i - 1];
+			const ColorStop& b = color_stops[i];
+			double t = (v - a.at) / (b.at - a.at);
+			return glm::mix(a.color, b.color, t);
+		}
+	}
+
+	return color_stops.back().color;
+}
+
+void TerrainGenerator::generate(const glm::dvec3* coord_3d, const glm::dvec2* coord_2d, size_t count,
+								double* heights, glm::dvec3* colors)
+{
+	for(size_t n = 0; n < nodes.size(); n++)
+	{
+		if(values[n].size() < count)
+		{
+			values[n].resize(count);
+		}
+
+		evaluate(nodes[n], values[n], coord_3d, coord_2d, count);
+	}
+
+	const std::vector<double>& height = values[height_node];
+	std::copy(height.begin(), height.begin() + count, heights);
+
+	if(colors)
+	{
+		const std::vector<double>& color = values[color_node];
+		for(size_t i = 0; i < count; i++)
+		{
+			colors[i] = get_color(color[i]);
+		}
+	}
+}
+
+TerrainGenerator::TerrainGenerator(const cpptoml::table& from)
+{
+	auto node_tables = from.get_table_array("node");
+	logger->check(node_tables.operator bool(), "Terrain generator has no nodes");
+
+	for(const auto& node_table : *node_tables)
+	{
+		nodes.emplace_back();
+		load_node(nodes.back(), *node_table);
+	}
+
+	std::string height, color_input;
+	SAFE_TOML_GET_OR(height, "height", std::string, nodes.back().name);
+	SAFE_TOML_GET_OR(color_input, "color_input", std::string, height);
+	height_node = find_node(height, "height");
+	color_node = find_node(color_input, "color_input");
+
+	auto stop_tables = from.get_table_array("color_stop");
+	if(stop_tables)
+	{
+		for(const auto& stop_table : *stop_tables)
+		{
+			ColorStop stop;
+			stop.at = stop_table->get_as<double>("at").value_or(0.0);
+			auto color_table = stop_table->get_table("color");
+			logger->check(color_table.operator bool(), "Terrain generator color stops need a color");
+			::deserialize(stop.color, *color_table);
+			color_stops.push_back(stop);
+		}
+
+		std::sort(color_stops.begin(), color_stops.end(), [](const ColorStop& a, const ColorStop& b)
+		{
+			return a.at < b.at;
+		});
+	}
+
+	values.resize(nodes.size());
+}
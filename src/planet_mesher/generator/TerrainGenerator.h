@@ -0,0 +1,126 @@
+#pragma once
+#include <FastNoiseC/FastNoise.h>
+#include <assets/Image.h>
+#include <assets/AssetManager.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/constants.hpp>
+#include <cpptoml.h>
+#include <vector>
+#include <string>
+#include <memory>
+
+// Native alternative to the lua surface scripts. The surface is described as
+// a small graph of nodes in the [surface.generator] table of the planet:
+//
+// [surface.generator]
+// height = "final"     <- Node giving the height in meters (default: last node)
+// color_input = "final" <- Node used to pick the color (default: height node)
+// [[surface.generator.node]]
+// name = "base"
+// type = "noise"       <- constant, noise, crater, image, blend or clamp
+// ...
+// [[surface.generator.color_stop]]
+// at = 0.0
+// color = {x = 0.2, y = 0.5, z = 0.1}
+//
+// Every node may have "scale" and "offset", applied to its result.
+// Nodes are evaluated in order over the whole tile at once, and may only
+// use nodes declared before them as inputs.
+// Each thread must use its own instance, create them from the main thread
+// as images are loaded in the constructor.
+class TerrainGenerator
+{
+private:
+
+	enum class NodeType
+	{
+		CONSTANT,
+		NOISE,
+		CRATER,
+		IMAGE,
+		BLEND,
+		CLAMP
+	};
+
+	enum class NoiseType
+	{
+		VALUE,
+		VALUE_FRACTAL,
+		PERLIN,
+		PERLIN_FRACTAL,
+		SIMPLEX,
+		SIMPLEX_FRACTAL
+	};
+
+	enum class BlendOp
+	{
+		ADD,
+		SUB,
+		MUL,
+		MIN,
+		MAX,
+		// inputs[0] * (1 - inputs[2]) + inputs[1] * inputs[2]
+		MIX
+	};
+
+	struct FastNoiseDeleter
+	{
+		void operator()(FastNoise* fn) { fn_delete(fn); }
+	};
+
+	struct Node
+	{
+		std::string name;
+		NodeType type;
+		double scale;
+		double offset;
+
+		// CONSTANT
+		double value;
+
+		// NOISE and CRATER, sampled over the unit sphere
+		std::unique_ptr<FastNoise, FastNoiseDeleter> noise;
+		NoiseType noise_type;
+
+		// IMAGE, sampled using the spherical coordinates as an equirectangular map
+		AssetHandle<Image> image;
+		int channel;
+
+		// BLEND and CLAMP
+		std::vector<size_t> inputs;
+		BlendOp op;
+		double min, max;
+	};
+
+	struct ColorStop
+	{
+		double at;
+		glm::dvec3 color;
+	};
+
+	std::vector<Node> nodes;
+	std::vector<ColorStop> color_stops;
+	size_t height_node;
+	size_t color_node;
+
+	// Results of each node, reused between calls
+	std::vector<std::vector<double>> values;
+
+	size_t find_node(const std::string& name, const std::string& user) const;
+	void load_node(Node& node, const cpptoml::table& from);
+	void evaluate(Node& node, std::vector<double>& out, const glm::dvec3* coord_3d,
+				  const glm::dvec2* coord_2d, size_t count);
+	glm::dvec3 get_color(double v) const;
+
+public:
+
+	// Writes count heights (meters from sea level) and, if colors is not nullptr, colors.
+	// Coordinates are given over the unit sphere (coord_3d) and as spherical coordinates
+	// in radians (coord_2d, see euclidean_to_spherical_r1), same as the lua generator
+	void generate(const glm::dvec3* coord_3d, const glm::dvec2* coord_2d, size_t count,
+				  double* heights, glm::dvec3* colors);
+
+	size_t get_node_count() const { return nodes.size(); }
+
+	explicit TerrainGenerator(const cpptoml::table& table);
+};
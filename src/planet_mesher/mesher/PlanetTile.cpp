@@ -1,6 +1,8 @@
 #include "PlanetTile.h"
 #include <util/Logger.h>
 #include <util/LuaUtil.h>
+#include "../generator/TerrainGenerator.h"
+#include <limits>
 
 template<int S>
 constexpr std::array<uint16_t, (S + 2) * (S + 2) * 6> get_nrm_indices()
@@ -210,8 +212,39 @@ void generate_skirt(PlanetTileVertex* target, glm::dmat4 model, glm::dmat4 inver
 
 #include <util/Timer.h>
 
-bool PlanetTile::generate(PlanetTilePath path, double planet_radius, sol::state& lua_state, bool has_water,
-	GeneratorArrays* arrays)
+void PlanetTile::run_native(TerrainGenerator* native, const GeneratorInfo* info, GeneratorOut* out, size_t count)
+{
+	thread_local std::vector<glm::dvec3> coord_3d;
+	thread_local std::vector<glm::dvec2> coord_2d;
+	thread_local std::vector<double> heights;
+	thread_local std::vector<glm::dvec3> colors;
+	coord_3d.resize(count);
+	coord_2d.resize(count);
+	heights.resize(count);
+	colors.resize(count);
+
+	bool needs_color = false;
+	for(size_t i = 0; i < count; i++)
+	{
+		coord_3d[i] = info[i].coord_3d;
+		coord_2d[i] = info[i].coord_2d;
+		needs_color |= info[i].needs_color;
+	}
+
+	native->generate(coord_3d.data(), coord_2d.data(), count, heights.data(), needs_color ? colors.data() : nullptr);
+
+	for(size_t i = 0; i < count; i++)
+	{
+		out[i].height = heights[i];
+		if(needs_color)
+		{
+			out[i].color = colors[i];
+		}
+	}
+}
+
+bool PlanetTile::generate(PlanetTilePath path, double planet_radius, sol::state& lua_state, TerrainGenerator* native,
+	bool has_water, GeneratorArrays* arrays)
 {
 	auto& work_array = arrays->work_array;
 	auto& heights = arrays->heights;
@@ -276,21 +309,32 @@ bool PlanetTile::generate(PlanetTilePath path, double planet_radius, sol::state&
 		}
 	}
 
-	sol::protected_function func = lua_state["generate"];
-	auto result = func(std::ref(gen_info), std::ref(gen_out));
-
-	if (!result.valid())
+	if (native)
 	{
-		sol::error err = result;
-		LuaUtil::lua_error_handler(lua_state.lua_state(), err);
-		// We only write one error per tile so we don't overload the log
-		errors = true;
+		run_native(native, gen_info.data(), gen_out.data(), gen_out.size());
+	}
+	else
+	{
+		sol::protected_function func = lua_state["generate"];
+		auto result = func(std::ref(gen_info), std::ref(gen_out));
+
+		if (!result.valid())
+		{
+			sol::error err = result;
+			LuaUtil::lua_error_handler(lua_state.lua_state(), err);
+			// We only write one error per tile so we don't overload the log
+			errors = true;
+		}
 	}
 
 	// Post-process
+	min_height = std::numeric_limits<double>::max();
+	max_height = -std::numeric_limits<double>::max();
 	for(size_t i = 0; i < gen_out.size(); i++)
 	{
 		heights[i] = (gen_out[i].height) / planet_radius;
+		min_height = std::min(min_height, heights[i]);
+		max_height = std::max(max_height, heights[i]);
 		if (!needs_water)
 		{
 			if (heights[i] < 0.0)
@@ -302,7 +346,10 @@ bool PlanetTile::generate(PlanetTilePath path, double planet_radius, sol::state&
 		colors[i] = (glm::vec3)gen_out[i].color;
 	}
 
-	lua_state.collect_garbage();
+	if (!native)
+	{
+		lua_state.collect_garbage();
+	}
 
 	// Detail texture adjustements
 	glm::dvec2 min = path.get_min(), max;
@@ -318,7 +365,6 @@ bool PlanetTile::generate(PlanetTilePath path, double planet_radius, sol::state&
 	generate_normals<TILE_SIZE>(work_array.data(), work_array.size(), model_spheric, clockwise);
 	copy_vertices<TILE_SIZE>(work_array.data(), vertices.data());
 
-	water_vertices = nullptr;
 	water_vbo = 0;
 	if (has_water && needs_water)
 	{
@@ -326,8 +372,19 @@ bool PlanetTile::generate(PlanetTilePath path, double planet_radius, sol::state&
 				model, inverse_model_spheric, &heights[0], nullptr);
 
 		generate_normals<TILE_SIZE>(work_array.data(), work_array.size(), model_spheric, clockwise);
-		water_vertices = new std::array<PlanetTileWaterVertex, VERTEX_COUNT>();
+		// Tiles may be generated more than once (benchmark_generator), reuse the array
+		if (water_vertices == nullptr)
+		{
+			water_vertices = new std::array<PlanetTileWaterVertex, VERTEX_COUNT>();
+		}
 		copy_vertices<TILE_SIZE>(work_array.data(), water_vertices->data());
+		// The water surface is at height 0
+		max_height = std::max(max_height, 0.0);
+	}
+	else
+	{
+		delete water_vertices;
+		water_vertices = nullptr;
 	}
 
 	// We generate the up vector easily
@@ -361,7 +418,7 @@ bool PlanetTile::generate(PlanetTilePath path, double planet_radius, sol::state&
 
 
 bool PlanetTile::generate_physics(PlanetTilePath path, double planet_radius, sol::state& lua_state,
-	SimpleVertexArray<PlanetTile::PHYSICS_SIZE>* work_array)
+	TerrainGenerator* native, SimpleVertexArray<PlanetTile::PHYSICS_SIZE>* work_array)
 {
 	bool errors = false;
 
@@ -379,8 +436,6 @@ bool PlanetTile::generate_physics(PlanetTilePath path, double planet_radius, sol
 	std::array<GeneratorInfo, ARR_SIZE> info;
 	std::array<GeneratorOut, ARR_SIZE> out;
 
-	sol::protected_function func = lua_state["generate"];
-
 	 
 	// We need some small tricks to keep the render and physics vertices aligned
 	for (int y = 0; y < PlanetTile::PHYSICS_SIZE; y++)
@@ -411,15 +466,24 @@ bool PlanetTile::generate_physics(PlanetTilePath path, double planet_radius, sol
 		}
 	}
 
-	auto result = func(std::ref(info), std::ref(out));
+	if (native)
+	{
+		run_native(native, info.data(), out.data(), out.size());
+	}
+	else
+	{
+		sol::protected_function func = lua_state["generate"];
+		auto result = func(std::ref(info), std::ref(out));
 
+		if (!result.valid())
+		{
+			sol::error err = result;
+			logger->error("Lua Runtime Error:\n{}", err.what());
+			// We only write one error per tile so we don't overload the log
+			errors = true;
+		}
 
-	if (!result.valid())
-	{
-		sol::error err = result;
-		logger->error("Lua Runtime Error:\n{}", err.what());
-		// We only write one error per tile so we don't overload the log
-		errors = true;
+		lua_state.collect_garbage();
 	}
 
 	for(size_t i = 0; i < out.size(); i++)
@@ -427,7 +491,6 @@ bool PlanetTile::generate_physics(PlanetTilePath path, double planet_radius, sol
 		heights[i] = (out[i].height) / planet_radius;
 	}
 
-	lua_state.collect_garbage();
 	generate_vertices_simple<PlanetTileSimpleVertex>(work_array->data(), model, inverse_model_spheric, heights.data());
 
 	return errors;
@@ -581,6 +644,8 @@ PlanetTile::PlanetTile()
 	vbo = 0;
 	water_vbo = 0;
 	water_vertices = nullptr;
+	min_height = 0.0;
+	max_height = 0.0;
 
 }
 
@@ -9,6 +9,8 @@
 #include <lua/LuaCore.h>
 #include <assets/AssetManager.h>
 
+class TerrainGenerator;
+
 // TODO: Tile vertex structure
 // We may not even use colors
 struct PlanetTileVertex
@@ -58,6 +60,9 @@ struct PlanetTile
 	GLuint vbo, water_vbo;
 	// The average up vector of the tile, for texturing
 	glm::dvec3 up;
+	// Lowest and highest point of the tile (including water), in radius units over the
+	// unit sphere, for culling
+	double min_height, max_height;
 
 	// Keep below ~128, for OpenGL reasons (index buffer too big)
 	// In debug, 32 is good for performance, but in Release 64 can be used just fine
@@ -93,12 +98,16 @@ struct PlanetTile
 	};
 
 	// Return true if errors happened
-	bool generate(PlanetTilePath path, double planet_radius, sol::state& lua_state, bool has_water,
-		GeneratorArrays* arrays);
+	// If native is not nullptr it's used instead of the lua generate function
+	bool generate(PlanetTilePath path, double planet_radius, sol::state& lua_state, TerrainGenerator* native,
+		bool has_water, GeneratorArrays* arrays);
 
 	// Simply generates stuff to the output_array, that's it, we can be static 
 	static bool generate_physics(PlanetTilePath path, double planet_radius, sol::state& lua_state,
-		SimpleVertexArray<PHYSICS_SIZE>* work_array);
+		TerrainGenerator* native, SimpleVertexArray<PHYSICS_SIZE>* work_array);
+
+	// Evaluates the native generator over a batch of GeneratorInfo
+	static void run_native(TerrainGenerator* native, const GeneratorInfo* info, GeneratorOut* out, size_t count);
 
 	static void prepare_lua(sol::state& lua_state);
 
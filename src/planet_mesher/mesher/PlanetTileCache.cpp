@@ -0,0 +1,345 @@
+#include "PlanetTileCache.h"
+#include <util/Logger.h>
+#include <util/ThreadUtil.h>
+#include <util/Profiler.h>
+#include <OSP.h>
+#include <filesystem>
+#include <cstring>
+
+#pragma pack(push, 1)
+struct PlanetTileCacheHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	uint64_t hash;
+};
+
+struct PlanetTileCacheRecord
+{
+	uint64_t key;
+	uint32_t size;
+};
+#pragma pack(pop)
+
+uint64_t PlanetTileCache::hash(const std::string& data, uint64_t seed)
+{
+	// FNV-1a
+	uint64_t h = seed;
+	for(char c : data)
+	{
+		h ^= (uint8_t)c;
+		h *= 1099511628211ULL;
+	}
+	return h;
+}
+
+void PlanetTileCache::encode(const PlanetTile& tile, std::vector<uint8_t>& out)
+{
+	size_t verts_size = sizeof(PlanetTileVertex) * tile.vertices.size();
+	size_t water_size = tile.water_vertices ? sizeof(PlanetTileWaterVertex) * tile.water_vertices->size() : 0;
+
+	out.resize(2 + sizeof(glm::dvec3) + sizeof(double) * 2 + verts_size + water_size);
+	uint8_t* ptr = out.data();
+	*ptr++ = tile.clockwise ? 1 : 0;
+	*ptr++ = tile.water_vertices ? 1 : 0;
+	memcpy(ptr, &tile.up, sizeof(glm::dvec3));
+	ptr += sizeof(glm::dvec3);
+	memcpy(ptr, &tile.min_height, sizeof(double));
+	ptr += sizeof(double);
+	memcpy(ptr, &tile.max_height, sizeof(double));
+	ptr += sizeof(double);
+	memcpy(ptr, tile.vertices.data(), verts_size);
+	ptr += verts_size;
+	if(tile.water_vertices)
+	{
+		memcpy(ptr, tile.water_vertices->data(), water_size);
+	}
+}
+
+bool PlanetTileCache::decode(const uint8_t* data, size_t size, PlanetTile& tile)
+{
+	size_t verts_size = sizeof(PlanetTileVertex) * tile.vertices.size();
+	size_t water_size = sizeof(PlanetTileWaterVertex) * PlanetTile::VERTEX_COUNT;
+	size_t base_size = 2 + sizeof(glm::dvec3) + sizeof(double) * 2 + verts_size;
+
+	if(size < base_size)
+	{
+		return false;
+	}
+
+	bool has_water = data[1] != 0;
+	if(size != base_size + (has_water ? water_size : 0))
+	{
+		return false;
+	}
+
+	tile.clockwise = data[0] != 0;
+	const uint8_t* ptr = data + 2;
+	memcpy(&tile.up, ptr, sizeof(glm::dvec3));
+	ptr += sizeof(glm::dvec3);
+	memcpy(&tile.min_height, ptr, sizeof(double));
+	ptr += sizeof(double);
+	memcpy(&tile.max_height, ptr, sizeof(double));
+	ptr += sizeof(double);
+	memcpy(tile.vertices.data(), ptr, verts_size);
+	ptr += verts_size;
+	if(has_water)
+	{
+		tile.water_vertices = new std::array<PlanetTileWaterVertex, PlanetTile::VERTEX_COUNT>();
+		memcpy(tile.water_vertices->data(), ptr, water_size);
+	}
+
+	return true;
+}
+
+void PlanetTileCache::open(uint64_t hash)
+{
+	PlanetTileCacheHeader header;
+	header.magic = MAGIC;
+	header.version = VERSION;
+	header.hash = hash;
+
+	bool fresh = !std::filesystem::exists(file_path);
+	if(!fresh)
+	{
+		file.open(file_path, std::ios::in | std::ios::out | std::ios::binary);
+		PlanetTileCacheHeader read_header;
+		file.read((char*)&read_header, sizeof(PlanetTileCacheHeader));
+		if(!file || read_header.magic != header.magic || read_header.version != header.version ||
+			read_header.hash != header.hash)
+		{
+			logger->warn("Planet tile cache '{}' is outdated or broken, recreating it", file_path);
+			file.close();
+			fresh = true;
+		}
+	}
+
+	if(fresh)
+	{
+		file.open(file_path, std::ios::in | std::ios::out | std::ios::binary | std::ios::trunc);
+		file.write((const char*)&header, sizeof(PlanetTileCacheHeader));
+		file.flush();
+	}
+
+	valid = file.good();
+	if(!valid)
+	{
+		logger->warn("Could not open planet tile cache '{}', tiles will not be cached", file_path);
+		return;
+	}
+
+	file_end = sizeof(PlanetTileCacheHeader);
+	if(!fresh)
+	{
+		scan();
+	}
+}
+
+void PlanetTileCache::scan()
+{
+	uint64_t file_size = (uint64_t)std::filesystem::file_size(file_path);
+	uint64_t offset = sizeof(PlanetTileCacheHeader);
+
+	while(offset + sizeof(PlanetTileCacheRecord) <= file_size)
+	{
+		PlanetTileCacheRecord record;
+		file.seekg(offset);
+		file.read((char*)&record, sizeof(PlanetTileCacheRecord));
+		uint64_t data_offset = offset + sizeof(PlanetTileCacheRecord);
+		if(!file || data_offset + record.size > file_size)
+		{
+			// Truncated by a crash while writing, it will be overwritten
+			break;
+		}
+
+		index[record.key] = std::make_pair(data_offset, record.size);
+		offset = data_offset + record.size;
+	}
+
+	file.clear();
+	file_end = offset;
+	logger->info("Loaded planet tile cache '{}' ({} tiles)", file_path, index.size());
+}
+
+void PlanetTileCache::writer_func()
+{
+	set_this_thread_name("tilecache");
+
+	std::unique_lock<std::mutex> lock(queue_mtx);
+	while(true)
+	{
+		queue_cv.wait(lock, [this](){ return !run || !queue.empty(); });
+
+		// Pending writes are finished even when closing
+		if(queue.empty() && !run)
+		{
+			return;
+		}
+
+		std::vector<PendingWrite> to_write = std::move(queue);
+		queue.clear();
+		lock.unlock();
+
+		{
+			PROFILE_BLOCK("tile_cache_write");
+			PROFILE_COUNTER("tile_cache_writes", to_write.size());
+			std::unique_lock<std::mutex> file_lock(file_mtx);
+			for(const PendingWrite& write : to_write)
+			{
+				PlanetTileCacheRecord record;
+				record.key = write.key;
+				record.size = (uint32_t)write.data.size();
+
+				file.seekp(file_end);
+				file.write((const char*)&record, sizeof(PlanetTileCacheRecord));
+				file.write((const char*)write.data.data(), write.data.size());
+				if(!file)
+				{
+					logger->warn("Could not write to planet tile cache '{}'", file_path);
+					file.clear();
+					break;
+				}
+
+				index[write.key] = std::make_pair(file_end + sizeof(PlanetTileCacheRecord), record.size);
+				file_end += sizeof(PlanetTileCacheRecord) + record.size;
+			}
+			file.flush();
+		}
+
+		lock.lock();
+		for(const PendingWrite& write : to_write)
+		{
+			queued.erase(write.key);
+		}
+	}
+}
+
+bool PlanetTileCache::contains(PlanetTileKey key)
+{
+	if(!valid)
+	{
+		return false;
+	}
+
+	std::unique_lock<std::mutex> lock(file_mtx);
+	return index.find(key.value) != index.end();
+}
+
+PlanetTile* PlanetTileCache::load(PlanetTileKey key)
+{
+	if(!valid)
+	{
+		return nullptr;
+	}
+
+	PROFILE_BLOCK("tile_cache_load");
+
+	thread_local std::vector<uint8_t> data;
+	{
+		std::unique_lock<std::mutex> lock(file_mtx);
+		auto it = index.find(key.value);
+		if(it == index.end())
+		{
+			return nullptr;
+		}
+
+		data.resize(it->second.second);
+		file.seekg(it->second.first);
+		file.read((char*)data.data(), data.size());
+		if(!file)
+		{
+			file.clear();
+			return nullptr;
+		}
+	}
+
+	PlanetTile* tile = new PlanetTile();
+	if(!decode(data.data(), data.size(), *tile))
+	{
+		delete tile;
+		return nullptr;
+	}
+
+	return tile;
+}
+
+void PlanetTileCache::store(PlanetTileKey key, const PlanetTile& tile)
+{
+	if(!valid || contains(key))
+	{
+		return;
+	}
+
+	PendingWrite write;
+	write.key = key.value;
+	encode(tile, write.data);
+
+	std::unique_lock<std::mutex> lock(queue_mtx);
+	if(!queued.insert(key.value).second)
+	{
+		return;
+	}
+
+	queue.push_back(std::move(write));
+	queue_cv.notify_one();
+}
+
+size_t PlanetTileCache::get_tile_count()
+{
+	std::unique_lock<std::mutex> lock(file_mtx);
+	return index.size();
+}
+
+PlanetTileCache::PlanetTileCache(const std::string& planet, uint64_t hash)
+{
+	valid = false;
+	run = true;
+	writer = nullptr;
+	file_end = 0;
+
+	std::string folder = osp->assets->udata_path + "cache/planets/";
+	std::string prefix = planet + "_";
+	char hash_str[17];
+	snprintf(hash_str, sizeof(hash_str), "%016llx", (unsigned long long)hash);
+	file_path = folder + prefix + hash_str + ".bin";
+
+	std::error_code code;
+	std::filesystem::create_directories(folder, code);
+	if(code)
+	{
+		logger->warn("Could not create planet tile cache folder '{}'", folder);
+		return;
+	}
+
+	// Remove caches of older versions of this planet
+	for(const auto& entry : std::filesystem::directory_iterator(folder, code))
+	{
+		std::string name = entry.path().filename().string();
+		if(name != prefix + hash_str + ".bin" && name.size() == prefix.size() + 16 + 4 &&
+			name.compare(0, prefix.size(), prefix) == 0)
+		{
+			std::filesystem::remove(entry.path(), code);
+		}
+	}
+
+	open(hash);
+
+	if(valid)
+	{
+		writer = new std::thread(&PlanetTileCache::writer_func, this);
+	}
+}
+
+PlanetTileCache::~PlanetTileCache()
+{
+	if(writer)
+	{
+		{
+			std::unique_lock<std::mutex> lock(queue_mtx);
+			run = false;
+			queue_cv.notify_all();
+		}
+		writer->join();
+		delete writer;
+	}
+}
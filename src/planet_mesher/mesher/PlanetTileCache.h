@@ -0,0 +1,83 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+#include <fstream>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <cstdint>
+#include "PlanetTile.h"
+#include "PlanetTileKey.h"
+
+// Stores generated tiles on disk, so revisiting an area or restarting the game
+// doesn't run the generator again.
+// There's one file per planet at udata/cache/planets/<planet>_<hash>.bin, where hash
+// covers everything that changes the generated tiles: the script (or generator table),
+// radius, water and the tile format. Changing any of them starts a new file, and old
+// files of the same planet are removed. (Files required by the script are not hashed,
+// delete the cache folder if you change only those!)
+// The file is a header followed by appended records (key, size, tile data). The index
+// is rebuilt by scanning the records on open, a truncated last record is discarded.
+// Reads may be done from any thread, writes are queued and done by a writer thread.
+class PlanetTileCache
+{
+private:
+
+	static constexpr uint32_t MAGIC = 0x5054534F;
+	static constexpr uint32_t VERSION = 2;
+
+	struct PendingWrite
+	{
+		uint64_t key;
+		std::vector<uint8_t> data;
+	};
+
+	std::string file_path;
+	std::fstream file;
+	uint64_t file_end;
+
+	// Protects file, file_end and index
+	std::mutex file_mtx;
+	// Offset of the tile data of each key
+	std::unordered_map<uint64_t, std::pair<uint64_t, uint32_t>> index;
+
+	std::mutex queue_mtx;
+	std::condition_variable queue_cv;
+	std::vector<PendingWrite> queue;
+	// Keys in the queue, so a tile is not queued twice
+	std::unordered_set<uint64_t> queued;
+	bool run;
+	std::thread* writer;
+
+	bool valid;
+
+	static void encode(const PlanetTile& tile, std::vector<uint8_t>& out);
+	static bool decode(const uint8_t* data, size_t size, PlanetTile& tile);
+
+	void open(uint64_t hash);
+	void scan();
+	void writer_func();
+
+public:
+
+	// Combine with the data that affects generation
+	static uint64_t hash(const std::string& data, uint64_t seed = 14695981039346656037ULL);
+
+	bool contains(PlanetTileKey key);
+
+	// Returns nullptr if the tile is not in the cache (or the stored data is broken)
+	PlanetTile* load(PlanetTileKey key);
+
+	// Encodes the tile now and writes it later, so it may be deleted after the call
+	void store(PlanetTileKey key, const PlanetTile& tile);
+
+	size_t get_tile_count();
+
+	bool is_valid() const { return valid; }
+
+	// planet is used for the file name, hash is built using PlanetTileCache::hash
+	PlanetTileCache(const std::string& planet, uint64_t hash);
+	~PlanetTileCache();
+};
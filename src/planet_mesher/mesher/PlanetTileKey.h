@@ -0,0 +1,159 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include "../quadtree/QuadTreeDefines.h"
+
+// Identifies a quadtree tile packed in 64 bits: side (3 bits), depth (5 bits) and
+// 2 bits per quadrant, root first. Unlike a vector of quadrants it's trivially copyable,
+// and hashing and comparing are single integer operations.
+// Quadrants are stored so that bit 0 is x (east) and bit 1 is y (south), so the tile
+// position in its side at its depth is obtained by de-interleaving them.
+struct PlanetTileKey
+{
+	static constexpr size_t MAX_DEPTH = 28;
+
+	uint64_t value;
+
+	PlanetSide get_side() const { return (PlanetSide)(value & 0x7); }
+	size_t get_depth() const { return (size_t)((value >> 3) & 0x1F); }
+
+	// i = 0 is the quadrant of the root tile
+	QuadTreeQuadrant get_quadrant(size_t i) const
+	{
+		return (QuadTreeQuadrant)((value >> (8 + i * 2)) & 0x3);
+	}
+
+	PlanetTileKey get_parent() const
+	{
+		size_t depth = get_depth();
+		if(depth == 0)
+		{
+			return *this;
+		}
+
+		uint64_t quads = (value >> 8) & ~(0x3ULL << ((depth - 1) * 2));
+		return PlanetTileKey(get_side(), depth - 1, quads);
+	}
+
+	// Don't call at MAX_DEPTH
+	PlanetTileKey get_child(QuadTreeQuadrant quad) const
+	{
+		size_t depth = get_depth();
+		uint64_t quads = (value >> 8) | ((uint64_t)quad << (depth * 2));
+		return PlanetTileKey(get_side(), depth + 1, quads);
+	}
+
+	// True if this is b or a child of b, at any depth
+	bool is_inside(PlanetTileKey b) const
+	{
+		size_t depth = get_depth();
+		size_t b_depth = b.get_depth();
+		if(get_side() != b.get_side() || b_depth > depth)
+		{
+			return false;
+		}
+
+		uint64_t mask = b_depth == 0 ? 0 : (~0ULL >> (64 - b_depth * 2));
+		return ((value >> 8) & mask) == ((b.value >> 8) & mask);
+	}
+
+	// Position of the tile in its side, in tiles of its depth (0 is north-west)
+	void get_xy(uint32_t& x, uint32_t& y) const
+	{
+		size_t depth = get_depth();
+		x = 0; y = 0;
+		for(size_t i = 0; i < depth; i++)
+		{
+			uint32_t q = (uint32_t)get_quadrant(i);
+			x = (x << 1) | (q & 0x1);
+			y = (y << 1) | (q >> 1);
+		}
+	}
+
+	static PlanetTileKey from_xy(PlanetSide side, size_t depth, uint32_t x, uint32_t y)
+	{
+		uint64_t quads = 0;
+		for(size_t i = 0; i < depth; i++)
+		{
+			uint64_t shift = depth - 1 - i;
+			uint64_t q = ((x >> shift) & 0x1) | (((y >> shift) & 0x1) << 1);
+			quads |= q << (i * 2);
+		}
+		return PlanetTileKey(side, depth, quads);
+	}
+
+	// Neighbor of the same depth in the same side. Returns false if it would
+	// be in another side of the cube (use the quadtree neighbors for those)
+	bool get_neighbor(QuadTreeSide dir, PlanetTileKey& out) const
+	{
+		uint32_t x, y;
+		get_xy(x, y);
+		size_t depth = get_depth();
+		uint32_t max = (uint32_t)((1ULL << depth) - 1);
+
+		if((dir == NORTH && y == 0) || (dir == SOUTH && y == max) ||
+			(dir == WEST && x == 0) || (dir == EAST && x == max))
+		{
+			return false;
+		}
+
+		if(dir == NORTH) y--;
+		else if(dir == SOUTH) y++;
+		else if(dir == WEST) x--;
+		else x++;
+
+		out = from_xy(get_side(), depth, x, y);
+		return true;
+	}
+
+	std::vector<QuadTreeQuadrant> to_path() const
+	{
+		std::vector<QuadTreeQuadrant> out;
+		out.reserve(get_depth());
+		for(size_t i = 0; i < get_depth(); i++)
+		{
+			out.push_back(get_quadrant(i));
+		}
+		return out;
+	}
+
+	static PlanetTileKey from_path(const std::vector<QuadTreeQuadrant>& path, PlanetSide side)
+	{
+		uint64_t quads = 0;
+		for(size_t i = 0; i < path.size(); i++)
+		{
+			quads |= (uint64_t)path[i] << (i * 2);
+		}
+		return PlanetTileKey(side, path.size(), quads);
+	}
+
+	bool operator==(const PlanetTileKey& b) const { return value == b.value; }
+	bool operator!=(const PlanetTileKey& b) const { return value != b.value; }
+
+	// Bigger (lower depth) tiles go first, so sets are ordered by priority
+	bool operator<(const PlanetTileKey& b) const
+	{
+		size_t da = get_depth();
+		size_t db = b.get_depth();
+		return da < db || (da == db && value < b.value);
+	}
+
+	// Root tile of side
+	explicit PlanetTileKey(PlanetSide side) : value((uint64_t)side) {}
+
+	PlanetTileKey(PlanetSide side, size_t depth, uint64_t quads)
+		: value((uint64_t)side | ((uint64_t)depth << 3) | (quads << 8)) {}
+
+	PlanetTileKey() : value(0) {}
+};
+
+struct PlanetTileKeyHasher
+{
+	std::size_t operator()(const PlanetTileKey& k) const
+	{
+		// Mix the bits as low bits are mostly the side and depth
+		uint64_t h = k.value * 0x9E3779B97F4A7C15ULL;
+		return (std::size_t)(h ^ (h >> 32));
+	}
+};
@@ -8,69 +8,28 @@ double sizeAtPathDepth(size_t depth)
 
 size_t PlanetTilePath::get_depth() const
 {
-	return path.size();
+	return key.get_depth();
 }
 
 glm::dvec2 PlanetTilePath::get_min() const
 {
-	glm::dvec2 out = glm::dvec2(0.0, 0.0);
+	uint32_t x, y;
+	key.get_xy(x, y);
+	double size = get_size();
 
-	for (size_t i = 0; i < path.size(); i++)
-	{
-		double size = sizeAtPathDepth(i + 1);
-
-		if (path[i] == NORTH_WEST)
-		{
-			// Nothing
-		}
-		else if (path[i] == NORTH_EAST)
-		{
-			out.x += size;
-		}
-		else if (path[i] == SOUTH_WEST)
-		{
-			out.y += size;
-		}
-		else
-		{
-			out.x += size;
-			out.y += size;
-		}
-	}
-
-	return out;
+	return glm::dvec2((double)x * size, (double)y * size);
 }
 
 
 
 double PlanetTilePath::get_size() const
 {
-	return sizeAtPathDepth(path.size());
-}
-
-bool arePathsEqual(const std::vector<QuadTreeQuadrant>& a, const std::vector<QuadTreeQuadrant>& b)
-{
-	if (a.size() == b.size())
-	{
-		for (size_t i = 0; i < a.size(); i++)
-		{
-			if (a[i] != b[i])
-			{
-				return false;
-			}
-		}
-
-		return true;
-	}
-	else
-	{
-		return false;
-	}
+	return sizeAtPathDepth(key.get_depth());
 }
 
 bool operator==(const PlanetTilePath& a, const PlanetTilePath& b)
 {
-	return a.side == b.side && arePathsEqual(a.path, b.path);
+	return a.key == b.key;
 }
 
 
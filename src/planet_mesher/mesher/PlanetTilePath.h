@@ -4,12 +4,16 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtx/quaternion.hpp>
 #include "../quadtree/QuadTreeDefines.h"
+#include "PlanetTileKey.h"
 #include <util/defines.h>
 #include <util/MathUtil.h>
 
+// Geometry of a tile (model matrices, bounds...) given its key.
+// Containers should store PlanetTileKey, which is much cheaper to hash and copy,
+// and build a PlanetTilePath only when the geometry is needed
 struct PlanetTilePath
 {
-	std::vector<QuadTreeQuadrant> path;
+	PlanetTileKey key;
 	PlanetSide side;
 
 	size_t get_depth() const;
@@ -31,39 +35,16 @@ struct PlanetTilePath
 	// Gets the aproximated up vector of the tile
 	glm::dvec3 get_tile_up() const;
 
-
-
-	PlanetTilePath(std::vector<QuadTreeQuadrant> path, PlanetSide side)
+	PlanetTilePath(PlanetTileKey key)
 	{
-		this->path = path;
-		this->side = side;
+		this->key = key;
+		this->side = key.get_side();
 	}
-};
 
-bool operator==(const PlanetTilePath& a, const PlanetTilePath& b);
-
-struct PlanetTilePathHasher
-{
-	std::size_t operator()(const PlanetTilePath &t) const
+	PlanetTilePath(const std::vector<QuadTreeQuadrant>& path, PlanetSide side)
+		: PlanetTilePath(PlanetTileKey::from_path(path, side))
 	{
-		std::size_t ret = 0;
-		hash_combine(ret, t.side);
-		for (size_t i = 0; i < t.path.size(); i++)
-		{
-			hash_combine(ret, t.path[i]);
-		}
-
-		return ret;
 	}
 };
 
-// Used in ordered sets
-struct PlanetTilePathLess
-{
-	// NOTE: We actually have the bigger tiles be the earliest 
-	// on the set!
-	bool operator() (const PlanetTilePath& a, const PlanetTilePath& b) const
-	{
-		return a.get_depth() < b.get_depth();
-	}
-};
\ No newline at end of file
+bool operator==(const PlanetTilePath& a, const PlanetTilePath& b);
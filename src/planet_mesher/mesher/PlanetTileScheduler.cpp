@@ -0,0 +1,185 @@
+#include "PlanetTileScheduler.h"
+#include "PlanetTilePath.h"
+#include <imgui/imgui.h>
+#include <algorithm>
+
+double PlanetTileScheduler::get_priority(PlanetTileKey key, glm::dvec3 camera)
+{
+	PlanetTilePath path = PlanetTilePath(key);
+	glm::dvec3 center_cubic = path.get_model_matrix() * glm::dvec4(0.5, 0.5, 0.0, 1.0);
+	glm::dvec3 center = MathUtil::cube_to_sphere(glm::normalize(center_cubic));
+
+	// The tile spans roughly its cube size over the unit sphere, which is also
+	// roughly the height error of drawing its parent instead
+	double error = path.get_size() * 2.0;
+	double distance = std::max(glm::distance(center, camera), 1e-6);
+
+	return error / distance;
+}
+
+void PlanetTileScheduler::set_wanted(const std::vector<PlanetTileKey>& keys, glm::dvec3 camera)
+{
+	auto now = Clock::now();
+
+	std::unique_lock<std::mutex> lock(mtx);
+
+	std::unordered_map<PlanetTileKey, Clock::time_point, PlanetTileKeyHasher> old_times;
+	old_times.reserve(pending.size());
+	for(const Request& req : pending)
+	{
+		old_times[req.key] = req.submit_time;
+	}
+
+	// keys is sorted, so we can binary search it
+	for(auto& pair : in_flight)
+	{
+		pair.second.cancelled = !std::binary_search(keys.begin(), keys.end(), pair.first);
+	}
+
+	pending.clear();
+	for(PlanetTileKey key : keys)
+	{
+		if(in_flight.find(key) != in_flight.end())
+		{
+			continue;
+		}
+
+		Request req;
+		req.key = key;
+		req.priority = get_priority(key, camera);
+
+		auto old = old_times.find(key);
+		if(old != old_times.end())
+		{
+			req.submit_time = old->second;
+			old_times.erase(old);
+		}
+		else
+		{
+			req.submit_time = now;
+		}
+
+		pending.push_back(req);
+	}
+
+	// Whatever is left was never started
+	dropped += old_times.size();
+
+	std::sort(pending.begin(), pending.end(), [](const Request& a, const Request& b)
+	{
+		return a.priority < b.priority;
+	});
+}
+
+size_t PlanetTileScheduler::pop_batch(std::vector<PlanetTileKey>& out)
+{
+	std::unique_lock<std::mutex> lock(mtx);
+
+	// Small batches when there's little work, so all threads get some
+	size_t batch = pending.size() / (thread_count * 4);
+	batch = std::max(std::min(batch, (size_t)8), (size_t)1);
+	batch = std::min(batch, pending.size());
+
+	for(size_t i = 0; i < batch; i++)
+	{
+		const Request& req = pending.back();
+		InFlight flight;
+		flight.submit_time = req.submit_time;
+		flight.cancelled = false;
+		in_flight[req.key] = flight;
+
+		out.push_back(req.key);
+		pending.pop_back();
+	}
+
+	return batch;
+}
+
+bool PlanetTileScheduler::finish(PlanetTileKey key)
+{
+	auto now = Clock::now();
+
+	std::unique_lock<std::mutex> lock(mtx);
+
+	auto it = in_flight.find(key);
+	if(it == in_flight.end())
+	{
+		return false;
+	}
+
+	float ms = std::chrono::duration<float, std::milli>(now - it->second.submit_time).count();
+	if(latencies.size() < LATENCY_SAMPLES)
+	{
+		latencies.push_back(ms);
+	}
+	else
+	{
+		latencies[latency_it] = ms;
+	}
+	latency_it = (latency_it + 1) % LATENCY_SAMPLES;
+
+	bool cancelled = it->second.cancelled;
+	in_flight.erase(it);
+
+	if(cancelled)
+	{
+		wasted++;
+		return false;
+	}
+
+	completed++;
+	return true;
+}
+
+bool PlanetTileScheduler::has_pending()
+{
+	std::unique_lock<std::mutex> lock(mtx);
+	return !pending.empty();
+}
+
+size_t PlanetTileScheduler::get_pending_count()
+{
+	std::unique_lock<std::mutex> lock(mtx);
+	return pending.size();
+}
+
+void PlanetTileScheduler::do_imgui()
+{
+	std::vector<float> sorted;
+	size_t pending_count, in_flight_count;
+	uint64_t completed_c, wasted_c, dropped_c;
+	{
+		std::unique_lock<std::mutex> lock(mtx);
+		sorted = latencies;
+		pending_count = pending.size();
+		in_flight_count = in_flight.size();
+		completed_c = completed;
+		wasted_c = wasted;
+		dropped_c = dropped;
+	}
+
+	ImGui::Text("Queue: %i pending, %i in flight", (int)pending_count, (int)in_flight_count);
+	double waste_pct = completed_c + wasted_c == 0 ? 0.0 : 100.0 * (double)wasted_c / (double)(completed_c + wasted_c);
+	ImGui::Text("Completed: %llu, wasted: %llu (%.1f%%), dropped: %llu", (unsigned long long)completed_c,
+		(unsigned long long)wasted_c, waste_pct, (unsigned long long)dropped_c);
+
+	if(!sorted.empty())
+	{
+		std::sort(sorted.begin(), sorted.end());
+		auto percentile = [&sorted](double p)
+		{
+			return sorted[std::min((size_t)(p * (double)sorted.size()), sorted.size() - 1)];
+		};
+		ImGui::Text("Latency (ms): p50 %.1f, p90 %.1f, p99 %.1f", percentile(0.5), percentile(0.9), percentile(0.99));
+	}
+}
+
+PlanetTileScheduler::PlanetTileScheduler(size_t thread_count)
+{
+	this->thread_count = std::max(thread_count, (size_t)1);
+	latency_it = 0;
+	completed = 0;
+	wasted = 0;
+	dropped = 0;
+	latencies.reserve(LATENCY_SAMPLES);
+}
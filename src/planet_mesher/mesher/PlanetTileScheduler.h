@@ -0,0 +1,80 @@
+#pragma once
+#include <vector>
+#include <unordered_map>
+#include <mutex>
+#include <chrono>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include "PlanetTileKey.h"
+
+// Decides which tile the generator threads work on next.
+// Every update the server hands the tiles it wants but doesn't have, and the
+// camera position. Pending tiles are ordered by an estimate of their screen space
+// error (tile size over distance to the camera), so the tiles under the camera come
+// first and coarse tiles come before their children.
+// Tiles no longer wanted are dropped from the queue, and if they are being generated,
+// their result is discarded once done (counted as wasted work).
+// Threads take batches of tiles so they don't fight over the lock for every tile.
+class PlanetTileScheduler
+{
+public:
+
+	using Clock = std::chrono::steady_clock;
+
+private:
+
+	struct Request
+	{
+		PlanetTileKey key;
+		double priority;
+		Clock::time_point submit_time;
+	};
+
+	struct InFlight
+	{
+		Clock::time_point submit_time;
+		bool cancelled;
+	};
+
+	static constexpr size_t LATENCY_SAMPLES = 512;
+
+	std::mutex mtx;
+	// Sorted by ascending priority, so the best requests are popped from the back
+	std::vector<Request> pending;
+	std::unordered_map<PlanetTileKey, InFlight, PlanetTileKeyHasher> in_flight;
+
+	size_t thread_count;
+
+	// Ring buffer of milliseconds from request to finished tile
+	std::vector<float> latencies;
+	size_t latency_it;
+
+	uint64_t completed;
+	// Finished tiles which were not wanted anymore
+	uint64_t wasted;
+	// Requests dropped before being started
+	uint64_t dropped;
+
+	static double get_priority(PlanetTileKey key, glm::dvec3 camera);
+
+public:
+
+	// camera is relative to the planet, in planet radius units, and in the
+	// rotating frame of the planet (same as the tiles)
+	void set_wanted(const std::vector<PlanetTileKey>& keys, glm::dvec3 camera);
+
+	// Appends up to a batch of the highest priority requests to out, which are
+	// marked as in flight. Returns how many were appended
+	size_t pop_batch(std::vector<PlanetTileKey>& out);
+
+	// Call once an in flight request is done. Returns false if it was cancelled,
+	// so the result must be discarded
+	bool finish(PlanetTileKey key);
+
+	bool has_pending();
+	size_t get_pending_count();
+
+	void do_imgui();
+
+	explicit PlanetTileScheduler(size_t thread_count);
+};
@@ -1,11 +1,20 @@
 #include "PlanetTileServer.h"
 #include <imgui/imgui.h>
 #include "../../util/Logger.h"
+#include "../../util/Profiler.h"
+#include "../generator/TerrainGenerator.h"
+#include <chrono>
+#include <sstream>
+#include <algorithm>
+#include <iterator>
 
 void PlanetTileServer::update(QuadTreePlanet& planet)
 {
+	PROFILE_BLOCK("planet_mesher");
+
 	if (dirty)
 	{
+		PROFILE_BLOCK("upload");
 		planet.iteration++;
 		auto tiles_w = tiles.get();
 
@@ -25,75 +34,95 @@ void PlanetTileServer::update(QuadTreePlanet& planet)
 		return;
 	}
 
-	std::vector<PlanetTilePath> paths = planet.get_all_paths();
+	// Both sorted, so we can find new and unused tiles with set differences
+	std::vector<PlanetTileKey> keys = planet.get_all_keys();
+	std::vector<PlanetTileKey> loaded_keys;
 
-	std::vector<PlanetTilePath> new_paths;
+	std::vector<PlanetTileKey> new_keys;
+	std::vector<PlanetTileKey> unused_keys;
 	{
 		// We obtain the lock on tiles during this block
 		auto tiles_w = tiles.get();
 
-		// Find new paths to generate
-		for (size_t i = 0; i < paths.size(); i++)
+		loaded_keys.reserve(tiles_w->size());
+		for (auto it = tiles_w->begin(); it != tiles_w->end(); it++)
 		{
-			if (tiles_w->find(paths[i]) == tiles_w->end())
+			loaded_keys.push_back(it->first);
+		}
+		std::sort(loaded_keys.begin(), loaded_keys.end());
+
+		std::set_difference(keys.begin(), keys.end(), loaded_keys.begin(), loaded_keys.end(),
+			std::back_inserter(new_keys));
+		std::set_difference(loaded_keys.begin(), loaded_keys.end(), keys.begin(), keys.end(),
+			std::back_inserter(unused_keys));
+
+		// Unload unused tiles
+		for (PlanetTileKey key : unused_keys)
+		{
+			if ((int)key.get_depth() > depth_for_unload)
 			{
-				new_paths.push_back(paths[i]);
+				auto it = tiles_w->find(key);
+				delete it->second;
+				tiles_w->erase(it);
 			}
 		}
+	}
 
-		// Find unused paths to unload, and unload them
-		for (auto it = tiles_w->begin(); it != tiles_w->end();)
+	// Tiles in the disk cache are loaded right away, instead of being generated
+	if (cache)
+	{
+		std::vector<std::pair<PlanetTileKey, PlanetTile*>> loaded;
+		size_t remaining = 0;
+		for (size_t i = 0; i < new_keys.size(); i++)
 		{
-			bool found = false;
-			for(size_t i = 0; i < paths.size(); i++)
-			{ 
-				if (paths[i] == it->first)
-				{
-					found = true;
-					break;
-				}
+			PlanetTile* tile = cache->load(new_keys[i]);
+			if (tile)
+			{
+				loaded.emplace_back(new_keys[i], tile);
+			}
+			else
+			{
+				new_keys[remaining++] = new_keys[i];
 			}
+		}
+		new_keys.resize(remaining);
 
-			if (!found)
+		if (!loaded.empty())
+		{
+			auto tiles_w = tiles.get();
+			for (auto& pair : loaded)
 			{
-				if (it->first.get_depth() > depth_for_unload)
+				if (tiles_w->find(pair.first) == tiles_w->end())
 				{
-					delete it->second;
-					it = tiles_w->erase(it);
+					(*tiles_w)[pair.first] = pair.second;
 				}
 				else
 				{
-					it++;
+					delete pair.second;
 				}
 			}
-			else
-			{
-				it++;
-			}
-		}
-		
 
+			dirty = true;
+		}
 	}
 
-	{
-		auto work_list_w = work_list.get();
-
-		work_list_w->clear();
+	// new_keys is sorted, as the scheduler needs
+	scheduler.set_wanted(new_keys, camera);
 
-		for (size_t i = 0; i < new_paths.size(); i++)
-		{
-			work_list_w->insert(new_paths[i]);
-		}
-
-		if (work_list_w->size() != 0)
-		{
-			condition_var.notify_all();
-		}
-		
+	if (scheduler.has_pending())
+	{
+		// Taking the lock makes sure no thread is between checking for work and waiting
+		std::unique_lock<std::mutex> lock(condition_mtx);
+		condition_var.notify_all();
 	}
 
 }
 
+void PlanetTileServer::set_camera(glm::dvec3 rel_camera_pos_radius_units)
+{
+	camera = rel_camera_pos_radius_units;
+}
+
 void PlanetTileServer::set_depth_for_unload(int depth)
 {
 	depth_for_unload = depth;
@@ -107,16 +136,23 @@ double PlanetTileServer::get_height(glm::dvec3 pos_3d, size_t depth)
 	glm::dvec2 projected = MathUtil::euclidean_to_spherical_r1(pos_3d);
 
 
-	default_lua(lua_state);
-
 	PlanetTile::GeneratorInfo info;
 	info.depth = (int)depth;
 	info.coord_3d = pos_3d;
 	info.coord_2d = projected;
 	info.radius = config->radius;
+	info.needs_color = false;
 
 	PlanetTile::GeneratorOut out;
 
+	if (generator)
+	{
+		PlanetTile::run_native(generator, &info, &out, 1);
+		return out.height;
+	}
+
+	default_lua(lua_state);
+
 	sol::protected_function func = lua_state["generate"];
 	auto result = func(info, &out);
 
@@ -131,8 +167,9 @@ double PlanetTileServer::get_height(glm::dvec3 pos_3d, size_t depth)
 	}
 }
 
-PlanetTileServer::PlanetTileServer(const std::string& script, const std::string& script_path,
+PlanetTileServer::PlanetTileServer(const std::string& name, const std::string& script, const std::string& script_path,
 								   ElementConfig* config, bool has_water, size_t thread_count)
+	: scheduler(thread_count)
 {
 	this->has_water = has_water;
 
@@ -140,44 +177,89 @@ PlanetTileServer::PlanetTileServer(const std::string& script, const std::string&
 	has_errors = false;
 	threads_run = true;
 	depth_for_unload = 0;
+	camera = glm::dvec3(0.0);
 
 	bool wrote_error = false;
 
 	PlanetTile::prepare_lua(lua_state);
-	LuaUtil::safe_lua(lua_state, script, wrote_error, script_path);
+	generator = nullptr;
+	if (config->surface.generator)
+	{
+		generator = new TerrainGenerator(*config->surface.generator);
+	}
+
+	// The script is still loaded if present, so both can be benchmarked
+	if (!script.empty())
+	{
+		LuaUtil::safe_lua(lua_state, script, wrote_error, script_path);
+	}
+
+	cache = nullptr;
+	if (config->surface.disk_cache)
+	{
+		// Everything that changes the generated tiles
+		std::string generator_str;
+		if (config->surface.generator)
+		{
+			std::stringstream ss;
+			ss << *config->surface.generator;
+			generator_str = ss.str();
+		}
+
+		uint64_t hash = PlanetTileCache::hash(script);
+		hash = PlanetTileCache::hash(generator_str, hash);
+		hash = PlanetTileCache::hash(fmt::format("{:.17g} {} {} {} {}", config->radius, has_water,
+			PlanetTile::TILE_SIZE, sizeof(PlanetTileVertex), sizeof(PlanetTileWaterVertex)), hash);
+
+		cache = new PlanetTileCache(name, hash);
+	}
 
 	threads.resize(thread_count);
 
 	for (size_t i = 0; i < threads.size(); i++)
 	{
-
-		threads[i].thread = new std::thread(thread_func, this, &threads[i]);
 		PlanetTile::prepare_lua(threads[i].lua_state);
-		
-		LuaUtil::safe_lua(threads[i].lua_state, script, wrote_error, script_path);
+
+		// Generators load images, so they are created here and not in the thread
+		threads[i].generator = nullptr;
+		if (config->surface.generator)
+		{
+			threads[i].generator = new TerrainGenerator(*config->surface.generator);
+		}
+		else
+		{
+			LuaUtil::safe_lua(threads[i].lua_state, script, wrote_error, script_path);
+		}
 
 		if (wrote_error)
 		{
 			has_errors = true;
 		}
+
+		threads[i].thread = new std::thread(thread_func, this, &threads[i]);
 	}
 }
 
 
 PlanetTileServer::~PlanetTileServer()
 {
-	threads_run = false;
-
-
-	for (size_t i = 0; i < threads.size(); i++)
 	{
-		// We must work hard to get those threads to wake up!
+		std::unique_lock<std::mutex> lock(condition_mtx);
+		threads_run = false;
 		condition_var.notify_all();
+	}
 
+	for (size_t i = 0; i < threads.size(); i++)
+	{
 		threads[i].thread->join();
 		delete threads[i].thread;
+		delete threads[i].generator;
 	}
 
+	delete generator;
+	// Pending writes are finished here
+	delete cache;
+
 	// Tiles are now only managed by us so this is actually safe
 	for (auto it = tiles.get_unsafe()->begin(); it != tiles.get_unsafe()->end(); it++)
 	{
@@ -193,7 +275,54 @@ void PlanetTileServer::do_imgui()
 	// (Not really unsafe!)
 	size_t tiles_size = tiles.get_unsafe()->size();
 	ImGui::Text("Loaded tiles: %i (%.2fMB)", (int)tiles_size, (float)(tiles_size * sizeof(PlanetTile)) / 1000000.0f);
-	ImGui::Text("Work List: %i", (int)work_list.get_unsafe()->size());
+	scheduler.do_imgui();
+	ImGui::Text("Generator: %s", generator ? "native" : "lua");
+	if (cache)
+	{
+		ImGui::Text("Disk cache: %i tiles", (int)cache->get_tile_count());
+	}
+	if (ImGui::Button("Benchmark generator"))
+	{
+		benchmark(64);
+	}
+}
+
+double PlanetTileServer::benchmark_generator(sol::state& lua, TerrainGenerator* native, size_t tile_count)
+{
+	auto arrays = std::make_unique<PlanetTile::GeneratorArrays>();
+	auto tile = std::make_unique<PlanetTile>();
+
+	// Tiles at a fixed depth all over the PX face, so noise is not cached between them
+	const size_t depth = 4;
+	const uint32_t side_tiles = 1 << depth;
+
+	auto start = std::chrono::high_resolution_clock::now();
+	for (size_t i = 0; i < tile_count; i++)
+	{
+		uint32_t x = (uint32_t)(i % side_tiles);
+		uint32_t y = (uint32_t)((i / side_tiles) % side_tiles);
+		tile->generate(PlanetTileKey::from_xy(PX, depth, x, y), config->radius, lua, native, has_water, arrays.get());
+	}
+	auto end = std::chrono::high_resolution_clock::now();
+
+	double seconds = std::chrono::duration<double>(end - start).count();
+	double vertices = (double)tile_count * (double)PlanetTile::GEN_ARRAY_SIZE;
+	return vertices / std::max(seconds, 1e-9);
+}
+
+void PlanetTileServer::benchmark(size_t tile_count)
+{
+	if (lua_state["generate"].valid())
+	{
+		double lua_rate = benchmark_generator(lua_state, nullptr, tile_count);
+		logger->info("Lua surface generator: {:.0f} vertices/s", lua_rate);
+	}
+
+	if (generator)
+	{
+		double native_rate = benchmark_generator(lua_state, generator, tile_count);
+		logger->info("Native surface generator: {:.0f} vertices/s", native_rate);
+	}
 }
 
 void PlanetTileServer::thread_func(PlanetTileServer* server, PlanetTileThread* thread)
@@ -201,63 +330,72 @@ void PlanetTileServer::thread_func(PlanetTileServer* server, PlanetTileThread* t
 	set_this_thread_name("surfacegen");
 	PlanetTile::GeneratorArrays arrays;
 
+	std::vector<PlanetTileKey> batch;
+
 	while (server->threads_run)
 	{
 		{
 			// Needs a block so the lock is free once the wait is over
 			std::unique_lock<std::mutex> lock(server->condition_mtx);
-			server->condition_var.wait(lock);
+			server->condition_var.wait(lock, [server]()
+			{
+				return !server->threads_run || server->scheduler.has_pending();
+			});
 		}
 
 		// (We break out of this loop)
-		while (true)
+		while (server->threads_run)
 		{
-			PlanetTilePath target = PlanetTilePath(std::vector<QuadTreeQuadrant>(), PX);
-
+			batch.clear();
+			if (server->scheduler.pop_batch(batch) == 0)
 			{
-				auto work_list_w = server->work_list.get();
-
-				if (work_list_w->size() == 0)
-				{
-					break;
-				}
-			
-				
-				// Simpler method, starts from smallest tile
-				target = *work_list_w->begin();
-				work_list_w->erase(work_list_w->begin());
-				
-				
+				break;
 			}
 
-			// Work on the target
-			PlanetTile* ntile = new PlanetTile();
-			bool has_errors = ntile->generate(target, server->config->radius, 
-				thread->lua_state, server->has_water, &arrays);
-
-			if (has_errors)
+			for (PlanetTileKey target : batch)
 			{
-				server->has_errors = true;
-			}
-
+				PROFILE_BLOCK("tile");
+				PlanetTile* ntile = new PlanetTile();
+				bool has_errors;
+				{
+					PROFILE_BLOCK("generate");
+					has_errors = ntile->generate(target, server->config->radius,
+						thread->lua_state, thread->generator, server->has_water, &arrays);
+				}
 
-			{
-				// Send it to the tiles
-				auto tiles_w = server->tiles.get();
-				if (tiles_w->find(target) == tiles_w->end())
+				if (has_errors)
 				{
-					(*tiles_w)[target] = ntile;
+					server->has_errors = true;
 				}
-				else
+				else if (server->cache)
 				{
-					// Weird, but can happen, thread will have wasted some precious CPU
-					// time. TODO: Try to reduce the frequency of this
+					// Even if it's not wanted anymore, it's likely to be wanted again soon
+					server->cache->store(target, *ntile);
+				}
+
+				if (!server->scheduler.finish(target))
+				{
+					// Cancelled while we were generating it
 					delete ntile;
+					continue;
+				}
+
+				{
+					// Send it to the tiles
+					auto tiles_w = server->tiles.get();
+					if (tiles_w->find(target) == tiles_w->end())
+					{
+						(*tiles_w)[target] = ntile;
+					}
+					else
+					{
+						// Can happen if the disk cache loaded it meanwhile
+						delete ntile;
+					}
 				}
-				
-			}
 
-			server->dirty = true;
+				server->dirty = true;
+			}
 		}
 	}
 
@@ -11,6 +11,8 @@
 #include <universe/element/config/ElementConfig.h>
 #include "PlanetTilePath.h"
 #include "PlanetTile.h"
+#include "PlanetTileCache.h"
+#include "PlanetTileScheduler.h"
 #include "../quadtree/QuadTreePlanet.h"
 #include <util/ThreadUtil.h>
 #include <assets/AssetManager.h>
@@ -22,6 +24,8 @@
 struct PlanetTileThread
 {
 	sol::state lua_state;
+	// nullptr if the planet uses a lua script
+	TerrainGenerator* generator;
 	std::thread* thread;
 };
 
@@ -49,6 +53,13 @@ private:
 	// We keep a little state to find height and so 
 	// everybody can query to find stuff about the script
 	sol::state lua_state;
+	TerrainGenerator* generator;
+
+	// nullptr if the planet has disk_cache = false
+	PlanetTileCache* cache;
+
+	// Average vertices per second generating tiles with the given generator
+	double benchmark_generator(sol::state& lua, TerrainGenerator* native, size_t tile_count);
 
 public:
 
@@ -60,7 +71,7 @@ public:
 
 	bool threads_run;
 
-	using TileMap = std::unordered_map<PlanetTilePath, PlanetTile*, PlanetTilePathHasher>;
+	using TileMap = std::unordered_map<PlanetTileKey, PlanetTile*, PlanetTileKeyHasher>;
 
 
 
@@ -72,9 +83,14 @@ public:
 	std::unordered_map<std::string, AssetHandle<Image>> images;
 
 	Atomic<TileMap> tiles;
-	// Threads always try to work on the highest priority
-	// (ie. lowest detail tile) first
-	Atomic<std::multiset<PlanetTilePath, PlanetTilePathLess>> work_list;
+	// Threads take the tiles to generate from here, highest priority first
+	PlanetTileScheduler scheduler;
+
+	// Relative to the planet, in its rotating frame and in radius units
+	glm::dvec3 camera;
+
+	// Used to prioritize tile generation, call before update
+	void set_camera(glm::dvec3 rel_camera_pos_radius_units);
 
 	// Tells threads to start loading some new tiles, if neccesary
 	// or unloads unused, small enough tiles.
@@ -90,14 +106,19 @@ public:
 
 	bool is_built()
 	{
-		return work_list.get_unsafe()->size() == 0;
+		return !scheduler.has_pending();
 	}
 	
 	double get_height(glm::dvec3 pos_3d, size_t depth = 1);
 
+	// Generates tile_count tiles (blocking) with the lua script and with the native
+	// generator, if both are present, and logs the throughput of each
+	void benchmark(size_t tile_count);
+
 	// Make sure you call once a OpenGL context is available
 	// as we will create the index buffer here
-	PlanetTileServer(const std::string& script, const std::string& script_path,
+	// name is used for the disk cache
+	PlanetTileServer(const std::string& name, const std::string& script, const std::string& script_path,
 					 ElementConfig* config, bool has_water, size_t thread_count = 4);
 
 	~PlanetTileServer();
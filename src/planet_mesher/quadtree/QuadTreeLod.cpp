@@ -0,0 +1,305 @@
+#include "QuadTreeLod.h"
+#include "../mesher/PlanetTilePath.h"
+#include <imgui/imgui.h>
+#include <algorithm>
+
+uint32_t QuadTreeLod::alloc_block()
+{
+	if (!free_blocks.empty())
+	{
+		uint32_t block = free_blocks.back();
+		free_blocks.pop_back();
+		return block;
+	}
+
+	uint32_t block = (uint32_t)pool.size();
+	pool.resize(pool.size() + 4);
+	return block;
+}
+
+void QuadTreeLod::free_children(uint32_t node)
+{
+	uint32_t block = pool[node].children;
+	if (block == NO_CHILDREN)
+	{
+		return;
+	}
+
+	for (uint32_t i = 0; i < 4; i++)
+	{
+		free_children(block + i);
+	}
+
+	free_blocks.push_back(block);
+	pool[node].children = NO_CHILDREN;
+}
+
+uint32_t QuadTreeLod::find_node(PlanetTileKey key) const
+{
+	uint32_t node = (uint32_t)key.get_side();
+	for (size_t i = 0; i < key.get_depth(); i++)
+	{
+		if (pool[node].children == NO_CHILDREN)
+		{
+			return NO_CHILDREN;
+		}
+		node = pool[node].children + (uint32_t)key.get_quadrant(i);
+	}
+
+	return node;
+}
+
+glm::dvec3 QuadTreeLod::get_center(PlanetTileKey key)
+{
+	PlanetTilePath path = PlanetTilePath(key);
+	glm::dvec3 center_cubic = path.get_model_matrix() * glm::dvec4(0.5, 0.5, 0.0, 1.0);
+	return MathUtil::cube_to_sphere(glm::normalize(center_cubic));
+}
+
+double QuadTreeLod::get_error(PlanetTileKey key, glm::dvec3 center) const
+{
+	// Size of the tile over the unit sphere (the cube face is 2 units wide)
+	double size = PlanetTilePath(key).get_size() * 2.0;
+	// Drawing the node instead of its children loses half its vertex spacing
+	double geometric = size / vertices_per_tile;
+	// The observer may be over any part of the tile
+	double bound = size * 0.75;
+
+	double error = 0.0;
+	for (const LodObserver& obs : observers)
+	{
+		double distance = std::max(glm::distance(center, obs.pos) - bound, 1e-6);
+		error = std::max(error, geometric / distance * obs.pixels_per_radian);
+	}
+
+	return error;
+}
+
+void QuadTreeLod::set_observers(const std::vector<LodObserver>& observers)
+{
+	this->observers = observers;
+}
+
+bool QuadTreeLod::update(const LoadedFunc& is_loaded)
+{
+	std::vector<std::pair<double, uint32_t>> to_split;
+	std::vector<std::pair<double, uint32_t>> to_merge;
+
+	std::vector<uint32_t> open;
+	for (uint32_t i = 0; i < 6; i++)
+	{
+		open.push_back(i);
+	}
+
+	while (!open.empty())
+	{
+		uint32_t node = open.back();
+		open.pop_back();
+		const Node& n = pool[node];
+
+		if (n.children == NO_CHILDREN)
+		{
+			if (n.key.get_depth() < max_depth && is_loaded(n.key))
+			{
+				double error = get_error(n.key, n.center);
+				if (error > pixel_error)
+				{
+					to_split.emplace_back(error, node);
+				}
+			}
+			continue;
+		}
+
+		bool all_leafs = true;
+		for (uint32_t i = 0; i < 4; i++)
+		{
+			if (pool[n.children + i].children != NO_CHILDREN)
+			{
+				all_leafs = false;
+			}
+			open.push_back(n.children + i);
+		}
+
+		if (all_leafs)
+		{
+			double error = get_error(n.key, n.center);
+			if (error < pixel_error * 0.5)
+			{
+				to_merge.emplace_back(error, node);
+			}
+		}
+	}
+
+	// Worst error first
+	std::sort(to_split.begin(), to_split.end(), [](const auto& a, const auto& b)
+	{
+		return a.first > b.first;
+	});
+	std::sort(to_merge.begin(), to_merge.end(), [](const auto& a, const auto& b)
+	{
+		return a.first < b.first;
+	});
+
+	last_merges = std::min(to_merge.size(), max_merges);
+	last_splits = 0;
+
+	for (size_t i = 0; i < last_merges; i++)
+	{
+		free_children(to_merge[i].second);
+	}
+
+	for (size_t i = 0; i < to_split.size() && last_splits < max_splits; i++)
+	{
+		uint32_t node = to_split[i].second;
+		PlanetTileKey key = pool[node].key;
+		// Its parent may have been merged just now
+		if (find_node(key) != node)
+		{
+			continue;
+		}
+
+		// (pool may grow, so don't hold references across this)
+		uint32_t block = alloc_block();
+		for (uint32_t j = 0; j < 4; j++)
+		{
+			pool[block + j].key = key.get_child((QuadTreeQuadrant)j);
+			pool[block + j].children = NO_CHILDREN;
+			pool[block + j].center = get_center(pool[block + j].key);
+		}
+		pool[node].children = block;
+		last_splits++;
+	}
+
+	return last_splits != 0 || last_merges != 0;
+}
+
+void QuadTreeLod::get_all_keys(uint32_t node, std::vector<PlanetTileKey>& out) const
+{
+	out.push_back(pool[node].key);
+	if (pool[node].children != NO_CHILDREN)
+	{
+		for (uint32_t i = 0; i < 4; i++)
+		{
+			get_all_keys(pool[node].children + i, out);
+		}
+	}
+}
+
+void QuadTreeLod::get_all_keys(std::vector<PlanetTileKey>& out) const
+{
+	for (uint32_t i = 0; i < 6; i++)
+	{
+		get_all_keys(i, out);
+	}
+
+	std::sort(out.begin(), out.end());
+}
+
+void QuadTreeLod::get_leaf_keys(uint32_t node, std::vector<PlanetTileKey>& out) const
+{
+	if (pool[node].children == NO_CHILDREN)
+	{
+		out.push_back(pool[node].key);
+		return;
+	}
+
+	for (uint32_t i = 0; i < 4; i++)
+	{
+		get_leaf_keys(pool[node].children + i, out);
+	}
+}
+
+void QuadTreeLod::get_leaf_keys(std::vector<PlanetTileKey>& out) const
+{
+	for (uint32_t i = 0; i < 6; i++)
+	{
+		get_leaf_keys(i, out);
+	}
+}
+
+bool QuadTreeLod::compute_drawable(uint32_t node, const LoadedFunc& is_loaded, std::vector<uint8_t>& drawable) const
+{
+	bool children_drawable = pool[node].children != NO_CHILDREN;
+	if (pool[node].children != NO_CHILDREN)
+	{
+		for (uint32_t i = 0; i < 4; i++)
+		{
+			if (!compute_drawable(pool[node].children + i, is_loaded, drawable))
+			{
+				children_drawable = false;
+			}
+		}
+	}
+
+	bool result = children_drawable || is_loaded(pool[node].key);
+	drawable[node] = result;
+	return result;
+}
+
+void QuadTreeLod::get_render_keys(uint32_t node, const LoadedFunc& is_loaded, std::vector<PlanetTileKey>& out,
+								  std::vector<uint8_t>& drawable) const
+{
+	uint32_t children = pool[node].children;
+	bool use_children = children != NO_CHILDREN;
+	if (use_children)
+	{
+		for (uint32_t i = 0; i < 4; i++)
+		{
+			if (!drawable[children + i])
+			{
+				use_children = false;
+			}
+		}
+	}
+
+	if (use_children)
+	{
+		for (uint32_t i = 0; i < 4; i++)
+		{
+			get_render_keys(children + i, is_loaded, out, drawable);
+		}
+	}
+	else if (is_loaded(pool[node].key))
+	{
+		out.push_back(pool[node].key);
+	}
+}
+
+void QuadTreeLod::get_render_keys(const LoadedFunc& is_loaded, std::vector<PlanetTileKey>& out) const
+{
+	std::vector<uint8_t> drawable;
+	drawable.resize(pool.size(), 0);
+
+	for (uint32_t i = 0; i < 6; i++)
+	{
+		compute_drawable(i, is_loaded, drawable);
+		get_render_keys(i, is_loaded, out, drawable);
+	}
+}
+
+void QuadTreeLod::do_imgui()
+{
+	ImGui::Text("LOD nodes: %i (pool %i), %i observers", (int)get_node_count(), (int)pool.size(),
+		(int)observers.size());
+	ImGui::Text("Last update: %i splits, %i merges", (int)last_splits, (int)last_merges);
+}
+
+QuadTreeLod::QuadTreeLod(size_t max_depth, double pixel_error, double vertices_per_tile,
+						 size_t max_splits, size_t max_merges)
+{
+	this->max_depth = std::min(max_depth, PlanetTileKey::MAX_DEPTH);
+	this->pixel_error = pixel_error;
+	this->vertices_per_tile = vertices_per_tile;
+	this->max_splits = max_splits;
+	this->max_merges = max_merges;
+	last_splits = 0;
+	last_merges = 0;
+
+	pool.resize(6);
+	for (uint32_t i = 0; i < 6; i++)
+	{
+		pool[i].key = PlanetTileKey((PlanetSide)i);
+		pool[i].children = NO_CHILDREN;
+		pool[i].center = get_center(pool[i].key);
+	}
+}
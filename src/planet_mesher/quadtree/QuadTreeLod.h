@@ -0,0 +1,100 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include <functional>
+#include <glm/glm.hpp>
+#include "QuadTreeDefines.h"
+#include "../mesher/PlanetTileKey.h"
+
+// Someone who wants to see detailed terrain (the camera, a vehicle...)
+struct LodObserver
+{
+	// Relative to the planet, in its rotating frame and in radius units
+	glm::dvec3 pos;
+	// Viewport height in pixels over vertical field of view in radians
+	double pixels_per_radian;
+};
+
+// Level of detail for a whole planet driven by any number of observers.
+// A node is split when the error of drawing it instead of its children, projected
+// to the screen of any observer, is bigger than pixel_error, and merged back when it's
+// below half of that (so nodes don't flicker between states).
+// Changes are incremental and bounded per update, nodes are never rebuilt from
+// scratch, and they live in a pool (blocks of 4 siblings) which is reused.
+// Nodes only split once their tile is loaded, so we don't get ahead of the generator.
+// It doesn't know about neighbors, tile skirts hide depth differences.
+class QuadTreeLod
+{
+public:
+
+	static constexpr uint32_t NO_CHILDREN = 0xFFFFFFFF;
+
+	struct Node
+	{
+		PlanetTileKey key;
+		// Index of the first of the 4 children in the pool
+		uint32_t children;
+		// Over the unit sphere, computed once as the error metric needs it every update
+		glm::dvec3 center;
+	};
+
+	using LoadedFunc = std::function<bool(PlanetTileKey)>;
+
+private:
+
+	// The 6 roots are the first nodes, then blocks of 4
+	std::vector<Node> pool;
+	std::vector<uint32_t> free_blocks;
+
+	std::vector<LodObserver> observers;
+
+	size_t max_depth;
+	double pixel_error;
+	double vertices_per_tile;
+
+	size_t max_splits;
+	size_t max_merges;
+
+	size_t last_splits;
+	size_t last_merges;
+
+	uint32_t alloc_block();
+	void free_children(uint32_t node);
+	// NO_CHILDREN if the node doesn't exist
+	uint32_t find_node(PlanetTileKey key) const;
+
+	void get_all_keys(uint32_t node, std::vector<PlanetTileKey>& out) const;
+	void get_leaf_keys(uint32_t node, std::vector<PlanetTileKey>& out) const;
+	void get_render_keys(uint32_t node, const LoadedFunc& is_loaded, std::vector<PlanetTileKey>& out,
+						 std::vector<uint8_t>& drawable) const;
+	// Sets drawable[node] if the node's area can be drawn by it or its children
+	bool compute_drawable(uint32_t node, const LoadedFunc& is_loaded, std::vector<uint8_t>& drawable) const;
+
+public:
+
+	static glm::dvec3 get_center(PlanetTileKey key);
+
+	// Biggest error (in pixels) any observer sees if the node is drawn instead of its children
+	double get_error(PlanetTileKey key, glm::dvec3 center) const;
+
+	void set_observers(const std::vector<LodObserver>& observers);
+
+	// Does a bounded amount of splits and merges, returns true if anything changed
+	bool update(const LoadedFunc& is_loaded);
+
+	// Every node, sorted
+	void get_all_keys(std::vector<PlanetTileKey>& out) const;
+	void get_leaf_keys(std::vector<PlanetTileKey>& out) const;
+	// The leafs to draw, using the closest loaded parent of leafs which are not loaded
+	void get_render_keys(const LoadedFunc& is_loaded, std::vector<PlanetTileKey>& out) const;
+
+	size_t get_node_count() const { return pool.size() - free_blocks.size() * 4; }
+	size_t get_last_splits() const { return last_splits; }
+	size_t get_last_merges() const { return last_merges; }
+
+	void do_imgui();
+
+	// vertices_per_tile is the tile size (in vertices) of the generated tiles
+	QuadTreeLod(size_t max_depth, double pixel_error, double vertices_per_tile,
+				size_t max_splits = 32, size_t max_merges = 32);
+};
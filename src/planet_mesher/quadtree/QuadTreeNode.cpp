@@ -105,7 +105,8 @@ QuadTreeNode* QuadTreeNode::get_recursive(glm::dvec2 coord, size_t maxDepth)
 		neighbors[WEST]->obtain_neighbors(neighbors[WEST]->quad);
 	}
 
-	if (depth < maxDepth)
+	// Deeper nodes would not fit in a PlanetTileKey
+	if (depth < maxDepth && depth < PlanetTileKey::MAX_DEPTH)
 	{
 		int result = get_quadrant(coord);
 		if (result == -1)
@@ -130,7 +131,8 @@ QuadTreeNode* QuadTreeNode::get_recursive(glm::dvec2 coord, size_t maxDepth)
 
 QuadTreeNode* QuadTreeNode::get_recursive_simple(glm::dvec2 coord, size_t maxDepth)
 {
-	if (depth < maxDepth)
+	// Deeper nodes would not fit in a PlanetTileKey
+	if (depth < maxDepth && depth < PlanetTileKey::MAX_DEPTH)
 	{
 		int result = get_quadrant(coord);
 		if (result == -1)
@@ -415,41 +417,14 @@ void QuadTreeNode::obtain_neighbors(QuadTreeQuadrant quad, bool nosplit)
 
 
 
-std::vector<QuadTreeQuadrant> QuadTreeNode::get_path() const
+PlanetTileKey QuadTreeNode::get_key() const
 {
-
-	if (depth > 0)
-	{
-
-		std::vector<QuadTreeQuadrant> fromParent = parent->get_path();
-
-		if (parent->children[NORTH_WEST] == this)
-		{
-			fromParent.push_back(NORTH_WEST);
-		}
-
-		if (parent->children[NORTH_EAST] == this)
-		{
-			fromParent.push_back(NORTH_EAST);
-		}
-
-		if (parent->children[SOUTH_WEST] == this)
-		{
-			fromParent.push_back(SOUTH_WEST);
-		}
-
-		if (parent->children[SOUTH_EAST] == this)
-		{
-			fromParent.push_back(SOUTH_EAST);
-		}
-
-		return fromParent;
-	}
-	else
+	if (depth == 0)
 	{
-		return std::vector<QuadTreeQuadrant>();
+		return PlanetTileKey(planetside);
 	}
-	
+
+	return key;
 }
 
 
@@ -480,33 +455,18 @@ std::vector<QuadTreeNode*> QuadTreeNode::get_all_leaf_nodes()
 	return out;
 }
 
-std::vector<std::vector<QuadTreeQuadrant>> QuadTreeNode::get_all_leaf_paths() const
+void QuadTreeNode::get_all_leaf_keys(std::vector<PlanetTileKey>& out) const
 {
-	std::vector<std::vector<QuadTreeQuadrant>> out;
+	if (!has_children())
+	{
+		out.push_back(get_key());
+		return;
+	}
 
 	for (size_t i = 0; i < 4; i++)
 	{
-		if (children[i] != NULL)
-		{
-			if (children[i]->has_children())
-			{
-				std::vector<std::vector<QuadTreeQuadrant>> fromChild = children[i]->get_all_leaf_paths();
-				out.insert(out.end(), fromChild.begin(), fromChild.end());
-			}
-			else
-			{
-				out.push_back(children[i]->get_path());
-			}
-		}
-		else
-		{
-			out.push_back(get_path());
-			return out;
-		}
+		children[i]->get_all_leaf_keys(out);
 	}
-
-
-	return out;
 }
 
 std::vector<QuadTreeNode*> QuadTreeNode::get_all()
@@ -527,37 +487,28 @@ std::vector<QuadTreeNode*> QuadTreeNode::get_all()
 	return out;
 }
 
-std::vector<std::vector<QuadTreeQuadrant>> QuadTreeNode::get_all_paths() const
+void QuadTreeNode::get_all_keys(std::vector<PlanetTileKey>& out) const
 {
-	std::vector<std::vector<QuadTreeQuadrant>> out;
-
 	if (has_children())
 	{
 		for (size_t i = 0; i < 4; i++)
 		{
-			std::vector<std::vector<QuadTreeQuadrant>> fromChild = children[i]->get_all_paths();
-			out.insert(out.end(), fromChild.begin(), fromChild.end());
+			children[i]->get_all_keys(out);
 		}
 	}
 
-	out.push_back(get_path());
-
-	return out;
+	out.push_back(get_key());
 }
 
-QuadTreeNode* QuadTreeNode::follow_path(std::vector<QuadTreeQuadrant> path)
+QuadTreeNode* QuadTreeNode::follow_key(PlanetTileKey key)
 {
-	if (path.size() == 0)
+	QuadTreeNode* node = this;
+	for (size_t i = depth; i < key.get_depth(); i++)
 	{
-		return this;
+		node = node->children[key.get_quadrant(i)];
 	}
-	else
-	{
-		std::vector<QuadTreeQuadrant> subpath = path;
-		subpath.erase(subpath.begin());
 
-		return children[path[0]]->follow_path(subpath);
-	}
+	return node;
 }
 
 QuadTreeNode::QuadTreeNode()
@@ -597,6 +548,7 @@ QuadTreeNode::QuadTreeNode(QuadTreeNode* p, QuadTreeQuadrant quad) : parent(p)
 	children[0] = NULL; children[1] = NULL; children[2] = NULL; children[3] = NULL;
 
 	depth = p->depth + 1;
+	key = p->get_key().get_child(quad);
 
 	if (quad == NORTH_WEST)
 	{
@@ -695,12 +647,10 @@ void QuadTreeNode::draw_gui(int SCL, PlanetTileServer* server)
 	{
 		if (server)
 		{
-			PlanetTilePath path = PlanetTilePath(get_path(), planetside);
-
 			{
 				auto server_tiles = server->tiles.try_get();
 
-				if (!server_tiles.is_null() && server_tiles->find(path) != server_tiles->end())
+				if (!server_tiles.is_null() && server_tiles->find(get_key()) != server_tiles->end())
 				{
 					// Shade if we are built
 					drawList->AddLine(tl, br, ImColor(0.5f, 0.5f, 0.5f), 1.0f);
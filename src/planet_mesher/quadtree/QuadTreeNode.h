@@ -3,6 +3,7 @@
 #include <glm/glm.hpp>
 #include <vector>
 #include "QuadTreeDefines.h"
+#include "../mesher/PlanetTileKey.h"
 
 class PlanetTileServer;
 
@@ -41,6 +42,9 @@ public:
 	// 0 is a root node
 	size_t depth;
 
+	// Only valid for non-root nodes, use get_key()
+	PlanetTileKey key;
+
 	// Returns true if split was possible
 	bool split(bool get_neighbors = true);
 
@@ -79,22 +83,22 @@ public:
 
 	bool touches_any_edge();
 
-	// Gets the path to this quad tree node, from its parent to the node
-	// For example, a node may be {NW, NW, NE}, the first quadrant is the 
-	// root, second is parent of the parent and last is the parent
-	std::vector<QuadTreeQuadrant> get_path() const;
+	// Gets the key of this node, which encodes the path from the root
+	PlanetTileKey get_key() const;
 
 	// Gets all nodes with no children, sons of this node
 	std::vector<QuadTreeNode*> get_all_leaf_nodes();
 
-	std::vector<std::vector<QuadTreeQuadrant>> get_all_leaf_paths() const;
+	// Appends the keys of all leafs to out
+	void get_all_leaf_keys(std::vector<PlanetTileKey>& out) const;
 
 	std::vector<QuadTreeNode*> get_all();
 
-	std::vector<std::vector<QuadTreeQuadrant>> get_all_paths() const;
-
+	// Appends the keys of this node and all its children to out
+	void get_all_keys(std::vector<PlanetTileKey>& out) const;
 
-	QuadTreeNode* follow_path(std::vector<QuadTreeQuadrant> path); 
+	// key must be inside this node
+	QuadTreeNode* follow_key(PlanetTileKey key);
 
 	QuadTreeNode();
 	QuadTreeNode(QuadTreeNode* n_nbor, QuadTreeNode* e_nbor, QuadTreeNode* s_nbor, QuadTreeNode* w_nbor);
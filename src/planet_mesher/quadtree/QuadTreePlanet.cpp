@@ -1,4 +1,5 @@
 #include <cmath>
+#include <algorithm>
 
 #include "QuadTreePlanet.h"
 #include "imgui/imgui.h"
@@ -16,29 +17,28 @@ void QuadTreePlanet::flatten()
 	}
 }
 
-std::vector<PlanetTilePath> QuadTreePlanet::get_all_render_leaf_paths(bool ignore_cache)
+const std::vector<PlanetTileKey>& QuadTreePlanet::get_all_render_leaf_keys(bool ignore_cache)
 {
-	if (iteration == old_render_leafs_it && !ignore_cache)
+	// Built every update()
+	if (lod)
 	{
 		return old_render_leafs;
 	}
 
-	std::vector<PlanetTilePath> out;
-
+	if (iteration == old_render_leafs_it && !ignore_cache)
+	{
+		return old_render_leafs;
+	}
 
+	old_render_leafs.clear();
 	for (size_t i = 0; i < 6; i++)
 	{
-		std::vector<std::vector<QuadTreeQuadrant>> from_side = render_sides[i].get_all_leaf_paths();
-		for (size_t j = 0; j < from_side.size(); j++)
-		{
-			out.push_back(PlanetTilePath(from_side[j], PlanetSide(i)));
-		}
+		render_sides[i].get_all_leaf_keys(old_render_leafs);
 	}
 
-	old_render_leafs = out;
 	old_render_leafs_it = iteration;
 
-	return out;
+	return old_render_leafs;
 }
 
 std::vector<QuadTreeNode*> QuadTreePlanet::get_all_leafs()
@@ -54,24 +54,27 @@ std::vector<QuadTreeNode*> QuadTreePlanet::get_all_leafs()
 	return out;
 }
 
-std::vector<PlanetTilePath> QuadTreePlanet::get_all_paths() const
+std::vector<PlanetTileKey> QuadTreePlanet::get_all_keys() const
 {
-	std::vector<PlanetTilePath> out;
+	std::vector<PlanetTileKey> out;
+
+	if (lod)
+	{
+		lod->get_all_keys(out);
+		return out;
+	}
 
 	for (size_t i = 0; i < 6; i++)
 	{
-		std::vector<std::vector<QuadTreeQuadrant>> from_side = sides[i].get_all_paths();
-		for (size_t j = 0; j < from_side.size(); j++)
-		{
-			out.push_back(PlanetTilePath(from_side[j], PlanetSide(i)));
-		}
+		sides[i].get_all_keys(out);
 	}
 
+	std::sort(out.begin(), out.end());
 
 	return out;
 }
 
-PlanetSide QuadTreePlanet::get_planet_side(glm::vec3 f) const
+PlanetSide QuadTreePlanet::get_planet_side(glm::vec3 f)
 {
 	float xabs = glm::abs(f.x);
 	float yabs = glm::abs(f.y);
@@ -96,7 +99,7 @@ PlanetSide QuadTreePlanet::get_planet_side(glm::vec3 f) const
 	return PX;
 }
 
-glm::dvec2 QuadTreePlanet::get_planet_side_offset(glm::vec3 point_normalized, PlanetSide side) const
+glm::dvec2 QuadTreePlanet::get_planet_side_offset(glm::vec3 point_normalized, PlanetSide side)
 {
 	glm::dvec3 cube = MathUtil::sphere_to_cube(point_normalized);
 
@@ -149,6 +152,22 @@ glm::dvec2 QuadTreePlanet::get_planet_side_offset(glm::vec3 point_normalized, Pl
 	}
 }
 
+PlanetTileKey QuadTreePlanet::get_key_at(glm::dvec3 point_normalized, size_t depth)
+{
+	depth = std::min(depth, PlanetTileKey::MAX_DEPTH);
+
+	PlanetSide side = get_planet_side(point_normalized);
+	glm::dvec2 offset = get_planet_side_offset(point_normalized, side);
+
+	// Points right on the edge belong to the last tile
+	double tiles = (double)((uint32_t)1 << depth);
+	uint32_t max = ((uint32_t)1 << depth) - 1;
+	uint32_t x = (uint32_t)std::min(std::max(offset.x * tiles, 0.0), (double)max);
+	uint32_t y = (uint32_t)std::min(std::max(offset.y * tiles, 0.0), (double)max);
+
+	return PlanetTileKey::from_xy(side, depth, x, y);
+}
+
 void QuadTreePlanet::set_wanted_subdivide(glm::dvec2 offset, PlanetSide side, size_t depth)
 {
 	previous_depth = current_depth;
@@ -166,8 +185,46 @@ void QuadTreePlanet::set_wanted_subdivide(glm::dvec2 offset, PlanetSide side, si
 }
 
 
+void QuadTreePlanet::enable_lod(size_t max_depth, double pixel_error, double vertices_per_tile)
+{
+	delete lod;
+	lod = new QuadTreeLod(max_depth, pixel_error, vertices_per_tile);
+	flatten();
+	iteration++;
+	dirty = true;
+}
+
+void QuadTreePlanet::set_observers(const std::vector<LodObserver>& observers)
+{
+	if (lod)
+	{
+		lod->set_observers(observers);
+	}
+}
+
 void QuadTreePlanet::update(PlanetTileServer& server)
 {
+	if (lod)
+	{
+		auto tiles_m = server.tiles.get();
+		auto is_loaded = [&tiles_m](PlanetTileKey key)
+		{
+			return tiles_m->find(key) != tiles_m->end();
+		};
+
+		if (lod->update(is_loaded))
+		{
+			iteration++;
+			dirty = true;
+		}
+
+		// Tiles may have loaded even if the tree didn't change
+		old_render_leafs.clear();
+		lod->get_render_keys(is_loaded, old_render_leafs);
+		old_render_leafs_it = iteration;
+		return;
+	}
+
 	if (current_depth <= wanted_depth)
 	{
 		if (server.is_built())
@@ -202,11 +259,11 @@ void QuadTreePlanet::update(PlanetTileServer& server)
 
 		for (size_t j = 0; j < all_leafs.size(); j++)
 		{
-			PlanetTilePath path = PlanetTilePath(all_leafs[j]->get_path(), all_leafs[j]->planetside);
+			PlanetTileKey key = all_leafs[j]->get_key();
 			bool found = true;
 			{
 				auto tiles_m = server.tiles.get();
-				auto it = tiles_m->find(path);
+				auto it = tiles_m->find(key);
 				if (it == tiles_m->end())
 				{
 					found = false;
@@ -215,19 +272,15 @@ void QuadTreePlanet::update(PlanetTileServer& server)
 
 			if (!found)
 			{
-				if (path.path.size() != 0)
-				{
-					path.path.pop_back();
-				}
-
-				// path is now the parent
-				QuadTreeNode* parent = render_sides[i].follow_path(path.path);
+				// key is now the parent
+				key = key.get_parent();
+				QuadTreeNode* parent = render_sides[i].follow_key(key);
 				bool good = true;
 
 				// Check that renderer has parent, if it does not then we moved too far, reduce quality
 				{
 					auto tiles_m = server.tiles.get();
-					if (tiles_m->find(path) == tiles_m->end())
+					if (tiles_m->find(key) == tiles_m->end())
 					{
 						// Horror, we moved too far, the user will be over low quality terrain
 						good = false;
@@ -283,6 +336,7 @@ QuadTreeNode* QuadTreePlanet::subdivide_to(glm::dvec2 offset, PlanetSide side, s
 QuadTreePlanet::QuadTreePlanet()
 {
 	iteration = 0;
+	lod = nullptr;
 
 	for (size_t i = 0; i < 6; i++)
 	{
@@ -375,6 +429,7 @@ QuadTreePlanet::QuadTreePlanet()
 
 QuadTreePlanet::~QuadTreePlanet()
 {
+	delete lod;
 }
 
 
@@ -446,5 +501,10 @@ void QuadTreePlanet::do_imgui(PlanetTileServer* server)
 
 	ImGui::Text("Wanted Depth: %i", (int)wanted_depth);
 
+	if (lod)
+	{
+		lod->do_imgui();
+	}
+
 }
 
@@ -1,6 +1,7 @@
 #pragma once
 #include "QuadTreeDefines.h"
 #include "QuadTreeNode.h"
+#include "QuadTreeLod.h"
 #include "../mesher/PlanetTilePath.h"
 #include <util/MathUtil.h>
 
@@ -12,6 +13,8 @@ class PlanetTileServer;
 // It also keeps another copy of the whole
 // system used for rendering when small tiles
 // are not yet generated
+// Alternatively, if enable_lod is called, subdivision is done by a
+// QuadTreeLod driven by observers, and set_wanted_subdivide is ignored
 class QuadTreePlanet
 {
 private:
@@ -27,7 +30,10 @@ private:
 	QuadTreeNode render_sides[6];
 
 	uint64_t old_render_leafs_it;
-	std::vector<PlanetTilePath> old_render_leafs;
+	std::vector<PlanetTileKey> old_render_leafs;
+
+	// nullptr unless enable_lod was called
+	QuadTreeLod* lod;
 
 public:
 
@@ -42,26 +48,36 @@ public:
 
 	QuadTreeNode sides[6];
 	
-	std::vector<PlanetTilePath> get_all_render_leaf_paths(bool ignore_cache = false);
+	const std::vector<PlanetTileKey>& get_all_render_leaf_keys(bool ignore_cache = false);
 
 	// Recursively obtains all leafs from all sides, don't hold the
 	// pointers for too long
 	std::vector<QuadTreeNode*> get_all_leafs();
 
-	// Converts the pointers to paths
-	std::vector<PlanetTilePath> get_all_paths() const;
+	// Keys of every node (not only leafs), sorted
+	std::vector<PlanetTileKey> get_all_keys() const;
 
 
 	// Gets the planet side a point is on from its normalized,
 	// relative to the planet center, coordinates
-	PlanetSide get_planet_side(glm::vec3 point_normalized) const;
+	static PlanetSide get_planet_side(glm::vec3 point_normalized);
 
 	// Gets planet side offset given a point and the side it's contained in
 	// (get it via get_planet_side)
-	glm::dvec2 get_planet_side_offset(glm::vec3 point_normalized, PlanetSide side) const;
+	static glm::dvec2 get_planet_side_offset(glm::vec3 point_normalized, PlanetSide side);
+
+	// Key of the tile of given depth containing the point, same result as
+	// subdivide_to but without building any node
+	static PlanetTileKey get_key_at(glm::dvec3 point_normalized, size_t depth);
 
 	void set_wanted_subdivide(glm::dvec2 offset, PlanetSide side, size_t depth);
 
+	// Switches to the multi-observer, screen space error LOD (see QuadTreeLod)
+	void enable_lod(size_t max_depth, double pixel_error, double vertices_per_tile);
+	bool is_lod_enabled() const { return lod != nullptr; }
+	// Only used if the LOD is enabled
+	void set_observers(const std::vector<LodObserver>& observers);
+
 	void do_imgui(PlanetTileServer* server);
 
 	// Tries to update subdivision, if the server has finished building
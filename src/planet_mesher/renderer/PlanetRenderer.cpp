@@ -13,7 +13,7 @@ void PlanetRenderer::render(PlanetTileServer &server, QuadTreePlanet &planet,
 	planet.do_imgui(nullptr);
 	ImGui::End();*/
 
-	auto render_tiles = planet.get_all_render_leaf_paths();
+	std::vector<PlanetTileKey> render_tiles = planet.get_all_render_leaf_keys();
 
 	// Renderer really needs the tiles so some tiny
 	// lags could be noticed by the user if there is
@@ -106,30 +106,17 @@ void PlanetRenderer::render(PlanetTileServer &server, QuadTreePlanet &planet,
              return a.get_depth() > b.get_depth();
 		});
 
-		for (size_t i = 0; i < render_tiles.size(); i++)
+		build_draw_list(*tiles_w, render_tiles, tforms.proj_view, tforms.wmodel);
+
+		for (const DrawTile& draw : draw_list)
 		{
-			auto it = tiles_w->find(render_tiles[i]);
-			if (it == tiles_w->end())
-			{
-				// Really should not happen on normal
-				// gameplay, but it can happen when a 
-				// very sharp LOD change happens
-				// For example, teleporting to a surface
-				// Visually, it probably is a small flicker
-				continue;
-			}
-			auto tile = it->second;
-			auto path = it->first;
+			PlanetTile* tile = draw.tile;
+			PlanetTilePath path = PlanetTilePath(draw.key);
 
-			glm::dmat4 model = path.get_model_spheric_matrix();
+			const glm::dmat4& model = draw.model;
 			// We also apply the camera tform, used by the deferred renderer
 			glm::dmat4 deferred_model = tforms.wmodel * model;
 
-			if (!tile->is_uploaded())
-			{
-				continue;
-			}
-
 			if (tile->clockwise && !cw_mode)
 			{
 				glFrontFace(GL_CW);
@@ -145,11 +132,11 @@ void PlanetRenderer::render(PlanetTileServer &server, QuadTreePlanet &planet,
 
 
 
-			shader->setMat4("tform", (glm::mat4)(tforms.proj_view * tforms.wmodel * model));
+			shader->setMat4("tform", (glm::mat4)(tforms.proj_view * deferred_model));
 			shader->setMat4("m_tform", (glm::mat4)(deferred_model));
 			shader->setMat4("rotm_tform", (glm::mat4)(tforms.rot_tform * model));
 
-			glm::dvec3 tile_or = tforms.wmodel * model * glm::dvec4(0.5, 0.5, 0.0, 1.0);
+			glm::dvec3 tile_or = deferred_model * glm::dvec4(0.5, 0.5, 0.0, 1.0);
 			// We use a reasonalbe distance to prevent gaps but also not show detail very far away
 			// to reduce GPU load
 			bool do_detail = glm::dot(tile_or, tile_or) < detail_fade * 20;
@@ -185,17 +172,12 @@ void PlanetRenderer::render(PlanetTileServer &server, QuadTreePlanet &planet,
 
 			cw_mode = false;
 			glFrontFace(GL_CCW);
-			for (size_t i = 0; i < render_tiles.size(); i++)
+			for (const DrawTile& draw : draw_list)
 			{
-				auto it = tiles_w->find(render_tiles[i]);
-				if (it == tiles_w->end())
-				{
-					continue;
-				}
-				auto tile = it->second;
-				auto path = it->first;
+				PlanetTile* tile = draw.tile;
+				PlanetTilePath path = PlanetTilePath(draw.key);
 
-				glm::dmat4 model = path.get_model_spheric_matrix();
+				const glm::dmat4& model = draw.model;
 				glm::dmat4 deferred_model = tforms.wmodel * model;
 
 				if (tile->water_vbo == 0)
@@ -244,6 +226,53 @@ void PlanetRenderer::render(PlanetTileServer &server, QuadTreePlanet &planet,
 	glFrontFace(GL_CCW);
 }
 
+void PlanetRenderer::build_draw_list(PlanetTileServer::TileMap& tiles, const std::vector<PlanetTileKey>& render_tiles,
+									 const glm::dmat4& proj_view, const glm::dmat4& wmodel)
+{
+	candidates.clear();
+	candidate_tiles.clear();
+	visible.clear();
+	draw_list.clear();
+
+	for (PlanetTileKey key : render_tiles)
+	{
+		auto it = tiles.find(key);
+		// Not finding the tile really should not happen on normal
+		// gameplay, but it can happen when a very sharp LOD change
+		// happens. For example, teleporting to a surface
+		// Visually, it probably is a small flicker
+		if (it == tiles.end() || !it->second->is_uploaded())
+		{
+			continue;
+		}
+
+		PlanetTileCuller::Candidate candidate;
+		candidate.key = key;
+		candidate.min_height = it->second->min_height;
+		candidate.max_height = it->second->max_height;
+		candidates.push_back(candidate);
+		candidate_tiles.push_back(it->second);
+	}
+
+	// The camera is at the origin of the deferred space
+	glm::dvec3 camera = glm::inverse(wmodel) * glm::dvec4(0.0, 0.0, 0.0, 1.0);
+	culler.set_view(proj_view * wmodel, camera);
+	culler.cull(candidates, visible);
+
+	for (uint32_t i : visible)
+	{
+		DrawTile draw;
+		draw.key = candidates[i].key;
+		draw.tile = candidate_tiles[i];
+		draw.model = PlanetTilePath(draw.key).get_model_spheric_matrix();
+		draw_list.push_back(draw);
+	}
+}
+
+void PlanetRenderer::do_imgui()
+{
+	culler.do_imgui();
+}
 
 void PlanetRenderer::generate_and_upload_index_buffer()
 {
@@ -2,6 +2,7 @@
 #include "../mesher/PlanetTileServer.h"
 #include "../quadtree/QuadTreePlanet.h"
 #include "../../assets/Shader.h"
+#include "PlanetTileCuller.h"
 // Handles optimized rendering of tiles, that are stored
 // in a PlanetTileServer
 // TODO: Integration with an asset manager
@@ -33,6 +34,25 @@ private:
 
 	// Current detail up means which direction is up pointing
 	glm::dvec3 current_detail_up;
+
+	// A visible, uploaded tile, with its model computed once for both passes
+	struct DrawTile
+	{
+		PlanetTileKey key;
+		PlanetTile* tile;
+		glm::dmat4 model;
+	};
+
+	// Kept between frames so they don't allocate every frame
+	std::vector<PlanetTileCuller::Candidate> candidates;
+	std::vector<PlanetTile*> candidate_tiles;
+	std::vector<uint32_t> visible;
+	std::vector<DrawTile> draw_list;
+
+	// Fills draw_list with the tiles which are loaded and visible, in the order given
+	void build_draw_list(PlanetTileServer::TileMap& tiles, const std::vector<PlanetTileKey>& render_tiles,
+		const glm::dmat4& proj_view, const glm::dmat4& wmodel);
+
 public:
 
 	struct PlanetRenderTforms
@@ -42,9 +62,14 @@ public:
 		double rot, time;
 		float far_plane;
 	};
+
+	PlanetTileCuller culler;
+
 	// Camera position should be given RELATIVE to the planet
 	void render(PlanetTileServer& server, QuadTreePlanet& planet, const PlanetRenderTforms& tforms, ElementConfig& config);
 
+	void do_imgui();
+
 	PlanetRenderer();
 	~PlanetRenderer();
 };
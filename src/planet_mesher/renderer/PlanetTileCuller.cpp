@@ -0,0 +1,144 @@
+#include "PlanetTileCuller.h"
+#include "../mesher/PlanetTilePath.h"
+#include <imgui/imgui.h>
+#include <algorithm>
+
+PlanetTileCuller::Bounds PlanetTileCuller::get_bounds(PlanetTileKey key, double min_height, double max_height)
+{
+	PlanetTilePath path = PlanetTilePath(key);
+	glm::dmat4 model = path.get_model_matrix();
+
+	// Corners, middle of the edges and center of the tile, over the unit sphere
+	std::array<glm::dvec3, 9> points;
+	for(size_t i = 0; i < 9; i++)
+	{
+		glm::dvec4 in_tile = glm::dvec4((double)(i % 3) * 0.5, (double)(i / 3) * 0.5, 0.0, 1.0);
+		glm::dvec3 world_pos_cubic = model * in_tile;
+		points[i] = glm::normalize(MathUtil::cube_to_sphere(world_pos_cubic));
+	}
+
+	double min_radius = 1.0 + min_height;
+	double max_radius = 1.0 + max_height;
+
+	Bounds out;
+	out.center = points[4] * (min_radius + max_radius) * 0.5;
+	out.max_radius = max_radius;
+	out.radius = 0.0;
+	// Points over the tile are furthest from the center at the corners and edges, and
+	// either at the lowest or highest height
+	for(const glm::dvec3& point : points)
+	{
+		out.radius = std::max(out.radius, glm::distance(out.center, point * min_radius));
+		out.radius = std::max(out.radius, glm::distance(out.center, point * max_radius));
+	}
+	// The edges bulge a bit between the sampled points
+	out.radius *= 1.01;
+
+	return out;
+}
+
+void PlanetTileCuller::set_view(const glm::dmat4& tile_to_clip, glm::dvec3 camera)
+{
+	this->camera = camera;
+
+	// Gribb & Hartmann plane extraction, glm matrices are column major
+	auto row = [&tile_to_clip](int i)
+	{
+		return glm::dvec4(tile_to_clip[0][i], tile_to_clip[1][i], tile_to_clip[2][i], tile_to_clip[3][i]);
+	};
+
+	planes[0] = row(3) + row(0);
+	planes[1] = row(3) - row(0);
+	planes[2] = row(3) + row(1);
+	planes[3] = row(3) - row(1);
+
+	for(glm::dvec4& plane : planes)
+	{
+		plane /= glm::length(glm::dvec3(plane));
+	}
+}
+
+bool PlanetTileCuller::is_in_frustum(const Bounds& bounds) const
+{
+	for(const glm::dvec4& plane : planes)
+	{
+		if(glm::dot(glm::dvec3(plane), bounds.center) + plane.w < -bounds.radius)
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+bool PlanetTileCuller::is_over_horizon(const Bounds& bounds, double occluder_radius) const
+{
+	double camera_dist2 = glm::dot(camera, camera);
+	double occluder2 = occluder_radius * occluder_radius;
+	if(camera_dist2 <= occluder2)
+	{
+		// Below the occluder, it can't hide anything
+		return true;
+	}
+
+	// A point at the height of the tile's top can be seen over the occluder as far as
+	// the distance from the camera to the horizon plus the distance from the horizon to it
+	double horizon_dist = glm::sqrt(camera_dist2 - occluder2);
+	double tile_horizon_dist = glm::sqrt(std::max(bounds.max_radius * bounds.max_radius - occluder2, 0.0));
+
+	double closest = glm::distance(camera, bounds.center) - bounds.radius;
+	return closest <= horizon_dist + tile_horizon_dist;
+}
+
+void PlanetTileCuller::cull(const std::vector<Candidate>& candidates, std::vector<uint32_t>& visible)
+{
+	last_candidates = candidates.size();
+	last_frustum_culled = 0;
+	last_horizon_culled = 0;
+
+	// The drawn tiles cover the whole planet, so the planet is solid up to their lowest point
+	double occluder_radius = 1.0;
+	for(const Candidate& candidate : candidates)
+	{
+		occluder_radius = std::min(occluder_radius, 1.0 + candidate.min_height);
+	}
+
+	for(size_t i = 0; i < candidates.size(); i++)
+	{
+		const Candidate& candidate = candidates[i];
+		if(enabled)
+		{
+			Bounds bounds = get_bounds(candidate.key, candidate.min_height, candidate.max_height);
+			if(!is_in_frustum(bounds))
+			{
+				last_frustum_culled++;
+				continue;
+			}
+
+			if(!is_over_horizon(bounds, occluder_radius))
+			{
+				last_horizon_culled++;
+				continue;
+			}
+		}
+
+		visible.push_back((uint32_t)i);
+	}
+}
+
+void PlanetTileCuller::do_imgui()
+{
+	ImGui::Checkbox("Tile culling", &enabled);
+	ImGui::Text("Tiles: %i candidates, %i visible", (int)last_candidates, (int)get_last_visible());
+	ImGui::Text("Culled: %i by frustum, %i by horizon", (int)last_frustum_culled, (int)last_horizon_culled);
+}
+
+PlanetTileCuller::PlanetTileCuller()
+{
+	enabled = true;
+	camera = glm::dvec3(0.0);
+	planes.fill(glm::dvec4(0.0, 0.0, 0.0, 1.0));
+	last_candidates = 0;
+	last_frustum_culled = 0;
+	last_horizon_culled = 0;
+}
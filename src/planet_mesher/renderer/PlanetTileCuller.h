@@ -0,0 +1,72 @@
+#pragma once
+#include <vector>
+#include <array>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include "../mesher/PlanetTileKey.h"
+
+// Decides which of the tiles the quadtree wants drawn are actually visible, so
+// the renderer only issues draw calls for those.
+// Each tile is bounded by a sphere built from its corners over the planet at its
+// lowest and highest heights. Tiles are culled if their sphere is outside the view
+// frustum, or behind the horizon of the biggest sphere that is surely solid (the
+// lowest point of all drawn tiles).
+// Works over the unit sphere in the rotating frame of the planet, same as the tile
+// models, and doesn't touch OpenGL, so it can be used (and tested) without a context.
+class PlanetTileCuller
+{
+public:
+
+	struct Candidate
+	{
+		PlanetTileKey key;
+		// In planet radius units, relative to the unit sphere
+		double min_height;
+		double max_height;
+	};
+
+	struct Bounds
+	{
+		glm::dvec3 center;
+		double radius;
+		// Distance from the planet center to the highest point of the tile
+		double max_radius;
+	};
+
+private:
+
+	// Left, right, bottom and top. As they meet at the camera, the near plane is
+	// not needed, and the far plane is so far away it never culls a planet tile
+	std::array<glm::dvec4, 4> planes;
+	glm::dvec3 camera;
+
+	size_t last_candidates;
+	size_t last_frustum_culled;
+	size_t last_horizon_culled;
+
+public:
+
+	bool enabled;
+
+	static Bounds get_bounds(PlanetTileKey key, double min_height, double max_height);
+
+	// tile_to_clip takes points over the unit sphere (the tile models) to clip space,
+	// usually proj_view * wmodel. camera is in the same space as the tiles
+	void set_view(const glm::dmat4& tile_to_clip, glm::dvec3 camera);
+
+	bool is_in_frustum(const Bounds& bounds) const;
+	// occluder_radius is the radius of a sphere which hides whatever is behind it
+	bool is_over_horizon(const Bounds& bounds, double occluder_radius) const;
+
+	// Appends to visible the index of each visible candidate, in the same order
+	void cull(const std::vector<Candidate>& candidates, std::vector<uint32_t>& visible);
+
+	size_t get_last_candidates() const { return last_candidates; }
+	size_t get_last_frustum_culled() const { return last_frustum_culled; }
+	size_t get_last_horizon_culled() const { return last_horizon_culled; }
+	size_t get_last_visible() const { return last_candidates - last_frustum_culled - last_horizon_culled; }
+
+	void do_imgui();
+
+	PlanetTileCuller();
+};
@@ -1,7 +1,8 @@
 #include "RockyPlanetRenderer.h"
 
-void RockyPlanetRenderer::load(const std::string& script, const std::string& script_path, ElementConfig& config)
+void RockyPlanetRenderer::load(const std::string& name, const std::string& script, const std::string& script_path,
+	ElementConfig& config)
 {
 	delete server;
-	server = new PlanetTileServer(script, script_path, &config, config.surface.has_water);
+	server = new PlanetTileServer(name, script, script_path, &config, config.surface.has_water);
 }
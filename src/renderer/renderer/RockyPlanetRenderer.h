@@ -11,7 +11,8 @@ public:
 	PlanetTileServer* server;
 	PlanetRenderer renderer;
 
-	void load(const std::string& script, const std::string& script_path, ElementConfig& config);
+	void load(const std::string& name, const std::string& script, const std::string& script_path,
+		ElementConfig& config);
 
 	RockyPlanetRenderer()
 	{
@@ -4,6 +4,8 @@
 #include "../physics/glm/BulletGlmCompat.h"
 #include "../physics/ground/GroundShape.h"
 #include <game/GameState.h>
+#include <renderer/Renderer.h>
+#include "Universe.h"
 
 glm::dvec3 PlanetarySystem::get_gravity_vector(glm::dvec3 p, bool physics)
 {
@@ -155,8 +157,20 @@ void PlanetarySystem::update_physics(double dt, bool bullet)
 	{
 		lock.lock();
 		propagator->propagate(dt);
-		lock.unlock();
 		t += dt;
+		// Entities on rails override the n-body result
+		for(size_t i = 0; i < handled_states_trj.size(); i++)
+		{
+			if(handled_states_trj[i])
+			{
+				handled_states_trj[i]->propagate(dt, states_now, handled_states_now, handled_states_now[i]);
+			}
+		}
+		if(ephemeris)
+		{
+			ephemeris->update_now(states_now, t);
+		}
+		lock.unlock();
 	}
 
 	if (bullet)
@@ -176,6 +190,8 @@ void PlanetarySystem::update_physics(double dt, bool bullet)
 				tform.setRotation(to_btQuaternion(quat));
 
 				elem->rigid_body->setWorldTransform(tform);
+
+				elem->ground_shape->update(dt);
 			}
 		}
 	}
@@ -236,6 +252,18 @@ void PlanetarySystem::update(double dt, btDynamicsWorld* world, bool bullet)
 
 	update_physics(dt, bullet);
 
+	if (bullet)
+	{
+		// Physics tiles are generated in the background before vehicles reach them
+		for(auto elem : elements)
+		{
+			if(elem->config.has_surface)
+			{
+				elem->ground_shape->prefetch(world, states_now[elem->index].vel);
+			}
+		}
+	}
+
 }
 
 void PlanetarySystem::init(btDynamicsWorld* world)
@@ -251,9 +279,13 @@ static void load_body(SystemElement* body)
 	{
 		body->renderer.rocky = new RockyPlanetRenderer();
 
-		std::string script = AssetManager::load_string_raw(body->config.surface.script_path);
+		std::string script;
+		if (!body->config.surface.script_path.empty())
+		{
+			script = AssetManager::load_string_raw(body->config.surface.script_path);
+		}
 
-		body->renderer.rocky->load(script, body->config.surface.script_path_raw, body->config);
+		body->renderer.rocky->load(body->name, script, body->config.surface.script_path_raw, body->config);
 	}
 	else
 	{
@@ -282,7 +314,8 @@ static void unload_body(SystemElement* body)
 	}
 }
 
-void PlanetarySystem::update_render_body_rocky(SystemElement* body, glm::dvec3 body_pos, glm::dvec3 camera_pos, double t, double t0)
+void PlanetarySystem::update_render_body_rocky(SystemElement* body, glm::dvec3 body_pos, glm::dvec3 camera_pos, double t, double t0,
+	const std::vector<glm::dvec3>& foci, double pixels_per_radian)
 {
 	bool moved = true;
 
@@ -298,7 +331,27 @@ void PlanetarySystem::update_render_body_rocky(SystemElement* body, glm::dvec3 b
 		rel_matrix = glm::translate(rel_matrix, -body_pos);
 
 		glm::dvec3 rel_camera_pos = rel_matrix * glm::dvec4(camera_pos, 1.0);
-	
+		// Used by the next server update to prioritize tiles
+		body->renderer.rocky->server->set_camera(rel_camera_pos / body->config.radius);
+
+		QuadTreePlanet& qtree = body->renderer.rocky->qtree;
+		if (body->config.surface.multi_focus_lod)
+		{
+			if (!qtree.is_lod_enabled())
+			{
+				qtree.enable_lod(body->config.surface.max_depth, body->config.surface.lod_pixel_error,
+					(double)PlanetTile::TILE_SIZE);
+			}
+
+			std::vector<LodObserver> observers;
+			observers.push_back({ rel_camera_pos / body->config.radius, pixels_per_radian });
+			for (glm::dvec3 focus : foci)
+			{
+				glm::dvec3 rel_focus = rel_matrix * glm::dvec4(focus, 1.0);
+				observers.push_back({ rel_focus / body->config.radius, pixels_per_radian });
+			}
+			qtree.set_observers(observers);
+		}
 
 
 		glm::vec3 pos_nrm = (glm::vec3)glm::normalize(rel_camera_pos);
@@ -349,6 +402,13 @@ void PlanetarySystem::update_render_body_rocky(SystemElement* body, glm::dvec3 b
 
 void PlanetarySystem::update_render(glm::dvec3 camera_pos, float fov)
 {
+	std::vector<glm::dvec3> foci;
+	for (Entity* e : universe->entities)
+	{
+		foci.push_back(e->get_position(false));
+	}
+
+	double pixels_per_radian = (double)osp->renderer->get_height() / (double)fov;
 
 	for (size_t i = 0; i < elements.size(); i++)
 	{
@@ -371,19 +431,76 @@ void PlanetarySystem::update_render(glm::dvec3 camera_pos, float fov)
 
 		if (elements[i]->renderer.rocky != nullptr)
 		{
-			update_render_body_rocky(elements[i], states_now[i].pos, camera_pos, t, t0);
+			update_render_body_rocky(elements[i], states_now[i].pos, camera_pos, t, t0, foci, pixels_per_radian);
 		}
 	}
 }
 
 #include "propagator/RK4Propagator.h"
 
+bool PlanetarySystem::set_propagator(const std::string& name, const cpptoml::table* settings)
+{
+	SystemPropagator* nprop = SystemPropagator::create(name);
+	if(nprop == nullptr)
+	{
+		logger->error("Unknown propagator '{}', keeping '{}'", name, propagator->get_name());
+		return false;
+	}
+
+	size_t light_threads = propagator->get_light_threads();
+	if(settings)
+	{
+		nprop->load(*settings);
+		int64_t threads = settings->get_as<int64_t>("light_threads").value_or((int64_t)light_threads);
+		light_threads = (size_t)std::max(threads, (int64_t)1);
+	}
+	nprop->set_light_threads(light_threads);
+
+	lock.lock();
+	delete propagator;
+	propagator = nprop;
+	propagator->bind_to(this);
+	lock.unlock();
+
+	return true;
+}
+
+Ephemeris* PlanetarySystem::get_ephemeris()
+{
+	lock.lock();
+	if(ephemeris == nullptr)
+	{
+		ephemeris = new Ephemeris(ephemeris_settings);
+		ephemeris->reset(states_now, t);
+	}
+	lock.unlock();
+
+	return ephemeris;
+}
+
+OrbitPredictionServer* PlanetarySystem::get_prediction_server()
+{
+	lock.lock();
+	if(prediction_server == nullptr)
+	{
+		prediction_server = new OrbitPredictionServer(prediction_threads, prediction_jobs_per_frame);
+	}
+	lock.unlock();
+
+	return prediction_server;
+}
+
 PlanetarySystem::PlanetarySystem(Universe* universe)
 {
 	this->universe = universe;
 
 	states_now.resize(0);
 	propagator = new RK4Propagator();
+	ephemeris = nullptr;
+	prediction_server = nullptr;
+	prediction_threads = std::max(std::thread::hardware_concurrency() / 2, 1U);
+	prediction_jobs_per_frame = 0;
+	timewarp_max_step = 5.0;
 
 	name_to_index["__default"] = 0;
 }
@@ -391,7 +508,10 @@ PlanetarySystem::PlanetarySystem(Universe* universe)
 
 PlanetarySystem::~PlanetarySystem()
 {
+	// Predictions use the ephemeris, stop them first
+	delete prediction_server;
 	delete propagator;
+	delete ephemeris;
 
 	// Remove physics stuff
 	
@@ -412,6 +532,34 @@ void PlanetarySystem::load(const cpptoml::table &root)
 	t0 = root.get_qualified_as<double>("t").value_or(0);
 	bt = 0; t = 0;
 
+	auto prediction_toml = root.get_table("prediction");
+	if(prediction_toml)
+	{
+		prediction_threads = (size_t)prediction_toml->get_as<int64_t>("threads")
+				.value_or((int64_t)prediction_threads);
+		prediction_jobs_per_frame = (size_t)prediction_toml->get_as<int64_t>("jobs_per_frame")
+				.value_or((int64_t)prediction_jobs_per_frame);
+	}
+
+	auto timewarp_toml = root.get_table("timewarp");
+	if(timewarp_toml)
+	{
+		timewarp_max_step = timewarp_toml->get_as<double>("max_step").value_or(timewarp_max_step);
+	}
+
+	auto ephemeris_toml = root.get_table("ephemeris");
+	if(ephemeris_toml)
+	{
+		ephemeris_settings.load(*ephemeris_toml);
+	}
+
+	auto propagator_toml = root.get_table("propagator");
+	if(propagator_toml)
+	{
+		std::string type = propagator_toml->get_as<std::string>("type").value_or("rk4");
+		set_propagator(type, propagator_toml.get());
+	}
+
 	auto toml_elements = root.get_table_array("element");
 	if(!toml_elements) return;
 
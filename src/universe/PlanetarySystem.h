@@ -4,6 +4,8 @@
 #include "../util/SerializeUtil.h"
 #include "element/SystemElement.h"
 #include "propagator/SystemPropagator.h"
+#include "predictor/Ephemeris.h"
+#include "predictor/OrbitPredictionServer.h"
 
 #include <renderer/Drawable.h>
 
@@ -33,7 +35,9 @@ private:
 	static void render_body_atmosphere(CartesianState state, SystemElement* body, glm::dvec3 camera_pos,
 		glm::dmat4 proj_view, float far_plane, glm::dvec3 sun_pos);
 
-	static void update_render_body_rocky(SystemElement* body, glm::dvec3 body_pos, glm::dvec3 camera_pos, double t, double t0);
+	// foci are the world positions which get detail with multi focus LOD, besides the camera
+	static void update_render_body_rocky(SystemElement* body, glm::dvec3 body_pos, glm::dvec3 camera_pos, double t, double t0,
+		const std::vector<glm::dvec3>& foci, double pixels_per_radian);
 
 	void update_physics(double dt, bool bullet);
 	void init_physics(btDynamicsWorld* world);
@@ -74,11 +78,34 @@ public:
 	SystemElement* get_element(const std::string& name);
 
 	StateVector states_now;
-	// Only used during time-warp, to propagate entities
+	// Only used during time-warp, to propagate entities (see TimeWarp)
+	// Entities with a trajectory are propagated by it, nullptr means n-body
 	LightStateVector handled_states_now;
 	TrajectoryVector handled_states_trj;
 
 	SystemPropagator* propagator;
+
+	// Replaces the propagator with a new one of given type (see SystemPropagator::create)
+	// settings is the [propagator] table, if available. Returns false if the name is unknown
+	bool set_propagator(const std::string& name, const cpptoml::table* settings = nullptr);
+	std::string get_propagator_name() { return propagator->get_name(); }
+
+	// Future states of the massive bodies, shared by all predictors
+	// Created on first use (thread-safe), read from the [ephemeris] table
+	Ephemeris::Settings ephemeris_settings;
+	Ephemeris* ephemeris;
+	Ephemeris* get_ephemeris();
+
+	// Runs the predictions of every vessel, created on first use
+	// Thread count and per frame budget are read from the [prediction] table
+	size_t prediction_threads;
+	size_t prediction_jobs_per_frame;
+	OrbitPredictionServer* prediction_server;
+	OrbitPredictionServer* get_prediction_server();
+
+	// Biggest step given to the propagator during timewarp (adaptive propagators
+	// take a single step per frame), read from the [timewarp] table
+	double timewarp_max_step;
 	
 	glm::dvec3 get_gravity_vector(glm::dvec3 point, bool physics);
 
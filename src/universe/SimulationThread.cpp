@@ -0,0 +1,175 @@
+#include "SimulationThread.h"
+#include "Universe.h"
+#include <util/ThreadUtil.h>
+#include <util/Timer.h>
+#include <util/Profiler.h>
+#include <LinearMath/btTransformUtil.h>
+#include <algorithm>
+#include <chrono>
+
+void SimulationThread::run()
+{
+	set_this_thread_name("simulation");
+
+	std::unique_lock<std::mutex> lock(mtx);
+	while(true)
+	{
+		cv.wait(lock, [this]{ return !running || served < released; });
+		if(!running)
+			break;
+
+		// The main thread is waiting or presenting, the universe is ours
+		lock.unlock();
+		auto start = std::chrono::steady_clock::now();
+		size_t ticks = catch_up();
+		double time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		lock.lock();
+
+		last_turn_ticks = ticks;
+		last_turn_time = time;
+		served = released;
+		cv.notify_all();
+	}
+}
+
+size_t SimulationThread::catch_up()
+{
+	PROFILE_FUNC();
+	PlanetarySystem& sys = universe->system;
+	if(universe->paused || universe->timewarp.is_warping() || sys.states_now.empty())
+	{
+		return 0;
+	}
+
+	size_t ticks = 0;
+	while(sys.bt < sys.t && ticks < MAX_TICKS_PER_TURN)
+	{
+		// A single step of exactly PHYSICS_STEPSIZE, bullet calls physics_update before it
+		double t0 = Timer::now();
+		{
+			PROFILE_BLOCK("bullet");
+			universe->bt_world->stepSimulation(Universe::PHYSICS_STEPSIZE, 0, Universe::PHYSICS_STEPSIZE);
+		}
+		universe->timings.bullet += Timer::now() - t0;
+		publish();
+		ticks++;
+	}
+
+	PROFILE_COUNTER("ticks_per_turn", ticks);
+	return ticks;
+}
+
+void SimulationThread::publish()
+{
+	PROFILE_FUNC();
+	// The previous snapshot is overwritten, the last published one is kept for interpolation
+	Snapshot& back = snapshots[1 - front];
+	back.bt = universe->system.bt;
+	back.bodies.clear();
+
+	btCollisionObjectArray& objects = universe->bt_world->getCollisionObjectArray();
+	for(int i = 0; i < objects.size(); i++)
+	{
+		btRigidBody* rb = btRigidBody::upcast(objects[i]);
+		if(rb == nullptr || rb->getMotionState() == nullptr || rb->isStaticOrKinematicObject())
+			continue;
+
+		BodyState st;
+		st.tform = rb->getWorldTransform();
+		st.lin_vel = rb->getLinearVelocity();
+		st.ang_vel = rb->getAngularVelocity();
+		back.bodies[rb] = st;
+	}
+
+	front = 1 - front;
+}
+
+void SimulationThread::release()
+{
+	std::unique_lock<std::mutex> lock(mtx);
+	released++;
+	cv.notify_all();
+}
+
+void SimulationThread::acquire()
+{
+	std::unique_lock<std::mutex> lock(mtx);
+	cv.wait(lock, [this]{ return served == released; });
+}
+
+double SimulationThread::limit_dt(double dt)
+{
+	// Bullet must be able to catch up in a single turn
+	PlanetarySystem& sys = universe->system;
+	double max_ahead = (double)MAX_TICKS_PER_TURN * Universe::PHYSICS_STEPSIZE;
+	return std::clamp(sys.bt + max_ahead - sys.t, 0.0, dt);
+}
+
+void SimulationThread::interpolate()
+{
+	const Snapshot& cur = snapshots[front];
+	const Snapshot& prev = snapshots[1 - front];
+	if(cur.bodies.empty())
+		return;
+
+	double t = universe->system.t;
+	double span = cur.bt - prev.bt;
+
+	// Bodies are looked up from the world, as the snapshot may hold removed ones
+	btCollisionObjectArray& objects = universe->bt_world->getCollisionObjectArray();
+	for(int i = 0; i < objects.size(); i++)
+	{
+		btRigidBody* rb = btRigidBody::upcast(objects[i]);
+		if(rb == nullptr || rb->getMotionState() == nullptr)
+			continue;
+
+		auto cur_it = cur.bodies.find(rb);
+		if(cur_it == cur.bodies.end())
+			continue;
+
+		const BodyState& cst = cur_it->second;
+		btTransform tform;
+		auto prev_it = prev.bodies.find(rb);
+		if(t < cur.bt && span > 0.0 && prev_it != prev.bodies.end())
+		{
+			const BodyState& pst = prev_it->second;
+			btScalar alpha = (btScalar)std::clamp((t - prev.bt) / span, 0.0, 1.0);
+			tform.setOrigin(pst.tform.getOrigin().lerp(cst.tform.getOrigin(), alpha));
+			tform.setRotation(pst.tform.getRotation().slerp(cst.tform.getRotation(), alpha));
+		}
+		else
+		{
+			// Bullet lags the system by up to a frame, extrapolate like bullet
+			// does with the motion states when single threaded
+			btTransformUtil::integrateTransform(cst.tform, cst.lin_vel, cst.ang_vel,
+									   (btScalar)(t - cur.bt), tform);
+		}
+
+		rb->getMotionState()->setWorldTransform(tform);
+	}
+}
+
+SimulationThread::SimulationThread(Universe* universe)
+{
+	this->universe = universe;
+	running = true;
+	released = 0;
+	served = 0;
+	front = 0;
+	snapshots[0].bt = 0.0;
+	snapshots[1].bt = 0.0;
+	last_turn_ticks = 0;
+	last_turn_time = 0.0;
+
+	thread = std::thread(&SimulationThread::run, this);
+}
+
+SimulationThread::~SimulationThread()
+{
+	{
+		std::unique_lock<std::mutex> lock(mtx);
+		running = false;
+		cv.notify_all();
+	}
+	thread.join();
+}
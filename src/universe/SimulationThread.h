@@ -0,0 +1,100 @@
+#pragma once
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <unordered_map>
+#pragma warning(push, 0)
+#include <btBulletDynamicsCommon.h>
+#pragma warning(pop)
+
+class Universe;
+
+// Runs bullet (and thus physics_update) on its own thread, in fixed steps of
+// Universe::PHYSICS_STEPSIZE, catching up with the system time (t) advanced by
+// the main thread. Enabled with simulation.threaded in the settings, which is false
+// by default (and always in the headless runner).
+//
+// Lua is not thread-safe and physics_update runs lua, so both threads take turns:
+// the main thread owns the universe while updating and rendering, and hands it to
+// the simulation thread while presenting the frame (release() / acquire()).
+// If rendering is slow the simulation catches up in a single turn, so it keeps
+// real time instead of slowing down with the framerate.
+//
+// Physics only overlaps with the main thread between release() in OSP::render and
+// acquire() in OSP::update, which is drawing imgui and swapping buffers (and the
+// start of the next frame, polling events). With vsync this includes waiting for the
+// vertical blank, otherwise it's short and the turn mostly runs serially, so don't
+// expect a speedup from the thread itself: it's the catch up which keeps real time.
+// Releasing earlier (after interpolate() in the update) is not possible, as the
+// entities update and rendering run lua and read bullet.
+//
+// After each tick the state of every dynamic rigidbody is published into a double
+// buffered snapshot, which the main thread interpolates (or extrapolates, as bullet
+// lags the system by up to a frame) into the motion states, which are what
+// get_graphics_transform() uses, so rendering is smooth.
+class SimulationThread
+{
+private:
+
+	struct BodyState
+	{
+		btTransform tform;
+		btVector3 lin_vel;
+		btVector3 ang_vel;
+	};
+
+	struct Snapshot
+	{
+		// Bullet time of the snapshot
+		double bt;
+		// Only used as keys, bodies may have been deleted since the tick
+		std::unordered_map<const btCollisionObject*, BodyState> bodies;
+	};
+
+	Universe* universe;
+	std::thread thread;
+
+	std::mutex mtx;
+	std::condition_variable cv;
+	bool running;
+	// The simulation thread has a turn each time the main thread releases the universe
+	uint64_t released;
+	uint64_t served;
+
+	// snapshots[front] is the last published, the other one the previous
+	Snapshot snapshots[2];
+	int front;
+
+	size_t last_turn_ticks;
+	double last_turn_time;
+
+	void run();
+	// Ticks until bullet time reaches system time, returns the number of ticks
+	size_t catch_up();
+	void publish();
+
+public:
+
+	// Biggest catch up in a single turn, anything beyond slows down the simulation
+	static constexpr size_t MAX_TICKS_PER_TURN = 8;
+	// Frames longer than this slow down the simulation
+	static constexpr double MAX_FRAME_DT = 0.25;
+
+	// Main thread: hands the universe to the simulation thread, do not touch
+	// the universe (or lua) until acquire() returns
+	void release();
+	// Main thread: waits for the simulation thread to finish its turn
+	void acquire();
+
+	// Main thread: limits how far the system can get ahead of bullet
+	double limit_dt(double dt);
+	// Main thread: writes the transforms interpolated to system time into the motion states
+	void interpolate();
+
+	size_t get_last_turn_ticks() const { return last_turn_ticks; }
+	// In seconds, wall time of the last turn of the simulation thread
+	double get_last_turn_time() const { return last_turn_time; }
+
+	explicit SimulationThread(Universe* universe);
+	~SimulationThread();
+};
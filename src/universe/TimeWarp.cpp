@@ -0,0 +1,259 @@
+#include "TimeWarp.h"
+#include "Universe.h"
+#include "vehicle/Vehicle.h"
+#include "entity/trajectory/LandedTrajectory.h"
+#include "kepler/KeplerElements.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+void TimeWarp::begin()
+{
+	PlanetarySystem& sys = universe->system;
+
+	for(Entity* e : universe->entities)
+	{
+		e->enable_bullet_wrapper(false, universe->bt_world);
+
+		Vehicle* v = e->get_vehicle();
+		if(v == nullptr)
+			continue;
+
+		OnRails r;
+		r.vehicle = v;
+		r.was_unpacked = !v->is_packed();
+		r.landed = nullptr;
+
+		int64_t landed_elem = v->get_landed_element();
+		LightCartesianState com = v->get_com_state();
+		if(r.was_unpacked)
+		{
+			// Unpacked vehicles are at bullet time, bring them to system time
+			com.pos += com.vel * (sys.t - sys.bt);
+			v->pack();
+		}
+
+		WorldState st = v->packed_veh.get_world_state();
+		r.rot = st.rot;
+		r.ang_vel = st.ang_vel;
+
+		if(landed_elem >= 0)
+		{
+			r.landed = new LandedTrajectory();
+			r.landed->set_element(sys.elements[landed_elem]->name);
+			r.landed->set_world_state(com.pos, st.rot);
+			r.ang_vel = glm::dvec3(0.0, 0.0, 0.0);
+		}
+
+		r.idx = sys.handled_states_now.size();
+		sys.handled_states_now.push_back(com);
+		sys.handled_states_trj.push_back(r.landed);
+		on_rails.push_back(r);
+	}
+
+	logger->info("Starting timewarp with {} vehicles on rails", on_rails.size());
+}
+
+void TimeWarp::end()
+{
+	PlanetarySystem& sys = universe->system;
+
+	// Bullet starts again from the current time
+	sys.bt = sys.t;
+
+	for(OnRails& r : on_rails)
+	{
+		if(r.was_unpacked)
+		{
+			r.vehicle->unpack();
+		}
+		delete r.landed;
+	}
+
+	on_rails.clear();
+	sys.handled_states_now.clear();
+	sys.handled_states_trj.clear();
+
+	for(Entity* e : universe->entities)
+	{
+		e->enable_bullet_wrapper(true, universe->bt_world);
+	}
+}
+
+void TimeWarp::advance(double sim_dt)
+{
+	PlanetarySystem& sys = universe->system;
+
+	size_t steps = 1;
+	if(!sys.propagator->is_adaptive())
+	{
+		steps = std::max((size_t)std::ceil(sim_dt / sys.timewarp_max_step), (size_t)1);
+	}
+
+	double h = sim_dt / (double)steps;
+	for(size_t i = 0; i < steps; i++)
+	{
+		sys.update(h, universe->bt_world, false);
+	}
+}
+
+void TimeWarp::write_back()
+{
+	PlanetarySystem& sys = universe->system;
+
+	for(OnRails& r : on_rails)
+	{
+		const LightCartesianState& lst = sys.handled_states_now[r.idx];
+
+		WorldState st;
+		st.vel = lst.vel;
+		st.rot = r.landed ? r.landed->get_rotation(sys.t) : r.rot;
+		st.ang_vel = r.ang_vel;
+		// The light state is the center of mass, the packed vehicle is positioned by the root
+		glm::dvec3 com = to_dvec3(r.vehicle->packed_veh.get_com_root_relative());
+		st.pos = lst.pos - st.rot * com;
+
+		r.vehicle->packed_veh.set_world_state(st);
+	}
+}
+
+bool TimeWarp::set_rate(double n_rate)
+{
+	if(n_rate <= 1.0)
+	{
+		if(is_warping())
+		{
+			end();
+		}
+		rate = 1.0;
+		return true;
+	}
+
+	if(!is_warping())
+	{
+		for(Entity* e : universe->entities)
+		{
+			if(!e->timewarp_safe())
+			{
+				logger->info("Cannot timewarp, entity {} ({}) is not safe to timewarp", e->get_uid(), e->get_type());
+				return false;
+			}
+		}
+
+		begin();
+	}
+
+	rate = n_rate;
+	return true;
+}
+
+void TimeWarp::update(double dt)
+{
+	advance(dt * rate);
+	write_back();
+}
+
+double TimeWarp::benchmark(size_t count, double at_rate, size_t frames)
+{
+	logger->check(!is_warping(), "Cannot benchmark timewarp while warping");
+
+	PlanetarySystem& sys = universe->system;
+
+	SystemElement* body = nullptr;
+	for(SystemElement* elem : sys.elements)
+	{
+		if(elem->config.has_surface)
+		{
+			body = elem;
+			break;
+		}
+	}
+	logger->check(body != nullptr, "Timewarp benchmark needs an element with a surface");
+
+	// Make sure the system is initialized, so restoring it doesn't initialize it again
+	if(sys.states_now.empty())
+	{
+		sys.update(0.0, universe->bt_world, false);
+	}
+
+	StateVector old_states = sys.states_now;
+	double old_t = sys.t;
+	double old_bt = sys.bt;
+
+	CartesianState body_st = sys.get_element_state(body->index);
+	double mu = G * body->get_mass();
+	std::vector<LandedTrajectory*> landed;
+
+	for(size_t i = 0; i < count; i++)
+	{
+		// Evenly spread directions (golden spiral)
+		double z = 1.0 - 2.0 * ((double)i + 0.5) / (double)count;
+		double xy = std::sqrt(1.0 - z * z);
+		double phi = (double)i * 2.399963;
+		glm::dvec3 dir = glm::dvec3(std::cos(phi) * xy, std::sin(phi) * xy, z);
+
+		LightCartesianState st;
+		LandedTrajectory* trj = nullptr;
+		if(i % 4 == 3)
+		{
+			trj = new LandedTrajectory();
+			trj->set_element(body->name);
+			trj->set_world_state(body_st.pos + dir * body->config.radius, glm::dquat(1.0, 0.0, 0.0, 0.0));
+			st.pos = body_st.pos + dir * body->config.radius;
+			st.vel = body_st.vel + body->get_tangential_speed(dir * body->config.radius);
+			landed.push_back(trj);
+		}
+		else
+		{
+			double r = body->config.radius * (1.1 + 0.5 * (double)i / (double)count);
+			glm::dvec3 up = std::abs(dir.z) < 0.9 ? glm::dvec3(0, 0, 1) : glm::dvec3(1, 0, 0);
+			glm::dvec3 tang = glm::normalize(glm::cross(dir, up));
+			st.pos = body_st.pos + dir * r;
+			st.vel = body_st.vel + tang * std::sqrt(mu / r);
+		}
+
+		sys.handled_states_now.push_back(st);
+		sys.handled_states_trj.push_back(trj);
+	}
+
+	frames = std::max(frames, (size_t)1);
+	constexpr double FRAME_DT = 1.0 / 60.0;
+	auto start = std::chrono::steady_clock::now();
+	for(size_t i = 0; i < frames; i++)
+	{
+		advance(FRAME_DT * at_rate);
+	}
+	double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	double simulated = FRAME_DT * at_rate * (double)frames;
+	double speed = simulated / std::max(wall, 1e-9);
+
+	logger->info("Timewarp benchmark: {} vehicles ({} landed) at {}x with {}, {:.0f} simulated seconds per second "
+				 "({:.2f}x the requested rate, {:.3f}ms per frame)",
+				 count, landed.size(), at_rate, sys.get_propagator_name(), speed,
+				 speed / at_rate, wall / (double)frames * 1000.0);
+
+	for(LandedTrajectory* trj : landed)
+	{
+		delete trj;
+	}
+	sys.handled_states_now.clear();
+	sys.handled_states_trj.clear();
+
+	sys.lock.lock();
+	sys.states_now = old_states;
+	sys.t = old_t;
+	sys.bt = old_bt;
+	if(sys.ephemeris)
+	{
+		sys.ephemeris->update_now(sys.states_now, sys.t);
+	}
+	sys.lock.unlock();
+
+	return speed;
+}
+
+TimeWarp::TimeWarp(Universe* universe)
+{
+	this->universe = universe;
+	rate = 1.0;
+}
@@ -0,0 +1,62 @@
+#pragma once
+#include "CartesianState.h"
+#include <vector>
+
+class Universe;
+class Vehicle;
+class LandedTrajectory;
+
+// Timewarp puts vehicles "on rails": they are packed and their center of mass is
+// propagated as a light state of the system (handled_states_now), or by a
+// LandedTrajectory if they are landed. This way the system is advanced in big steps
+// without bullet, which is frozen while warping and catches up (bt = t) once warp ends.
+// Warp can only start if every entity is timewarp_safe()
+// Orientation is kept fixed while on rails (landed vehicles rotate with the surface)
+class TimeWarp
+{
+private:
+
+	struct OnRails
+	{
+		Vehicle* vehicle;
+		// Index into handled_states_now / handled_states_trj
+		size_t idx;
+		// Vehicles which were unpacked are unpacked back when warp ends
+		bool was_unpacked;
+		glm::dquat rot;
+		glm::dvec3 ang_vel;
+		// nullptr if the vehicle is not landed
+		LandedTrajectory* landed;
+	};
+
+	Universe* universe;
+	std::vector<OnRails> on_rails;
+	double rate;
+
+	void begin();
+	void end();
+	// Advances the system sim_dt seconds without bullet, in steps of
+	// at most timewarp_max_step (see PlanetarySystem)
+	void advance(double sim_dt);
+	// Moves the packed vehicles to their propagated states
+	void write_back();
+
+public:
+
+	// Rates of 1 or lower end warp. Returns false if warp cannot start because
+	// an entity is not timewarp safe
+	bool set_rate(double n_rate);
+	double get_rate() const { return rate; }
+	bool is_warping() const { return rate > 1.0; }
+	size_t get_vehicles_on_rails() const { return on_rails.size(); }
+
+	// Called by Universe instead of stepping bullet while warping
+	void update(double dt);
+
+	// Puts count light states on rails around the first element with a surface (a quarter
+	// of them landed) and advances frames of 1/60s at given rate, without bullet or rendering.
+	// Logs and returns the simulated seconds per wall second. The system is restored afterwards
+	double benchmark(size_t count, double at_rate, size_t frames);
+
+	explicit TimeWarp(Universe* universe);
+};
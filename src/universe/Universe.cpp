@@ -1,6 +1,8 @@
 #include "Universe.h"
 #include <util/Profiler.h>
+#include <util/Timer.h>
 #include <game/GameState.h>
+#include "SimulationThread.h"
 
 #ifdef OSPGL_LRDB
 #include <LRDB/server.hpp>
@@ -18,31 +20,94 @@ static void bullet_tick(btDynamicsWorld* world, btScalar tstep)
 
 void Universe::physics_update(double pdt)
 {
+	PROFILE_BLOCK("physics_update");
+
+	double t0 = Timer::now();
 	osp->game_state->physics_update(pdt);
-	// Do the physics update on the system
-	system.update(pdt, bt_world, true);
+	double t1 = Timer::now();
+	{
+		PROFILE_BLOCK("system");
+		// Do the physics update on the system
+		system.update(pdt, bt_world, true);
+	}
+	double t2 = Timer::now();
 
-	for (Entity* e : entities)
 	{
-		e->physics_update(pdt);
+		PROFILE_BLOCK("entities");
+		for (Entity* e : entities)
+		{
+			e->physics_update(pdt);
+		}
 	}
+
+	timings.physics_update += (t1 - t0) + (Timer::now() - t2);
+	timings.system += t2 - t1;
+	timings.ticks++;
 }
 
 void Universe::update(double dt)
 {
 	PROFILE_BLOCK("universe");
 
+	// Predictions keep running while paused
+	PROFILE_COUNTER("entities", entities.size());
+
+	if(system.prediction_server)
+	{
+		PROFILE_BLOCK("prediction_server");
+		system.prediction_server->update();
+	}
+
 	if(!paused)
 	{
-		system.update(dt, bt_world, false);
+		double t0 = Timer::now();
+		bool warping = timewarp.is_warping();
+		if(warping)
+		{
+			PROFILE_BLOCK("timewarp");
+			timewarp.update(dt);
+		}
+		else
+		{
+			PROFILE_BLOCK("system");
+			if(sim_thread)
+			{
+				dt = sim_thread->limit_dt(dt);
+			}
+			system.update(dt, bt_world, false);
+		}
 
-		for (Entity* e : entities)
+		if(sim_thread && !warping)
+		{
+			sim_thread->interpolate();
+		}
+
+		double t1 = Timer::now();
 		{
-			e->update(dt);
+			PROFILE_BLOCK("entities");
+			for (Entity* e : entities)
+			{
+				e->update(dt);
+			}
 		}
+		double t2 = Timer::now();
 
-		bt_world->stepSimulation(dt, MAX_PHYSICS_STEPS, PHYSICS_STEPSIZE);
+		// Otherwise bullet is stepped by the simulation thread once the frame is presented
+		if(!warping && !sim_thread)
+		{
+			PROFILE_BLOCK("bullet");
+			bt_world->stepSimulation(dt, MAX_PHYSICS_STEPS, PHYSICS_STEPSIZE);
+			timings.bullet += Timer::now() - t2;
+		}
+
+		timings.system += t1 - t0;
+		timings.entities += t2 - t1;
+		timings.frames++;
+	}
 
+	if(osp->threaded_simulation && !sim_thread && !system.states_now.empty())
+	{
+		sim_thread = new SimulationThread(this);
 	}
 
 }
@@ -66,10 +131,11 @@ Entity* Universe::get_entity(int64_t uid)
 }
 
 
-Universe::Universe() : system(this)
+Universe::Universe() : system(this), timewarp(this)
 {
 	uid = 0;
 	paused = false;
+	sim_thread = nullptr;
 
 	// We set the global OSP so required modules can use it
 	lua_state["osp"] = osp;
@@ -108,6 +174,9 @@ Universe::Universe() : system(this)
 
 Universe::~Universe()
 {
+	// Stop it first, it may be waiting for a turn
+	delete sim_thread;
+
 	for(Entity* ent : entities)
 	{
 		delete ent;
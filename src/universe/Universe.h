@@ -1,5 +1,6 @@
 #pragma once
 #include "PlanetarySystem.h"
+#include "TimeWarp.h"
 #include "entity/Entity.h"
 #include <any>
 #include "Events.h"
@@ -29,6 +30,27 @@
 // 
 // It's the responsability of the event receiver to remove the handler once it's deleted / not needed!
 class GameState;
+class SimulationThread;
+
+// Wall time (in seconds) spent on each part of the simulation, accumulated until reset().
+// Only a few clock reads per tick, so it's always on. Printed by the headless runner
+struct UniverseTimings
+{
+	// Propagation of the system (or timewarp), both per frame and per tick
+	double system = 0.0;
+	// Entity::update
+	double entities = 0.0;
+	// Whole bullet steps, physics_update included
+	double bullet = 0.0;
+	// Scene and Entity::physics_update, plumbing included
+	double physics_update = 0.0;
+	// VehiclePlumbing::update_pipes of every vehicle
+	double plumbing = 0.0;
+	size_t frames = 0;
+	size_t ticks = 0;
+
+	void reset() { *this = UniverseTimings(); }
+};
 
 class Universe : public EventEmitter
 {
@@ -79,9 +101,16 @@ public:
 	// Exposed to lua to be addable as a drawable
 	// TODO: This feels like a horrible hack
 	std::shared_ptr<PlanetarySystem> system_ptr;
+	// While warping, bullet is not stepped and vehicles are on rails
+	TimeWarp timewarp;
+	// Steps bullet if simulation.threaded is enabled in the settings, otherwise nullptr
+	// Created on the first update
+	SimulationThread* sim_thread;
 	std::vector<Entity*> entities;
 	std::unordered_map<int64_t, Entity*> entities_by_id;
 
+	UniverseTimings timings;
+
 	template<typename T, typename... Args>
 	T* create_entity(Args&&... args);
 
@@ -1,8 +1,8 @@
 #pragma once
 #include "kepler/KeplerElements.h"
-#include "element/SystemElement.h"
 
 class Trajectory;
+class SystemElement;
 
 using LightStateVector = std::vector<LightCartesianState>;
 using StateVector = std::vector<CartesianState>;
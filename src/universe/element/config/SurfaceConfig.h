@@ -11,16 +11,31 @@ constexpr bool LOAD_SURFACES_ON_START = false;
 
 struct SurfaceConfig
 {
+	// Empty if the native generator is used
 	std::string script_path;
 	std::string script_path_raw;
+	// [surface.generator] table, if present it's used instead of the
+	// lua script (see TerrainGenerator)
+	std::shared_ptr<cpptoml::table> generator;
 	int max_depth;
 	double coef_a;
 	double coef_b;
 	double coef_c;
 	int depth_for_unload;
 
+	// Detail around every vehicle, not only the camera (see QuadTreeLod)
+	bool multi_focus_lod;
+	// Maximum vertex spacing, in screen pixels, before a tile is subdivided
+	double lod_pixel_error;
+
 	bool has_water;
 
+	// Store generated tiles in udata/cache/planets (see PlanetTileCache)
+	bool disk_cache;
+
+	// Memory limit for the physics tiles (see GroundShapeServer)
+	double physics_cache_mb;
+
 	// A rough estimate of maximum heigth from sea-level
 	// Doesn't need to be really exact, but make sure it's
 	// higher than the actual maximum height, otherwise physics 
@@ -39,15 +54,30 @@ public:
 	static void deserialize(SurfaceConfig& to, const cpptoml::table& from)
 	{
 		SAFE_TOML_GET(to.has_water, "has_water", bool);
-		SAFE_TOML_GET(to.script_path_raw, "script_path", std::string);
+		SAFE_TOML_GET_OR(to.disk_cache, "disk_cache", bool, true);
+		SAFE_TOML_GET_OR(to.physics_cache_mb, "physics_cache_mb", double, 64.0);
+		to.generator = from.get_table("generator");
+		if(to.generator)
+		{
+			SAFE_TOML_GET_OR(to.script_path_raw, "script_path", std::string, "");
+		}
+		else
+		{
+			SAFE_TOML_GET(to.script_path_raw, "script_path", std::string);
+		}
 		SAFE_TOML_GET(to.max_depth, "lod.max_depth", int);
 		SAFE_TOML_GET(to.coef_a, "lod.coef_a", double);
 		SAFE_TOML_GET(to.coef_b, "lod.coef_b", double);
 		SAFE_TOML_GET(to.coef_c, "lod.coef_c", double);
 		SAFE_TOML_GET(to.depth_for_unload, "lod.depth_for_unload", int)
+		SAFE_TOML_GET_OR(to.multi_focus_lod, "lod.multi_focus", bool, false);
+		SAFE_TOML_GET_OR(to.lod_pixel_error, "lod.pixel_error", double, 24.0);
 
 		SAFE_TOML_GET(to.max_height, "max_height", double);
 
-		to.script_path = osp->assets->resolve_path(to.script_path_raw);
+		if(!to.script_path_raw.empty())
+		{
+			to.script_path = osp->assets->resolve_path(to.script_path_raw);
+		}
 	}
 };
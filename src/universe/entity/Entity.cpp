@@ -3,7 +3,9 @@
 #include <lua/LuaCore.h>
 #include <game/GameState.h>
 #include <utility>
+#include <util/Profiler.h>
 #include <game/scenes/flight/InputContext.h>
+#include "../vehicle/Vehicle.h"
 
 void Entity::enable_bullet(btDynamicsWorld *world)
 {
@@ -52,11 +54,13 @@ bool Entity::is_physics_loader()
 
 void Entity::update(double dt)
 {
+	PROFILE_BLOCK("lua_entity_update");
 	LuaUtil::call_function_if_present(env["update"], dt);
 }
 
 void Entity::physics_update(double pdt)
 {
+	PROFILE_BLOCK("lua_entity_physics_update");
 	LuaUtil::call_function_if_present(env["physics_update"], pdt);
 }
 
@@ -65,6 +69,11 @@ void Entity::init()
 	LuaUtil::call_function_if_present(env["init"]);
 }
 
+Vehicle* Entity::get_vehicle()
+{
+	return LuaUtil::call_function_if_present_returns<Vehicle*>(env["get_vehicle"]).value_or(nullptr);
+}
+
 bool Entity::timewarp_safe()
 {
 	auto result = LuaUtil::call_function_if_present_returns<bool>(env["timewarp_safe"]);
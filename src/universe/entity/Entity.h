@@ -14,6 +14,7 @@
 #include <cpptoml.h>
 
 class InputContext;
+class Vehicle;
 
 // An entity is something which exists on the world, 
 // it has graphics, and can exists on the bullet physics
@@ -95,6 +96,10 @@ public:
 	// but create only once when the entity is first created
 	void init();
 
+	// Return the wrapped vehicle, if any, so timewarp can put it on rails
+	// If it returns nullptr, the entity is simply frozen during timewarp
+	Vehicle* get_vehicle();
+
 	// Return true if the physics have stabilized enough for timewarp
 	// Vehicles should return false when they are close enough to surfaces
 	// or in atmospheric flight
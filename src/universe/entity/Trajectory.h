@@ -24,4 +24,6 @@ public:
 	// and for positioning it in the physics engine (if use_bullet is true)
 	virtual WorldState update(double dt, bool use_bullet) = 0;
 
+	virtual ~Trajectory() = default;
+
 };
@@ -65,6 +65,7 @@ LandedTrajectory::~LandedTrajectory()
 
 LandedTrajectory::LandedTrajectory()
 {
+	prop_t = 0.0;
 	hndl = EventHandler(EventHandlerFnc([this](EventArguments& args)
 	{
 		this->update_element_idx();
@@ -75,7 +76,39 @@ LandedTrajectory::LandedTrajectory()
 void LandedTrajectory::propagate(double dt, const StateVector &mstates, const LightStateVector &lstates,
 								 LightCartesianState &our_state)
 {
-	// TODO
+	PlanetarySystem& sys = osp->universe->system;
+	SystemElement* elem = sys.elements[cached_elem_index];
+
+	prop_t += dt;
+
+	glm::dmat4 rot_matrix = elem->build_rotation_matrix(sys.t0, prop_t, false);
+	glm::dvec3 rel_pos = glm::dvec3(rot_matrix * glm::dvec4(initial_relative_pos, 1.0));
+
+	our_state.pos = mstates[cached_elem_index].pos + rel_pos;
+	our_state.vel = mstates[cached_elem_index].vel + elem->get_tangential_speed(rel_pos);
+}
+
+glm::dquat LandedTrajectory::get_rotation(double t)
+{
+	PlanetarySystem& sys = osp->universe->system;
+	SystemElement* elem = sys.elements[cached_elem_index];
+
+	glm::dmat4 rot_matrix = elem->build_rotation_matrix(sys.t0, t, false);
+	return glm::dquat(rot_matrix * glm::toMat4(initial_rotation));
+}
+
+void LandedTrajectory::set_world_state(glm::dvec3 pos, glm::dquat rot)
+{
+	PlanetarySystem& sys = osp->universe->system;
+	SystemElement* elem = sys.elements[cached_elem_index];
+
+	prop_t = sys.t;
+
+	glm::dmat4 inv_rot = glm::inverse(elem->build_rotation_matrix(sys.t0, sys.t, false));
+	glm::dvec3 rel_pos = pos - sys.get_element_state(cached_elem_index).pos;
+
+	initial_relative_pos = glm::dvec3(inv_rot * glm::dvec4(rel_pos, 1.0));
+	initial_rotation = glm::dquat(inv_rot) * rot;
 }
 
 void LandedTrajectory::set_element(const std::string &elem)
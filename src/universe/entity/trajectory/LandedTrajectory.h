@@ -27,10 +27,19 @@ public:
 	glm::dvec3 initial_relative_pos;
 	glm::dquat initial_rotation;
 
+	// Time up to which propagate() has run, it keeps its own clock
+	// so it can be used from predictions, not only from the system
+	double prop_t;
+
 	void set_element(const std::string& elem);
+	// Fixes the trajectory to the surface point under the given world position and
+	// rotation, at current system time. The element must be set first
+	void set_world_state(glm::dvec3 pos, glm::dquat rot);
+	// World rotation at given system time
+	glm::dquat get_rotation(double t);
 
 	LandedTrajectory();
-	~LandedTrajectory();
+	~LandedTrajectory() override;
 
 };
 
@@ -1,4 +1,5 @@
 #include "KeplerElements.h"
+#include <algorithm>
 
 #define ORBIT_COS cos
 #define ORBIT_SIN sin
@@ -354,3 +355,115 @@ CartesianState KeplerElements::get_cartesian(double parent_mass, double our_mass
 	// We have to correct the coordinate system
 	return CartesianState(glm::dvec3(-pos.x, pos.y, pos.z), glm::dvec3(-vel.x, vel.y, vel.z), our_mass);
 }
+
+// Stumpff functions, with series expansions near z = 0 where the closed
+// forms lose precision (and are slower)
+static inline void stumpff(double z, double& c, double& s)
+{
+	if (z > 0.1)
+	{
+		double sz = sqrt(z);
+		c = (1.0 - cos(sz)) / z;
+		s = (sz - sin(sz)) / (sz * sz * sz);
+	}
+	else if (z < -0.1)
+	{
+		double sz = sqrt(-z);
+		c = (cosh(sz) - 1.0) / -z;
+		s = (sinh(sz) - sz) / (sz * sz * sz);
+	}
+	else
+	{
+		// c = sum (-z)^k / (2k + 2)!, s = sum (-z)^k / (2k + 3)!
+		c = 1.0 / 2.0 - z * (1.0 / 24.0 - z * (1.0 / 720.0 - z * (1.0 / 40320.0 -
+			z * (1.0 / 3628800.0 - z * (1.0 / 479001600.0)))));
+		s = 1.0 / 6.0 - z * (1.0 / 120.0 - z * (1.0 / 5040.0 - z * (1.0 / 362880.0 -
+			z * (1.0 / 39916800.0 - z * (1.0 / 6227020800.0)))));
+	}
+}
+
+// Implementation of the universal variable formulation as described in
+// Curtis, Orbital Mechanics for Engineering Students (algorithms 3.3 and 3.4)
+bool propagate_conic(glm::dvec3& rel_pos, glm::dvec3& rel_vel, double mu, double dt)
+{
+	constexpr int MAX_ITERATIONS = 50;
+	constexpr double TOLERANCE = 1e-12;
+
+	double r0 = glm::length(rel_pos);
+	double v0 = glm::length(rel_vel);
+	if (r0 == 0.0 || mu <= 0.0)
+	{
+		return false;
+	}
+
+	double smu = sqrt(mu);
+	double vr0 = glm::dot(rel_pos, rel_vel) / r0;
+	// Reciprocal of the semi-major axis
+	double alpha = 2.0 / r0 - v0 * v0 / mu;
+
+	// For short steps chi is close to the travelled angle times sqrt(r0), which
+	// converges in a couple iterations. Long steps start from the mean motion
+	// Long hyperbolic steps use the guess from Vallado, Fundamentals of Astrodynamics
+	double chi = smu * dt / r0;
+	if (std::abs(alpha) > 1e-12 && std::abs(dt) * smu / (r0 * sqrt(r0)) > 0.5)
+	{
+		if (alpha > 0.0)
+		{
+			chi = smu * alpha * dt;
+		}
+		else
+		{
+			double a = 1.0 / alpha;
+			double sdt = dt > 0.0 ? 1.0 : -1.0;
+			double num = -2.0 * mu * alpha * dt;
+			double den = glm::dot(rel_pos, rel_vel) + sdt * sqrt(-mu * a) * (1.0 - r0 * alpha);
+			if (num / den > 0.0)
+			{
+				chi = sdt * sqrt(-a) * log(num / den);
+			}
+		}
+	}
+
+	double c, s, z;
+	bool converged = false;
+	for (int it = 0; it < MAX_ITERATIONS; it++)
+	{
+		z = alpha * chi * chi;
+		stumpff(z, c, s);
+
+		double chi2 = chi * chi;
+		double f = r0 * vr0 / smu * chi2 * c + (1.0 - alpha * r0) * chi2 * chi * s + r0 * chi - smu * dt;
+		double df = r0 * vr0 / smu * chi * (1.0 - z * s) + (1.0 - alpha * r0) * chi2 * c + r0;
+		double delta = f / df;
+		chi -= delta;
+
+		if (std::abs(delta) <= TOLERANCE * std::max(1.0, std::abs(chi)))
+		{
+			converged = true;
+			break;
+		}
+	}
+
+	if (!converged || !std::isfinite(chi))
+	{
+		return false;
+	}
+
+	z = alpha * chi * chi;
+	stumpff(z, c, s);
+	double chi2 = chi * chi;
+
+	// Lagrange coefficients
+	double f = 1.0 - chi2 / r0 * c;
+	double g = dt - chi2 * chi * s / smu;
+	glm::dvec3 npos = f * rel_pos + g * rel_vel;
+	double r = glm::length(npos);
+
+	double fdot = smu / (r * r0) * (z * s - 1.0) * chi;
+	double gdot = 1.0 - chi2 / r * c;
+	glm::dvec3 nvel = fdot * rel_pos + gdot * rel_vel;
+
+	rel_pos = npos;
+	rel_vel = nvel;
+	return true;
+}
@@ -64,6 +64,11 @@ struct KeplerElements
 // the position and velocity is given relative to the wanted center body!
 KeplerElements state_to_elements(glm::dvec3 rel_pos, glm::dvec3 rel_vel);
 
+// Advances a state (relative to the center body) by dt seconds along its conic,
+// using universal variables so it works for any eccentricity. mu = G * center mass
+// Returns false, without touching the state, if it doesn't converge
+bool propagate_conic(glm::dvec3& rel_pos, glm::dvec3& rel_vel, double mu, double dt);
+
 // Harder to generate elements, taken from NASA data for the default solar system.
 // They don't require central body mass as it's included in the mean_longitude variation
 // https://ssd.jpl.nasa.gov/txt/aprx_pos_planets.pdf
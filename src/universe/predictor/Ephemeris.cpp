@@ -0,0 +1,242 @@
+#include "Ephemeris.h"
+#include <util/Logger.h>
+#include <cmath>
+#include <algorithm>
+
+void Ephemeris::Settings::load(const cpptoml::table& table)
+{
+	knot_interval = table.get_as<double>("knot_interval").value_or(knot_interval);
+	knots_per_chunk = (size_t)table.get_as<int64_t>("knots_per_chunk").value_or((int64_t)knots_per_chunk);
+	int64_t budget_mb = table.get_as<int64_t>("memory_budget_mb").value_or((int64_t)(memory_budget / (1024 * 1024)));
+	memory_budget = (size_t)budget_mb * 1024 * 1024;
+	resync_distance = table.get_as<double>("resync_distance").value_or(resync_distance);
+	integrator = table.get_as<std::string>("integrator").value_or(integrator);
+
+	logger->check(knot_interval > 0.0, "Ephemeris knot_interval must be positive");
+	logger->check(knots_per_chunk >= 2, "Ephemeris knots_per_chunk must be at least 2");
+}
+
+size_t Ephemeris::chunk_bytes() const
+{
+	return settings.knots_per_chunk * body_count * sizeof(LightCartesianState) + sizeof(Chunk);
+}
+
+double Ephemeris::get_end_time() const
+{
+	if(chunks.empty())
+	{
+		return t_start;
+	}
+
+	// The last knot of each chunk is the first of the next one, so that every
+	// segment is contained in a single chunk
+	return chunks.back().t0 + (double)(settings.knots_per_chunk - 1) * settings.knot_interval;
+}
+
+void Ephemeris::reset_locked(const StateVector& states, double t)
+{
+	chunks.clear();
+	body_count = states.size();
+	masses.resize(body_count);
+	for(size_t i = 0; i < body_count; i++)
+	{
+		masses[i] = states[i].mass;
+	}
+	t_start = t;
+
+	prop_states = states;
+	prop_light.clear();
+	prop_trj.clear();
+	prop_t = t;
+
+	if(!propagator)
+	{
+		propagator.reset(SystemPropagator::create(settings.integrator));
+		if(!propagator)
+		{
+			logger->error("Unknown ephemeris integrator '{}', using rk4", settings.integrator);
+			propagator.reset(SystemPropagator::create("rk4"));
+		}
+	}
+	propagator->bind_to(&prop_states, &prop_light, &prop_trj);
+}
+
+void Ephemeris::reset(const StateVector& states, double t)
+{
+	std::unique_lock<std::mutex> expand_lock(expand_mtx);
+	std::unique_lock<std::shared_mutex> lock(data_mtx);
+	reset_locked(states, t);
+}
+
+bool Ephemeris::ensure(double t)
+{
+	{
+		std::shared_lock<std::shared_mutex> lock(data_mtx);
+		if(!chunks.empty() && t < chunks.front().t0)
+		{
+			return false;
+		}
+
+		if(t <= get_end_time() && !chunks.empty())
+		{
+			return true;
+		}
+	}
+
+	std::unique_lock<std::mutex> expand_lock(expand_mtx);
+
+	while(true)
+	{
+		{
+			std::shared_lock<std::shared_mutex> lock(data_mtx);
+			if(!chunks.empty() && t < chunks.front().t0)
+			{
+				return false;
+			}
+
+			if(t <= get_end_time() && !chunks.empty())
+			{
+				return true;
+			}
+
+			if((chunks.size() + 1) * chunk_bytes() > settings.memory_budget)
+			{
+				return false;
+			}
+		}
+
+		// Generate a new chunk without blocking readers
+		Chunk chunk;
+		chunk.t0 = prop_t;
+		chunk.states.resize(settings.knots_per_chunk * body_count);
+
+		for(size_t k = 0; k < settings.knots_per_chunk; k++)
+		{
+			if(k != 0)
+			{
+				propagator->propagate(settings.knot_interval);
+				prop_t += settings.knot_interval;
+			}
+
+			for(size_t i = 0; i < body_count; i++)
+			{
+				chunk.states[k * body_count + i].pos = prop_states[i].pos;
+				chunk.states[k * body_count + i].vel = prop_states[i].vel;
+			}
+		}
+
+		std::unique_lock<std::shared_mutex> lock(data_mtx);
+		chunks.push_back(std::move(chunk));
+	}
+}
+
+bool Ephemeris::get_states(double t, StateVector& out) const
+{
+	std::shared_lock<std::shared_mutex> lock(data_mtx);
+
+	if(chunks.empty() || t < chunks.front().t0 || t > get_end_time())
+	{
+		return false;
+	}
+
+	double h = settings.knot_interval;
+	double chunk_span = (double)(settings.knots_per_chunk - 1) * h;
+	size_t chunk_idx = (size_t)((t - chunks.front().t0) / chunk_span);
+	chunk_idx = std::min(chunk_idx, chunks.size() - 1);
+	const Chunk& chunk = chunks[chunk_idx];
+
+	size_t knot = (size_t)((t - chunk.t0) / h);
+	knot = std::min(knot, settings.knots_per_chunk - 2);
+
+	double s = (t - (chunk.t0 + (double)knot * h)) / h;
+	double s2 = s * s;
+	double s3 = s2 * s;
+
+	// Cubic Hermite basis and its derivative
+	double h00 = 2.0 * s3 - 3.0 * s2 + 1.0;
+	double h10 = s3 - 2.0 * s2 + s;
+	double h01 = -2.0 * s3 + 3.0 * s2;
+	double h11 = s3 - s2;
+	double d00 = (6.0 * s2 - 6.0 * s) / h;
+	double d10 = 3.0 * s2 - 4.0 * s + 1.0;
+	double d01 = (-6.0 * s2 + 6.0 * s) / h;
+	double d11 = 3.0 * s2 - 2.0 * s;
+
+	out.resize(body_count);
+	const LightCartesianState* k0 = &chunk.states[knot * body_count];
+	const LightCartesianState* k1 = &chunk.states[(knot + 1) * body_count];
+	for(size_t i = 0; i < body_count; i++)
+	{
+		out[i].pos = h00 * k0[i].pos + h10 * h * k0[i].vel + h01 * k1[i].pos + h11 * h * k1[i].vel;
+		out[i].vel = d00 * k0[i].pos + d10 * k0[i].vel + d01 * k1[i].pos + d11 * k1[i].vel;
+		out[i].mass = masses[i];
+	}
+
+	return true;
+}
+
+void Ephemeris::update_now(const StateVector& states, double t)
+{
+	// If a predictor is expanding we simply check again on the next update
+	std::unique_lock<std::mutex> expand_lock(expand_mtx, std::try_to_lock);
+	if(!expand_lock.owns_lock())
+	{
+		return;
+	}
+
+	bool needs_reset = states.size() != body_count;
+
+	if(!needs_reset)
+	{
+		std::unique_lock<std::shared_mutex> lock(data_mtx);
+		// Drop chunks entirely before t
+		double chunk_span = (double)(settings.knots_per_chunk - 1) * settings.knot_interval;
+		while(chunks.size() > 1 && chunks.front().t0 + chunk_span < t)
+		{
+			chunks.pop_front();
+		}
+
+		// Nothing generated yet, or left behind. Cheap to restart from current states
+		needs_reset = chunks.empty() || t > get_end_time();
+	}
+
+	if(!needs_reset)
+	{
+		StateVector stored;
+		needs_reset = !get_states(t, stored);
+		for(size_t i = 0; i < body_count && !needs_reset; i++)
+		{
+			needs_reset = glm::distance(stored[i].pos, states[i].pos) > settings.resync_distance;
+		}
+	}
+
+	if(needs_reset)
+	{
+		std::unique_lock<std::shared_mutex> lock(data_mtx);
+		reset_locked(states, t);
+	}
+}
+
+std::pair<double, double> Ephemeris::get_range() const
+{
+	std::shared_lock<std::shared_mutex> lock(data_mtx);
+	if(chunks.empty())
+	{
+		return std::make_pair(t_start, t_start);
+	}
+	return std::make_pair(chunks.front().t0, get_end_time());
+}
+
+size_t Ephemeris::get_memory_usage() const
+{
+	std::shared_lock<std::shared_mutex> lock(data_mtx);
+	return chunks.size() * chunk_bytes();
+}
+
+Ephemeris::Ephemeris(const Settings& nsettings)
+{
+	settings = nsettings;
+	body_count = 0;
+	t_start = 0.0;
+	prop_t = 0.0;
+}
@@ -0,0 +1,93 @@
+#pragma once
+#include "../UniverseDefinitions.h"
+#include "../propagator/SystemPropagator.h"
+#include <shared_mutex>
+#include <deque>
+#include <memory>
+
+// Stores the future states of the massive bodies of a system as cubic Hermite
+// segments (position and velocity at evenly spaced knots), so predictors don't
+// need to integrate the whole n-body system each time.
+// It's expanded lazily as predictions reach further ahead, and knots before the
+// current system time are dropped. Reads are thread-safe and can happen while
+// another thread expands the ephemeris.
+class Ephemeris
+{
+public:
+
+	struct Settings
+	{
+		// Time between knots, in seconds
+		double knot_interval = 300.0;
+		// Knots are stored (and generated) in chunks of this many knots
+		size_t knots_per_chunk = 256;
+		// Maximum memory used by the knots, in bytes
+		size_t memory_budget = 64 * 1024 * 1024;
+		// If the system deviates more than this (meters) from the stored
+		// states, the ephemeris is regenerated
+		double resync_distance = 100.0;
+		// Integrator used to generate the knots, see SystemPropagator::create
+		std::string integrator = "dopri54";
+
+		void load(const cpptoml::table& table);
+	};
+
+private:
+
+	struct Chunk
+	{
+		double t0;
+		// knots_per_chunk * body_count states, knot major
+		std::vector<LightCartesianState> states;
+	};
+
+	Settings settings;
+
+	// Protects chunks, masses and t_start
+	mutable std::shared_mutex data_mtx;
+	// Only one thread expands at once, without blocking readers while propagating
+	std::mutex expand_mtx;
+
+	std::deque<Chunk> chunks;
+	std::vector<double> masses;
+	size_t body_count;
+	double t_start;
+
+	// State of the internal propagation, only accessed with expand_mtx held
+	std::unique_ptr<SystemPropagator> propagator;
+	StateVector prop_states;
+	LightStateVector prop_light;
+	TrajectoryVector prop_trj;
+	double prop_t;
+
+	size_t chunk_bytes() const;
+	// Requires both locks
+	void reset_locked(const StateVector& states, double t);
+	// Requires shared or unique lock on data_mtx
+	double get_end_time() const;
+
+public:
+
+	// Discards everything and starts from the given states at time t
+	void reset(const StateVector& states, double t);
+
+	// Generates knots until time t is covered. May be called from any thread,
+	// returns false if the memory budget doesn't allow reaching t, or if t is
+	// before the first stored knot (already dropped)
+	bool ensure(double t);
+
+	// Interpolates all bodies at time t into out (resized as needed)
+	// Returns false if t is not covered, call ensure first
+	bool get_states(double t, StateVector& out) const;
+
+	// Called by the system as time advances: drops knots before t, and
+	// regenerates everything if the real states deviate too much
+	void update_now(const StateVector& states, double t);
+
+	// Time range currently stored
+	std::pair<double, double> get_range() const;
+	size_t get_memory_usage() const;
+	size_t get_body_count() const { return body_count; }
+
+	explicit Ephemeris(const Settings& settings);
+};
@@ -1 +1,224 @@
 #include "OrbitPredictionServer.h"
+#include <util/ThreadUtil.h>
+#include <util/Profiler.h>
+#include <algorithm>
+
+std::vector<OrbitPredictionServer::Job>::iterator OrbitPredictionServer::find_next_job()
+{
+	if(max_jobs_per_frame != 0 && frame_budget == 0)
+	{
+		return pending.end();
+	}
+
+	auto best = pending.end();
+	for(auto it = pending.begin(); it != pending.end(); it++)
+	{
+		// The previous job of this client must finish first
+		if(is_running(it->client))
+		{
+			continue;
+		}
+
+		if(best == pending.end() || it->priority < best->priority ||
+			(it->priority == best->priority && it->order < best->order))
+		{
+			best = it;
+		}
+	}
+
+	return best;
+}
+
+bool OrbitPredictionServer::is_running(const void* client)
+{
+	for(const auto& worker : workers)
+	{
+		if(worker->client == client)
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void OrbitPredictionServer::thread_func(Worker* worker)
+{
+	set_this_thread_name("orbit_pred");
+
+	std::unique_lock<std::mutex> lock(mtx);
+	while(true)
+	{
+		auto it = pending.end();
+		job_cv.wait(lock, [this, &it]()
+		{
+			if(!run)
+			{
+				return true;
+			}
+			it = find_next_job();
+			return it != pending.end();
+		});
+
+		if(!run)
+		{
+			return;
+		}
+
+		JobFunction fn = std::move(it->fn);
+		worker->client = it->client;
+		worker->cancelled = false;
+		pending.erase(it);
+		if(frame_budget > 0)
+		{
+			frame_budget--;
+		}
+
+		lock.unlock();
+		{
+			PROFILE_BLOCK("orbit_prediction");
+			fn(worker->cancelled);
+		}
+		lock.lock();
+
+		worker->client = nullptr;
+		done_cv.notify_all();
+		// A job of the same client may now be started
+		job_cv.notify_all();
+	}
+}
+
+void OrbitPredictionServer::submit(const void* client, Priority priority, JobFunction fn, bool cancel_running)
+{
+	std::unique_lock<std::mutex> lock(mtx);
+
+	pending.erase(std::remove_if(pending.begin(), pending.end(), [client](const Job& job)
+	{
+		return job.client == client;
+	}), pending.end());
+
+	if(cancel_running)
+	{
+		for(auto& worker : workers)
+		{
+			if(worker->client == client)
+			{
+				worker->cancelled = true;
+			}
+		}
+	}
+
+	Job job;
+	job.client = client;
+	job.priority = priority;
+	job.order = next_order++;
+	job.fn = std::move(fn);
+	pending.push_back(std::move(job));
+
+	job_cv.notify_one();
+}
+
+void OrbitPredictionServer::cancel(const void* client, bool wait)
+{
+	std::unique_lock<std::mutex> lock(mtx);
+
+	pending.erase(std::remove_if(pending.begin(), pending.end(), [client](const Job& job)
+	{
+		return job.client == client;
+	}), pending.end());
+
+	for(auto& worker : workers)
+	{
+		if(worker->client == client)
+		{
+			worker->cancelled = true;
+		}
+	}
+
+	if(wait)
+	{
+		done_cv.wait(lock, [this, client](){ return !is_running(client); });
+	}
+}
+
+void OrbitPredictionServer::set_priority(const void* client, Priority priority)
+{
+	std::unique_lock<std::mutex> lock(mtx);
+	for(auto& job : pending)
+	{
+		if(job.client == client)
+		{
+			job.priority = priority;
+		}
+	}
+}
+
+bool OrbitPredictionServer::is_busy(const void* client)
+{
+	std::unique_lock<std::mutex> lock(mtx);
+	if(is_running(client))
+	{
+		return true;
+	}
+
+	return std::any_of(pending.begin(), pending.end(), [client](const Job& job)
+	{
+		return job.client == client;
+	});
+}
+
+void OrbitPredictionServer::update()
+{
+	std::unique_lock<std::mutex> lock(mtx);
+	frame_budget = max_jobs_per_frame;
+	if(!pending.empty())
+	{
+		job_cv.notify_all();
+	}
+}
+
+OrbitPredictionServer::OrbitPredictionServer(size_t thread_count, size_t nmax_jobs_per_frame)
+{
+	next_order = 0;
+	max_jobs_per_frame = nmax_jobs_per_frame;
+	frame_budget = max_jobs_per_frame;
+	run = true;
+
+	thread_count = std::max(thread_count, (size_t)1);
+	for(size_t i = 0; i < thread_count; i++)
+	{
+		auto worker = std::make_unique<Worker>();
+		worker->client = nullptr;
+		worker->cancelled = false;
+		workers.push_back(std::move(worker));
+	}
+
+	// Started once workers is complete, as threads read it
+	for(auto& worker : workers)
+	{
+		Worker* w = worker.get();
+		w->thread = std::thread([this, w](){ thread_func(w); });
+	}
+}
+
+OrbitPredictionServer::~OrbitPredictionServer()
+{
+	{
+		std::unique_lock<std::mutex> lock(mtx);
+		run = false;
+		pending.clear();
+		for(auto& worker : workers)
+		{
+			worker->cancelled = true;
+		}
+		job_cv.notify_all();
+	}
+
+	for(auto& worker : workers)
+	{
+		if(worker->thread.joinable())
+		{
+			worker->thread.join();
+		}
+	}
+}
@@ -1,11 +1,98 @@
 #pragma once
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <vector>
+#include <cstdint>
 
-// Handles prediction of orbits, serializing of them and generating the drawables
-
+// Handles prediction of orbits for every vessel using a fixed pool of worker threads,
+// instead of each predictor running its own thread.
+// Clients (for example QuickPredictor) submit jobs identified by the client pointer.
+// Each client has at most one pending and one running job: submitting again replaces
+// the pending job, as it's stale, and jobs of the same client never run concurrently.
+// Pending jobs are started in order of priority, and at most max_jobs_per_frame are
+// started between two calls to update (called once per frame by the Universe)
+// Jobs must check the cancelled flag every now and then and return early if it's set
 class OrbitPredictionServer
 {
 public:
 
+	enum class Priority
+	{
+		// The vessel the player is controlling
+		FOCUSED = 0,
+		// Vessels visible in the map view / on screen
+		VISIBLE = 1,
+		BACKGROUND = 2
+	};
+
+	using JobFunction = std::function<void(const std::atomic<bool>& cancelled)>;
+
+private:
+
+	struct Job
+	{
+		const void* client;
+		Priority priority;
+		// Submission order, so jobs of equal priority are started first come first served
+		uint64_t order;
+		JobFunction fn;
+	};
+
+	struct Worker
+	{
+		std::thread thread;
+		// Client whose job is running, or nullptr
+		const void* client;
+		std::atomic<bool> cancelled;
+	};
+
+	std::vector<std::unique_ptr<Worker>> workers;
+	std::vector<Job> pending;
+
+	std::mutex mtx;
+	// Wakes up workers when a job may be started
+	std::condition_variable job_cv;
+	// Wakes up cancel() once a job finishes
+	std::condition_variable done_cv;
+
+	uint64_t next_order;
+	// 0 means no limit
+	size_t max_jobs_per_frame;
+	// Jobs that can still be started this frame
+	size_t frame_budget;
+	bool run;
+
+	// Requires mtx, returns pending.end() if nothing can be started now
+	std::vector<Job>::iterator find_next_job();
+	bool is_running(const void* client);
+	void thread_func(Worker* worker);
+
+public:
+
+	// Replaces any pending job of client. The running job, if any, is left to finish
+	// unless cancel_running is true
+	void submit(const void* client, Priority priority, JobFunction fn, bool cancel_running = false);
+
+	// Drops the pending job and cancels the running one. If wait is true, returns once
+	// the running job has returned, so the client can be safely destroyed
+	void cancel(const void* client, bool wait);
+
+	// Changes the priority of the pending job, if any
+	void set_priority(const void* client, Priority priority);
+
+	// True if client has a pending or running job
+	bool is_busy(const void* client);
+
+	// Call once per frame, resets the frame budget
+	void update();
 
+	size_t get_thread_count() const { return workers.size(); }
 
+	// max_jobs_per_frame = 0 means no limit
+	explicit OrbitPredictionServer(size_t thread_count, size_t max_jobs_per_frame = 0);
+	~OrbitPredictionServer();
 };
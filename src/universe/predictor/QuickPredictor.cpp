@@ -1,24 +1,36 @@
 #include "QuickPredictor.h"
-// TODO: Configurable integrator?
 #include "../propagator/RK4Propagator.h"
+#include "../propagator/EphemerisPropagator.h"
+#include <util/Timer.h>
 
 
 QuickPredictor::QuickPredictor(PlanetarySystem* nsys)
 {
 	this->sys = nsys;
 	this->drawer = nullptr;
+	this->integrator = "rk4";
+	this->use_ephemeris = false;
+	this->priority = OrbitPredictionServer::Priority::VISIBLE;
+	this->launched = false;
+	this->server = sys->get_prediction_server();
 }
 
 
 QuickPredictor::~QuickPredictor()
 {
-	stop();
+	mtx.lock();
+	launched = false;
+	mtx.unlock();
+	// Jobs capture this, so drop the pending one and block until the running one
+	// has seen its cancelled flag and returned
+	server->cancel(this, true);
 	delete drawer;
 };
 
-void QuickPredictor::sterm_predict(glm::dvec3 spos, glm::dvec3 svel)
+void QuickPredictor::sterm_predict(glm::dvec3 spos, glm::dvec3 svel, const std::string& integrator_name,
+								   bool sephemeris, const std::atomic<bool>& cancelled)
 {
-	double start_time = glfwGetTime();
+	double start_time = Timer::now();
 	StateVector st;
 	LightStateVector ls;
 	TrajectoryVector tv;
@@ -40,28 +52,45 @@ void QuickPredictor::sterm_predict(glm::dvec3 spos, glm::dvec3 svel)
 	FrameOfReference pred_ref = pred.ref;
 	pred.lock.unlock();
 
-	RK4Propagator prop;
-	prop.bind_to(&st, &ls, &tv);
+	std::unique_ptr<SystemPropagator> prop;
+	if(sephemeris)
+	{
+		prop = std::make_unique<EphemerisPropagator>(sys->get_ephemeris(), t0);
+	}
+	else
+	{
+		prop.reset(SystemPropagator::create(integrator_name));
+	}
+
+	if(!prop)
+	{
+		prop = std::make_unique<RK4Propagator>();
+	}
+	prop->bind_to(&st, &ls, &tv);
 
 	size_t it = 0;
 
 	std::vector<QuickPredictedInterval> intervals;
 	intervals.emplace_back();
 
-	// TODO: Adaptive timestep
-	double tstep = 1.0;
+	// Adaptive integrators take their own substeps, so they are stepped from saved point to saved point
+	double tstep = prop->is_adaptive() ? SAVE_INTERVAL : 1.0;
 	double t = 0.0;
-	double stime = glfwGetTime();
+	double stime = Timer::now();
 	while(true)
 	{
 		tstep = predict_interval(&intervals[intervals.size() - 1], t, t0, t00, tstep, stime,
-								 pred_ref, it, prop, st, ls);
+								 pred_ref, it, *prop, st, ls, cancelled);
 		if(tstep > 0)
 			intervals.emplace_back();
 		else
 			break;
 	}
 
+	if(cancelled)
+	{
+		return;
+	}
 
 
 	pred.lock.lock();
@@ -92,53 +121,60 @@ double QuickPredictor::get_scale()
 
 void QuickPredictor::stop()
 {
-	kill_thread = true;
-	if(thread.joinable())
-		thread.join();
+	mtx.lock();
+	launched = false;
+	mtx.unlock();
+	server->cancel(this, true);
 }
 
 void QuickPredictor::launch()
 {
-	kill_thread = false;
+	mtx.lock();
+	bool was_launched = launched;
+	launched = true;
+	mtx.unlock();
 
-	// Thread is already running?
-	if(thread.joinable())
-		return;
+	if(!was_launched)
+	{
+		submit(false);
+	}
+}
 
-	thread = std::thread([this]()
+void QuickPredictor::submit(bool cancel_running)
+{
+	mtx.lock();
+	OrbitPredictionServer::Priority spriority = priority;
+	mtx.unlock();
+
+	server->submit(this, spriority, [this](const std::atomic<bool>& cancelled)
 	{
-		set_this_thread_name("quick_pred");
-		while(true)
-		{
-			this->mtx.lock();
-			if(this->kill_thread)
-				return;
-			glm::dvec3 spos = this->pos;
-			glm::dvec3 svel = this->vel;
-			this->mtx.unlock();
-			sterm_predict(spos, svel);
-		}
-	});
+		// Inputs are read once the job starts, so they are as fresh as possible
+		this->mtx.lock();
+		glm::dvec3 spos = this->pos;
+		glm::dvec3 svel = this->vel;
+		std::string sintegrator = this->integrator;
+		bool sephemeris = this->use_ephemeris;
+		this->mtx.unlock();
+		sterm_predict(spos, svel, sintegrator, sephemeris, cancelled);
+	}, cancel_running);
 }
 
 double
 QuickPredictor::predict_interval(QuickPredictedInterval* inter, double& t, double sys_t0, double sys_t00, double tstep,
 								 double stime, FrameOfReference ref, size_t& it, SystemPropagator& prop,
-								 StateVector& st, LightStateVector& ls)
+								 StateVector& st, LightStateVector& ls, const std::atomic<bool>& cancelled)
 {
 	const size_t TIME_CHECK_INTERVAL = 10000;
-	// How much in-game time between drawn points?
-	// Useful to avoid sending massive ammount of points to the GPU
-	const double SAVE_INTERVAL = 10.0;
-	size_t save_it = 0;
-	size_t save_interval = SAVE_INTERVAL / tstep;
+	// Points are saved every SAVE_INTERVAL of prediction time, whatever the step is
+	double next_save = t + SAVE_INTERVAL;
 	while(true)
 	{
 		for(; it < TIME_CHECK_INTERVAL; it++)
 		{
 			prop.propagate(tstep);
-			save_it++;
-			if(save_it > save_interval)
+			t += tstep;
+			// Tolerates the rounding of adding many steps
+			if(t >= next_save - tstep * 1e-6)
 			{
 				// Save states
 				auto state = st[ref.center_id];
@@ -147,14 +183,14 @@ QuickPredictor::predict_interval(QuickPredictedInterval* inter, double& t, doubl
 				double body_rot = 0.0;
 				auto npos = ref.get_rel_pos(ls[0].pos, body_pos, body_rot);
 				inter->pred.push_back(npos);
-				save_it = 0;
+				next_save += SAVE_INTERVAL;
 			}
-			t += tstep;
 		}
 
 		it = 0;
-		double time = glfwGetTime();
-		if((quick_predict_timeout > 0 && time - stime > quick_predict_timeout) ||
+		double time = Timer::now();
+		if(cancelled ||
+		   (quick_predict_timeout > 0 && time - stime > quick_predict_timeout) ||
 		   (quick_predict_max_time > 0 && t > quick_predict_max_time))
 		{
 			// Interrupt
@@ -168,13 +204,56 @@ void QuickPredictor::update(glm::dvec3 npos, glm::dvec3 nvel)
 	mtx.lock();
 	this->pos = npos;
 	this->vel = nvel;
+	bool slaunched = launched;
 	mtx.unlock();
+
+	if(slaunched && !server->is_busy(this))
+	{
+		submit(false);
+	}
+
 	if(drawer)
 	{
 		drawer->update();
 	}
 }
 
+void QuickPredictor::set_integrator(const std::string& name)
+{
+	mtx.lock();
+	this->integrator = name;
+	mtx.unlock();
+	invalidate();
+}
+
+void QuickPredictor::set_use_ephemeris(bool value)
+{
+	mtx.lock();
+	this->use_ephemeris = value;
+	mtx.unlock();
+	invalidate();
+}
+
+void QuickPredictor::set_priority(OrbitPredictionServer::Priority npriority)
+{
+	mtx.lock();
+	this->priority = npriority;
+	mtx.unlock();
+	server->set_priority(this, npriority);
+}
+
+void QuickPredictor::invalidate()
+{
+	mtx.lock();
+	bool slaunched = launched;
+	mtx.unlock();
+
+	if(slaunched)
+	{
+		submit(true);
+	}
+}
+
 void QuickPredictor::on_add_to_renderer()
 {
 	// Create the drawer if not present
@@ -5,6 +5,7 @@
 #include "FrameOfReference.h"
 #include "../propagator/SystemPropagator.h"
 #include "PredictionDrawer.h"
+#include "OrbitPredictionServer.h"
 
 
 // Doesn't support new system elements appearing / disappearing during simulation
@@ -46,8 +47,10 @@ public:
 };
 
 // Runs a prediction for an orbit starting at current state of the solar system
-// Each prediction will simulate the whole solar system, this could be greatly
-// improved by caching the solar system state but that would require high memory usage
+// The whole system is integrated alongside the vessel, unless the predictor opts in to
+// reading it from the system's Ephemeris, which is shared by all predictors (see set_use_ephemeris)
+// Predictions run as jobs in the system's OrbitPredictionServer, a new one is
+// submitted from update once the previous one has finished
 // Note: To save on memory velocities are not stored, instead they are calculated from position when needed
 // This is performant because velocity is usually required at a few points, and not over the whole orbit
 class QuickPredictor : public Drawable
@@ -56,22 +59,33 @@ private:
 	PlanetarySystem* sys;
 	PredictionDrawer* drawer;
 	ShortTermPrediction pred;
-	std::thread thread;
+	OrbitPredictionServer* server;
 
 	glm::dvec3 pos, vel;
+	std::string integrator;
+	bool use_ephemeris;
+	OrbitPredictionServer::Priority priority;
 	std::mutex mtx;
-	bool kill_thread;
+	// Between launch and stop
+	bool launched;
 
+	// How much in-game time between drawn points?
+	// Useful to avoid sending massive ammount of points to the GPU
+	static constexpr double SAVE_INTERVAL = 10.0;
 
-	// Runs a short term prediction, called from the thread
-	void sterm_predict(glm::dvec3 pos = glm::dvec3(0, 0, 0),
-					   glm::dvec3 vel = glm::dvec3(0, 0, 0));
+	// Runs a short term prediction, called from a server thread
+	// Results are discarded if cancelled is set before it finishes
+	void sterm_predict(glm::dvec3 pos, glm::dvec3 vel, const std::string& integrator, bool use_ephemeris,
+					   const std::atomic<bool>& cancelled);
 
 	// Returns once a timestep change is needed, with the new value
 	// can also return if interrupt is needed, then return value will be negative
 	double predict_interval(QuickPredictedInterval* inter, double& t, double sys_t0, double sys_t00, double tstep,
 							double stime, FrameOfReference ref, size_t& it, SystemPropagator& prop,
-							StateVector& st, LightStateVector& ls);
+							StateVector& st, LightStateVector& ls, const std::atomic<bool>& cancelled);
+
+	// Submits a prediction job with the latest inputs
+	void submit(bool cancel_running);
 
 public:
 
@@ -99,14 +113,32 @@ public:
 	bool needs_forward_pass() override { return true; }
 	void forward_pass(CameraUniforms& cu, bool is_env_map = false) override;
 
-	// Note: both of these are relatively expensive as the create / destroy the thread
-	// TODO: Pause
+	// Both are cheap, they only submit / cancel jobs in the server
+	// stop waits for the running prediction to be cancelled
 	void launch();
 	void stop();
 
-	// Call every frame, an orbit will only be predicted once the thread interrupts
+	// Call every frame, an orbit will only be predicted once the previous prediction finishes
 	void update(glm::dvec3 pos, glm::dvec3 vel);
 
+	// Any name accepted by SystemPropagator::create. Cancels the running prediction
+	// Adaptive integrators are given a whole SAVE_INTERVAL per step, fixed step ones 1s steps,
+	// points are saved every SAVE_INTERVAL in both cases
+	// Not used while the ephemeris is in use
+	void set_integrator(const std::string& name);
+
+	// If true, only the vessel is integrated (RK4), reading the massive bodies from the system's
+	// shared ephemeris, which is much cheaper. Cancels the running prediction. Defaults to false
+	void set_use_ephemeris(bool value);
+
+	// The focused vessel should use FOCUSED, VISIBLE the ones shown in the map view
+	// Defaults to VISIBLE
+	void set_priority(OrbitPredictionServer::Priority priority);
+
+	// Call if the inputs have changed in a way that makes the running prediction
+	// useless (for example, after switching vessel), it's cancelled and restarted
+	void invalidate();
+
 	explicit QuickPredictor(PlanetarySystem* sys);
 	~QuickPredictor();
 };
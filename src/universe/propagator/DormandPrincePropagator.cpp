@@ -0,0 +1,206 @@
+#include "DormandPrincePropagator.h"
+#include <algorithm>
+
+// Butcher tableau, see Dormand & Prince (1980)
+static constexpr double A[7][6] =
+{
+	{ 0.0, 0.0, 0.0, 0.0, 0.0, 0.0 },
+	{ 1.0 / 5.0, 0.0, 0.0, 0.0, 0.0, 0.0 },
+	{ 3.0 / 40.0, 9.0 / 40.0, 0.0, 0.0, 0.0, 0.0 },
+	{ 44.0 / 45.0, -56.0 / 15.0, 32.0 / 9.0, 0.0, 0.0, 0.0 },
+	{ 19372.0 / 6561.0, -25360.0 / 2187.0, 64448.0 / 6561.0, -212.0 / 729.0, 0.0, 0.0 },
+	{ 9017.0 / 3168.0, -355.0 / 33.0, 46732.0 / 5247.0, 49.0 / 176.0, -5103.0 / 18656.0, 0.0 },
+	{ 35.0 / 384.0, 0.0, 500.0 / 1113.0, 125.0 / 192.0, -2187.0 / 6784.0, 11.0 / 84.0 }
+};
+
+// 5th order weights are the last row of A (First Same As Last)
+static constexpr double B[7] =
+{
+	35.0 / 384.0, 0.0, 500.0 / 1113.0, 125.0 / 192.0, -2187.0 / 6784.0, 11.0 / 84.0, 0.0
+};
+
+// Difference between the 5th and 4th order weights
+static constexpr double E[7] =
+{
+	71.0 / 57600.0, 0.0, -71.0 / 16695.0, 71.0 / 1920.0, -17253.0 / 339200.0, 22.0 / 525.0, -1.0 / 40.0
+};
+
+void DormandPrincePropagator::resize()
+{
+	size_t nsize = st_vector->size();
+	size_t nlsize = lst_vector->size();
+
+	// Masses could change even if size doesn't, so always update them
+	eval.set_masses(*st_vector);
+
+	if(nsize == size && nlsize == lsize)
+	{
+		return;
+	}
+
+	size = nsize;
+	lsize = nlsize;
+	size_t n = size + lsize;
+
+	eval.resize_light(lsize);
+	x0.resize(n); v0.resize(n);
+	xs.resize(n); vs.resize(n);
+	x5.resize(n); v5.resize(n);
+	for(size_t s = 0; s < STAGES; s++)
+	{
+		kx[s].resize(n);
+		kv[s].resize(n);
+	}
+}
+
+double DormandPrincePropagator::step(double dt, ThreadPool* pool)
+{
+	size_t n = size + lsize;
+
+	for(size_t s = 1; s < STAGES; s++)
+	{
+		for(size_t i = 0; i < n; i++)
+		{
+			glm::dvec3 dx = glm::dvec3(0.0);
+			glm::dvec3 dv = glm::dvec3(0.0);
+			for(size_t j = 0; j < s; j++)
+			{
+				dx += A[s][j] * kx[j][i];
+				dv += A[s][j] * kv[j][i];
+			}
+			xs[i] = x0[i] + dt * dx;
+			vs[i] = v0[i] + dt * dv;
+		}
+
+		// Stage 7 is evaluated at the 5th order solution
+		if(s == STAGES - 1)
+		{
+			x5 = xs;
+			v5 = vs;
+		}
+
+		kx[s] = vs;
+		eval.evaluate(xs, kv[s], pool);
+	}
+
+	// Error estimate, RMS over all bodies of the position and velocity errors
+	double err = 0.0;
+	for(size_t i = 0; i < n; i++)
+	{
+		glm::dvec3 ex = glm::dvec3(0.0);
+		glm::dvec3 ev = glm::dvec3(0.0);
+		for(size_t s = 0; s < STAGES; s++)
+		{
+			ex += E[s] * kx[s][i];
+			ev += E[s] * kv[s][i];
+		}
+		ex *= dt;
+		ev *= dt;
+
+		double sx = abs_tolerance + tolerance * std::max(glm::length(x0[i]), glm::length(x5[i]));
+		double sv = abs_tolerance + tolerance * std::max(glm::length(v0[i]), glm::length(v5[i]));
+		double rx = glm::length(ex) / sx;
+		double rv = glm::length(ev) / sv;
+		err += rx * rx + rv * rv;
+	}
+
+	return n == 0 ? 0.0 : glm::sqrt(err / (double)(2 * n));
+}
+
+void DormandPrincePropagator::propagate(double dt)
+{
+	resize();
+
+	size_t n = size + lsize;
+	if(n == 0 || dt <= 0.0)
+	{
+		return;
+	}
+
+	for(size_t i = 0; i < size; i++)
+	{
+		x0[i] = (*st_vector)[i].pos;
+		v0[i] = (*st_vector)[i].vel;
+	}
+
+	for(size_t i = 0; i < lsize; i++)
+	{
+		x0[size + i] = (*lst_vector)[i].pos;
+		v0[size + i] = (*lst_vector)[i].vel;
+	}
+
+	ThreadPool* pool = get_light_pool();
+
+	// States may have been modified from outside since the last call, so the
+	// first stage is always evaluated (afterwards we use First Same As Last)
+	kx[0] = v0;
+	eval.evaluate(x0, kv[0], pool);
+
+	double remaining = dt;
+	while(remaining > 0.0)
+	{
+		double h_wanted = std::min(h, max_step);
+		double h_try = std::min(h_wanted, remaining);
+		// Avoid leaving a tiny step at the end
+		if(remaining - h_try < min_step)
+		{
+			h_try = remaining;
+		}
+		bool shortened = h_try < h_wanted;
+
+		double err = step(h_try, pool);
+
+		if(err <= 1.0 || h_try <= min_step)
+		{
+			accepted_steps++;
+			remaining -= h_try;
+
+			x0.swap(x5);
+			v0.swap(v5);
+			// First Same As Last
+			kx[0].swap(kx[STAGES - 1]);
+			kv[0].swap(kv[STAGES - 1]);
+
+			double factor = err == 0.0 ? 5.0 : 0.9 * glm::pow(err, -0.2);
+			double nh = h_try * std::clamp(factor, 0.2, 5.0);
+			// A step shortened to reach dt says nothing about the step we could take
+			if(shortened && nh < h)
+			{
+				nh = h;
+			}
+			h = std::max(nh, min_step);
+		}
+		else
+		{
+			rejected_steps++;
+			double factor = 0.9 * glm::pow(err, -0.25);
+			h = std::max(h_try * std::clamp(factor, 0.1, 0.9), min_step);
+		}
+	}
+
+	for(size_t i = 0; i < size; i++)
+	{
+		(*st_vector)[i].pos = x0[i];
+		(*st_vector)[i].vel = v0[i];
+	}
+
+	for(size_t i = 0; i < lsize; i++)
+	{
+		(*lst_vector)[i].pos = x0[size + i];
+		(*lst_vector)[i].vel = v0[size + i];
+	}
+}
+
+void DormandPrincePropagator::load(const cpptoml::table& settings)
+{
+	tolerance = settings.get_as<double>("tolerance").value_or(tolerance);
+	abs_tolerance = settings.get_as<double>("abs_tolerance").value_or(abs_tolerance);
+	max_step = settings.get_as<double>("max_step").value_or(max_step);
+}
+
+DormandPrincePropagator::DormandPrincePropagator()
+{
+	size = 0;
+	lsize = 0;
+	h = 1.0;
+}
@@ -0,0 +1,59 @@
+#pragma once
+#include "SystemPropagator.h"
+#include "GravityEvaluator.h"
+#include <array>
+
+// Embedded Runge-Kutta 5(4) (Dormand-Prince) with error control. propagate(dt)
+// takes as many internal steps as needed to reach dt within tolerance, so it can
+// be given big timesteps (ideal for predictions and time-warp). All states share the
+// same step, so a light state in a tight orbit will slow down the whole system.
+// Settings ([propagator] table):
+//	tolerance: Relative tolerance, per body (default 1e-11)
+//	abs_tolerance: Absolute tolerance, in meters and meters per second (default 1e-6)
+//	max_step: Maximum internal step, in seconds (default 3600)
+class DormandPrincePropagator : public SystemPropagator
+{
+private:
+
+	static constexpr size_t STAGES = 7;
+
+	// Attracting states go first, then light states
+	size_t size;
+	size_t lsize;
+
+	GravityEvaluator eval;
+
+	std::vector<glm::dvec3> x0, v0;
+	std::vector<glm::dvec3> xs, vs;
+	std::vector<glm::dvec3> x5, v5;
+	// Stage derivatives, kx is x' (velocity) and kv is v' (acceleration)
+	std::array<std::vector<glm::dvec3>, STAGES> kx, kv;
+
+	// Step suggested by the error controller, kept between calls
+	double h;
+
+	void resize();
+	// Computes the 5th order solution into (x5, v5) and returns the error norm
+	// (<= 1 means the step is acceptable). Uses kx[0], kv[0] as the first stage
+	double step(double dt, ThreadPool* pool);
+
+public:
+
+	double tolerance = 1e-11;
+	double abs_tolerance = 1e-6;
+	double max_step = 3600.0;
+	// Steps smaller than this are always accepted to avoid stalling
+	double min_step = 1e-4;
+
+	// Statistics, useful to measure performance of the integrator
+	uint64_t accepted_steps = 0;
+	uint64_t rejected_steps = 0;
+
+	void propagate(double dt) override;
+	void load(const cpptoml::table& settings) override;
+	std::string get_name() const override { return "dopri54"; }
+	bool is_adaptive() const override { return true; }
+
+	DormandPrincePropagator();
+	~DormandPrincePropagator() override = default;
+};
@@ -0,0 +1,160 @@
+#include "EphemerisPropagator.h"
+#include <algorithm>
+
+void EphemerisPropagator::resize()
+{
+	if(lsize == lst_vector->size() && x0.size() == lsize)
+	{
+		return;
+	}
+
+	lsize = lst_vector->size();
+	lpos.resize(lsize);
+	lacc.resize(lsize);
+	x0.resize(lsize); v0.resize(lsize);
+	xs.resize(lsize); vs.resize(lsize);
+	for(size_t s = 0; s < 4; s++)
+	{
+		kx[s].resize(lsize);
+		kv[s].resize(lsize);
+	}
+}
+
+void EphemerisPropagator::eval_stage(size_t stage, const GravitySoA& bodies, size_t start, size_t end)
+{
+	for(size_t i = start; i < end; i++)
+	{
+		lpos.x[i] = xs[i].x;
+		lpos.y[i] = xs[i].y;
+		lpos.z[i] = xs[i].z;
+	}
+
+	GravityKernel::light_range(lpos, bodies, gm.data(), lacc, start, end, backend);
+
+	for(size_t i = start; i < end; i++)
+	{
+		kx[stage][i] = vs[i];
+		kv[stage][i] = glm::dvec3(lacc.x[i], lacc.y[i], lacc.z[i]);
+	}
+}
+
+void EphemerisPropagator::propagate_light_range(double dt, size_t start, size_t end)
+{
+	// Classic RK4, stages 2 and 3 share the body positions at t + dt / 2
+	static constexpr double STAGE_DT[4] = { 0.0, 0.5, 0.5, 1.0 };
+	static constexpr size_t STAGE_BODIES[4] = { 0, 1, 1, 2 };
+
+	for(size_t i = start; i < end; i++)
+	{
+		x0[i] = (*lst_vector)[i].pos;
+		v0[i] = (*lst_vector)[i].vel;
+	}
+
+	for(size_t s = 0; s < 4; s++)
+	{
+		for(size_t i = start; i < end; i++)
+		{
+			if(s == 0)
+			{
+				xs[i] = x0[i];
+				vs[i] = v0[i];
+			}
+			else
+			{
+				xs[i] = x0[i] + kx[s - 1][i] * (STAGE_DT[s] * dt);
+				vs[i] = v0[i] + kv[s - 1][i] * (STAGE_DT[s] * dt);
+			}
+		}
+
+		eval_stage(s, body_pos[STAGE_BODIES[s]], start, end);
+	}
+
+	double h = dt * (1.0 / 6.0);
+	for(size_t i = start; i < end; i++)
+	{
+		(*lst_vector)[i].pos = x0[i] + h * (kx[0][i] + 2.0 * kx[1][i] + 2.0 * kx[2][i] + kx[3][i]);
+		(*lst_vector)[i].vel = v0[i] + h * (kv[0][i] + 2.0 * kv[1][i] + 2.0 * kv[2][i] + kv[3][i]);
+	}
+}
+
+void EphemerisPropagator::start_fallback()
+{
+	// From now on we integrate everything, starting from the last interpolated states
+	fallback = std::make_unique<RK4Propagator>();
+	fallback->set_light_threads(light_threads);
+	fallback->bind_to(st_vector, lst_vector, trj_vector);
+}
+
+void EphemerisPropagator::propagate(double dt)
+{
+	if(!fallback && !ephemeris->ensure(t + dt))
+	{
+		start_fallback();
+	}
+
+	if(!fallback)
+	{
+		// The system may drop the start of the ephemeris (or regenerate it) at any time
+		double times[3] = { t, t + dt * 0.5, t + dt };
+		for(size_t k = 0; k < 3; k++)
+		{
+			if(!ephemeris->get_states(times[k], body_states[k]))
+			{
+				start_fallback();
+				break;
+			}
+		}
+	}
+
+	if(fallback)
+	{
+		fallback->propagate(dt);
+		t += dt;
+		return;
+	}
+
+	resize();
+
+	for(size_t k = 0; k < 3; k++)
+	{
+		size_t size = body_states[k].size();
+		body_pos[k].resize(size);
+		for(size_t i = 0; i < size; i++)
+		{
+			body_pos[k].x[i] = body_states[k][i].pos.x;
+			body_pos[k].y[i] = body_states[k][i].pos.y;
+			body_pos[k].z[i] = body_states[k][i].pos.z;
+		}
+	}
+
+	gm.resize(body_states[0].size());
+	for(size_t i = 0; i < gm.size(); i++)
+	{
+		gm[i] = G * body_states[0][i].mass;
+	}
+
+	size_t chunks = (lsize + LIGHT_CHUNK - 1) / LIGHT_CHUNK;
+	ThreadPool* pool = get_light_pool();
+	if(pool && chunks > 1)
+	{
+		pool->parallel_for(chunks, [this, dt](size_t chunk)
+		{
+			size_t start = chunk * LIGHT_CHUNK;
+			propagate_light_range(dt, start, std::min(start + LIGHT_CHUNK, lsize));
+		});
+	}
+	else
+	{
+		propagate_light_range(dt, 0, lsize);
+	}
+
+	*st_vector = body_states[2];
+	t += dt;
+}
+
+EphemerisPropagator::EphemerisPropagator(Ephemeris* neph, double nt)
+{
+	ephemeris = neph;
+	t = nt;
+	lsize = 0;
+}
@@ -0,0 +1,54 @@
+#pragma once
+#include "SystemPropagator.h"
+#include "GravityKernel.h"
+#include "RK4Propagator.h"
+#include "../predictor/Ephemeris.h"
+#include <array>
+
+// Propagates only the light states (RK4), reading the massive bodies from a shared
+// Ephemeris instead of integrating them. Massive states are overwritten with the
+// interpolated ones after each step, so users can read them as usual.
+// If the ephemeris can't cover a step (memory budget, or the system dropped the
+// knots we needed), it falls back to integrating the whole system with RK4
+class EphemerisPropagator : public SystemPropagator
+{
+private:
+
+	Ephemeris* ephemeris;
+	double t;
+
+	size_t lsize;
+	std::vector<double> gm;
+	// Bodies at t, t + dt / 2 and t + dt
+	std::array<StateVector, 3> body_states;
+	std::array<GravitySoA, 3> body_pos;
+
+	GravitySoA lpos;
+	GravitySoA lacc;
+	std::vector<glm::dvec3> x0, v0, xs, vs;
+	std::array<std::vector<glm::dvec3>, 4> kx, kv;
+
+	std::unique_ptr<RK4Propagator> fallback;
+
+	void resize();
+	void start_fallback();
+	// Evaluates stage derivatives for light states in [start, end)
+	void eval_stage(size_t stage, const GravitySoA& bodies, size_t start, size_t end);
+	void propagate_light_range(double dt, size_t start, size_t end);
+
+public:
+
+	GravityKernel::Backend backend = GravityKernel::get_best_backend();
+
+	static constexpr size_t LIGHT_CHUNK = 64;
+
+	void propagate(double dt) override;
+	std::string get_name() const override { return "ephemeris"; }
+
+	// Returns true if the ephemeris was too short and we are now integrating everything
+	bool is_using_fallback() const { return fallback != nullptr; }
+
+	// t is the system time of the states that will be bound
+	EphemerisPropagator(Ephemeris* ephemeris, double t);
+	~EphemerisPropagator() override = default;
+};
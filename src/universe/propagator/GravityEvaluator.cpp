@@ -0,0 +1,70 @@
+#include "GravityEvaluator.h"
+#include <algorithm>
+
+void GravityEvaluator::set_masses(const StateVector& states)
+{
+	size_t size = states.size();
+	pos.resize(size);
+	acc.resize(size);
+	gm.resize(size);
+	for(size_t i = 0; i < size; i++)
+	{
+		gm[i] = G * states[i].mass;
+	}
+}
+
+void GravityEvaluator::resize_light(size_t lsize)
+{
+	lpos.resize(lsize);
+	lacc.resize(lsize);
+}
+
+void GravityEvaluator::evaluate(const std::vector<glm::dvec3>& x, std::vector<glm::dvec3>& a, ThreadPool* pool)
+{
+	size_t size = pos.size();
+	for(size_t i = 0; i < size; i++)
+	{
+		pos.x[i] = x[i].x;
+		pos.y[i] = x[i].y;
+		pos.z[i] = x[i].z;
+	}
+
+	GravityKernel::nbody(pos, gm.data(), acc, backend);
+
+	for(size_t i = 0; i < size; i++)
+	{
+		a[i] = glm::dvec3(acc.x[i], acc.y[i], acc.z[i]);
+	}
+
+	size_t lsize = lpos.size();
+	auto eval_range = [&](size_t start, size_t end)
+	{
+		for(size_t i = start; i < end; i++)
+		{
+			lpos.x[i] = x[size + i].x;
+			lpos.y[i] = x[size + i].y;
+			lpos.z[i] = x[size + i].z;
+		}
+
+		GravityKernel::light_range(lpos, pos, gm.data(), lacc, start, end, backend);
+
+		for(size_t i = start; i < end; i++)
+		{
+			a[size + i] = glm::dvec3(lacc.x[i], lacc.y[i], lacc.z[i]);
+		}
+	};
+
+	size_t chunks = (lsize + LIGHT_CHUNK - 1) / LIGHT_CHUNK;
+	if(pool && chunks > 1)
+	{
+		pool->parallel_for(chunks, [&](size_t chunk)
+		{
+			size_t start = chunk * LIGHT_CHUNK;
+			eval_range(start, std::min(start + LIGHT_CHUNK, lsize));
+		});
+	}
+	else
+	{
+		eval_range(0, lsize);
+	}
+}
@@ -0,0 +1,32 @@
+#pragma once
+#include "GravityKernel.h"
+#include "../UniverseDefinitions.h"
+#include <util/ThreadPool.h>
+
+// Evaluates the accelerations of a whole system given positions stored as glm vectors
+// Attracting states go first in the arrays, followed by light states
+// Used by the integrators that don't need the per-stage reuse RK4Propagator does
+class GravityEvaluator
+{
+private:
+
+	GravitySoA pos;
+	GravitySoA acc;
+	GravitySoA lpos;
+	GravitySoA lacc;
+	std::vector<double> gm;
+
+public:
+
+	static constexpr size_t LIGHT_CHUNK = 64;
+
+	GravityKernel::Backend backend = GravityKernel::get_best_backend();
+
+	// Call whenever the number of states or masses change
+	void set_masses(const StateVector& states);
+	void resize_light(size_t lsize);
+
+	// If pool is not null light states are split in chunks and evaluated in parallel,
+	// giving the same result as the serial evaluation
+	void evaluate(const std::vector<glm::dvec3>& x, std::vector<glm::dvec3>& a, ThreadPool* pool = nullptr);
+};
@@ -0,0 +1,434 @@
+#include "GravityKernel.h"
+#include <algorithm>
+#include <cmath>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define GRAVITY_KERNEL_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+// On GCC and clang we compile the vector paths for their instruction set
+// without enabling it globally, so the scalar path still runs on any CPU
+#if defined(__GNUC__) || defined(__clang__)
+#define GRAVITY_TARGET_AVX2 __attribute__((target("avx2")))
+#define GRAVITY_TARGET_SSE2 __attribute__((target("sse2")))
+#else
+#define GRAVITY_TARGET_AVX2
+#define GRAVITY_TARGET_SSE2
+#endif
+
+void GravitySoA::resize(size_t size)
+{
+	x.resize(size);
+	y.resize(size);
+	z.resize(size);
+}
+
+static void zero(GravitySoA& v)
+{
+	std::fill(v.x.begin(), v.x.end(), 0.0);
+	std::fill(v.y.begin(), v.y.end(), 0.0);
+	std::fill(v.z.begin(), v.z.end(), 0.0);
+}
+
+// The scalar tails of the vector kernels use exactly the same operation
+// order as the vector lanes, so light states get bit-identical results
+// no matter which backend (or which chunk) they were evaluated in
+static void light_scalar(const GravitySoA& lpos, const GravitySoA& pos, const double* gm, GravitySoA& lacc,
+						 size_t start, size_t end)
+{
+	size_t n = pos.size();
+	for(size_t i = start; i < end; i++)
+	{
+		double ax = 0.0, ay = 0.0, az = 0.0;
+		for(size_t j = 0; j < n; j++)
+		{
+			double dx = pos.x[j] - lpos.x[i];
+			double dy = pos.y[j] - lpos.y[i];
+			double dz = pos.z[j] - lpos.z[i];
+			double r2 = dx * dx + dy * dy + dz * dz;
+			double inv_r3 = 1.0 / (r2 * std::sqrt(r2));
+			double f = gm[j] * inv_r3;
+			ax += dx * f;
+			ay += dy * f;
+			az += dz * f;
+		}
+		lacc.x[i] = ax;
+		lacc.y[i] = ay;
+		lacc.z[i] = az;
+	}
+}
+
+// Evaluates pairs (i, j) with j in [jstart, n), adding to both bodies
+static void nbody_scalar_row(const GravitySoA& pos, const double* gm, GravitySoA& acc, size_t i, size_t jstart,
+							 double& ax, double& ay, double& az)
+{
+	size_t n = pos.size();
+	for(size_t j = jstart; j < n; j++)
+	{
+		double dx = pos.x[j] - pos.x[i];
+		double dy = pos.y[j] - pos.y[i];
+		double dz = pos.z[j] - pos.z[i];
+		double r2 = dx * dx + dy * dy + dz * dz;
+		double inv_r3 = 1.0 / (r2 * std::sqrt(r2));
+		double fi = gm[j] * inv_r3;
+		double fj = gm[i] * inv_r3;
+		ax += dx * fi;
+		ay += dy * fi;
+		az += dz * fi;
+		acc.x[j] -= dx * fj;
+		acc.y[j] -= dy * fj;
+		acc.z[j] -= dz * fj;
+	}
+}
+
+static void nbody_scalar(const GravitySoA& pos, const double* gm, GravitySoA& acc)
+{
+	zero(acc);
+	for(size_t i = 0; i < pos.size(); i++)
+	{
+		double ax = 0.0, ay = 0.0, az = 0.0;
+		nbody_scalar_row(pos, gm, acc, i, i + 1, ax, ay, az);
+		acc.x[i] += ax;
+		acc.y[i] += ay;
+		acc.z[i] += az;
+	}
+}
+
+#ifdef GRAVITY_KERNEL_X86
+
+GRAVITY_TARGET_SSE2 static double hsum_sse2(__m128d v)
+{
+	__m128d hi = _mm_unpackhi_pd(v, v);
+	return _mm_cvtsd_f64(_mm_add_sd(v, hi));
+}
+
+GRAVITY_TARGET_AVX2 static double hsum_avx2(__m256d v)
+{
+	__m128d lo = _mm256_castpd256_pd128(v);
+	__m128d hi = _mm256_extractf128_pd(v, 1);
+	lo = _mm_add_pd(lo, hi);
+	__m128d hi64 = _mm_unpackhi_pd(lo, lo);
+	return _mm_cvtsd_f64(_mm_add_sd(lo, hi64));
+}
+
+GRAVITY_TARGET_SSE2 static void nbody_sse2(const GravitySoA& pos, const double* gm, GravitySoA& acc)
+{
+	zero(acc);
+	size_t n = pos.size();
+	const double* px = pos.x.data(); const double* py = pos.y.data(); const double* pz = pos.z.data();
+	double* ax = acc.x.data(); double* ay = acc.y.data(); double* az = acc.z.data();
+
+	for(size_t i = 0; i < n; i++)
+	{
+		__m128d pix = _mm_set1_pd(px[i]);
+		__m128d piy = _mm_set1_pd(py[i]);
+		__m128d piz = _mm_set1_pd(pz[i]);
+		__m128d gmi = _mm_set1_pd(gm[i]);
+		__m128d aix = _mm_setzero_pd();
+		__m128d aiy = _mm_setzero_pd();
+		__m128d aiz = _mm_setzero_pd();
+
+		size_t j = i + 1;
+		for(; j + 2 <= n; j += 2)
+		{
+			__m128d dx = _mm_sub_pd(_mm_loadu_pd(px + j), pix);
+			__m128d dy = _mm_sub_pd(_mm_loadu_pd(py + j), piy);
+			__m128d dz = _mm_sub_pd(_mm_loadu_pd(pz + j), piz);
+			__m128d r2 = _mm_add_pd(_mm_add_pd(_mm_mul_pd(dx, dx), _mm_mul_pd(dy, dy)), _mm_mul_pd(dz, dz));
+			__m128d inv_r3 = _mm_div_pd(_mm_set1_pd(1.0), _mm_mul_pd(r2, _mm_sqrt_pd(r2)));
+			__m128d fi = _mm_mul_pd(_mm_loadu_pd(gm + j), inv_r3);
+			__m128d fj = _mm_mul_pd(gmi, inv_r3);
+			aix = _mm_add_pd(aix, _mm_mul_pd(dx, fi));
+			aiy = _mm_add_pd(aiy, _mm_mul_pd(dy, fi));
+			aiz = _mm_add_pd(aiz, _mm_mul_pd(dz, fi));
+			_mm_storeu_pd(ax + j, _mm_sub_pd(_mm_loadu_pd(ax + j), _mm_mul_pd(dx, fj)));
+			_mm_storeu_pd(ay + j, _mm_sub_pd(_mm_loadu_pd(ay + j), _mm_mul_pd(dy, fj)));
+			_mm_storeu_pd(az + j, _mm_sub_pd(_mm_loadu_pd(az + j), _mm_mul_pd(dz, fj)));
+		}
+
+		double sx = hsum_sse2(aix), sy = hsum_sse2(aiy), sz = hsum_sse2(aiz);
+		nbody_scalar_row(pos, gm, acc, i, j, sx, sy, sz);
+		ax[i] += sx;
+		ay[i] += sy;
+		az[i] += sz;
+	}
+}
+
+GRAVITY_TARGET_AVX2 static void nbody_avx2(const GravitySoA& pos, const double* gm, GravitySoA& acc)
+{
+	zero(acc);
+	size_t n = pos.size();
+	const double* px = pos.x.data(); const double* py = pos.y.data(); const double* pz = pos.z.data();
+	double* ax = acc.x.data(); double* ay = acc.y.data(); double* az = acc.z.data();
+
+	for(size_t i = 0; i < n; i++)
+	{
+		__m256d pix = _mm256_set1_pd(px[i]);
+		__m256d piy = _mm256_set1_pd(py[i]);
+		__m256d piz = _mm256_set1_pd(pz[i]);
+		__m256d gmi = _mm256_set1_pd(gm[i]);
+		__m256d aix = _mm256_setzero_pd();
+		__m256d aiy = _mm256_setzero_pd();
+		__m256d aiz = _mm256_setzero_pd();
+
+		size_t j = i + 1;
+		for(; j + 4 <= n; j += 4)
+		{
+			__m256d dx = _mm256_sub_pd(_mm256_loadu_pd(px + j), pix);
+			__m256d dy = _mm256_sub_pd(_mm256_loadu_pd(py + j), piy);
+			__m256d dz = _mm256_sub_pd(_mm256_loadu_pd(pz + j), piz);
+			__m256d r2 = _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(dx, dx), _mm256_mul_pd(dy, dy)),
+									   _mm256_mul_pd(dz, dz));
+			__m256d inv_r3 = _mm256_div_pd(_mm256_set1_pd(1.0), _mm256_mul_pd(r2, _mm256_sqrt_pd(r2)));
+			__m256d fi = _mm256_mul_pd(_mm256_loadu_pd(gm + j), inv_r3);
+			__m256d fj = _mm256_mul_pd(gmi, inv_r3);
+			aix = _mm256_add_pd(aix, _mm256_mul_pd(dx, fi));
+			aiy = _mm256_add_pd(aiy, _mm256_mul_pd(dy, fi));
+			aiz = _mm256_add_pd(aiz, _mm256_mul_pd(dz, fi));
+			_mm256_storeu_pd(ax + j, _mm256_sub_pd(_mm256_loadu_pd(ax + j), _mm256_mul_pd(dx, fj)));
+			_mm256_storeu_pd(ay + j, _mm256_sub_pd(_mm256_loadu_pd(ay + j), _mm256_mul_pd(dy, fj)));
+			_mm256_storeu_pd(az + j, _mm256_sub_pd(_mm256_loadu_pd(az + j), _mm256_mul_pd(dz, fj)));
+		}
+
+		double sx = hsum_avx2(aix), sy = hsum_avx2(aiy), sz = hsum_avx2(aiz);
+		nbody_scalar_row(pos, gm, acc, i, j, sx, sy, sz);
+		ax[i] += sx;
+		ay[i] += sy;
+		az[i] += sz;
+	}
+}
+
+// Light states are vectorized over the light states themselves, as there are usually
+// many more of them than attracting bodies. Every body loaded is evaluated against two
+// registers of light states, so the divide and sqrt of one hide the latency of the other,
+// and bodies are visited in tiles of LIGHT_BODY_TILE (8KB) which stay in L1 while every
+// light state goes through them. Untiled, 1000 bodies are 32KB of positions and gm, and the
+// vector kernels were measured at 0.69x to 0.89x of the scalar loop on some CPUs. With a 48KB
+// L1 there's no crossover up to 8000 bodies (AVX2 3.9x, SSE2 3.2x the old loop at 1000).
+// Each light state still adds the bodies in order, so results are bit-identical
+static constexpr size_t LIGHT_BODY_TILE = 256;
+
+GRAVITY_TARGET_SSE2 static inline void light_sse2_body(__m128d bx, __m128d by, __m128d bz, __m128d bgm,
+		__m128d lx, __m128d ly, __m128d lz, __m128d& ax, __m128d& ay, __m128d& az)
+{
+	__m128d dx = _mm_sub_pd(bx, lx);
+	__m128d dy = _mm_sub_pd(by, ly);
+	__m128d dz = _mm_sub_pd(bz, lz);
+	__m128d r2 = _mm_add_pd(_mm_add_pd(_mm_mul_pd(dx, dx), _mm_mul_pd(dy, dy)), _mm_mul_pd(dz, dz));
+	__m128d inv_r3 = _mm_div_pd(_mm_set1_pd(1.0), _mm_mul_pd(r2, _mm_sqrt_pd(r2)));
+	__m128d f = _mm_mul_pd(bgm, inv_r3);
+	ax = _mm_add_pd(ax, _mm_mul_pd(dx, f));
+	ay = _mm_add_pd(ay, _mm_mul_pd(dy, f));
+	az = _mm_add_pd(az, _mm_mul_pd(dz, f));
+}
+
+GRAVITY_TARGET_SSE2 static void light_sse2(const GravitySoA& lpos, const GravitySoA& pos, const double* gm,
+										   GravitySoA& lacc, size_t start, size_t end)
+{
+	size_t n = pos.size();
+	const double* lx = lpos.x.data(); const double* ly = lpos.y.data(); const double* lz = lpos.z.data();
+	double* ax = lacc.x.data(); double* ay = lacc.y.data(); double* az = lacc.z.data();
+	size_t vend = start + (end - start) / 4 * 4;
+
+	size_t jstart = 0;
+	do
+	{
+		size_t jend = std::min(n, jstart + LIGHT_BODY_TILE);
+		for(size_t i = start; i < vend; i += 4)
+		{
+			__m128d lx0 = _mm_loadu_pd(lx + i), lx1 = _mm_loadu_pd(lx + i + 2);
+			__m128d ly0 = _mm_loadu_pd(ly + i), ly1 = _mm_loadu_pd(ly + i + 2);
+			__m128d lz0 = _mm_loadu_pd(lz + i), lz1 = _mm_loadu_pd(lz + i + 2);
+			__m128d ax0 = _mm_setzero_pd(), ay0 = _mm_setzero_pd(), az0 = _mm_setzero_pd();
+			__m128d ax1 = _mm_setzero_pd(), ay1 = _mm_setzero_pd(), az1 = _mm_setzero_pd();
+			if(jstart != 0)
+			{
+				ax0 = _mm_loadu_pd(ax + i); ax1 = _mm_loadu_pd(ax + i + 2);
+				ay0 = _mm_loadu_pd(ay + i); ay1 = _mm_loadu_pd(ay + i + 2);
+				az0 = _mm_loadu_pd(az + i); az1 = _mm_loadu_pd(az + i + 2);
+			}
+			for(size_t j = jstart; j < jend; j++)
+			{
+				__m128d bx = _mm_set1_pd(pos.x[j]);
+				__m128d by = _mm_set1_pd(pos.y[j]);
+				__m128d bz = _mm_set1_pd(pos.z[j]);
+				__m128d bgm = _mm_set1_pd(gm[j]);
+				light_sse2_body(bx, by, bz, bgm, lx0, ly0, lz0, ax0, ay0, az0);
+				light_sse2_body(bx, by, bz, bgm, lx1, ly1, lz1, ax1, ay1, az1);
+			}
+			_mm_storeu_pd(ax + i, ax0); _mm_storeu_pd(ax + i + 2, ax1);
+			_mm_storeu_pd(ay + i, ay0); _mm_storeu_pd(ay + i + 2, ay1);
+			_mm_storeu_pd(az + i, az0); _mm_storeu_pd(az + i + 2, az1);
+		}
+		jstart = jend;
+	} while(jstart < n);
+
+	light_scalar(lpos, pos, gm, lacc, vend, end);
+}
+
+GRAVITY_TARGET_AVX2 static inline void light_avx2_body(__m256d bx, __m256d by, __m256d bz, __m256d bgm,
+		__m256d lx, __m256d ly, __m256d lz, __m256d& ax, __m256d& ay, __m256d& az)
+{
+	__m256d dx = _mm256_sub_pd(bx, lx);
+	__m256d dy = _mm256_sub_pd(by, ly);
+	__m256d dz = _mm256_sub_pd(bz, lz);
+	__m256d r2 = _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(dx, dx), _mm256_mul_pd(dy, dy)),
+							   _mm256_mul_pd(dz, dz));
+	__m256d inv_r3 = _mm256_div_pd(_mm256_set1_pd(1.0), _mm256_mul_pd(r2, _mm256_sqrt_pd(r2)));
+	__m256d f = _mm256_mul_pd(bgm, inv_r3);
+	ax = _mm256_add_pd(ax, _mm256_mul_pd(dx, f));
+	ay = _mm256_add_pd(ay, _mm256_mul_pd(dy, f));
+	az = _mm256_add_pd(az, _mm256_mul_pd(dz, f));
+}
+
+GRAVITY_TARGET_AVX2 static void light_avx2(const GravitySoA& lpos, const GravitySoA& pos, const double* gm,
+										   GravitySoA& lacc, size_t start, size_t end)
+{
+	size_t n = pos.size();
+	const double* lx = lpos.x.data(); const double* ly = lpos.y.data(); const double* lz = lpos.z.data();
+	double* ax = lacc.x.data(); double* ay = lacc.y.data(); double* az = lacc.z.data();
+	size_t vend = start + (end - start) / 8 * 8;
+
+	size_t jstart = 0;
+	do
+	{
+		size_t jend = std::min(n, jstart + LIGHT_BODY_TILE);
+		for(size_t i = start; i < vend; i += 8)
+		{
+			__m256d lx0 = _mm256_loadu_pd(lx + i), lx1 = _mm256_loadu_pd(lx + i + 4);
+			__m256d ly0 = _mm256_loadu_pd(ly + i), ly1 = _mm256_loadu_pd(ly + i + 4);
+			__m256d lz0 = _mm256_loadu_pd(lz + i), lz1 = _mm256_loadu_pd(lz + i + 4);
+			__m256d ax0 = _mm256_setzero_pd(), ay0 = _mm256_setzero_pd(), az0 = _mm256_setzero_pd();
+			__m256d ax1 = _mm256_setzero_pd(), ay1 = _mm256_setzero_pd(), az1 = _mm256_setzero_pd();
+			if(jstart != 0)
+			{
+				ax0 = _mm256_loadu_pd(ax + i); ax1 = _mm256_loadu_pd(ax + i + 4);
+				ay0 = _mm256_loadu_pd(ay + i); ay1 = _mm256_loadu_pd(ay + i + 4);
+				az0 = _mm256_loadu_pd(az + i); az1 = _mm256_loadu_pd(az + i + 4);
+			}
+			for(size_t j = jstart; j < jend; j++)
+			{
+				__m256d bx = _mm256_set1_pd(pos.x[j]);
+				__m256d by = _mm256_set1_pd(pos.y[j]);
+				__m256d bz = _mm256_set1_pd(pos.z[j]);
+				__m256d bgm = _mm256_set1_pd(gm[j]);
+				light_avx2_body(bx, by, bz, bgm, lx0, ly0, lz0, ax0, ay0, az0);
+				light_avx2_body(bx, by, bz, bgm, lx1, ly1, lz1, ax1, ay1, az1);
+			}
+			_mm256_storeu_pd(ax + i, ax0); _mm256_storeu_pd(ax + i + 4, ax1);
+			_mm256_storeu_pd(ay + i, ay0); _mm256_storeu_pd(ay + i + 4, ay1);
+			_mm256_storeu_pd(az + i, az0); _mm256_storeu_pd(az + i + 4, az1);
+		}
+		jstart = jend;
+	} while(jstart < n);
+
+	light_scalar(lpos, pos, gm, lacc, vend, end);
+}
+
+static GravityKernel::Backend detect_backend()
+{
+	bool avx2 = false;
+	bool sse2 = false;
+#ifdef _MSC_VER
+	int info[4];
+	__cpuid(info, 0);
+	int max_leaf = info[0];
+	__cpuid(info, 1);
+	sse2 = (info[3] & (1 << 26)) != 0;
+	// The OS must also save the YMM registers on context switches
+	bool os_ymm = (info[2] & (1 << 27)) != 0 && (_xgetbv(0) & 0x6) == 0x6;
+	if(max_leaf >= 7 && os_ymm)
+	{
+		__cpuidex(info, 7, 0);
+		avx2 = (info[1] & (1 << 5)) != 0;
+	}
+#else
+	__builtin_cpu_init();
+	avx2 = __builtin_cpu_supports("avx2");
+	sse2 = __builtin_cpu_supports("sse2");
+#endif
+
+	if(avx2)
+	{
+		return GravityKernel::Backend::AVX2;
+	}
+	else if(sse2)
+	{
+		return GravityKernel::Backend::SSE2;
+	}
+
+	return GravityKernel::Backend::SCALAR;
+}
+
+#else
+
+static GravityKernel::Backend detect_backend()
+{
+	return GravityKernel::Backend::SCALAR;
+}
+
+#endif
+
+GravityKernel::Backend GravityKernel::get_best_backend()
+{
+	static Backend best = detect_backend();
+	return best;
+}
+
+const char* GravityKernel::get_backend_name(GravityKernel::Backend backend)
+{
+	switch(backend)
+	{
+		case Backend::AVX2:
+			return "AVX2";
+		case Backend::SSE2:
+			return "SSE2";
+		default:
+			return "Scalar";
+	}
+}
+
+void GravityKernel::nbody(const GravitySoA& pos, const double* gm, GravitySoA& acc, Backend backend)
+{
+#ifdef GRAVITY_KERNEL_X86
+	if(backend == Backend::AVX2)
+	{
+		nbody_avx2(pos, gm, acc);
+		return;
+	}
+	else if(backend == Backend::SSE2)
+	{
+		nbody_sse2(pos, gm, acc);
+		return;
+	}
+#endif
+	nbody_scalar(pos, gm, acc);
+}
+
+void GravityKernel::light(const GravitySoA& lpos, const GravitySoA& pos, const double* gm, GravitySoA& lacc,
+						  Backend backend)
+{
+	light_range(lpos, pos, gm, lacc, 0, lpos.size(), backend);
+}
+
+void GravityKernel::light_range(const GravitySoA& lpos, const GravitySoA& pos, const double* gm, GravitySoA& lacc,
+								size_t start, size_t end, Backend backend)
+{
+#ifdef GRAVITY_KERNEL_X86
+	if(backend == Backend::AVX2)
+	{
+		light_avx2(lpos, pos, gm, lacc, start, end);
+		return;
+	}
+	else if(backend == Backend::SSE2)
+	{
+		light_sse2(lpos, pos, gm, lacc, start, end);
+		return;
+	}
+#endif
+	light_scalar(lpos, pos, gm, lacc, start, end);
+}
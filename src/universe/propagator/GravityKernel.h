@@ -0,0 +1,48 @@
+#pragma once
+#include <vector>
+#include <cstddef>
+
+// Structure-of-arrays storage for 3D vectors, used by the gravity kernels so
+// that several bodies can be loaded into a single SIMD register
+struct GravitySoA
+{
+	std::vector<double> x;
+	std::vector<double> y;
+	std::vector<double> z;
+
+	void resize(size_t size);
+	size_t size() const { return x.size(); }
+};
+
+// Evaluates gravitational accelerations over SoA data. The best available
+// instruction set is detected at runtime, with a scalar fallback that works
+// everywhere. Masses are given premultiplied by G (gm = G * mass)
+class GravityKernel
+{
+public:
+
+	enum class Backend
+	{
+		SCALAR,
+		SSE2,
+		AVX2
+	};
+
+	// Detected once, the best backend the running CPU supports
+	static Backend get_best_backend();
+	static const char* get_backend_name(Backend backend);
+
+	// Accelerations between attracting bodies. Each pair is only evaluated once
+	// as gravity is symmetric. acc must have the same size as pos
+	static void nbody(const GravitySoA& pos, const double* gm, GravitySoA& acc,
+					  Backend backend = get_best_backend());
+
+	// Accelerations caused by attracting bodies (pos) on non-attracting bodies (lpos)
+	// lacc must have the same size as lpos
+	static void light(const GravitySoA& lpos, const GravitySoA& pos, const double* gm, GravitySoA& lacc,
+					  Backend backend = get_best_backend());
+
+	// Same as light, but only for lights in range [start, end)
+	static void light_range(const GravitySoA& lpos, const GravitySoA& pos, const double* gm, GravitySoA& lacc,
+							size_t start, size_t end, Backend backend = get_best_backend());
+};
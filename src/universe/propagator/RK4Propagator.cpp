@@ -1,54 +1,49 @@
 #include "RK4Propagator.h"
+#include "../kepler/KeplerElements.h"
+#include <algorithm>
+#include <limits>
 
-void RK4Propagator::f(SolVec *target, const SolVec& eval_p)
+void RK4Propagator::f(SolVec *target, const SolVec& eval_p, size_t stage)
 {
 	// target is (x', v')
 	// eval_p is (x, v)
 	// so that x' = v, v' = accelerations(x)
-
-	// Evaluates accelerations(x) into v'
-	// TODO: Easy optimization, gravity is symmetric!
+	GravitySoA& pos = stage_pos[stage];
 	for(size_t i = 0; i < size; i++)
 	{
-		(*target)[i].second = glm::dvec3(0, 0, 0);
-		for(size_t j = 0; j < size; j++)
-		{
-			if(i == j)
-				continue;
-
-			double mass_j = masses[j];
-			glm::dvec3 diff = eval_p[j].first - eval_p[i].first;
-			double dist2 = glm::length2(diff);
+		pos.x[i] = eval_p[i].first.x;
+		pos.y[i] = eval_p[i].first.y;
+		pos.z[i] = eval_p[i].first.z;
+	}
 
-			glm::dvec3 diffn = diff / glm::sqrt(dist2);
-			double am = (G * mass_j) / dist2;
-			(*target)[i].second += diffn * am;
-		}
+	// Evaluates accelerations(x) into v'
+	GravityKernel::nbody(pos, gm.data(), acc, backend);
 
+	for(size_t i = 0; i < size; i++)
+	{
+		(*target)[i].second = glm::dvec3(acc.x[i], acc.y[i], acc.z[i]);
 		// Evaluates v into x' (integrate velocity)
 		(*target)[i].first = eval_p[i].second;
 	}
 }
 
-void RK4Propagator::fl(SolVec* target, const SolVec& light_p, const SolVec& eval_p)
+void RK4Propagator::fl(SolVec* target, const SolVec& light_p, size_t stage, size_t start, size_t end)
 {
 	// target is (x', v')
 	// light_p is (x, v) of non-attracting bodies
-	// eval_p is (x, v) of attracting bodies
-	for(size_t i = 0; i < lsize; i++)
+	// attracting bodies were already stored by f for this stage
+	for(size_t i = start; i < end; i++)
 	{
-		(*target)[i].second = glm::dvec3(0, 0, 0);
-		for(size_t j = 0; j < size; j++)
-		{
-			double mass_j = masses[j];
-			glm::dvec3 diff = eval_p[j].first - light_p[i].first;
-			double dist2 = glm::length2(diff);
+		lpos.x[i] = light_p[i].first.x;
+		lpos.y[i] = light_p[i].first.y;
+		lpos.z[i] = light_p[i].first.z;
+	}
 
-			glm::dvec3 diffn = diff / glm::sqrt(dist2);
-			double am = (G * mass_j) / dist2;
-			(*target)[i].second += diffn * am;
-		}
+	GravityKernel::light_range(lpos, stage_pos[stage], gm.data(), lacc, start, end, backend);
 
+	for(size_t i = start; i < end; i++)
+	{
+		(*target)[i].second = glm::dvec3(lacc.x[i], lacc.y[i], lacc.z[i]);
 		// Evaluates v into x' (integrate velocity)
 		(*target)[i].first = light_p[i].second;
 	}
@@ -69,14 +64,15 @@ void RK4Propagator::propagate(double dt)
 		u0[i].first = (*st_vector)[i].pos;
 		u0[i].second = (*st_vector)[i].vel;
 		masses[i] = (*st_vector)[i].mass;
+		gm[i] = G * masses[i];
 	}
-	f(&C1, u0);
-	set_buffer(&buffer1, C1, u0, hdt, size);
-	f(&C2, buffer1);
-	set_buffer(&buffer2, C2, u0, hdt, size);
-	f(&C3, buffer2);
-	set_buffer(&buffer3, C3, u0, dt, size);
-	f(&C4, buffer3);
+	f(&C1, u0, 0);
+	set_buffer(&buffer1, C1, u0, hdt, 0, size);
+	f(&C2, buffer1, 1);
+	set_buffer(&buffer2, C2, u0, hdt, 0, size);
+	f(&C3, buffer2, 2);
+	set_buffer(&buffer3, C3, u0, dt, 0, size);
+	f(&C4, buffer3, 3);
 
 	// We can now step the system
 	for(size_t i = 0; i < size; i++)
@@ -87,20 +83,160 @@ void RK4Propagator::propagate(double dt)
 	}
 
 	// Then run RK4 on the light states, using intermediate states
-	for(size_t i = 0; i < lsize; i++)
+	// Each light state only depends on itself and the massive states, so chunks
+	// give the same result no matter which thread runs them
+	size_t chunks = (lsize + LIGHT_CHUNK - 1) / LIGHT_CHUNK;
+	ThreadPool* pool = get_light_pool();
+	if(pool && chunks > 1)
+	{
+		pool->parallel_for(chunks, [this, dt](size_t chunk)
+		{
+			size_t start = chunk * LIGHT_CHUNK;
+			propagate_light_range(dt, start, std::min(start + LIGHT_CHUNK, lsize));
+		});
+	}
+	else
+	{
+		propagate_light_range(dt, 0, lsize);
+	}
+
+	kepler_time += dt;
+}
+
+void RK4Propagator::propagate_light_range(double dt, size_t start, size_t end)
+{
+	if(kepler_threshold <= 0.0)
+	{
+		propagate_light_rk4(dt, start, end);
+		return;
+	}
+
+	// Consecutive states that can't use the fast path are integrated together,
+	// so the gravity kernel still works over contiguous ranges
+	size_t run_start = start;
+	for(size_t i = start; i < end; i++)
+	{
+		KeplerCheck& check = kepler_checks[i];
+		const LightCartesianState& state = (*lst_vector)[i];
+		check.checked = check.pos != state.pos || check.vel != state.vel ||
+				kepler_time >= check.next_check || check.center >= size;
+		if(check.checked)
+		{
+			check_kepler(i, check);
+			check.next_check = kepler_time + KEPLER_CHECK_INTERVAL;
+		}
+
+		if(check.fast && propagate_light_kepler(dt, i, check.center))
+		{
+			if(run_start != i)
+			{
+				propagate_light_rk4(dt, run_start, i);
+			}
+			run_start = i + 1;
+		}
+		else
+		{
+			check.fast = false;
+		}
+	}
+
+	if(run_start != end)
+	{
+		propagate_light_rk4(dt, run_start, end);
+	}
+
+	for(size_t i = start; i < end; i++)
+	{
+		kepler_checks[i].pos = (*lst_vector)[i].pos;
+		kepler_checks[i].vel = (*lst_vector)[i].vel;
+	}
+}
+
+void RK4Propagator::check_kepler(size_t i, KeplerCheck& check)
+{
+	const GravitySoA& pos = stage_pos[0];
+	glm::dvec3 x = (*lst_vector)[i].pos;
+	check.fast = false;
+	check.center = 0;
+
+	// The dominant body is the one that pulls the most
+	double center_acc = -1.0;
+	for(size_t j = 0; j < size; j++)
+	{
+		glm::dvec3 diff = glm::dvec3(pos.x[j], pos.y[j], pos.z[j]) - x;
+		double a = gm[j] / glm::dot(diff, diff);
+		if(a > center_acc)
+		{
+			center_acc = a;
+			check.center = j;
+		}
+	}
+
+	if(center_acc <= 0.0)
+	{
+		return;
+	}
+
+	// In the frame of the dominant body, the rest of bodies only contribute
+	// the difference of their pull on us and on the dominant body
+	glm::dvec3 center_pos = glm::dvec3(pos.x[check.center], pos.y[check.center], pos.z[check.center]);
+	double max_perturbation = kepler_threshold * center_acc;
+	double perturbation = 0.0;
+	for(size_t j = 0; j < size; j++)
+	{
+		if(j == check.center)
+		{
+			continue;
+		}
+
+		glm::dvec3 body_pos = glm::dvec3(pos.x[j], pos.y[j], pos.z[j]);
+		glm::dvec3 d0 = body_pos - x;
+		glm::dvec3 d1 = body_pos - center_pos;
+		double l0 = glm::length(d0);
+		double l1 = glm::length(d1);
+		glm::dvec3 tidal = gm[j] * (d0 / (l0 * l0 * l0) - d1 / (l1 * l1 * l1));
+		perturbation += glm::length(tidal);
+		if(perturbation > max_perturbation)
+		{
+			return;
+		}
+	}
+
+	check.fast = true;
+}
+
+bool RK4Propagator::propagate_light_kepler(double dt, size_t i, size_t center)
+{
+	glm::dvec3 rel_pos = (*lst_vector)[i].pos - u0[center].first;
+	glm::dvec3 rel_vel = (*lst_vector)[i].vel - u0[center].second;
+	if(!propagate_conic(rel_pos, rel_vel, gm[center], dt))
+	{
+		return false;
+	}
+
+	(*lst_vector)[i].pos = (*st_vector)[center].pos + rel_pos;
+	(*lst_vector)[i].vel = (*st_vector)[center].vel + rel_vel;
+	return true;
+}
+
+void RK4Propagator::propagate_light_rk4(double dt, size_t start, size_t end)
+{
+	double hdt = dt * 0.5;
+
+	for(size_t i = start; i < end; i++)
 	{
 		lu0[i].first = (*lst_vector)[i].pos;
 		lu0[i].second = (*lst_vector)[i].vel;
 	}
-	fl(&lC1, lu0, u0);
-	set_buffer(&lbuffer1, lC1, lu0, hdt, lsize);
-	fl(&lC2, lbuffer1, buffer1);
-	set_buffer(&lbuffer2, lC2, lu0, hdt, lsize);
-	fl(&lC3, lbuffer2, buffer2);
-	set_buffer(&lbuffer3, lC3, lu0, dt, lsize);
-	fl(&lC4, lbuffer3, buffer3);
+	fl(&lC1, lu0, 0, start, end);
+	set_buffer(&lbuffer1, lC1, lu0, hdt, start, end);
+	fl(&lC2, lbuffer1, 1, start, end);
+	set_buffer(&lbuffer2, lC2, lu0, hdt, start, end);
+	fl(&lC3, lbuffer2, 2, start, end);
+	set_buffer(&lbuffer3, lC3, lu0, dt, start, end);
+	fl(&lC4, lbuffer3, 3, start, end);
 
-	for(size_t i = 0; i < lsize; i++)
+	for(size_t i = start; i < end; i++)
 	{
 		double h = dt * (1.0 / 6.0);
 		(*lst_vector)[i].pos = lu0[i].first + h * (lC1[i].first + 2.0 * lC2[i].first + 2.0 * lC3[i].first + lC4[i].first);
@@ -108,6 +244,18 @@ void RK4Propagator::propagate(double dt)
 	}
 }
 
+RK4Propagator::RK4Propagator()
+{
+	size = 0;
+	lsize = 0;
+	kepler_time = 0.0;
+}
+
+void RK4Propagator::load(const cpptoml::table& settings)
+{
+	kepler_threshold = settings.get_as<double>("kepler_threshold").value_or(kepler_threshold);
+}
+
 void RK4Propagator::resize()
 {
 	if(C1.size() != st_vector->size())
@@ -122,6 +270,12 @@ void RK4Propagator::resize()
 		buffer2.resize(size);
 		buffer3.resize(size);
 		masses.resize(size);
+		gm.resize(size);
+		acc.resize(size);
+		for(GravitySoA& pos : stage_pos)
+		{
+			pos.resize(size);
+		}
 	}
 
 	if(lC1.size() != lst_vector->size())
@@ -135,15 +289,30 @@ void RK4Propagator::resize()
 		lbuffer1.resize(lsize);
 		lbuffer2.resize(lsize);
 		lbuffer3.resize(lsize);
+		lpos.resize(lsize);
+		lacc.resize(lsize);
+	}
+
+	if(kepler_threshold > 0.0 && kepler_checks.size() != lsize)
+	{
+		// States may have been reordered, force a check on all of them
+		KeplerCheck check;
+		check.pos = glm::dvec3(std::numeric_limits<double>::quiet_NaN());
+		check.vel = check.pos;
+		check.center = 0;
+		check.next_check = 0.0;
+		check.fast = false;
+		check.checked = false;
+		kepler_checks.assign(lsize, check);
 	}
 
 }
 
 void RK4Propagator::set_buffer(RK4Propagator::SolVec* target, const RK4Propagator::SolVec &C, const RK4Propagator::SolVec& eu0,
-							   double dt, size_t s)
+							   double dt, size_t start, size_t end)
 {
 	// buffer = u0 + dt * C
-	for(size_t i = 0; i < s; i++)
+	for(size_t i = start; i < end; i++)
 	{
 		(*target)[i].first = eu0[i].first + C[i].first * dt;
 		(*target)[i].second = eu0[i].second + C[i].second * dt;
@@ -1,5 +1,7 @@
 #pragma once
 #include "SystemPropagator.h"
+#include "GravityKernel.h"
+#include <array>
 
 // Allows very good precision at big timesteps, but may be unnecesary at
 // real-time timesteps!
@@ -34,20 +36,80 @@ private:
 	std::vector<std::pair<glm::dvec3, glm::dvec3>> lbuffer3;
 	// Cache consistency may be improved this way
 	std::vector<double> masses;
+	// Masses premultiplied by G, as used by the gravity kernel
+	std::vector<double> gm;
+
+	// SoA positions of the attracting bodies at each of the 4 RK4 stages,
+	// stored by f so that fl can reuse them
+	std::array<GravitySoA, 4> stage_pos;
+	GravitySoA acc;
+	GravitySoA lpos;
+	GravitySoA lacc;
+
+	// Light states are split into chunks of this size for the workers
+	static constexpr size_t LIGHT_CHUNK = 64;
 
 	void resize();
 
-	// n-body
-	void f(SolVec* target, const SolVec& eval_p);
-	void set_buffer(SolVec* target, const SolVec& C, const SolVec& u0, double dt, size_t size);
-	// light states
-	void fl(SolVec* target, const SolVec& light_p, const SolVec& eval_p);
+	// Whether each light state can use the Kepler fast path. It's only checked again
+	// every KEPLER_CHECK_INTERVAL seconds, or if the state was changed by someone else
+	// (a burn changes only the velocity)
+	struct KeplerCheck
+	{
+		// State as we left it after the last step
+		glm::dvec3 pos;
+		glm::dvec3 vel;
+		size_t center;
+		double next_check;
+		bool fast;
+		// Checked in the last step
+		bool checked;
+	};
+	std::vector<KeplerCheck> kepler_checks;
+	// Time propagated so far, only used to schedule checks
+	double kepler_time;
+	static constexpr double KEPLER_CHECK_INTERVAL = 60.0;
+
+	// Runs the whole step for light states in [start, end), on the Kepler fast path
+	// if possible and RK4 otherwise. The massive bodies must have been propagated before
+	void propagate_light_range(double dt, size_t start, size_t end);
+	void propagate_light_rk4(double dt, size_t start, size_t end);
+	// Finds the dominant body of the light state and if the perturbations from
+	// the rest of bodies are below kepler_threshold
+	void check_kepler(size_t i, KeplerCheck& check);
+	// Advances the light state along a conic around center, false if it failed
+	bool propagate_light_kepler(double dt, size_t i, size_t center);
+
+	// n-body, stage is the RK4 stage (0 to 3)
+	void f(SolVec* target, const SolVec& eval_p, size_t stage);
+	// Sets elements in range [start, end)
+	void set_buffer(SolVec* target, const SolVec& C, const SolVec& u0, double dt, size_t start, size_t end);
+	// light states in [start, end), evaluated against the attracting bodies as they were at given stage
+	void fl(SolVec* target, const SolVec& light_p, size_t stage, size_t start, size_t end);
 
 public:
 
+	// Defaults to the best one the CPU supports, can be changed to compare results
+	GravityKernel::Backend backend = GravityKernel::get_best_backend();
+
+	// Light states whose perturbations (tidal accelerations of every body but the
+	// dominant one, relative to the dominant one's acceleration) are below this are
+	// propagated analytically as a two-body problem. 0 disables it
+	// A value of around 1e-6 catches low parking orbits
+	double kepler_threshold = 0.0;
+
+	// True if light state i took the Kepler fast path in the last step
+	bool is_on_kepler_path(size_t i) const { return i < kepler_checks.size() && kepler_checks[i].fast; }
+	// True if light state i was checked for the Kepler fast path in the last step
+	bool was_kepler_checked(size_t i) const { return i < kepler_checks.size() && kepler_checks[i].checked; }
+
 	// Propagates the system, including non-nbody bodies
 	virtual void propagate(double dt) override;
 
+	void load(const cpptoml::table& settings) override;
+	std::string get_name() const override { return "rk4"; }
+
+	RK4Propagator();
 	~RK4Propagator() override = default;
 
 	void propagate_int(std::vector<glm::dvec3> *pos_target, std::vector<glm::dvec3> *vel_target,
@@ -0,0 +1,117 @@
+#include "SymplecticPropagator.h"
+#include <util/Logger.h>
+#include <algorithm>
+
+// Yoshida (1990) coefficients
+static const double CBRT2 = 1.2599210498948732;
+static const double W1 = 1.0 / (2.0 - CBRT2);
+static const double W0 = -CBRT2 / (2.0 - CBRT2);
+
+static const double YOSHIDA_C[4] = { W1 * 0.5, (W0 + W1) * 0.5, (W0 + W1) * 0.5, W1 * 0.5 };
+static const double YOSHIDA_D[3] = { W1, W0, W1 };
+
+static const double LEAPFROG_C[2] = { 0.5, 0.5 };
+static const double LEAPFROG_D[1] = { 1.0 };
+
+void SymplecticPropagator::resize()
+{
+	eval.set_masses(*st_vector);
+
+	if(st_vector->size() == size && lst_vector->size() == lsize)
+	{
+		return;
+	}
+
+	size = st_vector->size();
+	lsize = lst_vector->size();
+	eval.resize_light(lsize);
+	x.resize(size + lsize);
+	v.resize(size + lsize);
+	a.resize(size + lsize);
+}
+
+void SymplecticPropagator::drift(double dt)
+{
+	for(size_t i = 0; i < x.size(); i++)
+	{
+		x[i] += v[i] * dt;
+	}
+}
+
+void SymplecticPropagator::kick(double dt, ThreadPool* pool)
+{
+	eval.evaluate(x, a, pool);
+	for(size_t i = 0; i < v.size(); i++)
+	{
+		v[i] += a[i] * dt;
+	}
+}
+
+void SymplecticPropagator::propagate(double dt)
+{
+	resize();
+
+	if(x.empty() || dt <= 0.0)
+	{
+		return;
+	}
+
+	for(size_t i = 0; i < size; i++)
+	{
+		x[i] = (*st_vector)[i].pos;
+		v[i] = (*st_vector)[i].vel;
+	}
+
+	for(size_t i = 0; i < lsize; i++)
+	{
+		x[size + i] = (*lst_vector)[i].pos;
+		v[size + i] = (*lst_vector)[i].vel;
+	}
+
+	const double* c = order == 4 ? YOSHIDA_C : LEAPFROG_C;
+	const double* d = order == 4 ? YOSHIDA_D : LEAPFROG_D;
+	size_t kicks = order == 4 ? 3 : 1;
+
+	// Equal substeps, so the integrator stays symplectic
+	size_t substeps = (size_t)glm::ceil(dt / max_step);
+	substeps = std::max(substeps, (size_t)1);
+	double h = dt / (double)substeps;
+
+	ThreadPool* pool = get_light_pool();
+
+	for(size_t s = 0; s < substeps; s++)
+	{
+		for(size_t k = 0; k < kicks; k++)
+		{
+			drift(c[k] * h);
+			kick(d[k] * h, pool);
+		}
+		drift(c[kicks] * h);
+	}
+
+	for(size_t i = 0; i < size; i++)
+	{
+		(*st_vector)[i].pos = x[i];
+		(*st_vector)[i].vel = v[i];
+	}
+
+	for(size_t i = 0; i < lsize; i++)
+	{
+		(*lst_vector)[i].pos = x[size + i];
+		(*lst_vector)[i].vel = v[size + i];
+	}
+}
+
+void SymplecticPropagator::load(const cpptoml::table& settings)
+{
+	max_step = settings.get_as<double>("max_step").value_or(max_step);
+	logger->check(max_step > 0.0, "max_step must be positive");
+}
+
+SymplecticPropagator::SymplecticPropagator(int norder)
+{
+	logger->check(norder == 2 || norder == 4, "Symplectic propagator order must be 2 or 4, given {}", norder);
+	order = norder;
+	size = 0;
+	lsize = 0;
+}
@@ -0,0 +1,40 @@
+#pragma once
+#include "SystemPropagator.h"
+#include "GravityEvaluator.h"
+
+// Fixed step symplectic integrators (drift-kick compositions). They don't drift
+// in energy over long timespans, so they are ideal for long time-warps, as long
+// as the timestep is kept constant. Orders:
+//	2: Leapfrog (velocity Verlet)
+//	4: Yoshida's 4th order composition of 3 leapfrog steps
+// Settings ([propagator] table):
+//	max_step: If propagate is called with a bigger timestep it will be split
+//	in equal substeps no longer than this (default 60s)
+class SymplecticPropagator : public SystemPropagator
+{
+private:
+
+	size_t size;
+	size_t lsize;
+	int order;
+
+	GravityEvaluator eval;
+
+	std::vector<glm::dvec3> x, v, a;
+
+	void resize();
+	void drift(double dt);
+	void kick(double dt, ThreadPool* pool);
+
+public:
+
+	double max_step = 60.0;
+
+	void propagate(double dt) override;
+	void load(const cpptoml::table& settings) override;
+	std::string get_name() const override { return order == 4 ? "yoshida4" : "leapfrog"; }
+
+	// Order must be 2 or 4
+	explicit SymplecticPropagator(int order = 4);
+	~SymplecticPropagator() override = default;
+};
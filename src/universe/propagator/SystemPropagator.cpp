@@ -0,0 +1,26 @@
+#include "SystemPropagator.h"
+#include "RK4Propagator.h"
+#include "DormandPrincePropagator.h"
+#include "SymplecticPropagator.h"
+
+SystemPropagator* SystemPropagator::create(const std::string& name)
+{
+	if(name == "rk4")
+	{
+		return new RK4Propagator();
+	}
+	else if(name == "dopri54")
+	{
+		return new DormandPrincePropagator();
+	}
+	else if(name == "leapfrog")
+	{
+		return new SymplecticPropagator(2);
+	}
+	else if(name == "yoshida4")
+	{
+		return new SymplecticPropagator(4);
+	}
+
+	return nullptr;
+}
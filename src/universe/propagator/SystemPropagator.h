@@ -1,6 +1,9 @@
 #pragma once
 #include "../UniverseDefinitions.h"
 #include "Propagable.h"
+#include <util/ThreadPool.h>
+#include <cpptoml.h>
+#include <memory>
 
 
 // Propagates N-body systems and can also handle vessels and non-attracting bodies
@@ -12,8 +15,35 @@ protected:
 	// If nullptr, it's nbody. Same number of elements as lst_vector
 	TrajectoryVector* trj_vector;
 
+	// Threads used to propagate light states, 1 means everything runs on the calling thread
+	size_t light_threads = 1;
+	std::unique_ptr<ThreadPool> light_pool;
+
+	// Returns nullptr if light states must be propagated in the calling thread
+	// The pool is created on first use, with light_threads - 1 workers
+	ThreadPool* get_light_pool()
+	{
+		if(light_threads <= 1)
+		{
+			return nullptr;
+		}
+
+		if(!light_pool || light_pool->get_thread_count() != light_threads - 1)
+		{
+			light_pool = std::make_unique<ThreadPool>(light_threads - 1, "propagator");
+		}
+
+		return light_pool.get();
+	}
+
 public:
 
+	// Light states are independent of each other, so they may be propagated in parallel
+	// Results must not depend on the number of threads. Each propagator owns its threads,
+	// so predictors can keep using single-threaded copies
+	virtual void set_light_threads(size_t count) { light_threads = count == 0 ? 1 : count; }
+	size_t get_light_threads() const { return light_threads; }
+
 
 	void bind_to(Propagable* system)
 	{
@@ -36,5 +66,18 @@ public:
 	// Propagates the system, including non-nbody bodies
 	virtual void propagate(double dt) = 0;
 
+	// Reads integrator specific settings from the [propagator] table of the system
+	virtual void load(const cpptoml::table& settings) {}
+	// The name used to create the propagator
+	virtual std::string get_name() const = 0;
+	// Adaptive propagators take internal substeps, so they can be given
+	// big timesteps without losing precision
+	virtual bool is_adaptive() const { return false; }
+
+	// Creates a propagator from its name:
+	// "rk4" (default), "dopri54" (adaptive), "leapfrog" and "yoshida4" (symplectic)
+	// Returns nullptr if the name is not known
+	static SystemPropagator* create(const std::string& name);
+
 	virtual ~SystemPropagator() = default;
 };
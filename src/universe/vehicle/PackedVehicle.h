@@ -39,6 +39,7 @@ public:
 	btTransform get_root_transform(){ return root_transform; }
 	WorldState get_root_state(){ return root_state; }
 	btVector3 get_com_root_relative(){ return com; }
+	glm::dvec3 get_com_position(){ return to_dvec3(root_transform * com); }
 
 	void calculate_com();
 
@@ -4,9 +4,8 @@
 #include "../../physics/glm/BulletGlmCompat.h"
 #include "../../physics/RigidBodyUserData.h"
 #include "Vehicle.h"
-
-using WeldedGroupCreation = std::pair<std::unordered_set<Piece*>, bool>;
-
+#include <chrono>
+#include <algorithm>
 
 static UnpackedVehicle::PieceState obtain_piece_state(Piece* piece)
 {
@@ -32,233 +31,284 @@ static std::unordered_map<Piece*, UnpackedVehicle::PieceState> get_states_at_sta
 	return states_at_start;
 }
 
-static void add_to_welded_groups(std::vector<WeldedGroupCreation>& welded_groups, Piece* piece)
+// Union-find over the pieces, joining every welded piece with the one it's attached to
+static int find_root(std::vector<int>& parent, int i)
 {
-	bool found = false;
-	// Find what welded group to add this to
-	if (piece->welded)
+	while (parent[i] != i)
 	{
-		for (size_t i = 0; i < welded_groups.size(); i++)
-		{
-			if (welded_groups[i].first.count(piece->attached_to) != 0)
-			{
-				welded_groups[i].first.insert(piece);
-				found = true;
-				break;
-			}
-		}
+		parent[i] = parent[parent[i]];
+		i = parent[i];
 	}
+	return i;
+}
 
-	if (!found)
+// Returns the welded groups (of more than one piece) of the vehicle, and writes
+// for every piece (same index as all_pieces) the group it belongs to, or -1 if alone
+static std::vector<std::vector<Piece*>> find_welded_groups(const std::vector<Piece*>& all_pieces,
+	std::unordered_map<Piece*, int>& piece_to_idx, std::vector<int>& group_of)
+{
+	piece_to_idx.clear();
+	piece_to_idx.reserve(all_pieces.size());
+	for (size_t i = 0; i < all_pieces.size(); i++)
 	{
-		// Create the welded group, add the part, and, if this part is welded, add
-		// whatever it's welded to (Note: individual parts get a lone welded group)
-		welded_groups.push_back(std::make_pair(std::unordered_set<Piece*>(), false));
-		welded_groups[welded_groups.size() - 1].first.insert(piece);
-		if (piece->welded && piece->attached_to != nullptr)
-		{
-			welded_groups[welded_groups.size() - 1].first.insert(piece->attached_to);
-		}
+		piece_to_idx[all_pieces[i]] = (int)i;
 	}
-}
 
-static std::vector<Piece*> extract_single_pieces(std::vector<WeldedGroupCreation>& welded_groups)
-{
-	std::vector<Piece*> single_pieces;
+	std::vector<int> parent(all_pieces.size());
+	std::vector<int> size(all_pieces.size(), 1);
+	for (size_t i = 0; i < all_pieces.size(); i++)
+	{
+		parent[i] = (int)i;
+	}
 
-	// Find single piece (groups of only one piece)
-	for (auto it = welded_groups.begin(); it != welded_groups.end();)
+	for (size_t i = 0; i < all_pieces.size(); i++)
 	{
-		if (it->first.size() == 1)
+		Piece* piece = all_pieces[i];
+		if (!piece->welded || piece->attached_to == nullptr)
 		{
-			Piece* piece = *it->first.begin();
-
-			single_pieces.push_back(piece);
-			// Remove welded colliders, if it had any
-			if (piece->in_group != nullptr)
-			{
-				piece->rigid_body = nullptr;
-				piece->motion_state = nullptr;
-				piece->in_group = nullptr;
-				piece->welded_collider_id = -1;
-			}
-
-			it = welded_groups.erase(it);
+			continue;
 		}
-		else
+
+		auto it = piece_to_idx.find(piece->attached_to);
+		if (it == piece_to_idx.end())
 		{
-			it++;
+			continue;
 		}
-	}
 
-	return single_pieces;
-}
-
-static void remove_outdated_welded_groups(
-	std::vector<WeldedGroup*>& welded, std::vector<WeldedGroupCreation>& welded_groups, btDynamicsWorld* world)
-{
-	for (auto it = welded.begin(); it != welded.end();)
-	{
-		WeldedGroup* wgroup = *it;
-
-		bool found = false;
-		// Find any same group, to be the same, the welded_group
-		// must contain every piece in wgroup, and be the same size
-		for (size_t j = 0; j < welded_groups.size(); j++)
+		int a = find_root(parent, (int)i);
+		int b = find_root(parent, it->second);
+		if (a != b)
 		{
-			int count = 0;
-			for (size_t i = 0; i < wgroup->pieces.size(); i++)
+			if (size[a] < size[b])
 			{
-				count += (int)welded_groups[j].first.count(wgroup->pieces[i]);
+				std::swap(a, b);
 			}
+			parent[b] = a;
+			size[a] += size[b];
+		}
+	}
 
-			if (count == wgroup->pieces.size() && !wgroup->dirty)
-			{
-				found = true;
-				welded_groups[j].second = true;
-				break;
-			}
+	std::vector<std::vector<Piece*>> groups;
+	std::vector<int> root_to_group(all_pieces.size(), -1);
+	group_of.assign(all_pieces.size(), -1);
+	for (size_t i = 0; i < all_pieces.size(); i++)
+	{
+		int root = find_root(parent, (int)i);
+		if (size[root] == 1)
+		{
+			continue;
 		}
 
-		if (!found)
+		if (root_to_group[root] < 0)
 		{
-			// We remove the group as it is not present anymore
-			world->removeRigidBody(wgroup->rigid_body);
+			root_to_group[root] = (int)groups.size();
+			groups.emplace_back();
+			groups.back().reserve(size[root]);
+		}
 
-			// Set all group rigidbodies to nullptr!
-			for (Piece* p : wgroup->pieces)
-			{
-				p->rigid_body = nullptr;
-			}
+		group_of[i] = root_to_group[root];
+		groups[root_to_group[root]].push_back(all_pieces[i]);
+	}
+
+	return groups;
+}
 
-			delete wgroup->motion_state;
-			delete wgroup->rigid_body;
-			delete wgroup;
+static void release_from_group(Piece* p)
+{
+	p->rigid_body = nullptr;
+	p->motion_state = nullptr;
+	p->in_group = nullptr;
+	p->welded_collider_id = -1;
+}
 
+static void destroy_welded_group(WeldedGroup* wgroup, btDynamicsWorld* world)
+{
+	delete (RigidBodyUserData*)wgroup->rigid_body->getUserPointer();
+	world->removeRigidBody(wgroup->rigid_body);
 
+	// The children are the piece colliders, which are not ours
+	delete wgroup->rigid_body->getCollisionShape();
+	delete wgroup->rigid_body;
+	delete wgroup->motion_state;
 
-			it = welded.erase(it);
-		}
-		else
+	for (Piece* p : wgroup->pieces)
+	{
+		if (p->in_group == wgroup)
 		{
-			it++;
+			release_from_group(p);
 		}
 	}
+
+	delete wgroup;
 }
 
-static void create_new_welded_group(
-	std::vector<WeldedGroup*>& welded, WeldedGroupCreation& wg, 
-	std::unordered_map<Piece*, UnpackedVehicle::PieceState>& states_at_start, btDynamicsWorld* world,
-	std::vector<Piece*>& all_pieces)
+// Moves the children of the collider so that the center of mass and principal axes
+// are at the origin, and returns the transform of the principal frame
+static btTransform center_welded_collider(btCompoundShape* collider, const std::vector<Piece*>& pieces,
+	btScalar& tot_mass, btVector3& local_inertia)
 {
-	if (wg.second == false)
+	std::vector<btScalar> masses;
+	masses.reserve(pieces.size());
+	tot_mass = 0.0;
+	for (Piece* p : pieces)
 	{
-		// Create a new WeldedGroup
-		WeldedGroup* n_group = new WeldedGroup();
-		n_group->pieces.reserve(wg.first.size());
+		masses.push_back(p->mass);
+		tot_mass += p->mass;
+	}
 
-		// Create collider
-		btCompoundShape temp_collider = btCompoundShape();
-		btCompoundShape* collider = new btCompoundShape();
+	btTransform principal;
+	principal.setIdentity();
+	collider->calculatePrincipalAxisTransform(masses.data(), principal, local_inertia);
 
-		btTransform identity;
-		identity.setIdentity();
+	btTransform principal_inverse = principal.inverse();
+	for (int i = 0; i < collider->getNumChildShapes(); i++)
+	{
+		collider->updateChildTransform(i, principal_inverse * collider->getChildTransform(i), false);
+		pieces[i]->welded_tform = principal_inverse * pieces[i]->welded_tform;
+	}
+	collider->recalculateLocalAabb();
+	collider->calculateLocalInertia(tot_mass, local_inertia);
 
-		std::vector<btScalar> masses;
-		btTransform principal;
-		principal.setIdentity();
+	return principal;
+}
 
-		double tot_mass = 0.0;
+// The group lost some pieces (a decoupler was fired...), but the remaining pieces are still
+// welded together, so we keep the rigidbody and collider and only remove the lost children
+static void shrink_welded_group(WeldedGroup* wgroup, int group, const std::unordered_map<Piece*, int>& piece_to_idx,
+	const std::vector<int>& group_of, btDynamicsWorld* world)
+{
+	btRigidBody* rigid_body = wgroup->rigid_body;
+	btCompoundShape* collider = (btCompoundShape*)rigid_body->getCollisionShape();
 
-		for (Piece* p : wg.first)
+	// btCompoundShape removes children by swapping with the last one, we do the same
+	// with the pieces so that child indices keep matching piece indices
+	for (int i = (int)wgroup->pieces.size() - 1; i >= 0; i--)
+	{
+		Piece* p = wgroup->pieces[i];
+		auto it = piece_to_idx.find(p);
+		if (it != piece_to_idx.end() && group_of[it->second] == group)
 		{
-			p->welded_tform = states_at_start[p].transform;
-			temp_collider.addChildShape(p->welded_tform, p->collider);
-			masses.push_back(p->mass);
-			tot_mass += p->mass;
-
-			p->welded_collider_id = temp_collider.getNumChildShapes() - 1;
+			continue;
 		}
 
-		// Create rigidbody
-		btVector3 local_inertia;
+		collider->removeChildShapeByIndex(i);
+		wgroup->pieces[i] = wgroup->pieces.back();
+		wgroup->pieces.pop_back();
+		release_from_group(p);
+	}
 
-		temp_collider.calculatePrincipalAxisTransform(masses.data(), principal, local_inertia);
+	for (size_t i = 0; i < wgroup->pieces.size(); i++)
+	{
+		wgroup->pieces[i]->collider->setUserIndex((int)i);
+		wgroup->pieces[i]->welded_collider_id = (int)i;
+	}
 
-		btTransform principal_inverse = principal.inverse();
+	btVector3 old_com = rigid_body->getCenterOfMassPosition();
+	btVector3 linear = rigid_body->getLinearVelocity();
+	btVector3 angular = rigid_body->getAngularVelocity();
 
-		for (int i = 0; i < temp_collider.getNumChildShapes(); i++)
-		{
-			collider->addChildShape(principal_inverse * temp_collider.getChildTransform(i),
-				temp_collider.getChildShape(i));
-		}
+	btScalar tot_mass;
+	btVector3 local_inertia;
+	btTransform principal = center_welded_collider(collider, wgroup->pieces, tot_mass, local_inertia);
+	btTransform tform = rigid_body->getWorldTransform() * principal;
+
+	// Mass and shape changes are only picked up properly by the world if we re-add the body
+	world->removeRigidBody(rigid_body);
+	rigid_body->setMassProps(tot_mass, local_inertia);
+	rigid_body->setCenterOfMassTransform(tform);
+	wgroup->motion_state->setWorldTransform(tform);
+	rigid_body->updateInertiaTensor();
+	// The pieces keep moving as they were, the new center of mass is elsewhere in the body
+	rigid_body->setLinearVelocity(linear + angular.cross(tform.getOrigin() - old_com));
+	rigid_body->setAngularVelocity(angular);
+	world->addRigidBody(rigid_body);
+
+	wgroup->dirty = false;
+}
 
+static void create_new_welded_group(
+	std::vector<WeldedGroup*>& welded, const std::vector<Piece*>& pieces,
+	std::unordered_map<Piece*, UnpackedVehicle::PieceState>& states_at_start, btDynamicsWorld* world)
+{
+	// Create a new WeldedGroup
+	WeldedGroup* n_group = new WeldedGroup();
+	n_group->pieces = pieces;
 
-		collider->calculateLocalInertia(tot_mass, local_inertia);
+	// Create collider, it's first built in world space and then centered
+	btCompoundShape* collider = new btCompoundShape(true, (int)pieces.size());
 
-		btMotionState* motion_state = new btDefaultMotionState(principal);
-		btRigidBody::btRigidBodyConstructionInfo info(tot_mass, motion_state, collider, local_inertia);
-		btRigidBody* rigid_body = new btRigidBody(info);
-		RigidBodyUserData* udata = new RigidBodyUserData();
-		udata->type = RigidBodyType::WELDED_GROUP;
-		udata->as_wgroup = n_group;
-		rigid_body->setUserPointer(udata);
+	for (size_t i = 0; i < pieces.size(); i++)
+	{
+		Piece* p = pieces[i];
+		p->welded_tform = states_at_start[p].transform;
+		collider->addChildShape(p->welded_tform, p->collider);
+		p->welded_collider_id = (int)i;
+	}
 
-		rigid_body->setActivationState(DISABLE_DEACTIVATION);
+	// Create rigidbody
+	btScalar tot_mass;
+	btVector3 local_inertia;
+	btTransform principal = center_welded_collider(collider, n_group->pieces, tot_mass, local_inertia);
 
-		// TODO: Think, maybe we can do the average of all parts? Maybe using default values is good
-		rigid_body->setFriction(PIECE_DEFAULT_FRICTION);
-		rigid_body->setRestitution(PIECE_DEFAULT_RESTITUTION);
+	btMotionState* motion_state = new btDefaultMotionState(principal);
+	btRigidBody::btRigidBodyConstructionInfo info(tot_mass, motion_state, collider, local_inertia);
+	btRigidBody* rigid_body = new btRigidBody(info);
+	RigidBodyUserData* udata = new RigidBodyUserData();
+	udata->type = RigidBodyType::WELDED_GROUP;
+	udata->as_wgroup = n_group;
+	rigid_body->setUserPointer(udata);
+
+	rigid_body->setActivationState(DISABLE_DEACTIVATION);
 
-		world->addRigidBody(rigid_body);
+	// TODO: Think, maybe we can do the average of all parts? Maybe using default values is good
+	rigid_body->setFriction(PIECE_DEFAULT_FRICTION);
+	rigid_body->setRestitution(PIECE_DEFAULT_RESTITUTION);
 
-		btVector3 total_angvel = btVector3(0, 0, 0);
+	world->addRigidBody(rigid_body);
 
-		size_t idx = 0;
-		for (Piece* p : wg.first)
-		{
-			p->collider->setUserIndex(idx);
-			n_group->pieces.push_back(p);
-			idx++;
-			p->in_group = n_group;
+	btVector3 total_angvel = btVector3(0, 0, 0);
 
-			if (p->rigid_body != nullptr)
+	for (size_t i = 0; i < pieces.size(); i++)
+	{
+		Piece* p = pieces[i];
+		p->collider->setUserIndex((int)i);
+		p->in_group = n_group;
+
+		if (p->rigid_body != nullptr)
+		{
+			// We must be careful here, we may be removing an already welded rigidbody!
+			for (Piece* sp : pieces)
 			{
-				// We must be careful here, we may be removing an already welded rigidbody!
-				for (Piece* sp : wg.first)
+				if (sp->rigid_body == p->rigid_body && sp != p)
 				{
-					if (sp->rigid_body == p->rigid_body && sp != p)
-					{
-						sp->rigid_body = nullptr;
-					}
+					sp->rigid_body = nullptr;
 				}
-
-				world->removeRigidBody(p->rigid_body);
-				delete p->rigid_body;
 			}
 
-			p->rigid_body = rigid_body;
-			p->motion_state = motion_state;
-			p->welded_tform = principal_inverse * p->welded_tform;
-
-			//rigid_body->applyCentralImpulse(states_at_start[p].linear * p->mass);
-			rigid_body->applyImpulse(states_at_start[p].linear * p->mass, p->get_local_transform().getOrigin());
-			//rigid_body->applyImpulse(states_at_start[p].linear * p->mass, p->get_relative_position()); 
-			total_angvel += states_at_start[p].angular;
+			delete (RigidBodyUserData*)p->rigid_body->getUserPointer();
+			world->removeRigidBody(p->rigid_body);
+			delete p->rigid_body;
+			delete p->motion_state;
 		}
 
+		p->rigid_body = rigid_body;
+		p->motion_state = motion_state;
 
-		// Angular momentum is conserved, we need to get angular velocity back
-		// from total_angmom
-		glm::dvec3 ang_veld = to_dvec3(total_angvel) / (double)wg.first.size();
-		btVector3 ang_vel = to_btVector3(ang_veld);
-		rigid_body->setAngularVelocity(ang_vel);
+		rigid_body->applyImpulse(states_at_start[p].linear * p->mass, p->get_local_transform().getOrigin());
+		total_angvel += states_at_start[p].angular;
+	}
 
-		n_group->rigid_body = rigid_body;
-		n_group->motion_state = motion_state;
 
-		welded.push_back(n_group);
-	}
+	// Angular momentum is conserved, we need to get angular velocity back
+	// from total_angmom
+	glm::dvec3 ang_veld = to_dvec3(total_angvel) / (double)pieces.size();
+	btVector3 ang_vel = to_btVector3(ang_veld);
+	rigid_body->setAngularVelocity(ang_vel);
+
+	n_group->rigid_body = rigid_body;
+	n_group->motion_state = motion_state;
+
+	welded.push_back(n_group);
 }
 
 static void add_piece_physics(Piece* piece, btTransform tform, btDynamicsWorld* world)
@@ -321,6 +371,7 @@ void UnpackedVehicle::update()
 	// but they cannot set it themselves
 	if(!dirty)
 	{
+		auto start = std::chrono::steady_clock::now();
 		for (Piece* p : vehicle->all_pieces)
 		{
 			if (p->link != nullptr && p->attached_to != nullptr && !p->welded)
@@ -334,6 +385,7 @@ void UnpackedVehicle::update()
 				}
 			}
 		}
+		last_link_check_time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
 	}
 
 
@@ -384,24 +436,99 @@ void UnpackedVehicle::build_physics(std::unordered_map<Piece*, PieceState>& stat
 
 	// We need to create shared colliders for all welded 
 	// groups, and individual colliders for every other piece
-	// The bool is used later on to check if the group was already present
-	
-	std::vector<WeldedGroupCreation> welded_groups;
+	// Existing groups are kept if they are still present, or shrunk if they lost some
+	// pieces, so only the groups that actually changed are built again
+	auto start = std::chrono::steady_clock::now();
 
+	std::unordered_map<Piece*, int> piece_to_idx;
+	std::vector<int> group_of;
+	std::vector<std::vector<Piece*>> welded_groups = find_welded_groups(vehicle->all_pieces, piece_to_idx, group_of);
+	std::vector<bool> group_present(welded_groups.size(), false);
 
-	for (Piece* piece : vehicle->all_pieces)
+	std::vector<std::pair<int, size_t>> counts;
+	for (auto it = welded.begin(); it != welded.end();)
 	{
-		add_to_welded_groups(welded_groups, piece);
+		WeldedGroup* wgroup = *it;
+
+		// How many of our pieces went to each of the new groups
+		counts.clear();
+		for (Piece* p : wgroup->pieces)
+		{
+			auto idx_it = piece_to_idx.find(p);
+			int group = idx_it == piece_to_idx.end() ? -1 : group_of[idx_it->second];
+			if (group < 0)
+			{
+				continue;
+			}
+
+			bool found = false;
+			for (auto& count : counts)
+			{
+				if (count.first == group)
+				{
+					count.second++;
+					found = true;
+					break;
+				}
+			}
+
+			if (!found)
+			{
+				counts.emplace_back(group, 1);
+			}
+		}
+
+		// We can reuse the group for the biggest new group made only of our pieces
+		int best = -1;
+		size_t best_count = 0;
+		for (auto& count : counts)
+		{
+			if (count.second == welded_groups[count.first].size() && !group_present[count.first] &&
+				count.second > best_count)
+			{
+				best = count.first;
+				best_count = count.second;
+			}
+		}
+
+		if (best < 0)
+		{
+			destroy_welded_group(wgroup, world);
+			it = welded.erase(it);
+			continue;
+		}
+
+		group_present[best] = true;
+		if (best_count != wgroup->pieces.size() || wgroup->dirty)
+		{
+			shrink_welded_group(wgroup, best, piece_to_idx, group_of, world);
+		}
+
+		it++;
 	}
 
-	std::vector<Piece*> single_pieces = extract_single_pieces(welded_groups);
+	std::vector<Piece*> single_pieces;
+	for (size_t i = 0; i < vehicle->all_pieces.size(); i++)
+	{
+		Piece* piece = vehicle->all_pieces[i];
+		if (group_of[i] < 0)
+		{
+			// Remove welded colliders, if it had any
+			if (piece->in_group != nullptr)
+			{
+				release_from_group(piece);
+			}
+			single_pieces.push_back(piece);
+		}
+	}
 	this->single_pieces = single_pieces;
 
-	remove_outdated_welded_groups(welded, welded_groups, world);
-
-	for (WeldedGroupCreation& wg : welded_groups)
+	for (size_t i = 0; i < welded_groups.size(); i++)
 	{
-		create_new_welded_group(welded, wg, states_at_start, world, vehicle->all_pieces);
+		if (!group_present[i])
+		{
+			create_new_welded_group(welded, welded_groups[i], states_at_start, world);
+		}
 	}
 
 	for (Piece* piece : single_pieces)
@@ -431,6 +558,7 @@ void UnpackedVehicle::build_physics(std::unordered_map<Piece*, PieceState>& stat
 		}
 	}
 
+	last_build_time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
 	
 
 }
@@ -716,13 +844,18 @@ void UnpackedVehicle::draw_debug()
 
 void UnpackedVehicle::deactivate()
 {
+	// Links must release their constraints before the rigidbodies are gone
+	for(Piece* p : vehicle->all_pieces)
+	{
+		if(p->link != nullptr)
+		{
+			p->link->deactivate();
+		}
+	}
+
 	for(WeldedGroup* group : welded)
 	{
-		delete (RigidBodyUserData*)group->rigid_body->getUserPointer();
-		world->removeRigidBody(group->rigid_body);
-		delete group->rigid_body;
-		delete group->motion_state;
-		delete group;
+		destroy_welded_group(group, world);
 	}
 
 	for(Piece* p : single_pieces)
@@ -731,6 +864,8 @@ void UnpackedVehicle::deactivate()
 		world->removeRigidBody(p->rigid_body);
 		delete p->rigid_body;
 		delete p->motion_state;
+		p->rigid_body = nullptr;
+		p->motion_state = nullptr;
 	}
 
 	single_pieces.clear();
@@ -770,9 +905,120 @@ void UnpackedVehicle::activate()
 	vehicle->packed = false;
 }
 
+void UnpackedVehicle::benchmark(size_t stages, size_t iterations)
+{
+	iterations = std::max(iterations, (size_t)1);
+
+	// Stages are emulated by unwelding pieces evenly spread through the vehicle, which
+	// splits their welded group the same way firing a decoupler does
+	std::vector<Piece*> welded_pieces;
+	for (Piece* p : vehicle->all_pieces)
+	{
+		if (p != vehicle->root && p->welded && p->attached_to != nullptr)
+		{
+			welded_pieces.push_back(p);
+		}
+	}
+
+	stages = std::min(stages, welded_pieces.size());
+	if (stages == 0)
+	{
+		logger->info("Welding benchmark: the vehicle has no welded pieces");
+		return;
+	}
+
+	std::vector<Piece*> stage_pieces;
+	for (size_t i = 0; i < stages; i++)
+	{
+		stage_pieces.push_back(welded_pieces[(i * welded_pieces.size()) / stages]);
+	}
+
+	auto rebuild = [this](bool full)
+	{
+		auto states = get_states_at_start(vehicle);
+		auto start = std::chrono::steady_clock::now();
+		if (full)
+		{
+			// What every rebuild used to do, all groups are built from scratch
+			for (Piece* p : vehicle->all_pieces)
+			{
+				if (p->link != nullptr)
+				{
+					p->link->deactivate();
+				}
+			}
+
+			for (WeldedGroup* group : welded)
+			{
+				destroy_welded_group(group, world);
+			}
+			welded.clear();
+		}
+
+		build_physics(states);
+		return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	};
+
+	double times[2] = {0.0, 0.0};
+	double max_times[2] = {0.0, 0.0};
+	for (size_t i = 0; i < iterations; i++)
+	{
+		for (int full = 0; full < 2; full++)
+		{
+			for (Piece* p : stage_pieces)
+			{
+				p->welded = false;
+				double t = rebuild(full == 1);
+				times[full] += t;
+				max_times[full] = std::max(max_times[full], t);
+			}
+
+			for (Piece* p : stage_pieces)
+			{
+				p->welded = true;
+			}
+			rebuild(false);
+		}
+	}
+
+	double n = (double)(iterations * stages);
+	logger->info("Welding benchmark ({} pieces, {} welded groups, {} stages): {:.4f}ms (max {:.4f}ms) per separation "
+		"incremental, {:.4f}ms (max {:.4f}ms) per separation rebuilding everything", vehicle->all_pieces.size(),
+		welded.size(), stages, times[0] * 1000.0 / n, max_times[0] * 1000.0, times[1] * 1000.0 / n,
+		max_times[1] * 1000.0);
+}
+
+size_t UnpackedVehicle::get_link_count(bool native) const
+{
+	size_t count = 0;
+	for(Piece* p : vehicle->all_pieces)
+	{
+		if(p->link != nullptr && p->link->is_native() == native)
+		{
+			count++;
+		}
+	}
+	return count;
+}
+
+size_t UnpackedVehicle::get_link_memory_usage() const
+{
+	size_t bytes = 0;
+	for(Piece* p : vehicle->all_pieces)
+	{
+		if(p->link != nullptr)
+		{
+			bytes += p->link->get_memory_usage();
+		}
+	}
+	return bytes;
+}
+
 UnpackedVehicle::UnpackedVehicle(Vehicle* v)
 {
 	this->vehicle = v;
+	last_link_check_time = 0.0;
+	last_build_time = 0.0;
 }
 
 void UnpackedVehicle::apply_gravity(btVector3 dir)
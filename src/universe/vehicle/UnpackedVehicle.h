@@ -20,6 +20,11 @@ private:
 	bool breaking_enabled;
 	void handle_piece_separated(Piece* p);
 
+	// Time spent checking for broken links in the last update, in seconds
+	double last_link_check_time;
+	// Time spent in the last build_physics, in seconds
+	double last_build_time;
+
 public:
 	struct PieceState
 	{
@@ -74,6 +79,12 @@ public:
 
 	void set_breaking_enabled(bool value);
 
+	double get_last_link_check_time() const { return last_link_check_time; }
+	double get_last_build_time() const { return last_build_time; }
+	size_t get_link_count(bool native) const;
+	// Lua links only count their wrapper, their environments live in the shared lua state
+	size_t get_link_memory_usage() const;
+
 	void set_world(btDynamicsWorld* n_world)
 	{
 		this->world = n_world;
@@ -84,6 +95,11 @@ public:
 
 	void apply_gravity(btVector3 direction);
 
+	// Separates the given number of stages (evenly spread welded pieces) one by one,
+	// and logs the time taken by build_physics, incrementally and rebuilding every group
+	// The vehicle is welded back afterwards
+	void benchmark(size_t stages, size_t iterations);
+
 	UnpackedVehicle(Vehicle* v);
 
 };
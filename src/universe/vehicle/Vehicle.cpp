@@ -1,4 +1,6 @@
 #include "Vehicle.h"
+#include <util/Timer.h>
+#include <util/Profiler.h>
 
 void Vehicle::unpack()
 {
@@ -20,6 +22,25 @@ void Vehicle::pack()
 {
 	logger->check(!packed, "Tried to pack a packed vehicle");
 
+	// Keep the flight state so the packed vehicle continues where the unpacked one was
+	if(root != nullptr && root->rigid_body != nullptr)
+	{
+		btTransform root_tform = root->get_global_transform() * root->packed_tform.inverse();
+		btTransform inv_root = root_tform.inverse();
+		for(Piece* p : all_pieces)
+		{
+			p->packed_tform = inv_root * p->get_global_transform();
+		}
+
+		WorldState st;
+		st.pos = to_dvec3(root_tform.getOrigin());
+		st.rot = to_dquat(root_tform.getRotation());
+		// Packed vehicles rotate around the center of mass, so this is its velocity
+		st.vel = get_com_state().vel;
+		st.ang_vel = to_dvec3(root->get_angular_velocity());
+		packed_veh.set_world_state(st);
+	}
+
 	packed = true;
 
 	unpacked_veh.deactivate();
@@ -27,6 +48,83 @@ void Vehicle::pack()
 	packed_veh.calculate_com();
 }
 
+LightCartesianState Vehicle::get_com_state()
+{
+	LightCartesianState out;
+	if(packed)
+	{
+		out.pos = packed_veh.get_com_position();
+		out.vel = packed_veh.get_root_state().vel;
+		return out;
+	}
+
+	out.pos = unpacked_veh.get_center_of_mass(false);
+	out.vel = glm::dvec3(0.0, 0.0, 0.0);
+	double tot_mass = 0.0;
+	for(Piece* p : all_pieces)
+	{
+		out.vel += to_dvec3(p->get_linear_velocity()) * p->mass;
+		tot_mass += p->mass;
+	}
+	out.vel /= tot_mass;
+
+	return out;
+}
+
+// Closer than this to a body with surface, vehicles must be landed to timewarp. The margin
+// over the highest terrain leaves room for tall vehicles, as we check their center of mass
+static double get_surface_limit(const SystemElement* elem)
+{
+	return elem->config.radius + elem->config.surface.max_height + 100.0;
+}
+
+int64_t Vehicle::get_landed_element()
+{
+	PlanetarySystem& sys = in_universe->system;
+	LightCartesianState com = get_com_state();
+
+	for(size_t i = 0; i < sys.elements.size(); i++)
+	{
+		SystemElement* elem = sys.elements[i];
+		if(!elem->config.has_surface)
+			continue;
+
+		CartesianState st = sys.get_element_state(i, !packed);
+		glm::dvec3 rel_pos = com.pos - st.pos;
+		if(glm::length(rel_pos) > get_surface_limit(elem))
+			continue;
+
+		glm::dvec3 surface_vel = st.vel + elem->get_tangential_speed(rel_pos);
+		if(glm::length(com.vel - surface_vel) < LANDED_SPEED)
+		{
+			return (int64_t)i;
+		}
+	}
+
+	return -1;
+}
+
+bool Vehicle::is_timewarp_safe()
+{
+	PlanetarySystem& sys = in_universe->system;
+	LightCartesianState com = get_com_state();
+
+	for(size_t i = 0; i < sys.elements.size(); i++)
+	{
+		SystemElement* elem = sys.elements[i];
+		double dist = glm::length(com.pos - sys.get_element_state(i, !packed).pos);
+
+		bool near = elem->config.has_surface && dist < get_surface_limit(elem);
+		near |= elem->config.has_atmo && dist < elem->config.atmo.radius;
+		if(near)
+		{
+			return get_landed_element() >= 0;
+		}
+	}
+
+	return true;
+}
+
 Piece* Vehicle::remove_piece(Piece* p)
 {
 	// TODO: Check links, attachments, etc... So we don't leak memory and create "orphan" stuff
@@ -47,6 +145,8 @@ Piece* Vehicle::remove_piece(Piece* p)
 
 void Vehicle::update(double dt)
 {
+	PROFILE_BLOCK("vehicle");
+
 	for(Part* part : parts)
 	{
 		part->pre_update(dt);
@@ -71,6 +171,8 @@ void Vehicle::editor_update(double dt)
 
 void Vehicle::physics_update(double dt)
 {
+	PROFILE_BLOCK("vehicle");
+
 	if(!packed)
 	{
 		// Generate the gravity vector
@@ -84,8 +186,17 @@ void Vehicle::physics_update(double dt)
 
 	// TODO: Maybe add a pre_plumbing update or sort this stuff?
 
-	plumbing.update_pipes(dt, this);
+	double t0 = Timer::now();
+	{
+		PROFILE_BLOCK("plumbing");
+		plumbing.update_pipes(dt, this);
+	}
+	if(in_universe)
+	{
+		in_universe->timings.plumbing += Timer::now() - t0;
+	}
 
+	PROFILE_BLOCK("parts");
 	for(Part* part : parts)
 	{
 		part->physics_update(dt);
@@ -111,6 +222,14 @@ void Vehicle::init(sol::state* lua_state)
 		part->init(lua_state, this);
 	}
 
+	for(Piece* piece : all_pieces)
+	{
+		if(piece->link)
+		{
+			piece->link->init(lua_state);
+		}
+	}
+
 	plumbing.init();
 }
 
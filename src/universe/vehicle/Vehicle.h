@@ -125,11 +125,22 @@ public:
 	Part* get_part_by_id(int64_t id);
 	Piece* get_piece_by_id(int64_t id);
 
+	// Maximum speed relative to the surface for a vehicle to be considered landed
+	static constexpr double LANDED_SPEED = 0.5;
+
+	// Keeps the current flight state (if unpacked) in the packed vehicle
 	void pack();
 
 	void unpack();
 	bool is_packed() const { return packed; }
 
+	// Position and velocity of the center of mass, packed or unpacked
+	LightCartesianState get_com_state();
+	// Index of the element the vehicle is resting on, or -1 if it's not landed
+	int64_t get_landed_element();
+	// Vehicles can go on rails if they are landed, or away from surfaces and atmospheres
+	bool is_timewarp_safe();
+
 	void set_position(glm::dvec3 pos);
 	void set_linear_velocity(glm::dvec3 vel);
 
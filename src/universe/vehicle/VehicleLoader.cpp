@@ -14,6 +14,17 @@ void VehicleLoader::load_basic(const cpptoml::table& root)
 			n_vehicle->meta.group_names.push_back(gname);
 		}
 	}
+
+	std::string solver = root.get_as<std::string>("plumbing_solver").value_or("paths");
+	if(solver == "nodal")
+	{
+		n_vehicle->plumbing.set_solver(VehiclePlumbing::Solver::NODAL);
+	}
+	else
+	{
+		logger->check(solver == "paths", "Unknown plumbing solver: {}", solver);
+		n_vehicle->plumbing.set_solver(VehiclePlumbing::Solver::PATHS);
+	}
 }
 
 void VehicleLoader::obtain_pipes(const cpptoml::table &root)
@@ -223,7 +234,8 @@ void VehicleLoader::copy_pieces(const cpptoml::table& root)
 			if(link_type != "none")
 			{
 				// Load the physical link
-				p->link = std::make_unique<Link>(osp->assets->load_script(link_type).first);
+				p->link = Link::create(link_type);
+				p->link->load_toml(link);
 
 				glm::dvec3 link_from, link_to;
 				deserialize(p->link_from, *link->get_table_qualified("pfrom"));	
@@ -350,6 +362,9 @@ VehicleSaver::VehicleSaver(cpptoml::table &target, const Vehicle &what)
 	bool in_flight = what.in_universe != nullptr;
 	target.insert("in_flight", in_flight);
 
+	bool nodal = what.plumbing.get_solver() == VehiclePlumbing::Solver::NODAL;
+	target.insert("plumbing_solver", std::string(nodal ? "nodal" : "paths"));
+
 	assign_ids(target, what);
 	write_parts(target, what);
 	write_pieces(target, what);
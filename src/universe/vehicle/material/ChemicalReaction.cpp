@@ -1,7 +1,6 @@
 #include "ChemicalReaction.h"
 #include <assets/AssetManager.h>
 #include <assets/PhysicalMaterial.h>
-#include "../plumbing/StoredFluids.h"
 
 void ChemicalReaction::calculate_constants()
 {
@@ -56,99 +55,11 @@ void ChemicalReaction::calculate_constants()
 	dH = total_h / total_mass;
 }
 
-float ChemicalReaction::react(StoredFluids* fluids, float gas_ammount, float liquid_ammount)
-{
-	// Limiting reagent check
-	float min_gas_ammount = gas_ammount;
-	float min_liquid_ammount = liquid_ammount;
-
-	for(const auto& rct : reactants)
-	{
-		const PhysicalMaterial* mat = fluids->name_to_ptr[rct.reactant];
-		// Only react as much as we can (limiting reagent, adjust)
-		// Reactions may go one way int he gas phase, and another in the liquid phase!
-		// (Positive values mean reacting to the right)
-		if(gas_ammount > 0)
-		{
-			// If we react to the right and we are a reactant, we may be limited
-			if(rct.react_weight > 0 && fluids->contents[mat].gas_mass < rct.react_weight * gas_ammount)
-			{
-				min_gas_ammount = glm::min(fluids->contents[mat].gas_mass / rct.react_weight, min_gas_ammount);
-			}
-		}
-		else
-		{
-			// If we react to the left, everything is inverted
-			if(rct.react_weight < 0 && fluids->contents[mat].gas_mass < rct.react_weight * gas_ammount)
-			{
-				// Note that now, minimum is actually max as everything is negative
-				min_gas_ammount = glm::max(fluids->contents[mat].gas_mass / rct.react_weight, min_gas_ammount);
-			}
-		}
-
-		// Same as for gases
-		if(liquid_ammount > 0)
-		{
-			if(rct.react_weight > 0 && fluids->contents[mat].liquid_mass < rct.react_weight * liquid_ammount)
-			{
-				min_liquid_ammount = glm::min(fluids->contents[mat].liquid_mass / rct.react_weight, min_liquid_ammount);
-			}
-		}
-		else
-		{
-			if(rct.react_weight < 0 && fluids->contents[mat].liquid_mass < rct.react_weight * liquid_ammount)
-			{
-				min_liquid_ammount = glm::max(fluids->contents[mat].liquid_mass / rct.react_weight, min_liquid_ammount);
-			}
-		}
-	}
-
-	liquid_ammount = min_liquid_ammount;
-	gas_ammount = min_gas_ammount;
-
-	// Numerical and mass balance errors should be cancelled to avoid negative masses!
-	if(glm::abs(liquid_ammount) < 0.005f)
-		liquid_ammount = 0.0f;
-
-	if(glm::abs(gas_ammount) < 0.005f)
-		gas_ammount = 0.0f;
-
-	for(const auto& rct : reactants)
-	{
-		const PhysicalMaterial* mat = fluids->name_to_ptr[rct.reactant];
-		fluids->contents[mat].gas_mass -= rct.react_weight * gas_ammount;
-		fluids->contents[mat].liquid_mass -= rct.react_weight * liquid_ammount;
-	}
-
-	return gas_ammount + liquid_ammount;
-}
-
 float ChemicalReaction::get_rate(float T)
 {
 	return 1.0f;
 }
 
-float ChemicalReaction::get_Q(StoredFluids* fluids, float V)
-{
-	// Concentrations of everything is mol / L
-	float Q = 1.0f;
-
-	for(auto r : reactants)
-	{
-		auto mat = fluids->name_to_ptr[r.reactant];
-		float moles = fluids->contents[mat].gas_mass + fluids->contents[mat].liquid_mass;
-		moles /= mat->molar_mass;
-		if(glm::abs(moles) < 0.001f)
-		{
-			// To prevent singularity when there's nothing of a product
-			moles = 0.00001f;
-		}
-		Q *= powf(moles / V, r.moles);
-	}
-
-	return Q;
-}
-
 float ChemicalReaction::get_K(float T)
 {
 	constexpr float R = 8.314462618f;
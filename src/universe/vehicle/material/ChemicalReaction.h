@@ -12,8 +12,6 @@ struct StechiometricMaterial
 	float react_weight;
 };
 
-class StoredFluids;
-
 // Note: We do simulate reversible chemical reactions! We use gibbs free energy for
 // this, and thus all reactions can be reversed!
 // We use the approximation that dS and dH are constant with temperature and thus
@@ -39,13 +37,11 @@ public:
 	// Very approximate values!
 	void calculate_constants();
 
-	// Ammount refers to the total kgs of reactant that convert
-	// Returns total ammount converted
-	float react(StoredFluids* fluids, float gas_ammount, float liquid_ammount);
-
-	float get_Q(StoredFluids* fluids, float V);
 	float get_K(float T);
 
+	// Reactions are run from their compiled form (see MaterialRegistry), where
+	// materials are small ids instead of strings
+
 };
 
 static bool operator==(const ChemicalReaction& a, const ChemicalReaction& b)
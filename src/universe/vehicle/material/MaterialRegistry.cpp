@@ -0,0 +1,160 @@
+#include "MaterialRegistry.h"
+#include "../plumbing/StoredFluids.h"
+
+MaterialRegistry::Id MaterialRegistry::intern(const AssetHandle<PhysicalMaterial>& mat)
+{
+	auto it = ptr_to_id.find(mat.data);
+	if(it != ptr_to_id.end())
+	{
+		return it->second;
+	}
+
+	logger->check(mat.data != nullptr, "Trying to intern a null material");
+	logger->check(handles.size() < MAX_MATERIALS, "Too many materials, a maximum of {} are supported",
+				  MAX_MATERIALS);
+
+	Id id = (Id)handles.size();
+	handles.push_back(mat.duplicate());
+	ptr_to_id[mat.data] = id;
+	return id;
+}
+
+MaterialRegistry::Id MaterialRegistry::intern(const PhysicalMaterial* mat)
+{
+	auto it = ptr_to_id.find(mat);
+	if(it != ptr_to_id.end())
+	{
+		return it->second;
+	}
+
+	return intern(AssetHandle<PhysicalMaterial>(mat->get_asset_id()));
+}
+
+void MaterialRegistry::add_reaction(const ChemicalReaction& reaction)
+{
+	logger->check(reaction.reactants.size() <= MAX_SPECIES, "Reactions may have at most {} species",
+				  MAX_SPECIES);
+
+	CompiledReaction out;
+	out.reactants = 0;
+	out.products = 0;
+	out.dH = reaction.dH;
+	out.K = reaction.K;
+	out.T_of_K = reaction.T_of_K;
+
+	for(const StechiometricMaterial& mat : reaction.reactants)
+	{
+		Species species;
+		species.id = intern(AssetHandle<PhysicalMaterial>(mat.reactant));
+		species.moles = mat.moles;
+		species.react_weight = mat.react_weight;
+		species.molar_mass = get(species.id)->molar_mass;
+		out.species.push_back(species);
+
+		if(mat.moles > 0)
+		{
+			out.reactants |= get_bit(species.id);
+		}
+		else
+		{
+			out.products |= get_bit(species.id);
+		}
+	}
+
+	reactions.push_back(std::move(out));
+}
+
+float MaterialRegistry::CompiledReaction::get_K(float T) const
+{
+	constexpr float R = 8.314462618f;
+	// k2 = k1 * e^((dH / R) * (1 / T1 - 1 / T2))
+	return K * expf((dH / R) * (1.0f / T_of_K - 1 / T));
+}
+
+float MaterialRegistry::CompiledReaction::get_Q(StoredFluid* const* fluids, float V) const
+{
+	// Concentrations of everything is mol / L
+	float Q = 1.0f;
+
+	for(size_t i = 0; i < species.size(); i++)
+	{
+		float moles = fluids[i]->gas_mass + fluids[i]->liquid_mass;
+		moles /= species[i].molar_mass;
+		if(glm::abs(moles) < 0.001f)
+		{
+			// To prevent singularity when there's nothing of a product
+			moles = 0.00001f;
+		}
+		Q *= powf(moles / V, species[i].moles);
+	}
+
+	return Q;
+}
+
+float MaterialRegistry::CompiledReaction::react(StoredFluid* const* fluids, float gas_ammount,
+												float liquid_ammount) const
+{
+	// Limiting reagent check
+	float min_gas_ammount = gas_ammount;
+	float min_liquid_ammount = liquid_ammount;
+
+	for(size_t i = 0; i < species.size(); i++)
+	{
+		const StoredFluid& fluid = *fluids[i];
+		float react_weight = species[i].react_weight;
+		// Only react as much as we can (limiting reagent, adjust)
+		// Reactions may go one way in the gas phase, and another in the liquid phase!
+		// (Positive values mean reacting to the right)
+		if(gas_ammount > 0)
+		{
+			// If we react to the right and we are a reactant, we may be limited
+			if(react_weight > 0 && fluid.gas_mass < react_weight * gas_ammount)
+			{
+				min_gas_ammount = glm::min(fluid.gas_mass / react_weight, min_gas_ammount);
+			}
+		}
+		else
+		{
+			// If we react to the left, everything is inverted
+			if(react_weight < 0 && fluid.gas_mass < react_weight * gas_ammount)
+			{
+				// Note that now, minimum is actually max as everything is negative
+				min_gas_ammount = glm::max(fluid.gas_mass / react_weight, min_gas_ammount);
+			}
+		}
+
+		// Same as for gases
+		if(liquid_ammount > 0)
+		{
+			if(react_weight > 0 && fluid.liquid_mass < react_weight * liquid_ammount)
+			{
+				min_liquid_ammount = glm::min(fluid.liquid_mass / react_weight, min_liquid_ammount);
+			}
+		}
+		else
+		{
+			if(react_weight < 0 && fluid.liquid_mass < react_weight * liquid_ammount)
+			{
+				min_liquid_ammount = glm::max(fluid.liquid_mass / react_weight, min_liquid_ammount);
+			}
+		}
+	}
+
+	liquid_ammount = min_liquid_ammount;
+	gas_ammount = min_gas_ammount;
+
+	// Numerical and mass balance errors should be cancelled to avoid negative masses!
+	if(glm::abs(liquid_ammount) < 0.005f)
+		liquid_ammount = 0.0f;
+
+	if(glm::abs(gas_ammount) < 0.005f)
+		gas_ammount = 0.0f;
+
+	for(size_t i = 0; i < species.size(); i++)
+	{
+		fluids[i]->gas_mass -= species[i].react_weight * gas_ammount;
+		fluids[i]->liquid_mass -= species[i].react_weight * liquid_ammount;
+	}
+
+	return gas_ammount + liquid_ammount;
+}
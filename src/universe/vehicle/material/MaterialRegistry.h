@@ -0,0 +1,79 @@
+#pragma once
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+#include <assets/AssetManager.h>
+#include <assets/PhysicalMaterial.h>
+#include "ChemicalReaction.h"
+
+struct StoredFluid;
+
+// Materials are interned to small integer ids the first time they are used (or when
+// the game database finishes loading), and the handles are kept here so the materials
+// are never unloaded. This way fluids are stored densely by id, and the reactions which
+// may happen in a tank are found with a bitmask of the present species instead of
+// string lookups.
+class MaterialRegistry
+{
+public:
+
+	using Id = uint8_t;
+	using Mask = uint64_t;
+	// One bit per material in a Mask
+	static constexpr size_t MAX_MATERIALS = 64;
+	// Species (reactants + products) in a single reaction
+	static constexpr size_t MAX_SPECIES = 8;
+
+	struct Species
+	{
+		Id id;
+		// Negative if it's on the right hand side
+		int moles;
+		float react_weight;
+		float molar_mass;
+	};
+
+	// A ChemicalReaction with materials turned into ids, see ChemicalReaction for the maths.
+	// Functions take the fluids of each species, in the same order as species
+	struct CompiledReaction
+	{
+		std::vector<Species> species;
+		Mask reactants;
+		Mask products;
+		float dH, K, T_of_K;
+
+		// Rate in kg / (s * m^3), don't forget to account for the reaction volume
+		float get_rate(float T) const { return 1.0f; }
+		float get_K(float T) const;
+		float get_Q(StoredFluid* const* fluids, float V) const;
+		// Ammount refers to the total kgs of reactant that convert
+		// Returns total ammount converted
+		float react(StoredFluid* const* fluids, float gas_ammount, float liquid_ammount) const;
+	};
+
+private:
+
+	std::vector<AssetHandle<PhysicalMaterial>> handles;
+	std::unordered_map<const PhysicalMaterial*, Id> ptr_to_id;
+	std::vector<CompiledReaction> reactions;
+
+public:
+
+	// Returns the id of the material, interning it if it's new
+	Id intern(const AssetHandle<PhysicalMaterial>& mat);
+	Id intern(const PhysicalMaterial* mat);
+	const PhysicalMaterial* get(Id id) const { return handles[id].data; }
+	size_t get_count() const { return handles.size(); }
+
+	void add_reaction(const ChemicalReaction& reaction);
+	const std::vector<CompiledReaction>& get_reactions() const { return reactions; }
+
+	// Reactions are run in every tank that stores any of their species (even if there's
+	// no mass of it), the reaction quotient decides which way they go
+	static bool involves(const CompiledReaction& reaction, Mask stored)
+	{
+		return ((reaction.reactants | reaction.products) & stored) != 0;
+	}
+
+	static Mask get_bit(Id id) { return (Mask)1 << id; }
+};
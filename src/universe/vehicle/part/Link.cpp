@@ -1,3 +1,23 @@
 #include "Link.h"
+#include "link/NativeLink.h"
+#include "link/LuaLink.h"
 
-
+std::unique_ptr<Link> Link::create(const std::string& type)
+{
+	if(type == "fixed")
+	{
+		return std::make_unique<FixedLink>();
+	}
+	else if(type == "hinge")
+	{
+		return std::make_unique<HingeLink>();
+	}
+	else if(type == "breakable_fixed")
+	{
+		return std::make_unique<BreakableFixedLink>();
+	}
+	else
+	{
+		return std::make_unique<LuaLink>(type);
+	}
+}
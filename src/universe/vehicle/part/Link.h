@@ -9,46 +9,47 @@
 #include "../../../util/LuaUtil.h"
 #include "../../../lua/libs/LuaBullet.h"
 #include <cpptoml.h>
+#include <memory>
 
 // Base class for any link, which can be as simple as
 // a bullet3 constraint, or as complex as a soft-body rope
+// Common links are implemented natively (see link/NativeLink.h), and
+// custom behaviour can be scripted in lua (see link/LuaLink.h)
 class Link
 {
+protected:
+
+	// Return true if the link has broken, only called if initialized
+	virtual bool check_broken() = 0;
+
 public:
 
 	bool is_initialized;
-	sol::state lua_state;
 
-	// Called during loading of the link to give it its 
+	// Creates the link given its type, which is either the name of a native
+	// link ("fixed", "hinge", "breakable_fixed") or the path to a lua script
+	static std::unique_ptr<Link> create(const std::string& type);
+
+	// Called when the vehicle is initialized, lua links load their script here
+	// into an environment of the shared lua state
+	virtual void init(sol::state* lua_state) {}
+
+	// Called during loading of the link to give it its
 	// toml serialized data
-	void load_toml(std::shared_ptr<cpptoml::table> data)
-	{
-		LuaUtil::call_function(lua_state["load_toml"], data);
-	}
+	virtual void load_toml(std::shared_ptr<cpptoml::table> data) = 0;
 
 	// Called when the pieces are unwelded, or first created
-	void activate(
+	virtual void activate(
 		btRigidBody* from, btTransform from_frame,
 		btRigidBody* to, btTransform to_frame,
 		btDynamicsWorld* world
-	)
-	{
-		is_initialized = true;
-
-		LuaUtil::call_function(lua_state["activate"],
-				from, BulletTransform(from_frame), to, BulletTransform(to_frame), world);
-	}
+	) = 0;
 
 	// Called when the pieces are welded
 	// Keep in mind special links may have to implement some custom
 	// functionality to keep the previous state if they are reactivated,
 	// for example, ropes or motors which must remember their last position
-	void deactivate()
-	{
-		is_initialized = false;
-
-		LuaUtil::call_function(lua_state["deactivate"]);
-	}
+	virtual void deactivate() = 0;
 
 	// Return true if the link has broken and should be deleted
 	bool is_broken()
@@ -59,19 +60,21 @@ public:
 		}
 		else
 		{
-			return LuaUtil::call_function(lua_state["is_broken"]).get<bool>();
+			return check_broken();
 		}
 	}
 
-	void set_breaking_enabled(bool value)
-	{
-		LuaUtil::call_function(lua_state["set_breaking_enabled"], value);
-	}
+	virtual void set_breaking_enabled(bool value) = 0;
+
+	virtual bool is_native() const = 0;
+	// Approximate bytes used by the link itself (lua links only count their
+	// wrapper, their environment lives in the shared lua state)
+	virtual size_t get_memory_usage() const = 0;
 
-	Link(sol::state&& st)
+	Link()
 	{
-		this->lua_state = std::move(st);
 		is_initialized = false;
 	}
-};
 
+	virtual ~Link() = default;
+};
@@ -1,6 +1,7 @@
 #include "Machine.h"
 #include <util/Logger.h>
 #include <util/SerializeUtil.h>
+#include <util/Profiler.h>
 #include <assets/AssetManager.h>
 #include <lua/libs/LuaAssets.h>
 #include <game/database/GameDatabase.h>
@@ -35,6 +36,7 @@ void Machine::pre_update(double dt)
 {
 	if(!paused || step)
 	{
+		PROFILE_BLOCK("lua_machine_pre_update");
 		LuaUtil::call_function_if_present(env["pre_update"], dt);
 	}
 }
@@ -43,6 +45,7 @@ void Machine::update(double dt)
 {
 	if(!paused || step)
 	{
+		PROFILE_BLOCK("lua_machine_update");
 		LuaUtil::call_function_if_present(env["update"], dt);
 		step = false;
 	}
@@ -52,6 +55,7 @@ void Machine::physics_update(double dt)
 {
 	if(!paused || step)
 	{
+		PROFILE_BLOCK("lua_machine_physics_update");
 		LuaUtil::call_function_if_present(env["physics_update"], dt);
 		// TODO: Handle step properly?
 	}
@@ -0,0 +1,82 @@
+#include "LuaLink.h"
+#include <assets/AssetManager.h>
+#include <util/LuaUtil.h>
+#include <lua/libs/LuaBullet.h>
+
+void LuaLink::init(sol::state* lua_state)
+{
+	if(this->lua_state == lua_state)
+	{
+		return;
+	}
+
+	this->lua_state = lua_state;
+
+	auto[pkg, name] = osp->assets->get_package_and_name(script_path, osp->assets->get_current_package());
+
+	// We create a new environment for our script, same as machines
+	env = sol::environment(*lua_state, sol::create, lua_state->globals());
+	lua_core->load((sol::table&)env, pkg);
+
+	std::string full_path = osp->assets->res_path + pkg + "/" + name;
+	logger->check(AssetManager::file_exists(full_path), "Tried to load a link script which does not exist ({})", script_path);
+	auto result = (*lua_state).safe_script_file(full_path, env);
+	if(!result.valid())
+	{
+		sol::error err = result;
+		logger->fatal("Lua Error loading link {}:\n{}", script_path, err.what());
+	}
+
+	if(toml)
+	{
+		LuaUtil::call_function(env["load_toml"], toml);
+	}
+}
+
+void LuaLink::load_toml(std::shared_ptr<cpptoml::table> data)
+{
+	toml = data;
+	if(lua_state)
+	{
+		LuaUtil::call_function(env["load_toml"], toml);
+	}
+}
+
+void LuaLink::activate(btRigidBody* from, btTransform from_frame, btRigidBody* to, btTransform to_frame,
+					   btDynamicsWorld* world)
+{
+	logger->check(lua_state != nullptr, "Lua link {} activated before the vehicle was initialized", script_path);
+	is_initialized = true;
+
+	LuaUtil::call_function(env["activate"],
+			from, BulletTransform(from_frame), to, BulletTransform(to_frame), world);
+}
+
+void LuaLink::deactivate()
+{
+	is_initialized = false;
+
+	if(lua_state)
+	{
+		LuaUtil::call_function(env["deactivate"]);
+	}
+}
+
+bool LuaLink::check_broken()
+{
+	return LuaUtil::call_function(env["is_broken"]).get<bool>();
+}
+
+void LuaLink::set_breaking_enabled(bool value)
+{
+	if(lua_state)
+	{
+		LuaUtil::call_function(env["set_breaking_enabled"], value);
+	}
+}
+
+LuaLink::LuaLink(const std::string& script_path)
+{
+	this->script_path = script_path;
+	lua_state = nullptr;
+}
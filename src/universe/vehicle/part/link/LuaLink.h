@@ -0,0 +1,39 @@
+#pragma once
+#include "../Link.h"
+
+// A link implemented in a lua script. All lua links of a vehicle share the
+// vehicle's lua state (same as machines), each one running in its own environment
+// The script must implement load_toml, activate, deactivate, is_broken and set_breaking_enabled
+class LuaLink : public Link
+{
+private:
+
+	std::string script_path;
+	std::shared_ptr<cpptoml::table> toml;
+
+	sol::state* lua_state;
+	sol::environment env;
+
+protected:
+
+	bool check_broken() override;
+
+public:
+
+	void init(sol::state* lua_state) override;
+	void load_toml(std::shared_ptr<cpptoml::table> data) override;
+
+	void activate(
+		btRigidBody* from, btTransform from_frame,
+		btRigidBody* to, btTransform to_frame,
+		btDynamicsWorld* world
+	) override;
+
+	void deactivate() override;
+	void set_breaking_enabled(bool value) override;
+
+	bool is_native() const override { return false; }
+	size_t get_memory_usage() const override { return sizeof(LuaLink) + script_path.capacity(); }
+
+	explicit LuaLink(const std::string& script_path);
+};
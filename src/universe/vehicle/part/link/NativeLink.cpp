@@ -0,0 +1,143 @@
+#include "NativeLink.h"
+#include <universe/Universe.h>
+#include <util/Logger.h>
+
+btTypedConstraint* FixedLink::create_constraint(btRigidBody* from, btTransform from_frame, btRigidBody* to,
+												btTransform to_frame)
+{
+	return new btFixedConstraint(*from, *to, from_frame, to_frame);
+}
+
+bool FixedLink::check_broken()
+{
+	return constraint == nullptr || !constraint->isEnabled();
+}
+
+void FixedLink::activate(btRigidBody* from, btTransform from_frame, btRigidBody* to, btTransform to_frame,
+						 btDynamicsWorld* world)
+{
+	is_initialized = true;
+
+	if(constraint == nullptr)
+	{
+		this->world = world;
+		constraint = create_constraint(from, from_frame, to, to_frame);
+		// Pieces joined by a link never collide with each other
+		world->addConstraint(constraint, true);
+	}
+}
+
+void FixedLink::deactivate()
+{
+	is_initialized = false;
+
+	if(constraint != nullptr)
+	{
+		world->removeConstraint(constraint);
+		delete constraint;
+		constraint = nullptr;
+		world = nullptr;
+	}
+}
+
+size_t FixedLink::get_memory_usage() const
+{
+	return sizeof(FixedLink) + (constraint ? sizeof(btFixedConstraint) : 0);
+}
+
+FixedLink::FixedLink()
+{
+	constraint = nullptr;
+	world = nullptr;
+}
+
+FixedLink::~FixedLink()
+{
+	deactivate();
+}
+
+btTypedConstraint* HingeLink::create_constraint(btRigidBody* from, btTransform from_frame, btRigidBody* to,
+												btTransform to_frame)
+{
+	auto* hinge = new btHingeConstraint(*from, *to, from_frame, to_frame, false);
+	if(limited)
+	{
+		hinge->setLimit((btScalar)lower_limit, (btScalar)upper_limit);
+	}
+	return hinge;
+}
+
+void HingeLink::load_toml(std::shared_ptr<cpptoml::table> data)
+{
+	auto lower = data->get_qualified_as<double>("lower_limit");
+	auto upper = data->get_qualified_as<double>("upper_limit");
+	logger->check((bool)lower == (bool)upper, "Hinge links need both lower_limit and upper_limit, or none");
+
+	limited = (bool)lower;
+	if(limited)
+	{
+		lower_limit = *lower;
+		upper_limit = *upper;
+		logger->check(lower_limit <= upper_limit, "Hinge link lower_limit must be less than upper_limit");
+	}
+}
+
+size_t HingeLink::get_memory_usage() const
+{
+	return sizeof(HingeLink) + (constraint ? sizeof(btHingeConstraint) : 0);
+}
+
+HingeLink::HingeLink()
+{
+	limited = false;
+	lower_limit = 0.0;
+	upper_limit = 0.0;
+}
+
+void BreakableFixedLink::update_threshold()
+{
+	if(constraint == nullptr)
+	{
+		return;
+	}
+
+	if(breaking_enabled)
+	{
+		// Bullet works with impulses over a substep
+		constraint->setBreakingImpulseThreshold((btScalar)(break_force * Universe::PHYSICS_STEPSIZE));
+	}
+	else
+	{
+		constraint->setBreakingImpulseThreshold(SIMD_INFINITY);
+	}
+}
+
+btTypedConstraint* BreakableFixedLink::create_constraint(btRigidBody* from, btTransform from_frame,
+														 btRigidBody* to, btTransform to_frame)
+{
+	btTypedConstraint* out = FixedLink::create_constraint(from, from_frame, to, to_frame);
+	constraint = out;
+	update_threshold();
+	return out;
+}
+
+void BreakableFixedLink::load_toml(std::shared_ptr<cpptoml::table> data)
+{
+	auto force = data->get_qualified_as<double>("break_force");
+	logger->check((bool)force, "Breakable links need a break_force");
+	break_force = *force;
+	logger->check(break_force > 0.0, "Breakable link break_force must be positive");
+	update_threshold();
+}
+
+void BreakableFixedLink::set_breaking_enabled(bool value)
+{
+	breaking_enabled = value;
+	update_threshold();
+}
+
+BreakableFixedLink::BreakableFixedLink()
+{
+	break_force = 0.0;
+	breaking_enabled = true;
+}
@@ -0,0 +1,85 @@
+#pragma once
+#include "../Link.h"
+
+// Native links wrap a single bullet constraint, which they own. They are much cheaper
+// than lua links, as they don't need any lua calls every frame
+
+// Rigidly joins both pieces, never breaks
+// toml: none
+class FixedLink : public Link
+{
+protected:
+
+	btTypedConstraint* constraint;
+	btDynamicsWorld* world;
+
+	bool check_broken() override;
+	virtual btTypedConstraint* create_constraint(btRigidBody* from, btTransform from_frame,
+												 btRigidBody* to, btTransform to_frame);
+
+public:
+
+	void load_toml(std::shared_ptr<cpptoml::table> data) override {}
+
+	void activate(
+		btRigidBody* from, btTransform from_frame,
+		btRigidBody* to, btTransform to_frame,
+		btDynamicsWorld* world
+	) override;
+
+	void deactivate() override;
+	void set_breaking_enabled(bool value) override {}
+
+	bool is_native() const override { return true; }
+	size_t get_memory_usage() const override;
+
+	FixedLink();
+	~FixedLink() override;
+};
+
+// Rotates around the Z axis of the link frame (link_rot), optionally limited
+// toml: lower_limit, upper_limit (radians, optional. No limit if not present)
+class HingeLink : public FixedLink
+{
+private:
+
+	bool limited;
+	double lower_limit, upper_limit;
+
+protected:
+
+	btTypedConstraint* create_constraint(btRigidBody* from, btTransform from_frame,
+										 btRigidBody* to, btTransform to_frame) override;
+
+public:
+
+	void load_toml(std::shared_ptr<cpptoml::table> data) override;
+
+	size_t get_memory_usage() const override;
+
+	HingeLink();
+};
+
+// Rigidly joins both pieces until the force on the joint goes over a threshold
+// toml: break_force (N)
+class BreakableFixedLink : public FixedLink
+{
+private:
+
+	double break_force;
+	bool breaking_enabled;
+
+	void update_threshold();
+
+protected:
+
+	btTypedConstraint* create_constraint(btRigidBody* from, btTransform from_frame,
+										 btRigidBody* to, btTransform to_frame) override;
+
+public:
+
+	void load_toml(std::shared_ptr<cpptoml::table> data) override;
+	void set_breaking_enabled(bool value) override;
+
+	BreakableFixedLink();
+};
@@ -0,0 +1,442 @@
+#include "PlumbingNetwork.h"
+#include <cmath>
+#include <limits>
+#include <algorithm>
+
+uint32_t PlumbingNetwork::add_node(bool fixed, double pressure)
+{
+	Node node;
+	node.pressure = pressure;
+	node.fixed = fixed;
+	node.net_flow = 0.0;
+	node.component = NO_COMPONENT;
+	nodes.push_back(node);
+	return (uint32_t)(nodes.size() - 1);
+}
+
+uint32_t PlumbingNetwork::add_edge(uint32_t from, uint32_t to, double k, bool reversible)
+{
+	Edge edge;
+	edge.from = from;
+	edge.to = to;
+	edge.k = k;
+	edge.max_flow = -1.0;
+	edge.reversible = reversible;
+	edge.has_drop = false;
+	edge.drop = 0.0;
+	edge.reverse_drop = 0.0;
+	edge.flow = 0.0;
+	edges.push_back(edge);
+	return (uint32_t)(edges.size() - 1);
+}
+
+void PlumbingNetwork::build()
+{
+	node_offsets.assign(nodes.size() + 1, 0);
+	for(const Edge& edge : edges)
+	{
+		node_offsets[edge.from + 1]++;
+		node_offsets[edge.to + 1]++;
+	}
+	for(size_t i = 0; i < nodes.size(); i++)
+	{
+		node_offsets[i + 1] += node_offsets[i];
+	}
+
+	node_edges.resize(node_offsets.back());
+	std::vector<uint32_t> fill(node_offsets.begin(), node_offsets.end() - 1);
+	for(size_t i = 0; i < edges.size(); i++)
+	{
+		node_edges[fill[edges[i].from]++] = (uint32_t)i;
+		node_edges[fill[edges[i].to]++] = (uint32_t)i;
+	}
+
+	// Flood fill the components
+	component_count = 0;
+	std::vector<uint32_t> open;
+	for(Node& node : nodes)
+	{
+		node.component = NO_COMPONENT;
+	}
+
+	for(size_t start = 0; start < nodes.size(); start++)
+	{
+		if(nodes[start].component != NO_COMPONENT)
+		{
+			continue;
+		}
+
+		nodes[start].component = component_count;
+		open.push_back((uint32_t)start);
+		while(!open.empty())
+		{
+			uint32_t node = open.back();
+			open.pop_back();
+			for(uint32_t i = node_offsets[node]; i < node_offsets[node + 1]; i++)
+			{
+				const Edge& edge = edges[node_edges[i]];
+				uint32_t other = edge.from == node ? edge.to : edge.from;
+				if(nodes[other].component == NO_COMPONENT)
+				{
+					nodes[other].component = component_count;
+					open.push_back(other);
+				}
+			}
+		}
+		component_count++;
+	}
+
+	jacobian.resize(edges.size());
+}
+
+double PlumbingNetwork::get_flow(const Edge& edge, double dp, double& derivative) const
+{
+	// The flow is k * x / sqrt(|x| + epsilon), which is k * sqrt(x) but smooth around 0
+	double x = dp - edge.drop;
+	double y = -dp - edge.reverse_drop;
+	double flow;
+	if(x >= 0.0)
+	{
+		double s = std::sqrt(x + epsilon);
+		flow = edge.k * x / s;
+		derivative = edge.k * (x + 2.0 * epsilon) / (2.0 * s * s * s);
+	}
+	else if(edge.reversible && y >= 0.0)
+	{
+		double s = std::sqrt(y + epsilon);
+		flow = -edge.k * y / s;
+		derivative = edge.k * (y + 2.0 * epsilon) / (2.0 * s * s * s);
+	}
+	else
+	{
+		// Closed check valve, or the drops are bigger than the pressure difference. It keeps
+		// a tiny derivative so no node is left without equation
+		flow = 0.0;
+		derivative = edge.k * 1e-6 / std::sqrt(epsilon);
+	}
+
+	if(edge.max_flow >= 0.0 && std::abs(flow) > edge.max_flow)
+	{
+		flow = flow > 0.0 ? edge.max_flow : -edge.max_flow;
+		derivative = edge.k * 1e-6 / std::sqrt(epsilon);
+	}
+
+	return flow;
+}
+
+void PlumbingNetwork::multiply(const std::vector<double>& v, std::vector<double>& out) const
+{
+	// Only between free nodes, fixed nodes don't move
+	for(size_t n = 0; n < nodes.size(); n++)
+	{
+		if(!solved[n])
+		{
+			continue;
+		}
+
+		double sum = 0.0;
+		for(uint32_t i = node_offsets[n]; i < node_offsets[n + 1]; i++)
+		{
+			uint32_t e = node_edges[i];
+			uint32_t other = edges[e].from == n ? edges[e].to : edges[e].from;
+			sum += jacobian[e] * (v[n] - (solved[other] ? v[other] : 0.0));
+		}
+		out[n] = sum;
+	}
+}
+
+void PlumbingNetwork::solve_linear(size_t max_iterations)
+{
+	// The jacobian is a weighted graph laplacian, symmetric and positive definite once
+	// fixed nodes are removed, so Jacobi preconditioned conjugate gradient is used
+	size_t count = nodes.size();
+	diag.assign(count, 0.0);
+	for(size_t n = 0; n < count; n++)
+	{
+		if(solved[n])
+		{
+			for(uint32_t i = node_offsets[n]; i < node_offsets[n + 1]; i++)
+			{
+				diag[n] += jacobian[node_edges[i]];
+			}
+		}
+	}
+
+	x.assign(count, 0.0);
+	r = rhs;
+	z.assign(count, 0.0);
+	ap.assign(count, 0.0);
+	double rz = 0.0, r0 = 0.0;
+	for(size_t n = 0; n < count; n++)
+	{
+		if(solved[n])
+		{
+			z[n] = r[n] / diag[n];
+			rz += r[n] * z[n];
+			r0 = std::max(r0, std::abs(r[n]));
+		}
+	}
+	p = z;
+
+	for(size_t it = 0; it < max_iterations; it++)
+	{
+		double r_max = 0.0;
+		for(size_t n = 0; n < count; n++)
+		{
+			r_max = std::max(r_max, std::abs(r[n]));
+		}
+		if(r_max <= 1e-6 * r0 || rz == 0.0)
+		{
+			break;
+		}
+
+		multiply(p, ap);
+		double pap = 0.0;
+		for(size_t n = 0; n < count; n++)
+		{
+			pap += p[n] * ap[n];
+		}
+		if(pap <= 0.0)
+		{
+			break;
+		}
+
+		double alpha = rz / pap;
+		double new_rz = 0.0;
+		for(size_t n = 0; n < count; n++)
+		{
+			if(solved[n])
+			{
+				x[n] += alpha * p[n];
+				r[n] -= alpha * ap[n];
+				z[n] = r[n] / diag[n];
+				new_rz += r[n] * z[n];
+			}
+		}
+
+		double beta = new_rz / rz;
+		rz = new_rz;
+		for(size_t n = 0; n < count; n++)
+		{
+			p[n] = z[n] + beta * p[n];
+		}
+	}
+}
+
+void PlumbingNetwork::relax_node(uint32_t n)
+{
+	// The flow out of a node only grows with its pressure, so the pressure which balances
+	// it (given the neighbours) is found by bisection. Slow, but works where the flows are
+	// flat (closed or limited edges) and Newton gets stuck
+	double lo = std::numeric_limits<double>::max();
+	double hi = std::numeric_limits<double>::lowest();
+	for(uint32_t i = node_offsets[n]; i < node_offsets[n + 1]; i++)
+	{
+		const Edge& edge = edges[node_edges[i]];
+		uint32_t other = edge.from == n ? edge.to : edge.from;
+		double drop = std::max(std::abs(edge.drop), std::abs(edge.reverse_drop));
+		lo = std::min(lo, nodes[other].pressure - drop - epsilon);
+		hi = std::max(hi, nodes[other].pressure + drop + epsilon);
+	}
+
+	auto net_flow = [this, n](double pressure)
+	{
+		double sum = 0.0, derivative;
+		for(uint32_t i = node_offsets[n]; i < node_offsets[n + 1]; i++)
+		{
+			const Edge& edge = edges[node_edges[i]];
+			if(edge.from == n)
+			{
+				sum += get_flow(edge, pressure - nodes[edge.to].pressure, derivative);
+			}
+			else
+			{
+				sum -= get_flow(edge, nodes[edge.from].pressure - pressure, derivative);
+			}
+		}
+		return sum;
+	};
+
+	for(size_t i = 0; i < 48 && hi - lo > epsilon * 1e-3; i++)
+	{
+		double mid = (lo + hi) * 0.5;
+		if(net_flow(mid) > 0.0)
+		{
+			hi = mid;
+		}
+		else
+		{
+			lo = mid;
+		}
+	}
+
+	nodes[n].pressure = (lo + hi) * 0.5;
+}
+
+double PlumbingNetwork::update_flows()
+{
+	// Flows under the one at 1 unit of pressure difference are negligible
+	double max_flow = 0.0;
+	for(const Edge& edge : edges)
+	{
+		max_flow = std::max(max_flow, edge.k);
+	}
+	for(Node& node : nodes)
+	{
+		node.net_flow = 0.0;
+	}
+	for(size_t i = 0; i < edges.size(); i++)
+	{
+		Edge& edge = edges[i];
+		if(!has_fixed[nodes[edge.from].component])
+		{
+			edge.flow = 0.0;
+			jacobian[i] = 0.0;
+			continue;
+		}
+
+		double dp = nodes[edge.from].pressure - nodes[edge.to].pressure;
+		edge.flow = get_flow(edge, dp, jacobian[i]);
+		nodes[edge.from].net_flow += edge.flow;
+		nodes[edge.to].net_flow -= edge.flow;
+		max_flow = std::max(max_flow, std::abs(edge.flow));
+	}
+
+	double norm = 0.0;
+	last_residual = 0.0;
+	for(size_t n = 0; n < nodes.size(); n++)
+	{
+		if(solved[n])
+		{
+			norm += nodes[n].net_flow * nodes[n].net_flow;
+			if(max_flow > 0.0)
+			{
+				last_residual = std::max(last_residual, std::abs(nodes[n].net_flow) / max_flow);
+			}
+		}
+	}
+
+	return norm;
+}
+
+bool PlumbingNetwork::solve(const DropFunc& update_drops, size_t max_iterations, size_t linear_iterations,
+							double tolerance)
+{
+	// Unknown pressures start at the average pressure of the fixed nodes of their component,
+	// components without fixed nodes can't flow
+	std::vector<double> comp_sum(component_count, 0.0);
+	std::vector<size_t> comp_count(component_count, 0);
+	for(const Node& node : nodes)
+	{
+		if(node.fixed)
+		{
+			comp_sum[node.component] += node.pressure;
+			comp_count[node.component]++;
+		}
+	}
+
+	has_fixed.assign(component_count, 0);
+	solved.assign(nodes.size(), 0);
+	for(size_t n = 0; n < nodes.size(); n++)
+	{
+		Node& node = nodes[n];
+		size_t count = comp_count[node.component];
+		has_fixed[node.component] = count != 0;
+		if(!node.fixed && count != 0)
+		{
+			solved[n] = node_offsets[n] != node_offsets[n + 1];
+			if(std::isnan(node.pressure))
+			{
+				node.pressure = comp_sum[node.component] / (double)count;
+			}
+		}
+	}
+
+	// Damped Newton iterations over the free pressures. Flows out of every free node
+	// must add up to 0, and the step is halved until that imbalance gets smaller
+	auto call_drops = [this, &update_drops]()
+	{
+		if(update_drops)
+		{
+			for(size_t i = 0; i < edges.size(); i++)
+			{
+				if(edges[i].has_drop)
+				{
+					update_drops(i);
+				}
+			}
+		}
+	};
+
+	call_drops();
+	double norm = update_flows();
+	bool converged = last_residual <= tolerance;
+	last_iterations = 0;
+	while(last_iterations < max_iterations && !converged)
+	{
+		last_iterations++;
+
+		rhs.assign(nodes.size(), 0.0);
+		for(size_t n = 0; n < nodes.size(); n++)
+		{
+			rhs[n] = solved[n] ? -nodes[n].net_flow : 0.0;
+		}
+		solve_linear(linear_iterations);
+
+		start_pressure.resize(nodes.size());
+		for(size_t n = 0; n < nodes.size(); n++)
+		{
+			start_pressure[n] = nodes[n].pressure;
+		}
+
+		double t = 1.0;
+		double start_norm = norm;
+		bool improved = false;
+		for(size_t halvings = 0; halvings < 12 && !improved; halvings++)
+		{
+			for(size_t n = 0; n < nodes.size(); n++)
+			{
+				if(solved[n])
+				{
+					nodes[n].pressure = start_pressure[n] + t * x[n];
+				}
+			}
+
+			call_drops();
+			norm = update_flows();
+			improved = norm <= (1.0 - 0.5 * t) * start_norm;
+			t *= 0.5;
+		}
+
+		if(!improved)
+		{
+			// Newton is stuck, relax every node on its own instead
+			for(size_t n = 0; n < nodes.size(); n++)
+			{
+				nodes[n].pressure = start_pressure[n];
+			}
+			for(uint32_t n = 0; n < (uint32_t)nodes.size(); n++)
+			{
+				if(solved[n])
+				{
+					relax_node(n);
+				}
+			}
+
+			call_drops();
+			norm = update_flows();
+		}
+
+		converged = last_residual <= tolerance;
+	}
+
+	return converged;
+}
+
+PlumbingNetwork::PlumbingNetwork()
+{
+	component_count = 0;
+	last_iterations = 0;
+	last_residual = 0.0;
+	epsilon = 1.0;
+}
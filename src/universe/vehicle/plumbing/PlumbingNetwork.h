@@ -0,0 +1,108 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <functional>
+
+// Solves the flows in a plumbing network as a set of nodes (ports) joined by edges (pipes
+// and the connections inside flow machines). Nodes with fixed pressure (true ports, such
+// as tanks and engines) drive the flows, the rest of nodes must not accumulate fluid, so
+// their pressures are found so that flows into them equal flows out of them.
+// Every edge follows a sqrt law (flow = k * sqrt(pressure difference)), shifted by the
+// pressure drop of the edge (negative for pumps), and may be one way (check valves)
+// and have a maximum flow.
+// The system is solved with damped Newton iterations, where every linear system is solved
+// with preconditioned conjugate gradient over the sparse node-edge graph. If Newton gets
+// stuck (flows are flat on closed and limited edges), nodes are relaxed one at a time.
+// Pressures are kept between solves, so if the network didn't change much only a couple
+// iterations are needed. It doesn't know about fluids or machines, so it can be used on its own.
+class PlumbingNetwork
+{
+public:
+
+	static constexpr uint32_t NO_COMPONENT = 0xFFFFFFFF;
+
+	struct Node
+	{
+		double pressure;
+		bool fixed;
+		// Flow from the node into the network, only non-zero on fixed nodes once solved
+		double net_flow;
+		// Nodes connected by any path share the component
+		uint32_t component;
+	};
+
+	struct Edge
+	{
+		uint32_t from, to;
+		double k;
+		// Maximum absolute flow, negative if there's none
+		double max_flow;
+		// If false, fluid may only flow from -> to
+		bool reversible;
+		// If true, drops are updated every iteration by the DropFunc
+		bool has_drop;
+		// Pressure drop going from -> to, and going to -> from
+		double drop, reverse_drop;
+		// Positive means from -> to
+		double flow;
+	};
+
+	// Called with the edge index for every edge with has_drop, so the drops can be updated
+	// using the current pressures
+	using DropFunc = std::function<void(size_t edge)>;
+
+private:
+
+	// Edges of every node, node_edges[node_offsets[i]] to node_edges[node_offsets[i + 1]]
+	std::vector<uint32_t> node_offsets;
+	std::vector<uint32_t> node_edges;
+	uint32_t component_count;
+
+	// Derivative of the flow of each edge with respect to P_from - P_to
+	std::vector<double> jacobian;
+
+	// Free nodes in components with fixed nodes, which are solved for
+	std::vector<uint8_t> solved;
+	std::vector<uint8_t> has_fixed;
+	// Conjugate gradient work vectors
+	std::vector<double> rhs, diag, x, r, z, p, ap;
+	std::vector<double> start_pressure;
+
+	size_t last_iterations;
+	double last_residual;
+
+	double get_flow(const Edge& edge, double dp, double& derivative) const;
+	void multiply(const std::vector<double>& v, std::vector<double>& out) const;
+	// Solves jacobian * x = rhs for the free nodes
+	void solve_linear(size_t max_iterations);
+	// Sets the pressure of a free node so its flows are balanced, keeping the rest
+	void relax_node(uint32_t n);
+	// Flows, jacobian and residual with the current pressures, returns the squared imbalance
+	double update_flows();
+
+public:
+
+	std::vector<Node> nodes;
+	std::vector<Edge> edges;
+
+	// Regularization of the sqrt law around 0, in pressure units
+	double epsilon;
+
+	uint32_t add_node(bool fixed, double pressure);
+	uint32_t add_edge(uint32_t from, uint32_t to, double k, bool reversible);
+
+	// Call once all nodes and edges are added, before solving
+	void build();
+
+	// Returns true if converged. Fixed node pressures must be set before solving, free nodes
+	// with NaN pressure start at the average pressure of the fixed nodes
+	bool solve(const DropFunc& update_drops, size_t max_iterations = 24, size_t linear_iterations = 64,
+			   double tolerance = 1e-3);
+
+	uint32_t get_component_count() const { return component_count; }
+	size_t get_last_iterations() const { return last_iterations; }
+	// Biggest mass imbalance in a free node, relative to the biggest flow
+	double get_last_residual() const { return last_residual; }
+
+	PlumbingNetwork();
+};
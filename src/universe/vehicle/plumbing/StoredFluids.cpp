@@ -1,83 +1,108 @@
 #include "StoredFluids.h"
 #include <game/database/GameDatabase.h>
+#include <chrono>
+#include <algorithm>
+
+int StoredFluids::find(MaterialRegistry::Id id) const
+{
+	for(size_t i = 0; i < fluids.size(); i++)
+	{
+		if(fluids[i].id == id)
+		{
+			return (int)i;
+		}
+		else if(fluids[i].id > id)
+		{
+			break;
+		}
+	}
+
+	return -1;
+}
+
+StoredFluid& StoredFluids::get_or_add(MaterialRegistry::Id id)
+{
+	size_t pos = 0;
+	while(pos < fluids.size() && fluids[pos].id < id)
+	{
+		pos++;
+	}
+
+	if(pos < fluids.size() && fluids[pos].id == id)
+	{
+		return fluids[pos].fluid;
+	}
+
+	return fluids.insert(pos, Entry{id, StoredFluid()}).fluid;
+}
+
+StoredFluid* StoredFluids::get_fluid(const PhysicalMaterial* mat)
+{
+	int idx = find(osp->game_database->material_registry.intern(mat));
+	return idx < 0 ? nullptr : &fluids[idx].fluid;
+}
 
 StoredFluids StoredFluids::modify(const StoredFluids &b)
 {
 	StoredFluids out;
 	float final_heat = get_total_heat_capacity() * temperature + b.get_total_heat_capacity() * b.temperature;
 
-	for(const auto& pair : b.contents)
+	for(const Entry& entry : b.fluids)
 	{
-		auto it = contents.find(pair.first);
-		if(it == contents.end())
+		int idx = find(entry.id);
+		if(idx < 0)
 		{
-			// We create a new AssetHandle here to store it as we are creating the key
-			for(auto& ast : b.mat_ptrs)
-			{
-				if(ast.data == pair.first)
-				{
-					mat_ptrs.insert(ast.duplicate());
-					name_to_ptr[ast->get_asset_id()] = ast.data;
-				}
-			}
-
-			contents[pair.first] = pair.second;
-			if(pair.second.gas_mass < 0.0f)
+			StoredFluid& added = get_or_add(entry.id);
+			added = entry.fluid;
+			if(entry.fluid.gas_mass < 0.0f)
 			{
-				contents.at(pair.first).gas_mass = 0.0f;
+				added.gas_mass = 0.0f;
 			}
-			if(pair.second.liquid_mass < 0.0f)
+			if(entry.fluid.liquid_mass < 0.0f)
 			{
-				contents.at(pair.first).liquid_mass = 0.0f;
+				added.liquid_mass = 0.0f;
 			}
 		}
 		else
 		{
-			out.contents[pair.first] = StoredFluid();
-			// We create a new AssetHandle in out to store it as we are creating the key
-			for(auto& ast : b.mat_ptrs)
-			{
-				if(ast.data == pair.first)
-				{
-					out.mat_ptrs.insert(ast.duplicate());
-					out.name_to_ptr[ast->get_asset_id()] = ast.data;
-				}
-			}
+			StoredFluid& own = fluids[idx].fluid;
+			// b is sorted, so out is too
+			StoredFluid& taken = out.fluids.push_back(Entry{entry.id, StoredFluid()}).fluid;
 
-			if(pair.second.gas_mass < 0.0f)
+			if(entry.fluid.gas_mass < 0.0f)
 			{
-				float original = it->second.gas_mass;
-				it->second.gas_mass -= pair.second.gas_mass;
-				if(it->second.gas_mass < 0.0f)
+				float original = own.gas_mass;
+				own.gas_mass -= entry.fluid.gas_mass;
+				if(own.gas_mass < 0.0f)
 				{
-					out.contents.at(it->first).gas_mass = original;
+					taken.gas_mass = original;
 				}
 				else
 				{
-					out.contents.at(it->first).gas_mass = pair.second.gas_mass;
+					taken.gas_mass = entry.fluid.gas_mass;
 				}
 			}
 			else
 			{
-				it->second.gas_mass += pair.second.gas_mass;
+				own.gas_mass += entry.fluid.gas_mass;
 			}
 
-			if(pair.second.liquid_mass < 0.0f)
+			if(entry.fluid.liquid_mass < 0.0f)
 			{
-				float original = it->second.liquid_mass;
-				it->second.liquid_mass -= pair.second.liquid_mass;
-				if(it->second.liquid_mass < 0.0f)
+				float original = own.liquid_mass;
+				own.liquid_mass -= entry.fluid.liquid_mass;
+				if(own.liquid_mass < 0.0f)
 				{
-					out.contents.at(it->first).liquid_mass = original;
+					taken.liquid_mass = original;
 				}
 				else
 				{
-					out.contents.at(it->first).liquid_mass = pair.second.liquid_mass;
+					taken.liquid_mass = entry.fluid.liquid_mass;
 				}
 			}
 			else
 			{
-				it->second.liquid_mass += pair.second.liquid_mass;
+				own.liquid_mass += entry.fluid.liquid_mass;
 			}
 		}
 	}
@@ -97,41 +122,21 @@ StoredFluids StoredFluids::modify(const StoredFluids &b)
 StoredFluids StoredFluids::multiply(float value)
 {
 	StoredFluids out;
+	out.fluids = fluids;
 
-	for(const auto& pair : contents)
+	for(Entry& entry : out.fluids)
 	{
-		out.contents[pair.first] = pair.second;
-		// we create a new assethandle in out to store it as we are creating the key
-		for(auto& ast : mat_ptrs)
-		{
-			if(ast.data == pair.first)
-			{
-				out.mat_ptrs.insert(ast.duplicate());
-			}
-		}
-		out.contents.at(pair.first).gas_mass *= value;
-		out.contents.at(pair.first).liquid_mass *= value;
+		entry.fluid.gas_mass *= value;
+		entry.fluid.liquid_mass *= value;
 	}
 
 	return out;
 }
 
-void StoredFluids::remove_empty_fluids()
-{
-
-}
-
 void StoredFluids::add_fluid(const AssetHandle<PhysicalMaterial>& mat, float liquid_mass, float gas_mass, float temp)
 {
 	StoredFluids tmp;
-	if(mat_ptrs.count(mat) == 0)
-	{
-		// We must introduce a new asset handle
-		mat_ptrs.insert(mat.duplicate());
-		name_to_ptr[mat->get_asset_id()] = mat.data;
-	}
-
-	tmp.contents[mat.data] = StoredFluid(liquid_mass, gas_mass);
+	tmp.fluids.push_back(Entry{osp->game_database->material_registry.intern(mat), StoredFluid(liquid_mass, gas_mass)});
 	if(temp < 0.0f)
 	{
 		temp = temperature;
@@ -145,49 +150,32 @@ void StoredFluids::drain_to(StoredFluids* target, PhysicalMaterial* mat, float l
 	logger->check(target, "Trying to drain into nullptr");
 	logger->check(mat, "Trying to drain nullptr material");
 
-	auto it = target->contents.find(mat);
-	StoredFluid* target_fluids;
-	if(it == target->contents.end())
-	{
-		// we create a new assethandle in out to store it as we are creating the key
-		for(auto& ast : mat_ptrs)
-		{
-			if(ast.data == mat)
-			{
-				target->mat_ptrs.insert(ast.duplicate());
-			}
-		}
-
-		target->contents[mat] = StoredFluid();
-		target_fluids = &target->contents[mat];
-	}
-	else
-	{
-		target_fluids = &it->second;
-	}
+	MaterialRegistry::Id id = osp->game_database->material_registry.intern(mat);
+	StoredFluid* target_fluids = &target->get_or_add(id);
 
 	// Drain from our tank
-	auto self_it = contents.find(mat);
-	logger->check(self_it != contents.end(), "Could not find material in drain_to, this is not allowed!");
+	int self_idx = find(id);
+	logger->check(self_idx >= 0, "Could not find material in drain_to, this is not allowed!");
+	StoredFluid& self_fluid = fluids[self_idx].fluid;
 
-	float tmp_liquid = self_it->second.liquid_mass;
-	float tmp_gas = self_it->second.gas_mass;
+	float tmp_liquid = self_fluid.liquid_mass;
+	float tmp_gas = self_fluid.gas_mass;
 
-	self_it->second.gas_mass -= gas_mass;
-	self_it->second.liquid_mass -= liquid_mass;
+	self_fluid.gas_mass -= gas_mass;
+	self_fluid.liquid_mass -= liquid_mass;
 	float tfer_gas = gas_mass;
 	float tfer_liq = liquid_mass;
-	if(self_it->second.liquid_mass < 0.0f)
+	if(self_fluid.liquid_mass < 0.0f)
 	{
-		tfer_liq = -self_it->second.liquid_mass;
+		tfer_liq = -self_fluid.liquid_mass;
 	}
-	if(self_it->second.gas_mass < 0.0f)
+	if(self_fluid.gas_mass < 0.0f)
 	{
-		tfer_gas = -self_it->second.gas_mass;
+		tfer_gas = -self_fluid.gas_mass;
 	}
 
-	self_it->second.gas_mass = glm::max(self_it->second.gas_mass, 0.0f);
-	self_it->second.liquid_mass = glm::max(self_it->second.liquid_mass, 0.0f);
+	self_fluid.gas_mass = glm::max(self_fluid.gas_mass, 0.0f);
+	self_fluid.liquid_mass = glm::max(self_fluid.liquid_mass, 0.0f);
 
 	float target_heat = target->get_total_heat_capacity() * target->temperature;
 
@@ -205,30 +193,29 @@ void StoredFluids::drain_to(StoredFluids* target, PhysicalMaterial* mat, float l
 	// Restore the original fluids
 	if(!do_flow)
 	{
-		self_it->second.gas_mass = tmp_gas;
-		self_it->second.liquid_mass = tmp_liquid;
+		self_fluid.gas_mass = tmp_gas;
+		self_fluid.liquid_mass = tmp_liquid;
 	}
 
-	remove_empty_fluids();
-
 }
 
 float StoredFluids::get_total_liquid_mass() const
 {
 	float total = 0.0f;
-	for(const auto& pair : contents)
+	for(const Entry& entry : fluids)
 	{
-		total += pair.second.liquid_mass;
+		total += entry.fluid.liquid_mass;
 	}
 	return total;
 }
 
 float StoredFluids::get_total_liquid_volume() const
 {
+	const MaterialRegistry& registry = osp->game_database->material_registry;
 	float total = 0.0f;
-	for(const auto& pair : contents)
+	for(const Entry& entry : fluids)
 	{
-		total += pair.second.liquid_mass / pair.first->liquid_density;
+		total += entry.fluid.liquid_mass / registry.get(entry.id)->liquid_density;
 	}
 	return total;
 }
@@ -241,57 +228,62 @@ float StoredFluids::get_average_liquid_density() const
 float StoredFluids::get_total_gas_mass() const
 {
 	float total = 0.0f;
-	for(const auto& pair : contents)
+	for(const Entry& entry : fluids)
 	{
-		total += pair.second.gas_mass;
+		total += entry.fluid.gas_mass;
 	}
 	return total;
 }
 
 float StoredFluids::react(float T, float react_V, float liq_fac, float dt)
 {
-	// TODO: Optimize the way we obtain the possible reactions. Maybe cache?
-	// Usually there will be 2 or 3 reactants and maybe 4 reactions per reactant so not too bad
-	std::vector<ChemicalReaction> reactions;
-	for(auto pair : contents)
+	const MaterialRegistry& registry = osp->game_database->material_registry;
+	const std::vector<MaterialRegistry::CompiledReaction>& all_reactions = registry.get_reactions();
+
+	MaterialRegistry::Mask stored = 0;
+	for(const Entry& entry : fluids)
 	{
-		auto lb = osp->game_database->material_to_reactions.lower_bound(pair.first->get_asset_id());
-		auto ub = osp->game_database->material_to_reactions.upper_bound(pair.first->get_asset_id());
-		for(auto it = lb; it != ub; it++)
+		stored |= MaterialRegistry::get_bit(entry.id);
+	}
+
+	// Usually there will be 2 or 3 reactants and maybe 4 reactions per reactant
+	SmallVector<uint16_t, 8> reactions;
+	for(size_t i = 0; i < all_reactions.size(); i++)
+	{
+		if(MaterialRegistry::involves(all_reactions[i], stored))
 		{
-			// Check that it's not already added
-			bool found = false;
-			for (size_t i = 0; i < reactions.size(); i++)
+			reactions.push_back((uint16_t)i);
+			// Add the materials as they may be products that are not yet there
+			for(const MaterialRegistry::Species& species : all_reactions[i].species)
 			{
-				if (reactions[i] == it->second)
-				{
-					found = true;
-					break;
-				}
+				get_or_add(species.id);
 			}
+		}
+	}
 
-			if(found)
-				break;
-
-
-			// TODO: Check that either all products or all reactants are present!
-			reactions.push_back(it->second);
+	if(reactions.empty())
+	{
+		return 0.0f;
+	}
 
-		}
+	// Nothing is added from now on, so pointers to the fluids are stable
+	std::array<StoredFluid*, MaterialRegistry::MAX_MATERIALS> by_id;
+	for(Entry& entry : fluids)
+	{
+		by_id[entry.id] = &entry.fluid;
 	}
 
-	for(const ChemicalReaction& reaction : reactions)
+	SmallVector<std::array<StoredFluid*, MaterialRegistry::MAX_SPECIES>, 8> species_fluids;
+	for(size_t i = 0; i < reactions.size(); i++)
 	{
-		for(auto& reactant : reaction.reactants)
+		const MaterialRegistry::CompiledReaction& reaction = all_reactions[reactions[i]];
+		std::array<StoredFluid*, MaterialRegistry::MAX_SPECIES>& reaction_fluids = species_fluids.push_back({});
+		for(size_t j = 0; j < reaction.species.size(); j++)
 		{
-			auto it = name_to_ptr.find(reactant.reactant);
-			if (it == name_to_ptr.end())
-			{
-				// Add the material as it may be a product that's not yet there
-				add_fluid(AssetHandle<PhysicalMaterial>(reactant.reactant), 0.0f, 0.0f);
-			}
+			reaction_fluids[j] = by_id[reaction.species[j].id];
 		}
 	}
+
 	// Now we move towards the equilibrium in substeps to achieve great precision
 	// when multiple reactions are competing. This is not really needed to be extremely
 	// precise as we are satisfied with approximate solutions to the equilibria
@@ -299,10 +291,12 @@ float StoredFluids::react(float T, float react_V, float liq_fac, float dt)
 	float total_h = 0.0f;
 	for(float s = 0.0f; s < dt; s += sub_step)
 	{
-		for(auto& reaction : reactions)
+		for(size_t i = 0; i < reactions.size(); i++)
 		{
+			const MaterialRegistry::CompiledReaction& reaction = all_reactions[reactions[i]];
+			StoredFluid* const* reaction_fluids = species_fluids[i].data();
 			// Obtain current reaction quotient
-			float Q = reaction.get_Q(this, react_V);
+			float Q = reaction.get_Q(reaction_fluids, react_V);
 			float K = reaction.get_K(T);
 			float QmK = Q - K;
 			constexpr float MAX_RATE = 50000.0f;
@@ -311,7 +305,7 @@ float StoredFluids::react(float T, float react_V, float liq_fac, float dt)
 			QmK = glm::min(QmK, MAX_RATE);
 			// K must move towards Q. Reacting DECREASES K so we must do the opposite:
 			float diff = -QmK * reaction.get_rate(T) * react_V * sub_step;
-			float total_react = reaction.react(this, diff, diff * liq_fac);
+			float total_react = reaction.react(reaction_fluids, diff, diff * liq_fac);
 			total_h += reaction.dH * total_react;
 		}
 	}
@@ -333,20 +327,23 @@ float StoredFluid::get_total_mass()
 
 float StoredFluids::get_total_heat_capacity() const
 {
+	const MaterialRegistry& registry = osp->game_database->material_registry;
 	float total = 0.0f;
-	for(auto pair : contents)
+	for(const Entry& entry : fluids)
 	{
-		total += pair.first->heat_capacity_gas * pair.second.gas_mass + pair.first->heat_capacity_liquid * pair.second.liquid_mass;
+		const PhysicalMaterial* mat = registry.get(entry.id);
+		total += mat->heat_capacity_gas * entry.fluid.gas_mass + mat->heat_capacity_liquid * entry.fluid.liquid_mass;
 	}
 	return total;
 }
 
 float StoredFluids::get_total_gas_moles() const
 {
+	const MaterialRegistry& registry = osp->game_database->material_registry;
 	float total = 0.0f;
-	for(const auto& pair : contents)
+	for(const Entry& entry : fluids)
 	{
-		total += pair.first->get_moles(pair.second.gas_mass);
+		total += registry.get(entry.id)->get_moles(entry.fluid.gas_mass);
 	}
 	return total;
 }
@@ -362,14 +359,15 @@ void StoredFluids::add_heat(float v)
 
 void StoredFluids::set_vapor_fraction(const AssetHandle<PhysicalMaterial> &mat, float factor)
 {
-	auto it = contents.find(mat.get());
+	int idx = find(osp->game_database->material_registry.intern(mat));
 	// TODO: Don't include this check and simply ignore the command silently?
-	logger->check(it != contents.end(), "Cannot modify liquid fraction of not-present fluid");
+	logger->check(idx >= 0, "Cannot modify liquid fraction of not-present fluid");
 	logger->check(factor <= 1.0f && factor >= 0.0f, "Vapor fraction must be within 0 and 1 and its value is {}", factor);
 
-	float total_mass = it->second.gas_mass + it->second.liquid_mass;
-	it->second.gas_mass = total_mass * factor;
-	it->second.liquid_mass = total_mass * (1.0f - factor);
+	StoredFluid& fluid = fluids[idx].fluid;
+	float total_mass = fluid.gas_mass + fluid.liquid_mass;
+	fluid.gas_mass = total_mass * factor;
+	fluid.liquid_mass = total_mass * (1.0f - factor);
 }
 
 
@@ -377,12 +375,13 @@ float StoredFluids::get_specific_gas_constant() const
 {
 	constexpr float R = 8.314462618f;
 
+	const MaterialRegistry& registry = osp->game_database->material_registry;
 	float total_mass = get_total_gas_mass();
 	float mass_sum = 0.0f;
 
-	for(const auto& pair : contents)
+	for(const Entry& entry : fluids)
 	{
-		mass_sum += pair.second.gas_mass * pair.first->molar_mass;
+		mass_sum += entry.fluid.gas_mass * registry.get(entry.id)->molar_mass;
 	}
 
 	mass_sum /= total_mass;
@@ -390,9 +389,78 @@ float StoredFluids::get_specific_gas_constant() const
 	return R / mass_sum;
 }
 
+void StoredFluids::benchmark(size_t iterations)
+{
+	iterations = std::max(iterations, (size_t)1);
+
+	struct Mixture
+	{
+		const char* name;
+		StoredFluids fluids;
+		float T, V, liquid_factor;
+	};
+
+	auto hydrogen = AssetHandle<PhysicalMaterial>("core:materials/hydrogen.toml");
+	auto oxygen = AssetHandle<PhysicalMaterial>("core:materials/oxygen.toml");
+	auto water = AssetHandle<PhysicalMaterial>("core:materials/water.toml");
+	auto methane = AssetHandle<PhysicalMaterial>("core:materials/methane.toml");
+
+	std::vector<Mixture> mixtures(4);
+	mixtures[0].name = "LH2 tank";
+	mixtures[0].fluids.temperature = 20.0f;
+	mixtures[0].fluids.add_fluid(hydrogen, 500.0f, 2.0f);
+	mixtures[0].T = 20.0f; mixtures[0].V = 8.0f; mixtures[0].liquid_factor = 0.01f;
+
+	mixtures[1].name = "LOX tank";
+	mixtures[1].fluids.temperature = 90.0f;
+	mixtures[1].fluids.add_fluid(oxygen, 2000.0f, 5.0f);
+	mixtures[1].T = 90.0f; mixtures[1].V = 2.0f; mixtures[1].liquid_factor = 0.01f;
+
+	mixtures[2].name = "Hydrolox chamber";
+	mixtures[2].fluids.temperature = 3000.0f;
+	mixtures[2].fluids.add_fluid(hydrogen, 0.0f, 1.0f);
+	mixtures[2].fluids.add_fluid(oxygen, 0.0f, 8.0f);
+	mixtures[2].fluids.add_fluid(water, 0.0f, 4.0f);
+	mixtures[2].T = 3000.0f; mixtures[2].V = 0.1f; mixtures[2].liquid_factor = 0.001f;
+
+	mixtures[3].name = "Methalox chamber";
+	mixtures[3].fluids.temperature = 3000.0f;
+	mixtures[3].fluids.add_fluid(methane, 0.0f, 2.0f);
+	mixtures[3].fluids.add_fluid(oxygen, 0.0f, 7.0f);
+	mixtures[3].T = 3000.0f; mixtures[3].V = 0.1f; mixtures[3].liquid_factor = 0.001f;
+
+	constexpr float dt = 0.02f;
+	for(Mixture& mixture : mixtures)
+	{
+		auto start = std::chrono::steady_clock::now();
+		float heat = 0.0f;
+		for(size_t i = 0; i < iterations; i++)
+		{
+			StoredFluids copy = mixture.fluids;
+			heat += copy.react(mixture.T, mixture.V, mixture.liquid_factor, dt);
+		}
+		auto mid = std::chrono::steady_clock::now();
+
+		// What flowing through a pipe does, take a bit and put it somewhere else
+		StoredFluids target;
+		target.temperature = mixture.T;
+		for(size_t i = 0; i < iterations; i++)
+		{
+			StoredFluids taken = mixture.fluids.multiply(0.001f);
+			taken.temperature = mixture.T;
+			target.modify(taken);
+		}
+		auto end = std::chrono::steady_clock::now();
+
+		double react_us = std::chrono::duration<double, std::micro>(mid - start).count() / (double)iterations;
+		double flow_us = std::chrono::duration<double, std::micro>(end - mid).count() / (double)iterations;
+		logger->info("Fluids benchmark ({}, {} fluids): react {:.3f}us, flow {:.3f}us (heat {})",
+			mixture.name, mixture.fluids.get_fluids().size(), react_us, flow_us, heat);
+	}
+}
+
 StoredFluid::StoredFluid(float liquid, float gas)
 {
 	liquid_mass = liquid;
 	gas_mass = gas;
 }
-
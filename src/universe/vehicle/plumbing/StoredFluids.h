@@ -4,6 +4,8 @@
 #include <assets/AssetManager.h>
 #include <assets/PhysicalMaterial.h>
 #include <lua/libs/LuaAssets.h>
+#include <util/SmallVector.h>
+#include <universe/vehicle/material/MaterialRegistry.h>
 
 
 struct StoredFluid
@@ -19,32 +21,49 @@ struct StoredFluid
 
 class StoredFluids
 {
+public:
+
+	struct Entry
+	{
+		MaterialRegistry::Id id;
+		StoredFluid fluid;
+	};
+
+	// Tanks rarely hold more than a handful of different fluids
+	static constexpr size_t INLINE_FLUIDS = 6;
+	using FluidVector = SmallVector<Entry, INLINE_FLUIDS>;
+
+	// Used to iterate the contents from lua, see LuaPlumbing
+	struct Contents
+	{
+		StoredFluids* fluids;
+	};
+
 private:
 
-	// This vector allows fast access without allowing modifications to the material
-	// regenerated after adding or removing fluids to improve perfomance
-	std::vector<std::pair<const PhysicalMaterial*, StoredFluid*>> internal_contents;
+	// Sorted by material id (see MaterialRegistry). Materials are kept even if
+	// their mass goes to 0
+	FluidVector fluids;
 
-	void remove_empty_fluids();
+	// Returns the index of the material in fluids, or -1
+	int find(MaterialRegistry::Id id) const;
+	StoredFluid& get_or_add(MaterialRegistry::Id id);
 
 public:
 
 	// Temperature of the fluids
 	float temperature;
-	// TODO: There should me a special asset type for stuff like this. Fow now this works
-	std::unordered_set<AssetHandle<PhysicalMaterial>> mat_ptrs;
-	std::unordered_map<const PhysicalMaterial*, StoredFluid> contents;
-	std::unordered_map<std::string, const PhysicalMaterial*> name_to_ptr;
 
 	// Fluids in b may be negative, in that case it will take away
 	// as much as possible and return the ammount taken
 	StoredFluids modify(const StoredFluids& b);
 	StoredFluids multiply(float value);
 
-	const std::unordered_map<const PhysicalMaterial*, StoredFluid>& get_contents()
-	{
-		return contents;
-	};
+	FluidVector& get_fluids() { return fluids; }
+	const FluidVector& get_fluids() const { return fluids; }
+	Contents get_contents() { return Contents{this}; }
+	// nullptr if the material is not present
+	StoredFluid* get_fluid(const PhysicalMaterial* mat);
 
 	// Changes vapor / liquid distribution "aphysically", ie, it maintains temperature without
 	// the need for energy to be added.
@@ -72,5 +91,7 @@ public:
 	// Obtains R / Mm (Mm is the mean molar mass for the mixture)
 	float get_specific_gas_constant() const;
 	void add_heat(float heat);
-};
 
+	// Times react, modify and multiply on a few typical tank mixtures and logs the results
+	static void benchmark(size_t iterations);
+};
@@ -1,15 +1,27 @@
 #include "VehiclePlumbing.h"
 #include "../Vehicle.h"
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <algorithm>
 
 // A reasonable multiplier to prevent extreme flow velocities
 // I don't know enough fluid mechanics as to determine a reasonable value
 // so it's arbitrary, chosen to approximate real life rocket values
 #define FLOW_MULTIPLIER 0.0001
+// Flow machines barely restrict flow, the path solver only considers their pressure drop
+#define MACHINE_FLOW_MULTIPLIER (FLOW_MULTIPLIER * 100.0)
 
 
 VehiclePlumbing::VehiclePlumbing(Vehicle *in_vehicle)
 {
 	veh = in_vehicle;
+	graph_valid = false;
+	solver = Solver::PATHS;
+	check_cache = false;
+	graph_rebuilds = 0;
+	reductions = 0;
+	last_update_time = 0.0;
 }
 
 std::vector<PlumbingMachine*> VehiclePlumbing::grid_aabb_check(glm::vec2 start, glm::vec2 end,
@@ -152,8 +164,9 @@ void VehiclePlumbing::execute_flows(float dt)
 	// We first normalize flows so that two equal flows from a machine
 	// equal a single flow that splits in two (realistic)
 
-	for(const FlowPath& path : fws)
+	for(size_t idx : fws)
 	{
+		const FlowPath& path = paths[idx];
 		float to_move = path.final_flow * dt;
 		if(to_move == 0.0f)
 			continue;
@@ -193,93 +206,410 @@ void VehiclePlumbing::execute_flows(float dt)
 
 }
 
-// TODO: Quit condition if we enter a loop
-void VehiclePlumbing::find_all_possible_paths()
+bool VehiclePlumbing::is_graph_valid()
 {
-	// Find a new unvisited pipe to start from that's connected to a real port
+	if(!graph_valid || pipes.size() != graph_pipes.size())
+	{
+		return false;
+	}
+
+	for(size_t pipe_id = 0; pipe_id < pipes.size(); pipe_id++)
+	{
+		if(pipes[pipe_id].a != graph_pipes[pipe_id].first || pipes[pipe_id].b != graph_pipes[pipe_id].second ||
+			pipes[pipe_id].surface != graph_surfaces[pipe_id])
+		{
+			return false;
+		}
+	}
+
+	if(get_all_elements() != graph_machines)
+	{
+		return false;
+	}
+
+	// Valves and similar machines may change their connections at any time
+	for(const auto& pair : connected_cache)
+	{
+		if(pair.first->in_machine->get_connected_ports(pair.first->id) != pair.second)
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+void VehiclePlumbing::rebuild_graph()
+{
+	port_steps.clear();
+	connected_cache.clear();
+	graph_pipes.clear();
+	graph_surfaces.clear();
+	paths.clear();
+	last_active.clear();
+	last_reduced.clear();
+
+	graph_machines = get_all_elements();
+
 	for(size_t pipe_id = 0; pipe_id < pipes.size(); pipe_id++)
 	{
 		Pipe& pipe = pipes[pipe_id];
-		if(!pipe.a->is_flow_port)
+		graph_pipes.emplace_back(pipe.a, pipe.b);
+		graph_surfaces.push_back(pipe.surface);
+
+		port_steps[pipe.a].emplace_back(pipe_id, false, 0.0f);
+		if(pipe.b != pipe.a)
 		{
-			find_all_possible_paths_from(FlowStep(pipe_id, false, 0.0f));
+			port_steps[pipe.b].emplace_back(pipe_id, true, 0.0f);
+		}
+
+		for(FluidPort* port : {pipe.a, pipe.b})
+		{
+			if(port->is_flow_port && connected_cache.find(port) == connected_cache.end())
+			{
+				connected_cache[port] = port->in_machine->get_connected_ports(port->id);
+			}
 		}
+	}
 
-		if(!pipe.b->is_flow_port)
+	if(solver == Solver::NODAL)
+	{
+		build_network();
+	}
+	else
+	{
+		// Start from every pipe that's connected to a real port
+		for(size_t pipe_id = 0; pipe_id < pipes.size(); pipe_id++)
 		{
-			find_all_possible_paths_from(FlowStep(pipe_id, true, 0.0f));
+			Pipe& pipe = pipes[pipe_id];
+			if(!pipe.a->is_flow_port)
+			{
+				find_all_possible_paths_from(FlowStep(pipe_id, false, 0.0f));
+			}
+
+			if(!pipe.b->is_flow_port)
+			{
+				find_all_possible_paths_from(FlowStep(pipe_id, true, 0.0f));
+			}
 		}
 	}
 
+	graph_valid = true;
+	graph_rebuilds++;
+}
+
+void VehiclePlumbing::build_network()
+{
+	// Pressures of the old network are kept for the ports which remain, so even after a
+	// valve changes the solver starts close to the solution
+	std::unordered_map<const FluidPort*, double> old_pressures;
+	for(size_t i = 0; i < network_ports.size(); i++)
+	{
+		old_pressures[network_ports[i]] = network.nodes[i].pressure;
+	}
+
+	network = PlumbingNetwork();
+	network_ports.clear();
+	port_to_node.clear();
+	edge_pipes.clear();
+
+	auto get_node = [this, &old_pressures](FluidPort* port)
+	{
+		auto it = port_to_node.find(port);
+		if(it != port_to_node.end())
+		{
+			return it->second;
+		}
+
+		auto old = old_pressures.find(port);
+		double pressure = old == old_pressures.end() ? std::numeric_limits<double>::quiet_NaN() : old->second;
+		uint32_t node = network.add_node(!port->is_flow_port, pressure);
+		network_ports.push_back(port);
+		port_to_node[port] = node;
+		return node;
+	};
+
+	for(size_t pipe_id = 0; pipe_id < pipes.size(); pipe_id++)
+	{
+		Pipe& pipe = pipes[pipe_id];
+		uint32_t a = get_node(pipe.a);
+		uint32_t b = get_node(pipe.b);
+		network.add_edge(a, b, FLOW_MULTIPLIER * pipe.surface, true);
+		edge_pipes.push_back(pipe_id);
+	}
+
+	// Connections inside flow machines, which may be one way (check valves...)
+	for(const auto& pair : connected_cache)
+	{
+		for(FluidPort* to : pair.second)
+		{
+			// Ports without pipes can't take fluid anywhere
+			if(to == nullptr || to == pair.first || port_steps.find(to) == port_steps.end())
+			{
+				continue;
+			}
+
+			auto back = connected_cache.find(to);
+			bool reversible = back != connected_cache.end() &&
+				std::find(back->second.begin(), back->second.end(), pair.first) != back->second.end();
+			// Two way connections are only added once
+			if(reversible && to < pair.first)
+			{
+				continue;
+			}
+
+			// Every port in the cache has a pipe, so it's already a node
+			network.add_edge(port_to_node.at(pair.first), get_node(to), MACHINE_FLOW_MULTIPLIER, reversible);
+			edge_pipes.push_back(NO_PIPE);
+		}
+	}
+
+	network.build();
+}
+
+void VehiclePlumbing::solve_network()
+{
+	for(size_t i = 0; i < network_ports.size(); i++)
+	{
+		FluidPort* port = network_ports[i];
+		if(!port->is_flow_port)
+		{
+			network.nodes[i].pressure = port->in_machine->get_pressure(port->id);
+		}
+	}
+
+	// Drops and limits are evaluated once per tick with the last pressures, as calling
+	// into lua every iteration is too expensive
+	for(size_t i = 0; i < network.edges.size(); i++)
+	{
+		PlumbingNetwork::Edge& edge = network.edges[i];
+		FluidPort* from = network_ports[edge.from];
+		FluidPort* to = network_ports[edge.to];
+
+		if(edge_pipes[i] == NO_PIPE)
+		{
+			double from_P = network.nodes[edge.from].pressure;
+			double to_P = network.nodes[edge.to].pressure;
+			edge.drop = from->in_machine->get_pressure_drop(from->id, to->id,
+															std::isnan(from_P) ? 0.0f : (float)from_P);
+			if(edge.reversible)
+			{
+				edge.reverse_drop = to->in_machine->get_pressure_drop(to->id, from->id,
+																	  std::isnan(to_P) ? 0.0f : (float)to_P);
+			}
+		}
+		else
+		{
+			// Same as the path solver, the pipe is limited by its ports
+			float from_max = from->in_machine->get_maximum_flowrate(from->id);
+			float to_max = to->in_machine->get_maximum_flowrate(to->id);
+			edge.max_flow = (from_max >= 0.0f || to_max >= 0.0f) ? glm::max(from_max, to_max) : -1.0;
+		}
+	}
+
+	network.solve(nullptr);
+}
+
+void VehiclePlumbing::execute_network_flows(float dt)
+{
+	// Every component is a separate pool, ports which push fluid (positive net flow) bleed
+	// into it, and the ones which take fluid receive it in proportion to their flow
+	std::vector<StoredFluids> buffers(network.get_component_count());
+	std::vector<double> pushed(network.get_component_count(), 0.0);
+	std::vector<double> taken(network.get_component_count(), 0.0);
+	for(size_t i = 0; i < network_ports.size(); i++)
+	{
+		const PlumbingNetwork::Node& node = network.nodes[i];
+		FluidPort* port = network_ports[i];
+		if(port->is_flow_port)
+		{
+			continue;
+		}
+
+		if(node.net_flow > 0.0)
+		{
+			buffers[node.component].modify(port->in_machine->out_flow(port->id, (float)(node.net_flow * dt), true));
+			pushed[node.component] += node.net_flow;
+		}
+		else
+		{
+			taken[node.component] -= node.net_flow;
+		}
+	}
+
+	for(size_t i = 0; i < network_ports.size(); i++)
+	{
+		const PlumbingNetwork::Node& node = network.nodes[i];
+		FluidPort* port = network_ports[i];
+		if(port->is_flow_port || node.net_flow >= 0.0 || taken[node.component] <= 0.0)
+		{
+			continue;
+		}
+
+		StoredFluids& buffer = buffers[node.component];
+		StoredFluids part = buffer.multiply((float)(-node.net_flow / taken[node.component]));
+		part.temperature = buffer.temperature;
+		port->in_machine->in_flow(port->id, part, true);
+	}
+
+	// Pipes show the flow in mass, with the same sign as the path solver
+	for(size_t i = 0; i < network.edges.size(); i++)
+	{
+		if(edge_pipes[i] == NO_PIPE)
+		{
+			continue;
+		}
+
+		const PlumbingNetwork::Edge& edge = network.edges[i];
+		size_t component = network.nodes[edge.from].component;
+		const StoredFluids& buffer = buffers[component];
+		double mass = buffer.get_total_gas_mass() + buffer.get_total_liquid_mass();
+		double density = pushed[component] > 0.0 ? mass / (pushed[component] * dt) : 0.0;
+		pipes[edge_pipes[i]].flow = (float)(-edge.flow * density);
+	}
+}
+
+void VehiclePlumbing::calculate_flows()
+{
+	if(solver == Solver::NODAL)
+	{
+		solve_network();
+	}
+	else
+	{
+		find_flowing_paths();
+		calculate_flowrates();
+	}
+}
+
+void VehiclePlumbing::set_solver(Solver n_solver)
+{
+	if(n_solver != solver)
+	{
+		solver = n_solver;
+		paths.clear();
+		fws.clear();
+		last_active.clear();
+		last_reduced.clear();
+		network = PlumbingNetwork();
+		network_ports.clear();
+		port_to_node.clear();
+		edge_pipes.clear();
+		graph_valid = false;
+	}
 }
 
 void VehiclePlumbing::find_all_possible_paths_from(FlowStep start)
 {
 	// start.a/b contains a true port, so we just need to travel to port b/a now,
 	// this is a tree search algorithm
-	// We store the whole path to the open pipe so we can rebuild it later
-	std::queue<std::vector<FlowStep>> open;
-	std::vector<FlowStep> start_v;
-	start_v.push_back(start);
-	open.push(start_v);
-
-	while(!open.empty())
+	// Instead of copying the whole path to every open pipe, each node points to
+	// the one it came from, and the path is rebuilt once we reach a true port
+	struct Node
 	{
-		std::vector<FlowStep> open_chain = open.front();
-		size_t work = open_chain.back().pipe;
-		bool backwards = open_chain.back().backwards;
-		const Pipe* p = &pipes[work];
-		const FluidPort* next = backwards ? p->a : p->b;
+		FlowStep step;
+		size_t parent;
+	};
+	const size_t NO_PARENT = std::numeric_limits<size_t>::max();
+
+	const FluidPort* start_port = start.backwards ? pipes[start.pipe].b : pipes[start.pipe].a;
 
-		open.pop();
+	std::vector<Node> nodes;
+	nodes.push_back(Node{start, NO_PARENT});
+	std::vector<FlowStep> next_steps;
+
+	// Nodes are appended in order, so this is a breadth first search
+	for(size_t cur = 0; cur < nodes.size(); cur++)
+	{
+		FlowStep step = nodes[cur].step;
+		const Pipe* p = &pipes[step.pipe];
+		const FluidPort* next = step.backwards ? p->a : p->b;
 
 		if(next->is_flow_port)
 		{
 			// Find all connected ports to this port and propagate in correct direction
-			std::vector<FluidPort*> connected = next->in_machine->get_connected_ports(next->id);
-			// Find the pipes connected as "a" to said ports, others are included in symmetric searches
-			for(size_t pipe_id = 0; pipe_id < pipes.size(); pipe_id++)
+			auto connected = connected_cache.find(next);
+			logger->check(connected != connected_cache.end(), "Flow port was not in the plumbing graph");
+
+			next_steps.clear();
+			for(const FluidPort* port : connected->second)
 			{
-				Pipe& pipe = pipes[pipe_id];
-				for(const FluidPort* port : connected)
+				auto steps = port_steps.find(port);
+				if(steps != port_steps.end())
 				{
-					std::vector<FlowStep> new_open;
-					new_open.insert(new_open.begin(), open_chain.begin(), open_chain.end());
-					bool found = false;
-					if(pipe.a == port)
-					{
-						// Forward
-						new_open.push_back(FlowStep(pipe_id, false, 0.0f));
-						found = true;
-					}
-					else if(pipe.b == port)
-					{
-						// Backward
-						new_open.push_back(FlowStep(pipe_id, true, 0.0f));
-						found = true;
-					}
-					if(found)
+					next_steps.insert(next_steps.end(), steps->second.begin(), steps->second.end());
+				}
+			}
+			// Keep the pipe order so paths are always found in the same order
+			std::stable_sort(next_steps.begin(), next_steps.end(), [](const FlowStep& a, const FlowStep& b)
+			{
+				return a.pipe < b.pipe;
+			});
+
+			for(const FlowStep& next_step : next_steps)
+			{
+				// Don't go around loops forever
+				bool in_chain = false;
+				for(size_t n = cur; n != NO_PARENT; n = nodes[n].parent)
+				{
+					if(nodes[n].step.pipe == next_step.pipe)
 					{
-						open.push(new_open);
+						in_chain = true;
+						break;
 					}
 				}
+
+				if(!in_chain)
+				{
+					nodes.push_back(Node{next_step, cur});
+				}
 			}
 		}
-		else
+		// We check that we don't end up where we started through a loop
+		else if(next != start_port)
 		{
 			FlowPath fpath;
-			fpath.path = open_chain;
-			calculate_delta_p(fpath);
-			// We check that we don't end up where we started through a loop
-			if(fpath.delta_P < 0.0f && next != (start.backwards ? pipes[start.pipe].b : pipes[start.pipe].a))
+			fpath.delta_P = 0.0f;
+			fpath.final_flow = 0.0f;
+			for(size_t n = cur; n != NO_PARENT; n = nodes[n].parent)
 			{
-				fws.push_back(fpath);
+				fpath.path.push_back(nodes[n].step);
 			}
+			std::reverse(fpath.path.begin(), fpath.path.end());
+			paths.push_back(std::move(fpath));
+		}
+	}
+}
 
+void VehiclePlumbing::find_flowing_paths()
+{
+	fws.clear();
+	std::vector<uint8_t> active(paths.size(), 0);
+
+	for(size_t i = 0; i < paths.size(); i++)
+	{
+		FlowPath& fpath = paths[i];
+		fpath.rate_limiters.clear();
+		calculate_delta_p(fpath);
+		// End pressure must be lower than start pressure!
+		if(fpath.delta_P < 0.0f)
+		{
+			active[i] = 1;
+			fws.push_back(i);
 		}
 	}
 
+	if(active == last_active)
+	{
+		fws = last_reduced;
+		return;
+	}
 
+	reduce_to_forced_paths();
+	reductions++;
+
+	last_active = std::move(active);
+	last_reduced = fws;
 }
 
 void VehiclePlumbing::calculate_delta_p(FlowPath& fw)
@@ -333,8 +663,9 @@ std::vector<size_t> VehiclePlumbing::find_forced_paths()
 	std::set<FluidPort*> multiple_start;
 	std::set<FluidPort*> multiple_end;
 
-	for(const FlowPath& path : fws)
+	for(size_t idx : fws)
 	{
+		const FlowPath& path = paths[idx];
 		Pipe* front = &pipes[path.path.front().pipe];
 		Pipe* back = &pipes[path.path.back().pipe];
 
@@ -360,12 +691,13 @@ std::vector<size_t> VehiclePlumbing::find_forced_paths()
 	// Now, the elements which are not in multiple are unique
 	for(size_t idx = 0; idx < fws.size(); idx++)
 	{
-		Pipe* front = &pipes[fws[idx].path.front().pipe];
-		Pipe* back = &pipes[fws[idx].path.back().pipe];
+		const FlowPath& path = paths[fws[idx]];
+		Pipe* front = &pipes[path.path.front().pipe];
+		Pipe* back = &pipes[path.path.back().pipe];
 
 		// If this is a unique path, it must happen and thus is forced.
-		if(multiple_start.count(fws[idx].path.front().backwards ? front-> b: front->a) == 0 &&
-		multiple_end.count(fws[idx].path.back().backwards ? back->a : back->b) == 0)
+		if(multiple_start.count(path.path.front().backwards ? front-> b: front->a) == 0 &&
+		multiple_end.count(path.path.back().backwards ? back->a : back->b) == 0)
 		{
 			out.push_back(idx);
 		}
@@ -385,9 +717,11 @@ bool VehiclePlumbing::remove_paths_not_compatible_with_forced()
 		{
 			if(forced[f] != i)
 			{
-				if(!are_paths_compatible(fws[i], fws[forced[f]]))
+				if(!are_paths_compatible(paths[fws[i]], paths[fws[forced[f]]]))
 				{
+					// (Indices must not repeat)
 					to_remove.push_back(i);
+					break;
 				}
 			}
 		}
@@ -460,16 +794,172 @@ int VehiclePlumbing::find_pipe_connected_to(FluidPort *port)
 
 void VehiclePlumbing::update_pipes(float dt, Vehicle *in_vehicle)
 {
+	auto start = std::chrono::steady_clock::now();
+
 	// Clear flows in pipes
-	fws.clear();
 	for(Pipe& p : pipes)
 	{
 		p.flow = 0.0f;
 	}
-	find_all_possible_paths();
-	reduce_to_forced_paths();
-	calculate_flowrates();
-	execute_flows(dt);
+
+	if(check_cache)
+	{
+		check_graph_cache();
+	}
+
+	if(!is_graph_valid())
+	{
+		rebuild_graph();
+	}
+
+	calculate_flows();
+	if(solver == Solver::NODAL)
+	{
+		execute_network_flows(dt);
+	}
+	else
+	{
+		execute_flows(dt);
+	}
+
+	last_update_time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+bool VehiclePlumbing::check_graph_cache()
+{
+	if(!is_graph_valid())
+	{
+		return true;
+	}
+
+	std::vector<FlowPath> old_paths = paths;
+	std::vector<PlumbingNetwork::Edge> old_edges = network.edges;
+	std::vector<FluidPort*> old_ports = network_ports;
+	// The reduction is still valid if the graph is the same
+	std::vector<uint8_t> old_active = last_active;
+	std::vector<size_t> old_reduced = last_reduced;
+
+	rebuild_graph();
+	graph_rebuilds--;
+
+	bool same = old_paths.size() == paths.size() && old_edges.size() == network.edges.size() &&
+		old_ports == network_ports;
+	for(size_t i = 0; same && i < paths.size(); i++)
+	{
+		same = old_paths[i].path.size() == paths[i].path.size();
+		for(size_t j = 0; same && j < paths[i].path.size(); j++)
+		{
+			same = old_paths[i].path[j].pipe == paths[i].path[j].pipe &&
+				old_paths[i].path[j].backwards == paths[i].path[j].backwards;
+		}
+	}
+	for(size_t i = 0; same && i < network.edges.size(); i++)
+	{
+		const PlumbingNetwork::Edge& a = old_edges[i];
+		const PlumbingNetwork::Edge& b = network.edges[i];
+		same = a.from == b.from && a.to == b.to && a.k == b.k && a.reversible == b.reversible;
+	}
+
+	if(!same)
+	{
+		logger->error("Plumbing graph changed without being detected ({} -> {} paths, {} -> {} edges)",
+			old_paths.size(), paths.size(), old_edges.size(), network.edges.size());
+		return false;
+	}
+
+	last_active = std::move(old_active);
+	last_reduced = std::move(old_reduced);
+	return true;
+}
+
+void VehiclePlumbing::benchmark(size_t ticks)
+{
+	ticks = std::max(ticks, (size_t)1);
+	size_t old_rebuilds = graph_rebuilds;
+	size_t old_reductions = reductions;
+
+	// What every tick did before the graph was cached: find all paths and reduce them
+	// (rebuild_graph forgets the last reduction)
+	auto start = std::chrono::steady_clock::now();
+	for(size_t i = 0; i < ticks; i++)
+	{
+		rebuild_graph();
+		calculate_flows();
+	}
+	auto mid = std::chrono::steady_clock::now();
+
+	for(size_t i = 0; i < ticks; i++)
+	{
+		if(!is_graph_valid())
+		{
+			rebuild_graph();
+		}
+		calculate_flows();
+	}
+	auto end = std::chrono::steady_clock::now();
+
+	double rebuild_ms = std::chrono::duration<double, std::milli>(mid - start).count() / (double)ticks;
+	double cached_ms = std::chrono::duration<double, std::milli>(end - mid).count() / (double)ticks;
+	logger->info("Plumbing benchmark ({} solver, {} pipes, {} machines, {} paths, {} nodes): {:.4f}ms per tick "
+		"rebuilding, {:.4f}ms per tick cached", solver == Solver::NODAL ? "nodal" : "paths", pipes.size(),
+		graph_machines.size(), paths.size(), network.nodes.size(), rebuild_ms, cached_ms);
+
+	graph_rebuilds = old_rebuilds;
+	reductions = old_reductions;
+}
+
+void VehiclePlumbing::compare_solvers()
+{
+	Solver old_solver = solver;
+	// Flow out of every true port, negative if it goes in
+	std::unordered_map<const FluidPort*, double> path_flows;
+	std::unordered_map<const FluidPort*, double> nodal_flows;
+
+	set_solver(Solver::PATHS);
+	auto start = std::chrono::steady_clock::now();
+	rebuild_graph();
+	calculate_flows();
+	double path_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	for(size_t idx : fws)
+	{
+		const FlowPath& path = paths[idx];
+		const Pipe& first = pipes[path.path.front().pipe];
+		const Pipe& last = pipes[path.path.back().pipe];
+		path_flows[path.path.front().backwards ? first.b : first.a] += path.final_flow;
+		path_flows[path.path.back().backwards ? last.a : last.b] -= path.final_flow;
+	}
+	size_t flowing_paths = fws.size();
+
+	set_solver(Solver::NODAL);
+	start = std::chrono::steady_clock::now();
+	rebuild_graph();
+	calculate_flows();
+	double nodal_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	for(size_t i = 0; i < network_ports.size(); i++)
+	{
+		if(!network_ports[i]->is_flow_port)
+		{
+			nodal_flows[network_ports[i]] = network.nodes[i].net_flow;
+		}
+	}
+
+	double max_diff = 0.0;
+	double path_total = 0.0;
+	double nodal_total = 0.0;
+	for(const auto& pair : nodal_flows)
+	{
+		double path_flow = path_flows[pair.first];
+		max_diff = glm::max(max_diff, glm::abs(path_flow - pair.second));
+		path_total += glm::max(path_flow, 0.0);
+		nodal_total += glm::max(pair.second, 0.0);
+	}
+
+	logger->info("Plumbing solvers ({} true ports): paths flow {:.6f} ({} flowing paths, {:.4f}ms), "
+		"nodal flow {:.6f} ({} iterations, residual {:.2e}, {:.4f}ms), biggest port difference {:.6f}",
+		nodal_flows.size(), path_total, flowing_paths, path_ms, nodal_total, network.get_last_iterations(),
+		network.get_last_residual(), nodal_ms, max_diff);
+
+	set_solver(old_solver);
 }
 
 void VehiclePlumbing::init()
@@ -498,8 +988,9 @@ void VehiclePlumbing::calculate_flowrates()
 	// These ones have limited flowrates that MAY be shared between multiple FlowPaths
 	std::unordered_multimap<size_t, std::pair<FlowPath&, float>> rate_limited;
 
-	for(FlowPath& path : fws)
+	for(size_t idx : fws)
 	{
+		FlowPath& path = paths[idx];
 		path.final_flow = sqrtf(-path.delta_P) * FLOW_MULTIPLIER;
 
 		if(!path.rate_limiters.empty())
@@ -1,7 +1,9 @@
 #pragma once
 #include "../part/Machine.h"
+#include "PlumbingNetwork.h"
 #include <unordered_map>
 #include <queue>
+#include <limits>
 
 class Vehicle;
 
@@ -38,6 +40,16 @@ struct Pipe
 // Do not hold pointers to pipes for long as they may be modified, use array indices instead
 class VehiclePlumbing
 {
+public:
+
+	enum class Solver
+	{
+		// Finds every path between two true ports and flows over the ones which are forced
+		PATHS,
+		// Solves the pressure of every port and junction (see PlumbingNetwork)
+		NODAL
+	};
+
 private:
 
 	// We travel from a->b unless the bool is true, then it's from b->a
@@ -68,13 +80,61 @@ private:
 
 	Vehicle* veh;
 
-	std::vector<FlowPath> fws;
-
-	void find_all_possible_paths();
+	// The plumbing graph is cached between ticks, and only rebuilt if pipes, machines or
+	// the connections inside flow machines (valves...) change. Pressures change every tick
+	// so they are always evaluated, over the cached paths.
+
+	// Pipes entering from each port, a step is backwards if the port is the pipe's b
+	std::unordered_map<const FluidPort*, std::vector<FlowStep>> port_steps;
+	// Last result of get_connected_ports for every flow port with a pipe
+	std::unordered_map<const FluidPort*, std::vector<FluidPort*>> connected_cache;
+	// Ends of each pipe and machines when the graph was built
+	std::vector<std::pair<FluidPort*, FluidPort*>> graph_pipes;
+	// The nodal solver uses them for the pipe edges
+	std::vector<float> graph_surfaces;
+	std::vector<PlumbingMachine*> graph_machines;
+	bool graph_valid;
+
+	// Every path between two true ports, regardless of pressure
+	std::vector<FlowPath> paths;
+	// Indices into paths of the paths which flow this tick
+	std::vector<size_t> fws;
+
+	// The reduction to forced paths only depends on which paths have a pressure difference,
+	// so it's reused while they don't change
+	std::vector<uint8_t> last_active;
+	std::vector<size_t> last_reduced;
+
+	// Nodal solver, nodes are the ports and edges are pipes and connections inside flow
+	// machines. Kept between ticks so it starts from the previous solution
+	PlumbingNetwork network;
+	std::vector<FluidPort*> network_ports;
+	std::unordered_map<const FluidPort*, uint32_t> port_to_node;
+	// Index of the pipe of each network edge, or NO_PIPE for connections inside machines
+	std::vector<size_t> edge_pipes;
+	static constexpr size_t NO_PIPE = std::numeric_limits<size_t>::max();
+
+	Solver solver;
+	bool check_cache;
+
+	size_t graph_rebuilds;
+	size_t reductions;
+	double last_update_time;
+
+	bool is_graph_valid();
+	void rebuild_graph();
+	void build_network();
+	// Updates pressures, drops and limits from the machines and solves the network
+	void solve_network();
+	void execute_network_flows(float dt);
+	// Finds the flows with the selected solver, without moving fluids
+	void calculate_flows();
 	// Starts assuming start.a contains the true machine!
 	void find_all_possible_paths_from(FlowStep start);
 	void calculate_delta_p(FlowPath& fpath);
-	// Returns the indices of the paths that are forced
+	// Fills fws with the paths which have a pressure difference, and reduces them to the forced ones
+	void find_flowing_paths();
+	// Returns the indices (into fws) of the paths that are forced
 	std::vector<size_t> find_forced_paths();
 	bool remove_paths_not_compatible_with_forced();
 	void reduce_to_forced_paths();
@@ -100,6 +160,37 @@ public:
 	std::vector<PlumbingMachine*> plumbing_machines;
 
 	void update_pipes(float dt, Vehicle* in_vehicle);
+
+	Solver get_solver() const { return solver; }
+	void set_solver(Solver n_solver);
+
+	// Forces the plumbing graph to be rebuilt on the next update. Changes are detected
+	// anyway, but this is cheaper if you know you changed something
+	void invalidate_graph() { graph_valid = false; }
+	// Rebuilds the graph and checks it's the same as the cached one, unless a change was
+	// detected (it would be rebuilt anyway). Logs an error and returns false if a change
+	// went unnoticed
+	bool check_graph_cache();
+	// If true, check_graph_cache is called every update. Slow, for debugging
+	void set_check_cache(bool value) { check_cache = value; }
+	bool get_check_cache() const { return check_cache; }
+
+	size_t get_path_count() const { return paths.size(); }
+	size_t get_flowing_path_count() const { return fws.size(); }
+	size_t get_graph_rebuilds() const { return graph_rebuilds; }
+	size_t get_reductions() const { return reductions; }
+	size_t get_network_iterations() const { return network.get_last_iterations(); }
+	double get_network_residual() const { return network.get_last_residual(); }
+	// In seconds
+	double get_last_update_time() const { return last_update_time; }
+
+	// Measures the time per tick of finding the flows with the selected solver, both with
+	// the cached graph and rebuilding it every tick (what every tick did before the graph
+	// was cached), and logs the results. Fluids are not moved
+	void benchmark(size_t ticks);
+	// Finds the flows with both solvers and logs how much they differ on every true port,
+	// and their time. Fluids are not moved
+	void compare_solvers();
 	// Called when adding new parts, or merging vehicles (etc...)
 	glm::ivec2 find_free_space(glm::ivec2 size);
 	// Returns (0, 0) if none of the machines have plumbing
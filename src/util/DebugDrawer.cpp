@@ -229,7 +229,12 @@ DebugDrawer::DebugDrawer()
 	lines_vbo = 0;
 	lines_vao = 0;
 
-	shader = osp->assets->get<Shader>("core", "shaders/debug.vs");
+	// Headless there's no GL context to compile the shader, and nothing renders
+	shader = nullptr;
+	if(osp->renderer != nullptr)
+	{
+		shader = osp->assets->get<Shader>("core", "shaders/debug.vs");
+	}
 	point_size = 4.0f;
 	line_size = 1.0f;
 
@@ -237,6 +242,11 @@ DebugDrawer::DebugDrawer()
 }
 
 
+void DebugDrawer::clear()
+{
+	draw_list.clear();
+}
+
 DebugDrawer::~DebugDrawer()
 {
 }
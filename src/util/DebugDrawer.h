@@ -56,6 +56,9 @@ public:
 	float line_size;
 
 	void render(glm::dmat4 proj_view, glm::dmat4 c_model, float far_plane);
+	// Drops everything added without drawing it (render does this after drawing).
+	// Used headless, where nothing renders
+	void clear();
 
 	void add_point(glm::dvec3 a, glm::vec3 color);
 	void add_line(glm::dvec3 a, glm::dvec3 b, glm::vec3 color);
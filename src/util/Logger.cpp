@@ -7,6 +7,9 @@
 #include <iomanip>
 #include <string>
 #include <chrono>
+#include <cstdint>
+#include <vector>
+#include "ThreadUtil.h"
 
 #ifdef OSPGL_STACKTRACES
 #include <backward/backward.hpp>
@@ -32,9 +35,10 @@ size_t get_console_width()
 #endif
 }
 
-// Pretty prints to the terminal and writes to the file too
-void Logger::stacktrace()
+// Formatted with a line per frame, so it can go to the log file too
+std::string Logger::get_stacktrace()
 {
+	std::string out;
 #ifdef OSPGL_STACKTRACES
 	using namespace backward;
 
@@ -42,8 +46,7 @@ void Logger::stacktrace()
 
 	StackTrace st; st.load_here();
 	TraceResolver tr; tr.load_stacktrace(st);
-	std::cout << rang::fg::yellow << "Stacktrace: " << std::endl;
-	toFile.push_back("Stacktrace: \n");
+	out += "Stacktrace: \n";
 	// We start at 1 to ignore the backward.hpp call
 	for(size_t i = 2; i < st.size(); i++)
 	{
@@ -85,29 +88,79 @@ void Logger::stacktrace()
 		{
 			pad += " ";
 		}
-		std::cout << rang::fg::reset << i << "\t" << rang::fg::magenta <<
-			path << pad << rang::fg::reset << fnc << std::endl;
-
-		std::string fstring = std::to_string(i);
-		fstring += " ";
-		fstring += path;
-		fstring += " ";
-		fstring += trace.object_function;
-		fstring += "\n";
-		toFile.push_back(fstring);
+		out += std::to_string(i) + "\t" + path + pad + fnc + "\n";
 	}
 #endif
+	return out;
 }
 
-void Logger::log(int level, const char* format, fmt::format_args args)
+void Logger::stacktrace()
+{
+	std::string str = get_stacktrace();
+	if(!str.empty())
+	{
+		// Not an error itself, but shown like a warning
+		if(!push(2, std::move(str)))
+		{
+			dropped.fetch_add(1, std::memory_order_relaxed);
+		}
+	}
+}
+
+bool Logger::push(int level, std::string&& text)
+{
+	size_t pos = enqueue_pos.load(std::memory_order_relaxed);
+	Record* rec;
+	while(true)
+	{
+		rec = &ring[pos % RING_SIZE];
+		size_t seq = rec->seq.load(std::memory_order_acquire);
+		intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+		if(diff == 0)
+		{
+			// On failure pos is updated to the current value
+			if(enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+			{
+				break;
+			}
+		}
+		else if(diff < 0)
+		{
+			// Full, the writer has not yet freed this slot
+			return false;
+		}
+		else
+		{
+			pos = enqueue_pos.load(std::memory_order_relaxed);
+		}
+	}
+
+	rec->level = level;
+	rec->text = std::move(text);
+	rec->seq.store(pos + 1, std::memory_order_release);
+	pushed.fetch_add(1, std::memory_order_release);
+
+	// The writer wakes up on its own often enough, unless we are about to fill the ring
+	if(pos + 1 - dequeue_pos.load(std::memory_order_relaxed) >= RING_SIZE / 2)
+	{
+		notify_writer();
+	}
+
+	return true;
+}
+
+void Logger::notify_writer()
 {
-	auto mtx_lock = std::unique_lock<std::mutex>(mtx);
+	wake.store(true, std::memory_order_release);
+	writer_cv.notify_one();
+}
 
-	std::string prefix = "";
+void Logger::log(int level, const char* format, fmt::format_args args)
+{
+	const char* prefix;
 	if (level == 0)
 	{
 		prefix = "DBG";
-		std::cout << rang::fgB::black;
 	}
 	else if (level == 1)
 	{
@@ -116,92 +169,194 @@ void Logger::log(int level, const char* format, fmt::format_args args)
 	else if (level == 2)
 	{
 		prefix = "WRN";
-		std::cout << rang::fg::yellow;
 	}
 	else if (level == 3)
 	{
 		prefix = "ERR";
-		std::cout << rang::fg::red;
 	}
 	else
 	{
 		prefix = "FTL";
-		std::cout << rang::fg::red;
 	}
 
 	std::string fmated = fmt::vformat(format, args);
 
 	std::string str = fmt::format("[{}] {}\n", prefix, fmated);
 
-	std::cout << str << rang::fg::reset << rang::bg::reset;
+	if(level >= 3)
+	{
+		// Must be obtained from this thread
+		str += get_stacktrace();
+		if(level == 4)
+		{
+			str += "Raising exception\n";
+		}
 
-	toFile.push_back(str);
-	// TODO: Implement some mechanism to clean the log
-	saved_log.emplace_back(str, level);
+		// Errors are never dropped, we wait for the writer to make space
+		while(!push(level, std::move(str)))
+		{
+			notify_writer();
+			std::this_thread::yield();
+		}
 
-	if(level >= 3)
+		// An exception (and maybe a crash) follows, make sure it's written
+		flush();
+	}
+	else if(!push(level, std::move(str)))
 	{
-		stacktrace();
+		dropped.fetch_add(1, std::memory_order_relaxed);
 	}
 
 	if (level == 4)
 	{
-		std::cout << "Raising exception" << std::endl;
-		flushCounter = 0;
+		throw("Fatal error");
 	}
+}
 
-	onLog(level >= 2);
+size_t Logger::write_batch()
+{
+	size_t start = dequeue_pos.load(std::memory_order_relaxed);
+	size_t pos = start;
 
-	if (level == 4)
+	std::vector<std::pair<std::string, int>> batch;
+	while(true)
 	{
-		throw("Fatal error");
+		Record& rec = ring[pos % RING_SIZE];
+		if(rec.seq.load(std::memory_order_acquire) != pos + 1)
+		{
+			// Empty, or a producer is still writing it
+			break;
+		}
+
+		batch.emplace_back(std::move(rec.text), rec.level);
+		rec.text.clear();
+		rec.seq.store(pos + RING_SIZE, std::memory_order_release);
+		pos++;
 	}
+	dequeue_pos.store(pos, std::memory_order_relaxed);
+
+	size_t n_dropped = dropped.exchange(0, std::memory_order_relaxed);
+	if(n_dropped > 0)
+	{
+		batch.emplace_back(fmt::format("[WRN] {} log messages were dropped, the log is too busy\n", n_dropped), 2);
+	}
+
+	if(batch.empty())
+	{
+		return 0;
+	}
+
+	for(const auto& pair : batch)
+	{
+		if(pair.second == 0)
+		{
+			std::cout << rang::fgB::black;
+		}
+		else if(pair.second == 2)
+		{
+			std::cout << rang::fg::yellow;
+		}
+		else if(pair.second >= 3)
+		{
+			std::cout << rang::fg::red;
+		}
+
+		std::cout << pair.first << rang::fg::reset << rang::bg::reset;
+		file << pair.first;
+	}
+	std::cout.flush();
+	file.flush();
+
+	auto lock = std::unique_lock<std::mutex>(mtx);
+	for(auto& pair : batch)
+	{
+		saved_log.push_back(std::move(pair));
+	}
+	while(saved_log.size() > MAX_SAVED_LOG)
+	{
+		saved_log.pop_front();
+	}
+
+	return pos - start;
 }
 
-void Logger::onLog(bool important)
+void Logger::writer_func()
 {
-	flushCounter--;
+	set_this_thread_name("logger");
 
-	if (flushCounter <= 0 || important)
+	while(true)
 	{
-		std::ofstream outfile;
+		{
+			std::unique_lock<std::mutex> lock(writer_mtx);
+			writer_cv.wait_for(lock, std::chrono::milliseconds(10), [this]()
+			{
+				return wake.load(std::memory_order_acquire) || !run.load(std::memory_order_acquire);
+			});
+			wake.store(false, std::memory_order_relaxed);
+		}
 
-		outfile.open("output.log", std::ios_base::app);
-		for (size_t i = 0; i < toFile.size(); i++)
+		bool running = run.load(std::memory_order_acquire);
+		size_t n = write_batch();
+		if(n > 0)
 		{
-			outfile << toFile[i];
+			std::unique_lock<std::mutex> lock(writer_mtx);
+			written += n;
+			written_cv.notify_all();
 		}
 
-		toFile.clear();
+		if(!running)
+		{
+			break;
+		}
+	}
+}
 
-		flushCounter = wantedFlushCounter;
+void Logger::flush()
+{
+	size_t target = pushed.load(std::memory_order_acquire);
 
-		outfile.close();
+	std::unique_lock<std::mutex> lock(writer_mtx);
+	while(written < target)
+	{
+		notify_writer();
+		written_cv.wait_for(lock, std::chrono::milliseconds(1));
 	}
 }
 
 Logger::Logger()
 {
-	wantedFlushCounter = 1000;
-	flushCounter = wantedFlushCounter;
-
-	remove("./output.log");
+	ring = std::make_unique<Record[]>(RING_SIZE);
+	for(size_t i = 0; i < RING_SIZE; i++)
+	{
+		ring[i].seq.store(i, std::memory_order_relaxed);
+	}
+	enqueue_pos = 0;
+	dequeue_pos = 0;
+	dropped = 0;
+	pushed = 0;
+	written = 0;
+	wake = false;
+	run = true;
 
-	std::ofstream logfile("output.log");
+	file.open("output.log", std::ios_base::trunc);
 
 	auto now = std::chrono::system_clock::now();
 	auto in_time_t = std::chrono::system_clock::to_time_t(now);
-	logfile << "Program started at " << std::put_time(std::localtime(&in_time_t), "%Y-%m-%d %X") << std::endl;
-	logfile << "-------------------------------------------------" << std::endl;
+	file << "Program started at " << std::put_time(std::localtime(&in_time_t), "%Y-%m-%d %X") << std::endl;
+	file << "-------------------------------------------------" << std::endl;
 
-	logfile.close();
+	writer = std::thread(&Logger::writer_func, this);
 }
 
 
 Logger::~Logger()
 {
-	flushCounter = 0;
-	onLog();
+	run.store(false, std::memory_order_release);
+	notify_writer();
+	writer.join();
+	// Anything logged while the writer was closing
+	write_batch();
+	file.close();
 }
 
 Logger* logger;
@@ -1,54 +1,122 @@
 #pragma once
 #include <fmt/core.h>
-#include <vector>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <memory>
 #include <mutex>
+#include <string>
+#include <thread>
 
-// Comment to disable "debug" logging in Release
+// Defined unconditionally, so Release builds log "debug" messages too. Comment to
+// disable them in Release
 #define LOG_DEBUG_ALWAYS
 // Comment to disable "check" calls in Release
 #define CHECK_ALWAYS
 
+// Calls below this level (0 debug, 1 info, 2 warn, 3 error) are compiled out: nothing
+// is formatted, but the arguments of the call are still evaluated by the caller. Use the
+// LOG_DEBUG / LOG_INFO / LOG_WARN macros if they are expensive to get. Fatal is never filtered
+#ifndef LOG_MIN_LEVEL
+	#if defined(_DEBUG) || defined(LOG_DEBUG_ALWAYS)
+		#define LOG_MIN_LEVEL 0
+	#else
+		#define LOG_MIN_LEVEL 1
+	#endif
+#endif
+
+// Messages are formatted by the calling thread and pushed into a lock free ring buffer,
+// a background thread writes them in batches to the console and output.log.
+// If the ring is full, debug, info and warnings are dropped (and a warning tells how many),
+// errors and fatals wait for space, and are written before returning, as they are
+// likely followed by a crash
 class Logger
 {
 private:
 
-	int flushCounter;
-	std::vector<std::string> toFile;
-
-	int wantedFlushCounter;
+	struct Record
+	{
+		// Sequence number of the ring (Vyukov bounded queue)
+		std::atomic<size_t> seq;
+		int level;
+		std::string text;
+	};
+
+	static constexpr size_t RING_SIZE = 4096;
+
+	std::unique_ptr<Record[]> ring;
+	// Producers reserve slots on enqueue_pos, only the writer thread advances dequeue_pos
+	std::atomic<size_t> enqueue_pos;
+	std::atomic<size_t> dequeue_pos;
+	std::atomic<size_t> dropped;
+
+	// Records pushed and written, for flush()
+	std::atomic<size_t> pushed;
+	size_t written;
+
+	std::thread writer;
+	std::atomic<bool> run;
+	std::atomic<bool> wake;
+	std::mutex writer_mtx;
+	// The writer waits on it with a timeout, so producers only notify when in a hurry
+	std::condition_variable writer_cv;
+	std::condition_variable written_cv;
+
+	std::ofstream file;
+
+	bool push(int level, std::string&& text);
+	void notify_writer();
+	void writer_func();
+	// Returns number of records written
+	size_t write_batch();
+	std::string get_stacktrace();
 
 public:
 
-	std::vector<std::pair<std::string, int>> saved_log;
+	// Last messages, with their level, guarded by mtx. Oldest are removed first
+	static constexpr size_t MAX_SAVED_LOG = 2048;
+	std::deque<std::pair<std::string, int>> saved_log;
 
 	std::mutex mtx;
 
+	// Logs the stacktrace of the calling thread (only if built with OSPGL_STACKTRACES)
 	void stacktrace();
 
 	template <typename... Args>
 	void debug(const char* format, const Args & ... args)
 	{
-#if defined(_DEBUG) || defined(LOG_DEBUG_ALWAYS)
-		log(0, format, fmt::make_format_args(args...));
-#endif
+		if constexpr(LOG_MIN_LEVEL <= 0)
+		{
+			log(0, format, fmt::make_format_args(args...));
+		}
 	}
 
 	template <typename... Args>
 	void info(const char*  format, const Args & ... args)
 	{
-		log(1, format, fmt::make_format_args(args...));
+		if constexpr(LOG_MIN_LEVEL <= 1)
+		{
+			log(1, format, fmt::make_format_args(args...));
+		}
 	}
 
 	template <typename... Args>
 	void warn(const char*  format, const Args & ... args)
 	{
-		log(2, format, fmt::make_format_args(args...));
+		if constexpr(LOG_MIN_LEVEL <= 2)
+		{
+			log(2, format, fmt::make_format_args(args...));
+		}
 	}
 
 	template <typename... Args>
 	void error(const char*  format, const Args & ... args)
 	{
-		log(3, format, fmt::make_format_args(args...));
+		if constexpr(LOG_MIN_LEVEL <= 3)
+		{
+			log(3, format, fmt::make_format_args(args...));
+		}
 	}
 
 	template <typename... Args>
@@ -74,7 +142,8 @@ public:
 		}
 	}
 
-	void onLog(bool important = false);
+	// Blocks until everything logged before the call is written
+	void flush();
 
 	Logger();
 	~Logger();
@@ -82,5 +151,10 @@ public:
 
 extern Logger* logger;
 
+// Same as the logger functions, but the arguments are not evaluated if the level is filtered
+#define LOG_DEBUG(...) do { if constexpr(LOG_MIN_LEVEL <= 0) { logger->debug(__VA_ARGS__); } } while(0)
+#define LOG_INFO(...) do { if constexpr(LOG_MIN_LEVEL <= 1) { logger->info(__VA_ARGS__); } } while(0)
+#define LOG_WARN(...) do { if constexpr(LOG_MIN_LEVEL <= 2) { logger->warn(__VA_ARGS__); } } while(0)
+
 void create_global_logger();
 void destroy_global_logger();
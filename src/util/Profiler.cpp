@@ -1,106 +1,359 @@
 #include "Profiler.h"
 #include "Logger.h"
-#include <GLFW/glfw3.h>
+#include "ThreadUtil.h"
 #include <imgui/imgui.h>
+#include <algorithm>
+#include <fstream>
 
-void Profiler::push(std::string gate)
+namespace
 {
-#ifdef ENABLE_PROFILER
-	stack.push_back(gate);
-	checkpoints[stack] = glfwGetTime();
-#endif
+	// Marks the buffer as dead when its thread exits
+	struct ThreadHandle
+	{
+		std::shared_ptr<Profiler::ThreadBuffer> buf;
+
+		~ThreadHandle()
+		{
+			if(buf)
+			{
+				buf->alive.store(false, std::memory_order_release);
+			}
+		}
+	};
 }
 
-void Profiler::pop()
+std::shared_ptr<Profiler::ThreadBuffer> Profiler::register_thread()
 {
-#ifdef ENABLE_PROFILER
-	logger->check(stack.size() > 0, "Tried to pop on an empty profiler stack");
+	auto buf = std::make_shared<ThreadBuffer>();
+	buf->thread_name = get_this_thread_name();
 
-	// On each pop we add to the results
-	auto it = results.find(stack);
-	if(it == results.end())
+	std::unique_lock<std::mutex> lock(buffers_mtx);
+	buf->index = next_thread_index++;
+	if(buf->thread_name.empty())
 	{
-		it = results.insert(std::make_pair(stack, RunStats())).first;
+		buf->thread_name = "thread " + std::to_string(buf->index);
 	}
+	buffers.push_back(buf);
+	return buf;
+}
 
-	RunStats& st = it->second;
+Profiler::ThreadBuffer* Profiler::get_thread_buffer()
+{
+	thread_local ThreadHandle handle;
+	if(!handle.buf)
+	{
+		handle.buf = register_thread();
+	}
+	return handle.buf.get();
+}
 
-	st.count++;
-	st.last = glfwGetTime() - checkpoints[stack];
-	st.avg = (st.avg * (st.count - 1) + st.last) / st.count;
-	if (st.max < st.last) st.max = st.last;
-	if (st.min > st.last) st.min = st.last;
+void Profiler::counter(const char* name, double value)
+{
+	if(!enabled.load(std::memory_order_relaxed))
+	{
+		return;
+	}
 
-	
-	stack.pop_back();
-#endif
+	ThreadBuffer* buf = get_thread_buffer();
+	Event ev;
+	ev.name = name;
+	ev.start = now();
+	ev.end = ev.start;
+	ev.value = value;
+	ev.path = hash_path(buf->path, name);
+	ev.parent = buf->path;
+	ev.type = EventType::COUNTER;
+	buf->push(ev);
 }
 
-void Profiler::show_results()
+void Profiler::process(const ThreadBuffer& buf, const Event& ev)
+{
+	if(capturing && captured.size() < MAX_CAPTURED_EVENTS)
+	{
+		captured.push_back(CapturedEvent{ev, buf.index});
+	}
+
+	if(ev.type == EventType::FRAME)
+	{
+		return;
+	}
+
+	// The same path on different threads are different nodes
+	uint64_t key = ev.path ^ ((uint64_t)buf.index * 0x9E3779B97F4A7C15ULL);
+	auto it = nodes.find(key);
+	if(it == nodes.end())
+	{
+		Node n = {};
+		n.name = ev.name;
+		n.parent = ev.parent == 0 ? 0 : ev.parent ^ ((uint64_t)buf.index * 0x9E3779B97F4A7C15ULL);
+		n.thread = buf.index;
+		n.counter = ev.type == EventType::COUNTER;
+		it = nodes.emplace(key, n).first;
+	}
+
+	Node& n = it->second;
+	if(n.counter)
+	{
+		n.value = ev.value;
+	}
+	else
+	{
+		n.frame_time += (double)(ev.end - ev.start) * 1e-9;
+		n.frame_calls++;
+	}
+}
+
+void Profiler::finish_frame()
 {
-#ifdef ENABLE_PROFILER
-	for(auto& pair : results)
+	for(auto& pair : nodes)
 	{
-		std::string full = "";
-		for(size_t i = 0; i < pair.first.size(); i++)
+		Node& n = pair.second;
+		n.last = n.frame_time;
+		n.calls = n.frame_calls;
+		n.avg = n.avg == 0.0 ? n.last : n.avg * 0.95 + n.last * 0.05;
+		n.max = std::max(n.max * 0.99, n.last);
+		n.frame_time = 0.0;
+		n.frame_calls = 0;
+	}
+}
+
+void Profiler::frame()
+{
+	ThreadBuffer* own = get_thread_buffer();
+	Event ev = {};
+	ev.name = "frame";
+	ev.start = now();
+	ev.end = ev.start;
+	ev.type = EventType::FRAME;
+	own->push(ev);
+
+	std::unique_lock<std::mutex> lock(buffers_mtx);
+	for(auto it = buffers.begin(); it != buffers.end();)
+	{
+		ThreadBuffer& buf = **it;
+		// Read before emptying, so events pushed right before the thread exited are not lost
+		bool alive = buf.alive.load(std::memory_order_acquire);
+
+		size_t tail = buf.tail.load(std::memory_order_relaxed);
+		size_t head = buf.head.load(std::memory_order_acquire);
+		for(; tail != head; tail++)
 		{
-			full += pair.first[i];
-			if(i != pair.first.size() - 1)
-			{
-				full += '.';
-			}
+			process(buf, buf.events[tail % ThreadBuffer::CAPACITY]);
+		}
+		buf.tail.store(tail, std::memory_order_release);
+
+		thread_names[buf.index] = buf.thread_name;
+		thread_dropped[buf.index] = buf.dropped.load(std::memory_order_relaxed);
+
+		if(!alive)
+		{
+			it = buffers.erase(it);
+		}
+		else
+		{
+			it++;
 		}
-		
-		logger->info("{0}: max: {2:.4f}ms min: {3:.4f}ms avg: {1:.4f}ms last: {4:.4f}ms", 
-				full, pair.second.avg*1000.0, pair.second.max*1000.0, pair.second.min*1000.0, pair.second.last*1000.0);
 	}
-#endif
+	lock.unlock();
+
+	finish_frame();
 }
 
-void Profiler::show_imgui()
+void Profiler::begin_capture()
+{
+	captured.clear();
+	capturing = true;
+	capture_start = now();
+	logger->info("Started profiler capture");
+}
+
+static void write_json_string(std::ofstream& out, const char* str)
 {
-	// TODO: Think this out, we are showing results while we are generating them
-	ImGui::SetNextWindowPos(ImVec2(pos_x, pos_y), ImGuiCond_Always);
-	ImGui::Begin("Profiler",nullptr,
-				 ImGuiWindowFlags_NoFocusOnAppearing | ImGuiWindowFlags_NoInputs
-				 | ImGuiWindowFlags_NoDecoration);
+	out << '"';
+	for(const char* c = str; *c != '\0'; c++)
+	{
+		if(*c == '"' || *c == '\\')
+		{
+			out << '\\';
+		}
+		out << *c;
+	}
+	out << '"';
+}
+
+bool Profiler::end_capture(const std::string& path)
+{
+	capturing = false;
+
+	std::ofstream out(path);
+	if(!out)
+	{
+		logger->warn("Could not write profiler capture to '{}'", path);
+		return false;
+	}
 
+	// Chrome trace event format, timestamps are in microseconds
+	out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
 	bool first = true;
-#ifdef ENABLE_PROFILER
-	for(auto& pair : results)
+	for(const auto& pair : thread_names)
 	{
-		std::string full = "";
-		for(size_t i = 0; i < pair.first.size(); i++)
+		out << (first ? "" : ",\n");
+		out << R"({"name":"thread_name","ph":"M","pid":1,"tid":)" << pair.first << R"(,"args":{"name":)";
+		write_json_string(out, pair.second.c_str());
+		out << "}}";
+		first = false;
+	}
+
+	out.precision(3);
+	out << std::fixed;
+	for(const CapturedEvent& cev : captured)
+	{
+		const Event& ev = cev.ev;
+		double ts = (double)(ev.start - capture_start) * 1e-3;
+		out << (first ? "" : ",\n") << "{\"name\":";
+		write_json_string(out, ev.name);
+		out << ",\"pid\":1,\"tid\":" << cev.thread << ",\"ts\":" << ts;
+		if(ev.type == EventType::SCOPE)
+		{
+			out << ",\"ph\":\"X\",\"dur\":" << (double)(ev.end - ev.start) * 1e-3 << "}";
+		}
+		else if(ev.type == EventType::COUNTER)
+		{
+			out << ",\"ph\":\"C\",\"args\":{\"value\":" << ev.value << "}}";
+		}
+		else
 		{
-			full += pair.first[i];
-			if(i != pair.first.size() - 1)
+			out << ",\"ph\":\"i\",\"s\":\"g\"}";
+		}
+		first = false;
+	}
+	out << "\n]}\n";
+
+	if(captured.size() >= MAX_CAPTURED_EVENTS)
+	{
+		logger->warn("Profiler capture was full, events after the first {} were dropped", MAX_CAPTURED_EVENTS);
+	}
+	logger->info("Wrote profiler capture ({} events) to '{}'", captured.size(), path);
+	captured.clear();
+	captured.shrink_to_fit();
+	return true;
+}
+
+void Profiler::show_node(uint64_t key, const std::unordered_map<uint64_t, std::vector<uint64_t>>& children)
+{
+	const Node& n = nodes.at(key);
+	auto it = children.find(key);
+	bool leaf = it == children.end();
+
+	ImGuiTreeNodeFlags flags = ImGuiTreeNodeFlags_DefaultOpen;
+	if(leaf)
+	{
+		flags |= ImGuiTreeNodeFlags_Leaf | ImGuiTreeNodeFlags_NoTreePushOnOpen;
+	}
+
+	bool open;
+	if(n.counter)
+	{
+		open = ImGui::TreeNodeEx((void*)(uintptr_t)key, flags, "%s = %g", n.name, n.value);
+	}
+	else
+	{
+		open = ImGui::TreeNodeEx((void*)(uintptr_t)key, flags, "%s -> %.3fms (max %.3fms, %i calls)",
+							   n.name, n.avg * 1000.0, n.max * 1000.0, (int)n.calls);
+	}
+
+	if(open && !leaf)
+	{
+		for(uint64_t child : it->second)
+		{
+			show_node(child, children);
+		}
+		ImGui::TreePop();
+	}
+}
+
+void Profiler::show_imgui()
+{
+	bool en = enabled.load(std::memory_order_relaxed);
+	if(ImGui::Checkbox("Enabled", &en))
+	{
+		enabled.store(en, std::memory_order_relaxed);
+	}
+
+	// Children in order of name, so the tree doesn't jump around
+	std::unordered_map<uint64_t, std::vector<uint64_t>> children;
+	std::unordered_map<size_t, std::vector<uint64_t>> roots;
+	for(const auto& pair : nodes)
+	{
+		if(pair.second.parent == 0 || nodes.find(pair.second.parent) == nodes.end())
+		{
+			roots[pair.second.thread].push_back(pair.first);
+		}
+		else
+		{
+			children[pair.second.parent].push_back(pair.first);
+		}
+	}
+	auto by_name = [this](uint64_t a, uint64_t b)
+	{
+		return std::string(nodes.at(a).name) < std::string(nodes.at(b).name);
+	};
+	for(auto& pair : children)
+	{
+		std::sort(pair.second.begin(), pair.second.end(), by_name);
+	}
+
+	std::vector<size_t> threads;
+	for(const auto& pair : roots)
+	{
+		threads.push_back(pair.first);
+	}
+	std::sort(threads.begin(), threads.end());
+
+	for(size_t thread : threads)
+	{
+		std::vector<uint64_t>& thread_roots = roots[thread];
+		std::sort(thread_roots.begin(), thread_roots.end(), by_name);
+
+		ImGui::PushID((int)thread);
+		std::string header = thread_names[thread];
+		if(thread_dropped[thread] > 0)
+		{
+			header += " (" + std::to_string(thread_dropped[thread]) + " dropped)";
+		}
+		bool is_main = thread_names[thread] == "main";
+		if(ImGui::CollapsingHeader(header.c_str(), is_main ? ImGuiTreeNodeFlags_DefaultOpen : 0))
+		{
+			for(uint64_t root : thread_roots)
 			{
-				full += '.';
+				show_node(root, children);
 			}
 		}
+		ImGui::PopID();
+	}
+}
 
-		float mils = pair.second.avg * 1000.0f;
-		if(first)
+void Profiler::show_results()
+{
+	for(const auto& pair : nodes)
+	{
+		const Node& n = pair.second;
+		if(n.counter)
 		{
-			ImGui::Text("%s -> %fms (%f fps)", full.c_str(), mils, 1000.0f / mils);
-			first = false;
+			logger->info("[{}] {} = {}", thread_names[n.thread], n.name, n.value);
 		}
 		else
 		{
-			ImGui::Text("%s -> %fms", full.c_str(), mils);
+			logger->info("[{}] {}: avg: {:.4f}ms max: {:.4f}ms last: {:.4f}ms ({} calls)",
+						 thread_names[n.thread], n.name, n.avg * 1000.0, n.max * 1000.0, n.last * 1000.0, n.calls);
 		}
 	}
-#else 
-	ImGui::Text("Profiler is compile-time disabled");
-#endif
-
-	ImGui::End();
 }
 
-ProfileBlock Profiler::block(std::string name)
+Profiler::Profiler()
 {
-	push(name);
-	return std::move(ProfileBlock());
+	capturing = false;
+	capture_start = 0;
 }
 
 Profiler* profiler;
@@ -1,11 +1,17 @@
-#pragma once 
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
 #include <string>
 #include <unordered_map>
 #include <vector>
 #include "defines.h"
 
-// Kind of useless thanks to perf tool
-//#define ENABLE_PROFILER
+// Cheap enough to leave on: a scope is two clock reads and a push into a ring buffer
+// of its thread, and only a relaxed atomic load while the profiler is disabled
+#define ENABLE_PROFILER
 
 // Helper macros to generate unique* identifier
 // * Limitation: Only one PROFILER_X per line
@@ -13,66 +19,171 @@
 #define _PROFILER_MERGE(A, B) A##B
 #define _PROFILER_LABEL(A) _PROFILER_MERGE(__profiler_, A)
 
-
-#ifdef ENABLE_PROFILER 
-	#define PROFILE_FUNC() auto _PROFILER_LABEL(__LINE__) = profiler->block(__func__);
-#else 
-	#define PROFILE_FUNC() {};
-#endif
-
+// Names are stored as pointers, use string literals (or __func__)
 #ifdef ENABLE_PROFILER
-	#define PROFILE_BLOCK(name) auto _PROFILER_LABEL(__LINE__) = profiler->block(name)
-#else 
-	#define PROFILE_BLOCK(name) 
-#endif 
-
-struct ProfileBlock;
+	#define PROFILE_FUNC() ProfileBlock _PROFILER_LABEL(__LINE__)(__func__)
+	#define PROFILE_BLOCK(name) ProfileBlock _PROFILER_LABEL(__LINE__)(name)
+	#define PROFILE_COUNTER(name, value) do { Profiler::counter(name, (double)(value)); } while(0)
+	// Call once per frame on the main thread, collects the events of every thread
+	#define PROFILE_FRAME() do { if(profiler) { profiler->frame(); } } while(0)
+#else
+	// Still require the semicolon, and are safe in an unbraced if / else
+	#define PROFILE_FUNC() do {} while(0)
+	#define PROFILE_BLOCK(name) do {} while(0)
+	#define PROFILE_COUNTER(name, value) do {} while(0)
+	#define PROFILE_FRAME() do {} while(0)
+#endif
 
+// Every thread pushes its events into its own ring buffer (single producer, single consumer,
+// lock free) which the main thread empties on frame(), so any thread can be profiled.
+// Full buffers drop events (counted), they never block the profiled thread.
+// Events are summarized per thread as a tree of scopes, shown by show_imgui(), and
+// can be captured and exported as a Chrome trace (chrome://tracing or ui.perfetto.dev)
 class Profiler
 {
-private:
+public:
 
-	struct RunStats
+	enum class EventType : uint8_t
 	{
-		uint64_t count;
-		double avg, min, max, last;
+		SCOPE,
+		COUNTER,
+		FRAME
+	};
 
-		RunStats()
-		{
-			count = 0; avg = 0; min = 99999999.0; max = -1.0; last = 0.0;
-		}
+	struct Event
+	{
+		const char* name;
+		// Nanoseconds of the steady clock
+		int64_t start;
+		// Only for scopes
+		int64_t end;
+		// Only for counters
+		double value;
+		// Hash of the stack of scopes (of the thread) the event closes, and of its parent
+		uint64_t path;
+		uint64_t parent;
+		EventType type;
 	};
 
-	struct VectorHasher
+	struct ThreadBuffer
 	{
-		std::size_t operator()(const std::vector<std::string>& vec) const
+		static constexpr size_t CAPACITY = 8192;
+
+		Event events[CAPACITY];
+		// head is only written by the owner thread, tail by frame()
+		std::atomic<size_t> head;
+		std::atomic<size_t> tail;
+		std::atomic<size_t> dropped;
+		// False once the thread exits, the buffer is freed once empty
+		std::atomic<bool> alive;
+
+		// Used as thread id in traces
+		size_t index;
+		std::string thread_name;
+		// Path of the innermost open scope, only used by the owner thread
+		uint64_t path;
+
+		// Owner thread
+		void push(const Event& ev)
 		{
-			size_t seed = 0;
-			for(const std::string& str : vec)
+			size_t h = head.load(std::memory_order_relaxed);
+			if(h - tail.load(std::memory_order_acquire) >= CAPACITY)
 			{
-				hash_combine(seed, str);
+				dropped.fetch_add(1, std::memory_order_relaxed);
+				return;
 			}
-			return seed;
-		}	
+			events[h % CAPACITY] = ev;
+			head.store(h + 1, std::memory_order_release);
+		}
+
+		ThreadBuffer() : head(0), tail(0), dropped(0), alive(true), index(0), path(0) {}
 	};
 
-	int compiled;
-	std::unordered_map<std::vector<std::string>, double, VectorHasher> checkpoints;
-	std::unordered_map<std::vector<std::string>, RunStats, VectorHasher> results;
+private:
+
+	struct Node
+	{
+		const char* name;
+		uint64_t parent;
+		size_t thread;
+		bool counter;
+
+		// Accumulated during the current frame
+		double frame_time;
+		uint64_t frame_calls;
+
+		// Of the last frame, exponential average, and peak (which slowly decays)
+		double last, avg, max;
+		uint64_t calls;
+		// Last value of counters
+		double value;
+	};
+
+	struct CapturedEvent
+	{
+		Event ev;
+		size_t thread;
+	};
+
+	// Shared by all profilers, so threads started before the profiler are also tracked
+	static inline std::mutex buffers_mtx;
+	static inline std::vector<std::shared_ptr<ThreadBuffer>> buffers;
+	static inline size_t next_thread_index = 0;
+
+	std::unordered_map<uint64_t, Node> nodes;
+	// By thread index, kept after the threads exit for the summary and traces
+	std::unordered_map<size_t, std::string> thread_names;
+	std::unordered_map<size_t, size_t> thread_dropped;
 
-	std::vector<std::string> stack;
+	bool capturing;
+	std::vector<CapturedEvent> captured;
+	int64_t capture_start;
+
+	void process(const ThreadBuffer& buf, const Event& ev);
+	void finish_frame();
+	void show_node(uint64_t key, const std::unordered_map<uint64_t, std::vector<uint64_t>>& children);
+
+	static std::shared_ptr<ThreadBuffer> register_thread();
 
 public:
 
-	int pos_x = 0, pos_y = 0;
+	// Bound on captured events, so a forgotten capture doesn't grow forever
+	static constexpr size_t MAX_CAPTURED_EVENTS = 1 << 20;
 
-	ProfileBlock block(std::string name);
+	static inline std::atomic<bool> enabled = true;
 
-	void push(std::string gate);
-	void pop();
-	void show_results();
+	static int64_t now()
+	{
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(
+				std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	static uint64_t hash_path(uint64_t parent, const char* name)
+	{
+		uint64_t h = (parent ^ (uint64_t)(uintptr_t)name) * 0x100000001b3ULL;
+		// 0 is the root
+		return h == 0 ? 1 : h;
+	}
+
+	// The buffer of the calling thread, created on first use
+	static ThreadBuffer* get_thread_buffer();
+
+	static void counter(const char* name, double value);
+
+	// Marks the end of a frame and collects the events of every thread (main thread)
+	void frame();
+
+	void begin_capture();
+	bool is_capturing() const { return capturing; }
+	// Writes the captured events as a Chrome trace json, returns false if it couldn't be written
+	bool end_capture(const std::string& path);
+
+	// Draws the summary into the current ImGui window
 	void show_imgui();
+	// Logs the summary
+	void show_results();
 
+	Profiler();
 };
 
 extern Profiler* profiler;
@@ -83,34 +194,46 @@ void destroy_global_profiler();
 // Simple RAII class for profiling blocks of code
 class ProfileBlock
 {
-protected:
-	friend class Profiler;
-
-	ProfileBlock()
-	{	
-		invalid = false;
-	}
-
 private:
-	bool invalid;
+
+	const char* name;
+	int64_t start;
+	uint64_t parent;
+	Profiler::ThreadBuffer* buf;
 
 	// Make non-copyable
 	ProfileBlock(const ProfileBlock& b) = delete;
 	ProfileBlock& operator=(const ProfileBlock& b) = delete;
 
 public:
-	
-	ProfileBlock(ProfileBlock&& b)
+
+	explicit ProfileBlock(const char* name)
 	{
-		invalid = b.invalid;
-		b.invalid = true;
+		buf = nullptr;
+		if(Profiler::enabled.load(std::memory_order_relaxed))
+		{
+			buf = Profiler::get_thread_buffer();
+			this->name = name;
+			parent = buf->path;
+			buf->path = Profiler::hash_path(parent, name);
+			start = Profiler::now();
+		}
 	}
 
 	~ProfileBlock()
 	{
-		if(!invalid)
+		if(buf)
 		{
-			profiler->pop();
+			Profiler::Event ev;
+			ev.name = name;
+			ev.start = start;
+			ev.end = Profiler::now();
+			ev.value = 0.0;
+			ev.path = buf->path;
+			ev.parent = parent;
+			ev.type = Profiler::EventType::SCOPE;
+			buf->push(ev);
+			buf->path = parent;
 		}
 	}
 };
@@ -0,0 +1,92 @@
+#pragma once
+#include <array>
+#include <vector>
+#include <cstddef>
+#include <type_traits>
+
+// A vector which keeps up to N elements inline, without allocating, and moves them
+// to the heap if it grows past that. Meant for small collections which are copied
+// around often (fluids in a tank...). Only for trivially copyable types.
+// Any insertion or erase invalidates pointers to the elements
+template<typename T, size_t N>
+class SmallVector
+{
+	static_assert(std::is_trivially_copyable<T>::value, "SmallVector is only for trivially copyable types");
+
+private:
+
+	std::array<T, N> inline_data;
+	std::vector<T> heap_data;
+	size_t count;
+
+	bool on_heap() const { return !heap_data.empty(); }
+
+public:
+
+	T* data() { return on_heap() ? heap_data.data() : inline_data.data(); }
+	const T* data() const { return on_heap() ? heap_data.data() : inline_data.data(); }
+
+	T* begin() { return data(); }
+	T* end() { return data() + count; }
+	const T* begin() const { return data(); }
+	const T* end() const { return data() + count; }
+
+	T& operator[](size_t i) { return data()[i]; }
+	const T& operator[](size_t i) const { return data()[i]; }
+
+	size_t size() const { return count; }
+	bool empty() const { return count == 0; }
+
+	void clear()
+	{
+		heap_data.clear();
+		count = 0;
+	}
+
+	// Returns a reference to the inserted element
+	T& insert(size_t pos, const T& value)
+	{
+		if(on_heap())
+		{
+			heap_data.insert(heap_data.begin() + pos, value);
+		}
+		else if(count < N)
+		{
+			for(size_t i = count; i > pos; i--)
+			{
+				inline_data[i] = inline_data[i - 1];
+			}
+			inline_data[pos] = value;
+		}
+		else
+		{
+			heap_data.reserve(N * 2);
+			heap_data.assign(inline_data.begin(), inline_data.end());
+			heap_data.insert(heap_data.begin() + pos, value);
+		}
+
+		count++;
+		return data()[pos];
+	}
+
+	T& push_back(const T& value) { return insert(count, value); }
+
+	void erase(size_t pos)
+	{
+		if(on_heap())
+		{
+			heap_data.erase(heap_data.begin() + pos);
+		}
+		else
+		{
+			for(size_t i = pos; i + 1 < count; i++)
+			{
+				inline_data[i] = inline_data[i + 1];
+			}
+		}
+
+		count--;
+	}
+
+	SmallVector() : count(0) {}
+};
@@ -0,0 +1,117 @@
+#include "ThreadPool.h"
+#include "ThreadUtil.h"
+#include "Profiler.h"
+
+void ThreadPool::work()
+{
+	PROFILE_BLOCK("thread_pool");
+	while(true)
+	{
+		size_t i = next_item.fetch_add(1);
+		if(i >= job_count)
+		{
+			break;
+		}
+
+		(*job)(i);
+	}
+}
+
+void ThreadPool::thread_func()
+{
+	uint64_t seen_generation = 0;
+
+	while(true)
+	{
+		{
+			std::unique_lock<std::mutex> lock(mtx);
+			job_cv.wait(lock, [this, seen_generation]()
+			{
+				return !run || generation != seen_generation;
+			});
+
+			if(!run)
+			{
+				return;
+			}
+
+			seen_generation = generation;
+		}
+
+		work();
+
+		{
+			std::unique_lock<std::mutex> lock(mtx);
+			active--;
+			if(active == 0)
+			{
+				done_cv.notify_all();
+			}
+		}
+	}
+}
+
+void ThreadPool::parallel_for(size_t count, const std::function<void(size_t)>& njob)
+{
+	if(threads.empty() || count <= 1)
+	{
+		for(size_t i = 0; i < count; i++)
+		{
+			njob(i);
+		}
+		return;
+	}
+
+	{
+		std::unique_lock<std::mutex> lock(mtx);
+		job = &njob;
+		job_count = count;
+		next_item = 0;
+		active = threads.size();
+		generation++;
+	}
+	job_cv.notify_all();
+
+	work();
+
+	std::unique_lock<std::mutex> lock(mtx);
+	done_cv.wait(lock, [this]()
+	{
+		return active == 0;
+	});
+	job = nullptr;
+}
+
+ThreadPool::ThreadPool(size_t thread_count, const std::string& thread_name)
+{
+	job = nullptr;
+	job_count = 0;
+	next_item = 0;
+	active = 0;
+	generation = 0;
+	run = true;
+
+	threads.reserve(thread_count);
+	for(size_t i = 0; i < thread_count; i++)
+	{
+		threads.emplace_back([this, thread_name]()
+		{
+			set_this_thread_name(thread_name);
+			thread_func();
+		});
+	}
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::unique_lock<std::mutex> lock(mtx);
+		run = false;
+	}
+	job_cv.notify_all();
+
+	for(std::thread& thread : threads)
+	{
+		thread.join();
+	}
+}
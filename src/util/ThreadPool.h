@@ -0,0 +1,50 @@
+#pragma once
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <vector>
+#include <string>
+#include <cstdint>
+
+// A fixed set of worker threads that run "parallel for" jobs. Work items are
+// handed out one at a time through an atomic counter, so faster threads steal
+// work from slower ones. The calling thread also works while waiting.
+// Only one job can be running at once, don't call parallel_for from a job!
+class ThreadPool
+{
+private:
+
+	std::vector<std::thread> threads;
+
+	std::mutex mtx;
+	// Wakes up workers when a new job is available
+	std::condition_variable job_cv;
+	// Wakes up the caller once all workers are done
+	std::condition_variable done_cv;
+
+	const std::function<void(size_t)>* job;
+	size_t job_count;
+	std::atomic<size_t> next_item;
+	// Workers still running the current job
+	size_t active;
+	// Increased on each job so workers don't run a job twice
+	uint64_t generation;
+	bool run;
+
+	void work();
+	void thread_func();
+
+public:
+
+	// Runs job(i) for every i in [0, count) and returns once all of them are done
+	void parallel_for(size_t count, const std::function<void(size_t)>& job);
+
+	// Doesn't include the calling thread
+	size_t get_thread_count() const { return threads.size(); }
+
+	// Thread name is limited to 15 characters (see set_this_thread_name)
+	ThreadPool(size_t thread_count, const std::string& thread_name);
+	~ThreadPool();
+};
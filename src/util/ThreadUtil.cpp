@@ -8,8 +8,11 @@
 
 #endif
 
+static thread_local std::string this_thread_name;
+
 void set_this_thread_name(const std::string& str)
 {
+	this_thread_name = str;
 	std::string sane_str = str;
 	if(sane_str.size() >= 15)
 	{
@@ -25,3 +28,8 @@ void set_this_thread_name(const std::string& str)
 #endif
 
 }
+
+const std::string& get_this_thread_name()
+{
+	return this_thread_name;
+}
@@ -114,4 +114,6 @@ public:
 // May not work on some platforms!
 // Maximum of 15 characters for name
 void set_this_thread_name(const std::string& str);
+// Empty if the thread was not named, not truncated to 15 characters
+const std::string& get_this_thread_name();
 
@@ -1,12 +1,16 @@
 #include "Timer.h"
-#include "GLFW/glfw3.h"
 #include "Logger.h"
-#include <cfloat>
+#include <chrono>
+
+double Timer::now()
+{
+	auto since_epoch = std::chrono::steady_clock::now().time_since_epoch();
+	return std::chrono::duration<double>(since_epoch).count();
+}
 
 double Timer::get_elapsed_time()
 {
-	double now = glfwGetTime();
-	double diff = now - t0;
+	double diff = now() - t0;
 
 	if (!str.empty())
 	{
@@ -18,28 +22,28 @@ double Timer::get_elapsed_time()
 
 double Timer::restart()
 {
-	double now = glfwGetTime();
-	double diff = now - t0;
+	double cur = now();
+	double diff = cur - t0;
 	
 	if (!str.empty())
 	{
 		logger->info("['{}' (Restart)] {} seconds", str, diff);
 	}
 
-	t0 = glfwGetTime();
+	t0 = cur;
 	return diff;
 }
 
 Timer::Timer(std::string name)
 {
 	str = name;
-	t0 = glfwGetTime();
+	t0 = now();
 }
 
 Timer::Timer()
 {
 	str = "";
-	t0 = glfwGetTime();
+	t0 = now();
 }
 
 
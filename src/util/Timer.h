@@ -4,8 +4,8 @@
 #include <vector>
 
 
-// Uses GLFW time to make relatively precise 
-// measurements
+// Uses the steady clock to make relatively precise
+// measurements (doesn't need GLFW, so it works headless)
 // Inspired by the SFML timer, but just returns seconds.
 // If you give a string to the constructor it will automatically
 // log (INFO) the time every single call to getElapsedTime or restart
@@ -16,6 +16,9 @@ private:
 	std::string str;
 public:
 
+	// Seconds since an arbitrary point, monotonic
+	static double now();
+
 	double get_elapsed_time();
 	double restart();
 
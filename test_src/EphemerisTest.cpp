@@ -0,0 +1,103 @@
+#include "Test.h"
+#include "TestSystem.h"
+#include <universe/predictor/Ephemeris.h>
+#include <universe/propagator/EphemerisPropagator.h>
+#include <universe/propagator/RK4Propagator.h>
+
+// Compares the vessels propagated by EphemerisPropagator against integrating the whole
+// system with RK4, and checks it falls back to RK4 (without a jump) when the ephemeris
+// can't cover a step: memory budget, or knots dropped / regenerated by the system.
+// Pass "quick" to simulate less time (ctest does)
+
+// Both step the test system from t = 0 in 1s steps, like QuickPredictor
+struct Run
+{
+	TestSystem ref;
+	RK4Propagator ref_prop;
+	TestSystem sys;
+	EphemerisPropagator prop;
+	double t;
+
+	explicit Run(Ephemeris* eph) : prop(eph, 0.0)
+	{
+		ref = make_test_system();
+		sys = make_test_system();
+		ref_prop.bind_to(&ref.st, &ref.ls, &ref.tv);
+		prop.bind_to(&sys.st, &sys.ls, &sys.tv);
+		t = 0.0;
+	}
+
+	void step(size_t count)
+	{
+		for(size_t i = 0; i < count; i++)
+		{
+			ref_prop.propagate(1.0);
+			prop.propagate(1.0);
+			t += 1.0;
+		}
+	}
+
+	double error() const
+	{
+		return std::max(glm::distance(ref.ls[0].pos, sys.ls[0].pos), glm::distance(ref.ls[1].pos, sys.ls[1].pos));
+	}
+};
+
+int main(int argc, char** argv)
+{
+	test_begin("Ephemeris test");
+	bool quick = argc > 1 && std::string(argv[1]) == "quick";
+	size_t steps = quick ? 3600 : 86400;
+	// With the default settings the interpolated bodies take the vessels about half a meter
+	// away in a day
+	const double TOLERANCE = 5.0;
+
+	{
+		Ephemeris eph((Ephemeris::Settings()));
+		eph.reset(make_test_system().st, 0.0);
+		Run run(&eph);
+		run.step(steps);
+		logger->info("Ephemeris: vessels {:.4f}m from RK4 after {}s", run.error(), run.t);
+		TEST_CHECK(!run.prop.is_using_fallback(), "Fell back with the default settings");
+		TEST_CHECK(run.error() < TOLERANCE, "Vessels {}m away from RK4", run.error());
+
+		// Knots before the first one are gone, ensure must not say they are covered
+		eph.reset(run.ref.st, run.t);
+		TEST_CHECK(!eph.ensure(run.t - 1.0), "ensure covers time before the first knot");
+		TEST_CHECK(eph.ensure(run.t + 1.0), "ensure doesn't cover time after the first knot");
+	}
+
+	{
+		// A single chunk of 64 knots (5h 15min)
+		Ephemeris::Settings settings;
+		settings.knots_per_chunk = 64;
+		settings.memory_budget = settings.knots_per_chunk * 4 * sizeof(LightCartesianState) + 1024;
+		Ephemeris eph(settings);
+		eph.reset(make_test_system().st, 0.0);
+		Run run(&eph);
+		run.step(63 * 300 + 100);
+		logger->info("Memory budget: vessels {:.4f}m from RK4 after {}s", run.error(), run.t);
+		TEST_CHECK(run.prop.is_using_fallback(), "Didn't fall back past the memory budget");
+		TEST_CHECK(run.error() < TOLERANCE, "Vessels {}m away from RK4 after falling back", run.error());
+	}
+
+	// The system regenerates the ephemeris starting after the propagator time, in the middle
+	// of a step (get_states fails for t), and after the whole step (ensure fails)
+	for(double offset : {0.5, 2.0})
+	{
+		Ephemeris eph((Ephemeris::Settings()));
+		eph.reset(make_test_system().st, 0.0);
+		Run run(&eph);
+		run.step(100);
+		TEST_CHECK(!run.prop.is_using_fallback(), "Fell back too early");
+
+		// The reference states are what the system would have at that time
+		eph.reset(run.ref.st, run.t + offset);
+		run.step(100);
+		logger->info("Regenerated {}s ahead: vessels {:.4f}m from RK4", offset, run.error());
+		TEST_CHECK(run.prop.is_using_fallback(), "Didn't fall back with the ephemeris starting {}s ahead", offset);
+		TEST_CHECK(run.error() < TOLERANCE, "Vessels {}m away from RK4 after falling back", run.error());
+	}
+
+	return test_end();
+}
@@ -0,0 +1,199 @@
+#include "Test.h"
+#include <universe/propagator/GravityKernel.h>
+#include <universe/kepler/KeplerElements.h>
+#include <glm/gtx/norm.hpp>
+#include <random>
+#include <algorithm>
+#include <cstring>
+
+// Compares GravityKernel against the array-of-structs loop RK4Propagator used before it
+// (every pair evaluated twice, a sqrt and divide each) at 10, 100 and 1000 bodies, for every
+// backend the CPU supports, and benchmarks them.
+// Pass "quick" to skip most of the timing (ctest does)
+
+struct Bodies
+{
+	std::vector<glm::dvec3> pos;
+	std::vector<double> mass;
+	std::vector<double> gm;
+	GravitySoA soa;
+};
+
+static Bodies make_bodies(size_t count, std::mt19937_64& rng)
+{
+	// Spread like a system with moons, masses over many orders of magnitude
+	std::uniform_real_distribution<double> dpos(-5e11, 5e11);
+	std::uniform_real_distribution<double> dexp(15.0, 30.0);
+	Bodies b;
+	b.pos.resize(count);
+	b.mass.resize(count);
+	b.gm.resize(count);
+	b.soa.resize(count);
+	for(size_t i = 0; i < count; i++)
+	{
+		b.pos[i] = glm::dvec3(dpos(rng), dpos(rng), dpos(rng));
+		b.mass[i] = std::pow(10.0, dexp(rng));
+		b.gm[i] = G * b.mass[i];
+		b.soa.x[i] = b.pos[i].x;
+		b.soa.y[i] = b.pos[i].y;
+		b.soa.z[i] = b.pos[i].z;
+	}
+	return b;
+}
+
+// The old RK4Propagator::f loop. scale gets the sum of the magnitudes of every
+// term, as sums with cancellation can't be compared relative to the result
+static void nbody_reference(const Bodies& b, std::vector<glm::dvec3>& acc, std::vector<double>& scale)
+{
+	size_t size = b.pos.size();
+	for(size_t i = 0; i < size; i++)
+	{
+		acc[i] = glm::dvec3(0, 0, 0);
+		scale[i] = 0.0;
+		for(size_t j = 0; j < size; j++)
+		{
+			if(i == j)
+			{
+				continue;
+			}
+
+			glm::dvec3 diff = b.pos[j] - b.pos[i];
+			double dist2 = glm::length2(diff);
+			glm::dvec3 diffn = diff / glm::sqrt(dist2);
+			double am = (G * b.mass[j]) / dist2;
+			acc[i] += diffn * am;
+			scale[i] += am;
+		}
+	}
+}
+
+static void light_reference(const std::vector<glm::dvec3>& lpos, const Bodies& b, std::vector<glm::dvec3>& acc,
+							std::vector<double>& scale)
+{
+	for(size_t i = 0; i < lpos.size(); i++)
+	{
+		acc[i] = glm::dvec3(0, 0, 0);
+		scale[i] = 0.0;
+		for(size_t j = 0; j < b.pos.size(); j++)
+		{
+			glm::dvec3 diff = b.pos[j] - lpos[i];
+			double dist2 = glm::length2(diff);
+			glm::dvec3 diffn = diff / glm::sqrt(dist2);
+			double am = (G * b.mass[j]) / dist2;
+			acc[i] += diffn * am;
+			scale[i] += am;
+		}
+	}
+}
+
+// Biggest error relative to the scale of each body
+static double max_error(const std::vector<glm::dvec3>& ref, const std::vector<double>& scale, const GravitySoA& got)
+{
+	double err = 0.0;
+	for(size_t i = 0; i < ref.size(); i++)
+	{
+		glm::dvec3 g(got.x[i], got.y[i], got.z[i]);
+		err = std::max(err, glm::length(g - ref[i]) / scale[i]);
+	}
+	return err;
+}
+
+static bool bit_identical(const GravitySoA& a, const GravitySoA& b)
+{
+	size_t bytes = a.size() * sizeof(double);
+	return std::memcmp(a.x.data(), b.x.data(), bytes) == 0 &&
+		std::memcmp(a.y.data(), b.y.data(), bytes) == 0 &&
+		std::memcmp(a.z.data(), b.z.data(), bytes) == 0;
+}
+
+int main(int argc, char** argv)
+{
+	test_begin("GravityKernel test");
+	bool quick = argc > 1 && std::string(argv[1]) == "quick";
+	// Roughly the rounding of summing 1000 terms
+	const double TOLERANCE = 1e-12;
+	const size_t LIGHTS = 512;
+
+	std::vector<GravityKernel::Backend> backends;
+	for(int b = 0; b <= (int)GravityKernel::get_best_backend(); b++)
+	{
+		backends.push_back((GravityKernel::Backend)b);
+	}
+	logger->info("Best backend: {}", GravityKernel::get_backend_name(GravityKernel::get_best_backend()));
+
+	std::mt19937_64 rng(1234);
+	for(size_t count : {10, 100, 1000})
+	{
+		Bodies b = make_bodies(count, rng);
+		std::vector<glm::dvec3> ref(count);
+		std::vector<double> scale(count);
+		nbody_reference(b, ref, scale);
+
+		Bodies lights = make_bodies(LIGHTS, rng);
+		std::vector<glm::dvec3> lref(LIGHTS);
+		std::vector<double> lscale(LIGHTS);
+		light_reference(lights.pos, b, lref, lscale);
+
+		// The work of a single evaluation is about the same for every count
+		size_t reps = quick ? 1 : std::max((size_t)1, (size_t)20000000 / (count * count));
+		double ref_time = test_time_best(quick ? 1 : 5, [&]()
+		{
+			for(size_t r = 0; r < reps; r++)
+			{
+				nbody_reference(b, ref, scale);
+			}
+		}) / (double)reps;
+		double lref_time = test_time_best(quick ? 1 : 5, [&]()
+		{
+			light_reference(lights.pos, b, lref, lscale);
+		});
+		logger->info("{} bodies, {} light states. Old loop: nbody {:.3f}us, light {:.3f}us",
+					 count, LIGHTS, ref_time * 1e6, lref_time * 1e6);
+
+		GravitySoA first_light;
+		for(GravityKernel::Backend backend : backends)
+		{
+			const char* name = GravityKernel::get_backend_name(backend);
+
+			GravitySoA acc;
+			acc.resize(count);
+			GravityKernel::nbody(b.soa, b.gm.data(), acc, backend);
+			double err = max_error(ref, scale, acc);
+			TEST_CHECK(err < TOLERANCE, "{} nbody with {} bodies: relative error {}", name, count, err);
+
+			GravitySoA lacc;
+			lacc.resize(LIGHTS);
+			GravityKernel::light(lights.soa, b.soa, b.gm.data(), lacc, backend);
+			double lerr = max_error(lref, lscale, lacc);
+			TEST_CHECK(lerr < TOLERANCE, "{} light with {} bodies: relative error {}", name, count, lerr);
+
+			// Light states must not depend on the backend, or on how the range is split
+			GravitySoA split;
+			split.resize(LIGHTS);
+			GravityKernel::light_range(lights.soa, b.soa, b.gm.data(), split, 0, 37, backend);
+			GravityKernel::light_range(lights.soa, b.soa, b.gm.data(), split, 37, LIGHTS, backend);
+			TEST_CHECK(bit_identical(lacc, split), "{} light with {} bodies: split range differs", name, count);
+			if(first_light.size() == 0)
+			{
+				first_light = lacc;
+			}
+			TEST_CHECK(bit_identical(lacc, first_light), "{} light with {} bodies: differs from scalar", name, count);
+
+			double time = test_time_best(quick ? 1 : 5, [&]()
+			{
+				for(size_t r = 0; r < reps; r++)
+				{
+					GravityKernel::nbody(b.soa, b.gm.data(), acc, backend);
+				}
+			}) / (double)reps;
+			double ltime = test_time_best(quick ? 1 : 5, [&]()
+			{
+				GravityKernel::light(lights.soa, b.soa, b.gm.data(), lacc, backend);
+			});
+			logger->info("  {:<6} nbody {:10.3f}us ({:5.2f}x) light {:10.3f}us ({:5.2f}x) error {:.2e}",
+						 name, time * 1e6, ref_time / time, ltime * 1e6, lref_time / ltime, std::max(err, lerr));
+		}
+	}
+
+	return test_end();
+}
@@ -0,0 +1,117 @@
+#include "Test.h"
+#include "TestSystem.h"
+#include <universe/propagator/RK4Propagator.h>
+#include <algorithm>
+
+// Regression test for the Kepler fast path of RK4Propagator: vessels are propagated with
+// kepler_threshold set and without it (plain RK4), and their positions compared over
+// several orbits. Besides the LEO and low lunar orbit vessels of TestSystem.h, there's a
+// vessel on an elliptical Earth orbit, which leaves the fast path near apogee (the Moon
+// perturbs it) and comes back near perigee. The LEO vessel also does a small burn every
+// orbit, which must be noticed as the state changing under the propagator.
+// Pass "quick" to run a single elliptical orbit instead of 5 (ctest does)
+
+int main(int argc, char** argv)
+{
+	test_begin("Kepler path test");
+	bool quick = argc > 1 && std::string(argv[1]) == "quick";
+
+	TestSystem ref = make_test_system();
+	const CartesianState& earth = ref.st[1];
+	double mu = G * earth.mass;
+
+	// Perigee 7000km, apogee 50000km
+	double rp = 7.0e6;
+	double ra = 5.0e7;
+	double a = (rp + ra) * 0.5;
+	glm::dvec3 ell_rel = glm::dvec3(0.0, 0.0, -rp);
+	LightCartesianState ell;
+	ell.pos = earth.pos + ell_rel;
+	ell.vel = earth.vel + test_circular_vel(mu, ell_rel, glm::dvec3(0.0, 1.0, 0.0)) * glm::sqrt(2.0 - rp / a);
+	ref.ls.push_back(ell);
+	ref.tv.push_back(nullptr);
+	TestSystem fast = ref;
+
+	double leo_period = glm::two_pi<double>() * glm::sqrt(glm::pow(6.771e6, 3.0) / mu);
+	double ell_period = glm::two_pi<double>() * glm::sqrt(a * a * a / mu);
+	size_t orbits = quick ? 1 : 5;
+
+	RK4Propagator ref_prop;
+	RK4Propagator fast_prop;
+	fast_prop.kepler_threshold = 1e-6;
+	ref_prop.bind_to(&ref.st, &ref.ls, &ref.tv);
+	fast_prop.bind_to(&fast.st, &fast.ls, &fast.tv);
+
+	double t = 0.0;
+	double next_burn = leo_period;
+	size_t fast_steps[3] = {0, 0, 0};
+	size_t switches[3] = {0, 0, 0};
+	bool was_fast[3] = {false, false, false};
+	double max_err[3] = {0.0, 0.0, 0.0};
+	size_t burns = 0;
+	bool burned = false;
+	size_t steps = (size_t)(orbits * ell_period);
+	for(size_t s = 0; s < steps; s++)
+	{
+		ref_prop.propagate(1.0);
+		fast_prop.propagate(1.0);
+		t += 1.0;
+
+		// The burn must force a check right away, not on the next periodic one
+		if(burned)
+		{
+			TEST_CHECK(fast_prop.was_kepler_checked(0), "LEO vessel not checked after the burn at {}s", t - 1.0);
+			TEST_CHECK(fast_prop.is_on_kepler_path(0), "LEO vessel left the fast path after the burn at {}s", t - 1.0);
+			burned = false;
+		}
+
+		for(size_t i = 0; i < 3; i++)
+		{
+			bool now = fast_prop.is_on_kepler_path(i);
+			fast_steps[i] += now ? 1 : 0;
+			switches[i] += (s != 0 && now != was_fast[i]) ? 1 : 0;
+			was_fast[i] = now;
+			max_err[i] = std::max(max_err[i], glm::distance(ref.ls[i].pos, fast.ls[i].pos));
+		}
+
+		if(t >= next_burn)
+		{
+			// 1m/s prograde, from outside the propagator
+			glm::dvec3 dv = glm::normalize(ref.ls[0].vel - ref.st[1].vel);
+			ref.ls[0].vel += dv;
+			fast.ls[0].vel += dv;
+			next_burn += leo_period;
+			burns++;
+			burned = true;
+		}
+	}
+
+	const char* names[3] = {"LEO", "LLO", "elliptical"};
+	for(size_t i = 0; i < 3; i++)
+	{
+		logger->info("{:<10} {:5.1f}% steps on the fast path, {} switches, max error {:.3f}m",
+					 names[i], 100.0 * (double)fast_steps[i] / (double)steps, switches[i], max_err[i]);
+	}
+
+	// Checked right away after every burn (above), and still on the fast path
+	TEST_CHECK(burns >= orbits, "Only {} burns in {} orbits", burns, orbits);
+	TEST_CHECK(fast_steps[0] > steps * 99 / 100, "LEO vessel not on the fast path");
+	TEST_CHECK(switches[0] == 0, "LEO vessel left the fast path {} times", switches[0]);
+	// The Earth perturbs low lunar orbits more than the threshold
+	TEST_CHECK(fast_steps[1] == 0, "LLO vessel took the fast path");
+	// Out near apogee, and back in near perigee, every orbit
+	TEST_CHECK(switches[2] >= 2 * orbits, "Elliptical orbit vessel switched only {} times", switches[2]);
+	TEST_CHECK(fast_steps[2] > 0 && fast_steps[2] < steps, "Elliptical orbit vessel never switched paths");
+
+	// Meters per elliptical orbit, about 3 times the error over 5 orbits (LEO 281m, elliptical
+	// 3017m), mostly along track as the perturbations ignored by the fast path shift the phase.
+	// LLO is always on RK4, so it must be the same
+	const double TOLERANCE[3] = {200.0, 1e-6, 2000.0};
+	for(size_t i = 0; i < 3; i++)
+	{
+		TEST_CHECK(max_err[i] <= TOLERANCE[i] * (double)orbits, "{} vessel {}m away from RK4 in {} orbits",
+				   names[i], max_err[i], orbits);
+	}
+
+	return test_end();
+}
@@ -0,0 +1,119 @@
+#include "Test.h"
+#include <universe/predictor/OrbitPredictionServer.h>
+#include <thread>
+#include <algorithm>
+
+// Checks the guarantees clients rely on to be destroyed safely (QuickPredictor jobs
+// capture this): cancel with wait returns only once the running job has returned,
+// and nothing of the client is left pending or started afterwards.
+// Also that jobs of the same client never run at once, and priorities are respected
+
+using namespace std::chrono_literals;
+
+// A job that runs until cancelled, like a prediction that never reaches its timeout
+static OrbitPredictionServer::JobFunction endless_job(std::atomic<bool>& started, std::atomic<bool>& returned)
+{
+	return [&started, &returned](const std::atomic<bool>& cancelled)
+	{
+		started = true;
+		while(!cancelled)
+		{
+			std::this_thread::sleep_for(1ms);
+		}
+		// Slow to return, so cancel really has to wait
+		std::this_thread::sleep_for(20ms);
+		returned = true;
+	};
+}
+
+static bool wait_for(const std::atomic<bool>& flag)
+{
+	for(size_t i = 0; i < 5000 && !flag; i++)
+	{
+		std::this_thread::sleep_for(1ms);
+	}
+	return flag;
+}
+
+int main(int argc, char** argv)
+{
+	test_begin("OrbitPredictionServer test");
+
+	{
+		OrbitPredictionServer server(2);
+		int client;
+		std::atomic<bool> started(false), returned(false);
+		server.submit(&client, OrbitPredictionServer::Priority::VISIBLE, endless_job(started, returned));
+		TEST_CHECK(wait_for(started), "Job never started");
+
+		// A pending job, which must never run
+		std::atomic<bool> pending_ran(false);
+		server.submit(&client, OrbitPredictionServer::Priority::VISIBLE, [&pending_ran](const std::atomic<bool>&)
+		{
+			pending_ran = true;
+		});
+
+		server.cancel(&client, true);
+		TEST_CHECK(returned, "cancel returned while the job was running");
+		TEST_CHECK(!server.is_busy(&client), "Client still busy after cancel");
+		std::this_thread::sleep_for(50ms);
+		TEST_CHECK(!pending_ran, "Pending job ran after cancel");
+	}
+
+	{
+		// Jobs of a client run one after the other, even with free workers
+		OrbitPredictionServer server(4);
+		int client;
+		std::atomic<int> running(0), max_running(0), done(0);
+		for(size_t i = 0; i < 20; i++)
+		{
+			server.submit(&client, OrbitPredictionServer::Priority::VISIBLE, [&](const std::atomic<bool>&)
+			{
+				int now = ++running;
+				max_running = std::max(max_running.load(), now);
+				std::this_thread::sleep_for(2ms);
+				running--;
+				done++;
+			});
+			std::this_thread::sleep_for(1ms);
+		}
+		for(size_t i = 0; i < 1000 && server.is_busy(&client); i++)
+		{
+			std::this_thread::sleep_for(1ms);
+		}
+		TEST_CHECK(max_running == 1, "{} jobs of the same client ran at once", max_running.load());
+		TEST_CHECK(done > 0, "No job ran");
+	}
+
+	{
+		// With the only worker busy, the focused job is started before the others
+		OrbitPredictionServer server(1);
+		int blocker, background, focused;
+		std::atomic<bool> started(false), returned(false);
+		server.submit(&blocker, OrbitPredictionServer::Priority::FOCUSED, endless_job(started, returned));
+		TEST_CHECK(wait_for(started), "Job never started");
+
+		std::mutex order_mtx;
+		std::vector<int*> order;
+		auto record = [&order_mtx, &order](int* client)
+		{
+			return [&order_mtx, &order, client](const std::atomic<bool>&)
+			{
+				std::unique_lock<std::mutex> lock(order_mtx);
+				order.push_back(client);
+			};
+		};
+		server.submit(&background, OrbitPredictionServer::Priority::BACKGROUND, record(&background));
+		server.submit(&focused, OrbitPredictionServer::Priority::FOCUSED, record(&focused));
+		server.cancel(&blocker, true);
+
+		for(size_t i = 0; i < 1000 && (server.is_busy(&background) || server.is_busy(&focused)); i++)
+		{
+			std::this_thread::sleep_for(1ms);
+		}
+		std::unique_lock<std::mutex> lock(order_mtx);
+		TEST_CHECK(order.size() == 2 && order[0] == &focused, "The focused job didn't run first");
+	}
+
+	return test_end();
+}
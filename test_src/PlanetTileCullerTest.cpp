@@ -0,0 +1,205 @@
+#include "Test.h"
+#include <planet_mesher/renderer/PlanetTileCuller.h>
+#include <planet_mesher/mesher/PlanetTilePath.h>
+#include <random>
+#include <algorithm>
+
+// Checks PlanetTileCuller against points sampled over every tile of a planet, for a camera
+// in orbit, one low over the surface looking along it, and one so close to the surface that
+// the near plane cuts through the tile under it. Any tile with a sampled point inside the
+// view and not hidden by the occluder must be drawn, tiles on the far side of the planet must
+// be culled by the horizon, and tiles far enough behind the camera by the frustum.
+
+static const size_t DEPTH = 4;
+static const double FOV = glm::radians(60.0);
+static const double NEAR_PLANE = 0.01;
+
+struct View
+{
+	glm::dvec3 camera;
+	glm::dvec3 forward;
+	glm::dmat4 tile_to_clip;
+};
+
+static View make_view(glm::dvec3 camera, glm::dvec3 target, glm::dvec3 up)
+{
+	View out;
+	out.camera = camera;
+	out.forward = glm::normalize(target - camera);
+	glm::dmat4 proj = glm::perspective(FOV, 1.0, NEAR_PLANE, 100.0);
+	out.tile_to_clip = proj * glm::lookAt(camera, target, up);
+	return out;
+}
+
+// Every tile of the planet at DEPTH, with some height
+static std::vector<PlanetTileCuller::Candidate> make_candidates()
+{
+	std::mt19937_64 rng(1234);
+	std::uniform_real_distribution<double> dmin(-0.002, 0.0);
+	std::uniform_real_distribution<double> drange(0.0, 0.004);
+	std::vector<PlanetTileCuller::Candidate> out;
+	uint32_t side_size = 1u << DEPTH;
+	for(int side = PX; side <= NZ; side++)
+	{
+		for(uint32_t y = 0; y < side_size; y++)
+		{
+			for(uint32_t x = 0; x < side_size; x++)
+			{
+				PlanetTileCuller::Candidate c;
+				c.key = PlanetTileKey::from_xy((PlanetSide)side, DEPTH, x, y);
+				c.min_height = dmin(rng);
+				c.max_height = c.min_height + drange(rng);
+				out.push_back(c);
+			}
+		}
+	}
+	return out;
+}
+
+// Whether any point on a grid over the tile, at its lowest or highest height, is inside
+// the side planes of the view and not behind the occluder
+static bool any_point_visible(const PlanetTileCuller::Candidate& c, const View& view, double occluder_radius)
+{
+	glm::dmat4 model = PlanetTilePath(c.key).get_model_matrix();
+	for(size_t i = 0; i < 25; i++)
+	{
+		glm::dvec4 in_tile = glm::dvec4((double)(i % 5) * 0.25, (double)(i / 5) * 0.25, 0.0, 1.0);
+		glm::dvec3 on_sphere = glm::normalize(MathUtil::cube_to_sphere(glm::dvec3(model * in_tile)));
+		for(double height : {c.min_height, c.max_height})
+		{
+			glm::dvec3 p = on_sphere * (1.0 + height);
+			glm::dvec4 clip = view.tile_to_clip * glm::dvec4(p, 1.0);
+			if(clip.w <= 0.0 || glm::abs(clip.x) > clip.w || glm::abs(clip.y) > clip.w)
+			{
+				continue;
+			}
+
+			// Closest point of the segment from the camera to the center of the planet
+			glm::dvec3 d = p - view.camera;
+			double t = glm::clamp(-glm::dot(view.camera, d) / glm::dot(d, d), 0.0, 1.0);
+			if(glm::length(view.camera + d * t) >= occluder_radius * (1.0 - 1e-9))
+			{
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
+// Returns which candidates are visible, and checks that the culler never drops a visible tile
+static std::vector<bool> check_view(const char* name, const std::vector<PlanetTileCuller::Candidate>& candidates,
+									const View& view)
+{
+	PlanetTileCuller culler;
+	culler.set_view(view.tile_to_clip, view.camera);
+	std::vector<uint32_t> visible_idx;
+	culler.cull(candidates, visible_idx);
+
+	std::vector<bool> visible(candidates.size(), false);
+	for(uint32_t i : visible_idx)
+	{
+		visible[i] = true;
+	}
+	TEST_CHECK(std::is_sorted(visible_idx.begin(), visible_idx.end()), "{}: draw order changed", name);
+	TEST_CHECK(culler.get_last_visible() == visible_idx.size(), "{}: {} visible counted, {} returned",
+			   name, culler.get_last_visible(), visible_idx.size());
+
+	double occluder_radius = 1.0;
+	for(const PlanetTileCuller::Candidate& c : candidates)
+	{
+		occluder_radius = std::min(occluder_radius, 1.0 + c.min_height);
+	}
+
+	size_t missing = 0;
+	for(size_t i = 0; i < candidates.size(); i++)
+	{
+		if(!visible[i] && any_point_visible(candidates[i], view, occluder_radius))
+		{
+			missing++;
+		}
+	}
+	TEST_CHECK(missing == 0, "{}: {} tiles in view were culled", name, missing);
+
+	logger->info("{:<8} {} candidates, {} visible, {} culled by frustum, {} by horizon", name,
+				 culler.get_last_candidates(), culler.get_last_visible(), culler.get_last_frustum_culled(),
+				 culler.get_last_horizon_culled());
+	return visible;
+}
+
+int main(int argc, char** argv)
+{
+	test_begin("PlanetTileCuller test");
+	std::vector<PlanetTileCuller::Candidate> candidates = make_candidates();
+
+	// In orbit, the whole planet is in view, and the far side is beyond the horizon
+	{
+		View view = make_view(glm::dvec3(0.0, 0.0, 3.0), glm::dvec3(0.0), glm::dvec3(0.0, 1.0, 0.0));
+		std::vector<bool> visible = check_view("Orbit", candidates, view);
+		size_t far_side = 0;
+		for(size_t i = 0; i < candidates.size(); i++)
+		{
+			const PlanetTileCuller::Candidate& c = candidates[i];
+			PlanetTileCuller::Bounds bounds = PlanetTileCuller::get_bounds(c.key, c.min_height, c.max_height);
+			// The horizon is at z = 1/3
+			if(bounds.center.z < -0.5)
+			{
+				far_side++;
+				TEST_CHECK(!visible[i], "Tile on the far side drawn, center at z = {}", bounds.center.z);
+			}
+		}
+		TEST_CHECK(far_side > 0, "No tile on the far side, the test doesn't check anything");
+	}
+
+	// Low over the surface, looking along it. The side planes meet at the camera, so with a
+	// half FOV of 30 degrees a bounding sphere is surely outside one of them once its center
+	// is more than 2 radii behind the camera
+	{
+		glm::dvec3 camera = glm::dvec3(0.0, 0.0, 1.05);
+		View view = make_view(camera, camera + glm::dvec3(1.0, 0.0, 0.0), glm::dvec3(0.0, 0.0, 1.0));
+		std::vector<bool> visible = check_view("Low", candidates, view);
+		size_t behind = 0;
+		for(size_t i = 0; i < candidates.size(); i++)
+		{
+			const PlanetTileCuller::Candidate& c = candidates[i];
+			PlanetTileCuller::Bounds bounds = PlanetTileCuller::get_bounds(c.key, c.min_height, c.max_height);
+			double ahead = glm::dot(bounds.center - camera, view.forward);
+			if(ahead < -bounds.radius / glm::sin(FOV * 0.5) * 1.01)
+			{
+				behind++;
+				TEST_CHECK(!visible[i], "Tile behind the camera drawn, center {} ahead", ahead);
+			}
+		}
+		TEST_CHECK(behind > 0, "No tile behind the camera, the test doesn't check anything");
+	}
+
+	// Closer to the surface than the near plane, looking down at an angle. The tile under the
+	// camera is cut by the near plane, it must still be drawn
+	{
+		glm::dvec3 ground = glm::normalize(glm::dvec3(0.3, 0.2, 1.0));
+		glm::dvec3 camera = ground * (1.0 + 0.002 + NEAR_PLANE * 0.1);
+		glm::dvec3 tangent = glm::normalize(glm::cross(ground, glm::dvec3(0.0, 1.0, 0.0)));
+		View view = make_view(camera, camera + tangent - ground * 0.5, ground);
+		std::vector<bool> visible = check_view("Near", candidates, view);
+
+		size_t under = 0;
+		double best = 1e300;
+		for(size_t i = 0; i < candidates.size(); i++)
+		{
+			PlanetTileCuller::Bounds bounds = PlanetTileCuller::get_bounds(candidates[i].key, 0.0, 0.0);
+			double dist = glm::distance(bounds.center, ground);
+			if(dist < best)
+			{
+				best = dist;
+				under = i;
+			}
+		}
+		const PlanetTileCuller::Candidate& c = candidates[under];
+		PlanetTileCuller::Bounds bounds = PlanetTileCuller::get_bounds(c.key, c.min_height, c.max_height);
+		double ahead = glm::dot(bounds.center - camera, view.forward);
+		TEST_CHECK(ahead - bounds.radius < NEAR_PLANE && ahead + bounds.radius > NEAR_PLANE,
+				   "The near plane doesn't cut the tile under the camera ({} ahead, radius {})", ahead, bounds.radius);
+		TEST_CHECK(visible[under], "Tile cut by the near plane culled");
+	}
+
+	return test_end();
+}
@@ -0,0 +1,319 @@
+#include "Test.h"
+#include <universe/vehicle/plumbing/PlumbingNetwork.h>
+#include <glm/glm.hpp>
+#include <random>
+#include <limits>
+#include <algorithm>
+
+// Checks the nodal plumbing solver on the cases the path solver handles (a single path
+// between two true ports, through pipes, a pump, a check valve and a flow limiter) against
+// the flow the path solver gives: k * sqrt(start pressure - drops - end pressure), limited.
+// The path solver gives a path the conductance of a single pipe however long it is, the
+// network puts its pipes in series, so the reference uses the conductance of the series.
+// Then random networks, with junctions, loops, pumps, check valves and limiters, which the
+// path solver can't handle. Their solution is checked with the exact sqrt law: balancing
+// every junction on its own, starting from the solver pressures, must barely change flows.
+// Pass "quick" for less random networks (ctest does)
+
+static const double NaN = std::numeric_limits<double>::quiet_NaN();
+// Same as VehiclePlumbing
+static const double PIPE_K = 0.0001;
+static const double MACHINE_K = PIPE_K * 100.0;
+
+// Flow of the path solver over a path made of edges of the given conductances
+static double path_flow(double start_P, double end_P, double drop, const std::vector<double>& ks, double max_flow = -1.0)
+{
+	double inv = 0.0;
+	for(double k : ks)
+	{
+		inv += 1.0 / (k * k);
+	}
+	double dp = start_P - drop - end_P;
+	double flow = dp > 0.0 ? glm::sqrt(dp / inv) : 0.0;
+	return max_flow >= 0.0 ? glm::min(flow, max_flow) : flow;
+}
+
+static double relative_error(double value, double expected)
+{
+	return glm::abs(value - expected) / glm::max(glm::abs(expected), 1e-12);
+}
+
+// Exact sqrt law, no smoothing around 0
+static double reference_flow(const PlumbingNetwork::Edge& edge, double dp)
+{
+	double flow = 0.0;
+	if(dp - edge.drop > 0.0)
+	{
+		flow = edge.k * glm::sqrt(dp - edge.drop);
+	}
+	else if(edge.reversible && -dp - edge.reverse_drop > 0.0)
+	{
+		flow = -edge.k * glm::sqrt(-dp - edge.reverse_drop);
+	}
+	if(edge.max_flow >= 0.0)
+	{
+		flow = glm::clamp(flow, -edge.max_flow, edge.max_flow);
+	}
+	return flow;
+}
+
+// Nonlinear Gauss-Seidel: every free node is balanced by bisection given its neighbours.
+// Converges very slowly from far away, so it starts from the solver pressures. Returns the
+// flow out of every node
+static std::vector<double> reference_solve(const PlumbingNetwork& net, size_t sweeps)
+{
+	std::vector<double> pressure(net.nodes.size());
+	for(size_t n = 0; n < net.nodes.size(); n++)
+	{
+		pressure[n] = net.nodes[n].pressure;
+	}
+
+	std::vector<std::vector<size_t>> node_edges(net.nodes.size());
+	for(size_t i = 0; i < net.edges.size(); i++)
+	{
+		node_edges[net.edges[i].from].push_back(i);
+		node_edges[net.edges[i].to].push_back(i);
+	}
+
+	auto net_flow = [&](size_t n, double P)
+	{
+		double sum = 0.0;
+		for(size_t i : node_edges[n])
+		{
+			const PlumbingNetwork::Edge& edge = net.edges[i];
+			if(edge.from == n)
+			{
+				sum += reference_flow(edge, P - pressure[edge.to]);
+			}
+			else
+			{
+				sum -= reference_flow(edge, pressure[edge.from] - P);
+			}
+		}
+		return sum;
+	};
+
+	for(size_t sweep = 0; sweep < sweeps; sweep++)
+	{
+		for(size_t n = 0; n < net.nodes.size(); n++)
+		{
+			if(net.nodes[n].fixed || node_edges[n].empty())
+			{
+				continue;
+			}
+			double lo = -1e7, hi = 1e7;
+			for(size_t it = 0; it < 80; it++)
+			{
+				double mid = (lo + hi) * 0.5;
+				(net_flow(n, mid) > 0.0 ? hi : lo) = mid;
+			}
+			pressure[n] = (lo + hi) * 0.5;
+		}
+	}
+
+	std::vector<double> out(net.nodes.size());
+	for(size_t n = 0; n < net.nodes.size(); n++)
+	{
+		out[n] = net_flow(n, pressure[n]);
+	}
+	return out;
+}
+
+int main(int argc, char** argv)
+{
+	test_begin("PlumbingNetwork test");
+	bool quick = argc > 1 && std::string(argv[1]) == "quick";
+	// The sqrt law is smoothed below 1 unit of pressure difference
+	const double TOLERANCE = 1e-4;
+
+	{
+		// Tank, pipe, engine: the same as the path solver
+		PlumbingNetwork net;
+		uint32_t tank = net.add_node(true, 3e5);
+		uint32_t engine = net.add_node(true, 1e5);
+		net.add_edge(tank, engine, PIPE_K, true);
+		net.build();
+		TEST_CHECK(net.solve(nullptr), "Single pipe didn't converge");
+		double expected = path_flow(3e5, 1e5, 0.0, {PIPE_K});
+		TEST_CHECK(relative_error(net.nodes[tank].net_flow, expected) < TOLERANCE,
+				   "Single pipe flow {}, expected {}", net.nodes[tank].net_flow, expected);
+	}
+
+	{
+		// Tank, pipe, machine, pipe, engine, the machine is then a pump
+		PlumbingNetwork net;
+		uint32_t tank = net.add_node(true, 3e5);
+		uint32_t in = net.add_node(false, NaN);
+		uint32_t out = net.add_node(false, NaN);
+		uint32_t engine = net.add_node(true, 1e5);
+		net.add_edge(tank, in, PIPE_K, true);
+		uint32_t machine = net.add_edge(in, out, MACHINE_K, true);
+		net.add_edge(out, engine, PIPE_K, true);
+		net.build();
+
+		TEST_CHECK(net.solve(nullptr), "Series pipes didn't converge");
+		double expected = path_flow(3e5, 1e5, 0.0, {PIPE_K, MACHINE_K, PIPE_K});
+		TEST_CHECK(relative_error(net.nodes[tank].net_flow, expected) < TOLERANCE,
+				   "Series pipes flow {}, expected {}", net.nodes[tank].net_flow, expected);
+		TEST_CHECK(relative_error(-net.nodes[engine].net_flow, expected) < TOLERANCE,
+				   "Series pipes take {} and give {}", net.nodes[tank].net_flow, -net.nodes[engine].net_flow);
+
+		TEST_CHECK(net.solve(nullptr) && net.get_last_iterations() == 0,
+				   "Solving again took {} iterations", net.get_last_iterations());
+
+		net.edges[machine].has_drop = true;
+		auto pump = [&net](size_t i)
+		{
+			net.edges[i].drop = -1e5;
+			net.edges[i].reverse_drop = 1e5;
+		};
+		TEST_CHECK(net.solve(pump), "Pump didn't converge");
+		expected = path_flow(3e5, 1e5, -1e5, {PIPE_K, MACHINE_K, PIPE_K});
+		TEST_CHECK(relative_error(net.nodes[tank].net_flow, expected) < TOLERANCE,
+				   "Pump flow {}, expected {}", net.nodes[tank].net_flow, expected);
+
+		// Pumping against a higher pressure
+		net.nodes[tank].pressure = 1e5;
+		net.nodes[engine].pressure = 1.5e5;
+		TEST_CHECK(net.solve(pump), "Pump against pressure didn't converge");
+		expected = path_flow(1e5, 1.5e5, -1e5, {PIPE_K, MACHINE_K, PIPE_K});
+		TEST_CHECK(relative_error(net.nodes[tank].net_flow, expected) < TOLERANCE,
+				   "Pump against pressure flow {}, expected {}", net.nodes[tank].net_flow, expected);
+	}
+
+	{
+		// Check valve, open one way and closed the other
+		for(bool open : {true, false})
+		{
+			PlumbingNetwork net;
+			uint32_t tank = net.add_node(true, open ? 3e5 : 1e5);
+			uint32_t in = net.add_node(false, NaN);
+			uint32_t out = net.add_node(false, NaN);
+			uint32_t engine = net.add_node(true, open ? 1e5 : 3e5);
+			net.add_edge(tank, in, PIPE_K, true);
+			net.add_edge(in, out, MACHINE_K, false);
+			net.add_edge(out, engine, PIPE_K, true);
+			net.build();
+			TEST_CHECK(net.solve(nullptr), "Check valve didn't converge");
+			double expected = open ? path_flow(3e5, 1e5, 0.0, {PIPE_K, MACHINE_K, PIPE_K}) : 0.0;
+			double flow = net.nodes[tank].net_flow;
+			TEST_CHECK(open ? relative_error(flow, expected) < TOLERANCE : glm::abs(flow) < 1e-6,
+					   "Check valve ({}) flow {}, expected {}", open ? "open" : "closed", flow, expected);
+		}
+	}
+
+	{
+		// A limiter on one of two engines fed by the same tank
+		PlumbingNetwork net;
+		uint32_t tank = net.add_node(true, 3e5);
+		uint32_t junction = net.add_node(false, NaN);
+		uint32_t engine_a = net.add_node(true, 1e5);
+		uint32_t engine_b = net.add_node(true, 1e5);
+		net.add_edge(tank, junction, PIPE_K, true);
+		uint32_t limited = net.add_edge(junction, engine_a, PIPE_K, true);
+		net.add_edge(junction, engine_b, PIPE_K, true);
+		net.edges[limited].max_flow = 0.005;
+		net.build();
+		TEST_CHECK(net.solve(nullptr), "Limiter didn't converge");
+		TEST_CHECK(glm::abs(-net.nodes[engine_a].net_flow - 0.005) < 0.005 * TOLERANCE,
+				   "Limited engine takes {}, limit is 0.005", -net.nodes[engine_a].net_flow);
+		// The free engine takes the rest, through the tank pipe and its own in series
+		double expected = path_flow(3e5, 1e5, 0.0, {PIPE_K, PIPE_K});
+		double flow = -net.nodes[engine_b].net_flow;
+		TEST_CHECK(flow > 0.005 && flow < expected, "Free engine takes {}", flow);
+		TEST_CHECK(relative_error(net.nodes[tank].net_flow, flow + 0.005) < TOLERANCE,
+				   "Tank gives {}, engines take {}", net.nodes[tank].net_flow, flow + 0.005);
+	}
+
+	// Random networks: tanks and engines on junctions joined by pipes, some of them pumps,
+	// check valves or limited. Same networks every run
+	std::mt19937 rng(1);
+	std::uniform_real_distribution<double> u(0.0, 1.0);
+	size_t networks = quick ? 20 : 200;
+	size_t failed = 0, cold_iterations = 0, warm_iterations = 0;
+	double worst = 0.0;
+	for(size_t trial = 0; trial < networks; trial++)
+	{
+		PlumbingNetwork net;
+		const uint32_t TANKS = 8, ENGINES = 8, JUNCTIONS = 60;
+		for(uint32_t i = 0; i < TANKS; i++)
+		{
+			net.add_node(true, 2e5 + 3e5 * u(rng));
+		}
+		for(uint32_t i = 0; i < ENGINES; i++)
+		{
+			net.add_node(true, 1e5 * u(rng));
+		}
+		for(uint32_t i = 0; i < JUNCTIONS; i++)
+		{
+			net.add_node(false, NaN);
+		}
+		for(uint32_t i = 0; i < TANKS + ENGINES; i++)
+		{
+			net.add_edge(i, TANKS + ENGINES + (uint32_t)(rng() % JUNCTIONS), PIPE_K, true);
+		}
+		for(uint32_t i = 0; i < JUNCTIONS * 2; i++)
+		{
+			uint32_t a = TANKS + ENGINES + (uint32_t)(rng() % JUNCTIONS);
+			uint32_t b = TANKS + ENGINES + (uint32_t)(rng() % JUNCTIONS);
+			if(a == b)
+			{
+				continue;
+			}
+			uint32_t e = net.add_edge(a, b, MACHINE_K * (0.5 + u(rng)), u(rng) > 0.1);
+			net.edges[e].has_drop = u(rng) < 0.1;
+			if(u(rng) < 0.05)
+			{
+				net.edges[e].max_flow = 0.01;
+			}
+		}
+		net.build();
+		auto pumps = [&net](size_t i)
+		{
+			net.edges[i].drop = -2e4;
+			net.edges[i].reverse_drop = 2e4;
+		};
+
+		// With the default tolerance (a thousandth of the biggest flow) junctions are left
+		// unbalanced enough for true ports to be a few percent off
+		bool converged = net.solve(pumps, 64, 128, 1e-6);
+		cold_iterations += net.get_last_iterations();
+
+		double max_flow = 0.0;
+		for(size_t n = 0; n < net.nodes.size(); n++)
+		{
+			max_flow = glm::max(max_flow, glm::abs(net.nodes[n].net_flow));
+		}
+		// The drops are constant, so the reference can use them as they are now
+		std::vector<double> ref = reference_solve(net, 20);
+		double error = 0.0;
+		for(size_t n = 0; n < TANKS + ENGINES; n++)
+		{
+			error = glm::max(error, glm::abs(net.nodes[n].net_flow - ref[n]) / glm::max(max_flow, 1e-12));
+		}
+		worst = glm::max(worst, error);
+		if(!converged || error > 1e-2)
+		{
+			failed++;
+			logger->error("Network {}: converged {}, residual {}, true ports {} of the biggest flow away from "
+						  "the reference", trial, converged, net.get_last_residual(), error);
+		}
+
+		// Tanks change a bit from one tick to the next
+		for(uint32_t i = 0; i < TANKS; i++)
+		{
+			net.nodes[i].pressure *= 1.01;
+		}
+		net.solve(pumps, 64, 128, 1e-6);
+		warm_iterations += net.get_last_iterations();
+	}
+
+	double cold = (double)cold_iterations / (double)networks;
+	double warm = (double)warm_iterations / (double)networks;
+	logger->info("{} random networks: {} failed, worst true port flow {:.2e} of the biggest flow away from the "
+				 "reference, {:.1f} iterations cold, {:.1f} warm", networks, failed, worst, cold, warm);
+	TEST_CHECK(failed == 0, "{} of {} random networks failed", failed, networks);
+	TEST_CHECK(warm < cold, "Warm start took {} iterations, cold {}", warm, cold);
+
+	return test_end();
+}
@@ -0,0 +1,94 @@
+#include "Test.h"
+#include "TestSystem.h"
+#include <universe/propagator/SystemPropagator.h>
+#include <universe/propagator/DormandPrincePropagator.h>
+#include <memory>
+
+// Accuracy against cost of every integrator SystemPropagator::create knows, stepped like
+// QuickPredictor does (1s steps, adaptive ones from saved point to saved point).
+// On the system of TestSystem.h, for each integrator it reports the wall time per simulated
+// day, the energy drift of the massive bodies, and how far the vessels end from a tight
+// tolerance Dormand-Prince reference.
+// Pass "quick" to simulate 3 hours instead of 1 day (ctest does)
+
+static double energy(const StateVector& st)
+{
+	double e = 0.0;
+	for(size_t i = 0; i < st.size(); i++)
+	{
+		e += 0.5 * st[i].mass * glm::length2(st[i].vel);
+		for(size_t j = i + 1; j < st.size(); j++)
+		{
+			e -= G * st[i].mass * st[j].mass / glm::distance(st[i].pos, st[j].pos);
+		}
+	}
+	return e;
+}
+
+struct RunResult
+{
+	double wall;
+	double drift;
+	TestSystem end;
+};
+
+static RunResult run(SystemPropagator& prop, double duration)
+{
+	RunResult res;
+	res.end = make_test_system();
+	prop.bind_to(&res.end.st, &res.end.ls, &res.end.tv);
+	double e0 = energy(res.end.st);
+
+	// Same as QuickPredictor
+	double step = prop.is_adaptive() ? 10.0 : 1.0;
+	size_t steps = (size_t)(duration / step);
+	auto start = std::chrono::steady_clock::now();
+	for(size_t i = 0; i < steps; i++)
+	{
+		prop.propagate(step);
+	}
+	res.wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	res.drift = (energy(res.end.st) - e0) / std::abs(e0);
+	return res;
+}
+
+int main(int argc, char** argv)
+{
+	test_begin("Propagator benchmark");
+	bool quick = argc > 1 && std::string(argv[1]) == "quick";
+	double duration = quick ? 3.0 * 3600.0 : 86400.0;
+	double day_scale = 86400.0 / duration;
+
+	DormandPrincePropagator reference;
+	reference.tolerance = 1e-14;
+	reference.abs_tolerance = 1e-9;
+	reference.max_step = 5.0;
+	RunResult ref = run(reference, duration);
+	logger->info("Reference (dopri54, tolerance 1e-14): {} steps, {:.2f}s", reference.accepted_steps, ref.wall);
+
+	logger->info("{:<10} {:>14} {:>12} {:>14} {:>14}", "integrator", "wall per day", "system dE/E",
+				 "LEO error", "LLO error");
+	for(const char* name : {"rk4", "dopri54", "leapfrog", "yoshida4"})
+	{
+		std::unique_ptr<SystemPropagator> prop(SystemPropagator::create(name));
+		TEST_CHECK(prop != nullptr, "{} is not known by SystemPropagator::create", name);
+		if(!prop)
+		{
+			continue;
+		}
+
+		RunResult res = run(*prop, duration);
+		double leo_err = glm::distance(res.end.ls[0].pos, ref.end.ls[0].pos);
+		double llo_err = glm::distance(res.end.ls[1].pos, ref.end.ls[1].pos);
+		logger->info("{:<10} {:>12.2f}ms {:>12.2e} {:>12.3f}m {:>12.3f}m",
+					 name, res.wall * day_scale * 1000.0, res.drift, leo_err, llo_err);
+
+		// Loose bounds, over ten times what the worst one (leapfrog, ~300m in LEO) does in a day,
+		// they are here to catch broken integrators, not to compare them
+		TEST_CHECK(std::abs(res.drift) < 1e-10, "{} drifts too much in energy: {}", name, res.drift);
+		TEST_CHECK(leo_err < 5000.0, "{} vessel in LEO too far from the reference: {}m", name, leo_err);
+		TEST_CHECK(llo_err < 5000.0, "{} vessel in LLO too far from the reference: {}m", name, llo_err);
+	}
+
+	return test_end();
+}
@@ -0,0 +1,175 @@
+#include "Test.h"
+#include <planet_mesher/quadtree/QuadTreeLod.h>
+#include <set>
+#include <algorithm>
+
+// Checks the incremental updates of QuadTreeLod: a camera comes down from orbit to the
+// surface while a landed vehicle observes another spot. Every update must stay within
+// the split / merge bounds, the drawn tiles must cover the whole planet, and stationary
+// observers must settle. Then the merge hysteresis: moving away, only nodes whose error
+// fell below half the pixel error are merged, so nodes between half and the full pixel
+// error stay split, and going back and forth doesn't make nodes flicker.
+// Pass "quick" for a shorter descent (ctest does)
+
+static const double PIXEL_ERROR = 16.0;
+static const double PIXELS_PER_RADIAN = 1080.0;
+
+static bool all_loaded(PlanetTileKey)
+{
+	return true;
+}
+
+// Sum of the area of the drawn tiles, in cube faces, must be 6 with no gaps or overlaps
+static double get_render_area(const QuadTreeLod& lod)
+{
+	std::vector<PlanetTileKey> render;
+	lod.get_render_keys(all_loaded, render);
+	double area = 0.0;
+	for(PlanetTileKey key : render)
+	{
+		area += glm::pow(4.0, -(double)key.get_depth());
+	}
+	return area;
+}
+
+// Nodes with children
+static std::set<PlanetTileKey> get_split_keys(const QuadTreeLod& lod)
+{
+	std::vector<PlanetTileKey> all, leafs;
+	lod.get_all_keys(all);
+	lod.get_leaf_keys(leafs);
+	std::set<PlanetTileKey> out(all.begin(), all.end());
+	for(PlanetTileKey key : leafs)
+	{
+		out.erase(key);
+	}
+	return out;
+}
+
+// Returns the number of updates, max_updates if it didn't settle
+static size_t settle(QuadTreeLod& lod, size_t max_updates, size_t max_ops)
+{
+	for(size_t i = 0; i < max_updates; i++)
+	{
+		bool changed = lod.update(all_loaded);
+		TEST_CHECK(lod.get_last_splits() <= max_ops && lod.get_last_merges() <= max_ops,
+				   "{} splits and {} merges in an update", lod.get_last_splits(), lod.get_last_merges());
+		if(!changed)
+		{
+			return i;
+		}
+	}
+	return max_updates;
+}
+
+static std::vector<LodObserver> observer_at(glm::dvec3 pos)
+{
+	return {LodObserver{pos, PIXELS_PER_RADIAN}};
+}
+
+int main(int argc, char** argv)
+{
+	test_begin("QuadTreeLod test");
+	bool quick = argc > 1 && std::string(argv[1]) == "quick";
+	size_t frames = quick ? 1000 : 3000;
+
+	// Default bounds, and very tight ones which are always hit
+	for(size_t max_ops : {32, 4})
+	{
+		QuadTreeLod lod(16, PIXEL_ERROR, 32.0, max_ops, max_ops);
+		glm::dvec3 vehicle = glm::dvec3(0.0, 0.0, 1.0001);
+		size_t max_splits = 0, max_merges = 0;
+		double camera_alt = 0.0;
+		for(size_t f = 0; f < frames; f++)
+		{
+			double a = (double)f * 0.002 * 3000.0 / (double)frames;
+			camera_alt = 1.0 + 2.0 * glm::exp(-(double)f / ((double)frames * 0.1));
+			glm::dvec3 camera = glm::normalize(glm::dvec3(glm::cos(a), glm::sin(a), 0.3)) * camera_alt;
+			lod.set_observers({LodObserver{camera, PIXELS_PER_RADIAN}, LodObserver{vehicle, PIXELS_PER_RADIAN}});
+			lod.update(all_loaded);
+
+			max_splits = std::max(max_splits, lod.get_last_splits());
+			max_merges = std::max(max_merges, lod.get_last_merges());
+			if(f % 100 == 0)
+			{
+				double area = get_render_area(lod);
+				TEST_CHECK(glm::abs(area - 6.0) < 1e-9, "Drawn tiles cover {} faces at frame {}", area, f);
+			}
+		}
+		logger->info("Bound {}: at most {} splits and {} merges per update, {} nodes", max_ops,
+					 max_splits, max_merges, lod.get_node_count());
+		TEST_CHECK(max_splits <= max_ops, "{} splits in an update, bound is {}", max_splits, max_ops);
+		TEST_CHECK(max_merges <= max_ops, "{} merges in an update, bound is {}", max_merges, max_ops);
+		TEST_CHECK(max_splits == max_ops, "The descent never hit the split bound of {}", max_ops);
+
+		size_t updates = settle(lod, 1000, max_ops);
+		TEST_CHECK(updates < 1000, "Stationary observers didn't settle");
+		double area = get_render_area(lod);
+		TEST_CHECK(glm::abs(area - 6.0) < 1e-9, "Drawn tiles cover {} faces after settling", area);
+	}
+
+	{
+		QuadTreeLod lod(16, PIXEL_ERROR, 32.0);
+		glm::dvec3 near_pos = glm::normalize(glm::dvec3(0.3, 0.2, 1.0)) * 1.01;
+		glm::dvec3 far_pos = near_pos * 1.02;
+		lod.set_observers(observer_at(near_pos));
+		TEST_CHECK(settle(lod, 1000, 32) < 1000, "Didn't settle near the surface");
+
+		// Settled: leafs are under the pixel error, and split nodes over half of it
+		std::vector<PlanetTileKey> leafs;
+		lod.get_leaf_keys(leafs);
+		for(PlanetTileKey key : leafs)
+		{
+			double error = lod.get_error(key, QuadTreeLod::get_center(key));
+			TEST_CHECK(key.get_depth() == 16 || error <= PIXEL_ERROR, "Settled leaf with {} pixels of error", error);
+		}
+		std::set<PlanetTileKey> split_near = get_split_keys(lod);
+
+		// Moving away, what would merge with the threshold at the pixel error, and what must
+		lod.set_observers(observer_at(far_pos));
+		size_t in_band = 0;
+		for(PlanetTileKey key : split_near)
+		{
+			double error = lod.get_error(key, QuadTreeLod::get_center(key));
+			if(error >= PIXEL_ERROR * 0.5 && error < PIXEL_ERROR)
+			{
+				in_band++;
+			}
+		}
+		TEST_CHECK(settle(lod, 1000, 32) < 1000, "Didn't settle after moving away");
+		std::set<PlanetTileKey> split_far = get_split_keys(lod);
+		size_t merged = 0, kept_in_band = 0;
+		for(PlanetTileKey key : split_near)
+		{
+			double error = lod.get_error(key, QuadTreeLod::get_center(key));
+			if(split_far.count(key) == 0)
+			{
+				merged++;
+				TEST_CHECK(error < PIXEL_ERROR * 0.5, "Node merged with {} pixels of error", error);
+			}
+			else if(error < PIXEL_ERROR)
+			{
+				kept_in_band++;
+			}
+		}
+		logger->info("Hysteresis: {} of {} split nodes under the pixel error after moving away, {} merged",
+					 in_band, split_near.size(), merged);
+		TEST_CHECK(in_band > 0, "No node fell under the pixel error, the test doesn't check anything");
+		TEST_CHECK(kept_in_band >= in_band, "Only {} of {} nodes between half and the full pixel error stayed split",
+				   kept_in_band, in_band);
+
+		// Back and forth: the first round trip may split nodes back, then nothing changes
+		lod.set_observers(observer_at(near_pos));
+		settle(lod, 1000, 32);
+		size_t flicker = 0;
+		for(size_t i = 0; i < 20; i++)
+		{
+			lod.set_observers(observer_at(i % 2 == 0 ? far_pos : near_pos));
+			lod.update(all_loaded);
+			flicker += lod.get_last_splits() + lod.get_last_merges();
+		}
+		TEST_CHECK(flicker == 0, "{} splits and merges going back and forth", flicker);
+	}
+
+	return test_end();
+}
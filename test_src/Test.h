@@ -0,0 +1,57 @@
+#pragma once
+#include <util/Logger.h>
+#include <chrono>
+#include <string>
+
+// Helpers for the test and benchmark executables in test_src, which are run by ctest.
+// A failed check is logged and the test keeps going, so a single run shows every failure.
+// The executable returns 1 if any check failed
+
+inline int test_failures = 0;
+
+inline void test_fail(const char* file, int line, const char* cond, const std::string& msg)
+{
+	logger->error("{}({}): '{}' failed: {}", file, line, cond, msg);
+	test_failures++;
+}
+
+// The message is a format string and its arguments, like logger calls
+#define TEST_CHECK(cond, ...) \
+	do { if(!(cond)) { test_fail(__FILE__, __LINE__, #cond, fmt::format(__VA_ARGS__)); } } while(0)
+
+// Wall time in seconds of the fastest of runs calls to fn, to keep noise out of benchmarks
+template<typename F>
+double test_time_best(size_t runs, F&& fn)
+{
+	double best = 1e300;
+	for(size_t i = 0; i < runs; i++)
+	{
+		auto start = std::chrono::steady_clock::now();
+		fn();
+		double t = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		best = t < best ? t : best;
+	}
+	return best;
+}
+
+inline void test_begin(const char* name)
+{
+	create_global_logger();
+	logger->info("Running {}", name);
+}
+
+// Returns the exit code
+inline int test_end()
+{
+	int ret = test_failures == 0 ? 0 : 1;
+	if(ret == 0)
+	{
+		logger->info("All checks passed");
+	}
+	else
+	{
+		logger->error("{} checks failed", test_failures);
+	}
+	destroy_global_logger();
+	return ret;
+}
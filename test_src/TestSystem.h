@@ -0,0 +1,56 @@
+#pragma once
+#include <universe/UniverseDefinitions.h>
+#include <universe/kepler/KeplerElements.h>
+#include <glm/gtx/norm.hpp>
+
+// A small system like the debug system (whose package is not in the tree): a star, an
+// Earth-Moon pair and a gas giant, with a vessel in a polar LEO (around every 90 minutes)
+// and another in low lunar orbit, in that order
+
+struct TestSystem
+{
+	StateVector st;
+	LightStateVector ls;
+	TrajectoryVector tv;
+};
+
+inline glm::dvec3 test_circular_vel(double gm, glm::dvec3 rel_pos, glm::dvec3 axis)
+{
+	return glm::normalize(glm::cross(axis, rel_pos)) * glm::sqrt(gm / glm::length(rel_pos));
+}
+
+inline TestSystem make_test_system()
+{
+	const double AU = 1.496e11;
+	glm::dvec3 up = glm::dvec3(0.0, 1.0, 0.0);
+	TestSystem sys;
+
+	CartesianState star(glm::dvec3(0.0), glm::dvec3(0.0), 1.989e30);
+	double gm_star = G * star.mass;
+
+	glm::dvec3 earth_pos = glm::dvec3(AU, 0.0, 0.0);
+	CartesianState earth(earth_pos, test_circular_vel(gm_star, earth_pos, up), 5.972e24);
+
+	glm::dvec3 moon_rel = glm::dvec3(0.0, 0.0, 3.844e8);
+	CartesianState moon(earth_pos + moon_rel, earth.vel + test_circular_vel(G * earth.mass, moon_rel, up), 7.342e22);
+
+	// Tilted a bit, so not everything is on a plane
+	glm::dvec3 giant_pos = glm::dvec3(-3.0 * AU, 1e10, 4.2 * AU);
+	CartesianState giant(giant_pos, test_circular_vel(gm_star, giant_pos, up), 1.898e27);
+
+	sys.st = {star, earth, moon, giant};
+
+	glm::dvec3 leo_rel = glm::dvec3(6.771e6, 0.0, 0.0);
+	LightCartesianState leo;
+	leo.pos = earth.pos + leo_rel;
+	leo.vel = earth.vel + test_circular_vel(G * earth.mass, leo_rel, glm::dvec3(0.0, 0.0, 1.0));
+
+	glm::dvec3 llo_rel = glm::dvec3(1.837e6, 0.0, 0.0);
+	LightCartesianState llo;
+	llo.pos = moon.pos + llo_rel;
+	llo.vel = moon.vel + test_circular_vel(G * moon.mass, llo_rel, up);
+
+	sys.ls = {leo, llo};
+	sys.tv = {nullptr, nullptr};
+	return sys;
+}